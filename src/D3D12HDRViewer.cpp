@@ -26,8 +26,13 @@
 #include "D3D12HDRViewer.h"
 #include <dxgidebug.h>
 #include <Commdlg.h>
+#include <psapi.h>
 #include <sstream>
+#include <fstream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 
 // DirectXTex
 #include "DirectXTexEXR.h"
@@ -41,6 +46,11 @@
 #include "palettePS.hlsl.h"
 #include "presentVS.hlsl.h"
 #include "presentPS.hlsl.h"
+#include "fusedSRGBPS.hlsl.h"
+#include "fusedST2084PS.hlsl.h"
+#include "fusedLinearPS.hlsl.h"
+#include "luminanceHistogramCS.hlsl.h"
+#include "OutputTransform.h"
 
 const float D3D12HDRViewer::ClearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 const float D3D12HDRViewer::HDRMetaDataPool[4][4] =
@@ -53,6 +63,28 @@ const float D3D12HDRViewer::HDRMetaDataPool[4][4] =
     { 2000.0f, 1.000f, 2000.0f, 1000.0f }
 };
 
+// imgui's font atlas goes through the texture uploader like everything else.
+static bool UploadImGuiTexture(ID3D12Resource* texture, const unsigned char* pixels, int width, int height, void* userData)
+{
+	DirectX::Image image = {};
+	image.width = static_cast<size_t>(width);
+	image.height = static_cast<size_t>(height);
+	image.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	image.rowPitch = image.width * 4;
+	image.slicePitch = image.rowPitch * image.height;
+	image.pixels = const_cast<uint8_t*>(pixels);
+
+	return SUCCEEDED(static_cast<TextureUploader*>(userData)->UploadSubresources(texture, &image, 1));
+}
+
+// Allocated size of the intermediate render target for a window dimension:
+// an eighth of headroom, rounded up to 64 pixels, so that small resizes fit.
+static UINT AlignRenderTargetSize(UINT size)
+{
+	const UINT aligned = (size + size / 8 + 63) & ~63u;
+	return std::max<UINT>(size, std::min<UINT>(aligned, D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION));
+}
+
 std::string float_to_string(float f, int digits)
 {
 
@@ -74,14 +106,20 @@ D3D12HDRViewer::D3D12HDRViewer(UINT width, UINT height, std::wstring name) :
     m_currentSwapChainBitDepth(_8),
     m_swapChainFormatChanged(false),
     m_intermediateRenderTargetFormat(DXGI_FORMAT_R16G16B16A16_FLOAT),
+    m_intermediateWidth(0),
+    m_intermediateHeight(0),
     m_rtvDescriptorSize(0),
-    m_srvDescriptorSize(0),
     m_dxgiFactoryFlags(0),
     m_rootConstants{},
     m_fenceValues{},
+    m_frameCount(2),
+    m_frameLatencyWaitableObject(nullptr),
     m_windowVisible(true),
     m_windowedMode(true),
     m_in_sizechanging(false),
+    m_pendingWidth(width),
+    m_pendingHeight(height),
+    m_resizePending(false),
 	m_evValue(0.0f)
 {
 	// Alias the root constants so that we can easily set them as either floats or UINTs.
@@ -92,6 +130,13 @@ void D3D12HDRViewer::OnInit()
 {
 	LoadPipeline();
 	LoadAssets();
+
+	m_imageCache.reset(new ImageCache(static_cast<size_t>(m_imageCacheSizeMB) * 1024 * 1024));
+	m_tileCache.reset(new ImageCache(static_cast<size_t>(m_tileCacheSizeMB) * 1024 * 1024));
+	m_imageLoader.reset(new ImageLoader(m_textureUploader.get(), m_imageCache.get(), m_tileCache.get()));
+	m_imageLoader->SetViewSize(m_width, m_height);
+	m_imageLoader->SetProgressive(m_progressiveLoad);
+	m_imageLoader->SetStreaming(m_streamLoads);
 }
 
 // Load the rendering pipeline dependencies.
@@ -146,8 +191,10 @@ void D3D12HDRViewer::LoadPipeline()
 	NAME_D3D12_OBJECT(m_commandQueue);
 
 	// Describe and create the swap chain.
+	m_frameCount = std::min<UINT>(std::max<UINT>(m_swapChainBufferCount, 2), MaxFrameCount);
+
 	DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-	swapChainDesc.BufferCount = FrameCount;
+	swapChainDesc.BufferCount = m_frameCount;
 	swapChainDesc.Width = m_width;
 	swapChainDesc.Height = m_height;
 	swapChainDesc.Format = m_swapChainFormats[m_currentSwapChainBitDepth];
@@ -157,6 +204,10 @@ void D3D12HDRViewer::LoadPipeline()
 
 	// It is recommended to always use the tearing flag when it is available.
 	swapChainDesc.Flags = m_tearingSupport ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0;
+	if (m_waitableSwapChain)
+	{
+		swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+	}
 
 	ComPtr<IDXGISwapChain1> swapChain;
 	ThrowIfFailed(m_dxgiFactory->CreateSwapChainForHwnd(
@@ -176,12 +227,23 @@ void D3D12HDRViewer::LoadPipeline()
 	}
 
 	ThrowIfFailed(swapChain.As(&m_swapChain));
+
+	if (m_waitableSwapChain)
+	{
+		m_maxFrameLatency = std::min<UINT>(std::max<UINT>(m_maxFrameLatency, 1), DXGI_MAX_SWAP_CHAIN_BUFFERS);
+		ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(m_maxFrameLatency));
+		m_frameLatencyWaitableObject = m_swapChain->GetFrameLatencyWaitableObject();
+	}
+
+	LARGE_INTEGER qpcFrequency;
+	QueryPerformanceFrequency(&qpcFrequency);
+	m_qpcFrequency = qpcFrequency.QuadPart;
     
     // Check display HDR support and initialize ST.2084 support to match the display's support.
     CheckDisplayHDRSupport();
     m_enableST2084 = m_hdrSupport;
     EnsureSwapChainColorSpace(m_currentSwapChainBitDepth, m_enableST2084);
-    SetHDRMetaData(HDRMetaDataPool[m_hdrMetaDataPoolIdx][0], HDRMetaDataPool[m_hdrMetaDataPoolIdx][1], HDRMetaDataPool[m_hdrMetaDataPoolIdx][2], HDRMetaDataPool[m_hdrMetaDataPoolIdx][3]);
+    ApplyHDRMetaData();
 
 	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 
@@ -189,24 +251,45 @@ void D3D12HDRViewer::LoadPipeline()
 	{
 		// Describe and create a render target view (RTV) descriptor heap.
 		D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-		rtvHeapDesc.NumDescriptors = FrameCount + 2;	// A descriptor for each frame + 2 intermediate render targets.
+		rtvHeapDesc.NumDescriptors = m_frameCount + 2;	// A descriptor for each frame + 2 intermediate render targets.
 		rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
 		rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 		ThrowIfFailed(m_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&m_rtvHeap)));
 
-		// Describe and create a shader resource view (SRV) descriptor heap.
-		D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-		srvHeapDesc.NumDescriptors = 100;					// A descriptor for each of the 2 intermediate render targets.
-		srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-		ThrowIfFailed(m_device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&m_srvHeap)));
+		// Describe and create the shader resource view (SRV) descriptor heaps.
+		m_srvHeap = std::make_unique<DescriptorHeap>(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+			ShaderVisibleDescriptorCount, TransientDescriptorCountPerFrame, m_frameCount);
+		m_srvStagingHeap = std::make_unique<DescriptorHeap>(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
+			StagingDescriptorCount);
+
+		// The sources of the per-frame SRV table live as long as the app.
+		for (UINT n = 0; n < SrvTableSlotCount; n++)
+		{
+			ThrowIfFailed(m_srvStagingHeap->Allocate(1, m_srvTableSources[n]));
+		}
+
+		// The scene slot stays a null view unless the two-pass path allocates
+		// the intermediate render target.
+		D3D12_SHADER_RESOURCE_VIEW_DESC nullSrvDesc = {};
+		nullSrvDesc.Format = m_intermediateRenderTargetFormat;
+		nullSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		nullSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		nullSrvDesc.Texture2D.MipLevels = 1;
+		m_device->CreateShaderResourceView(nullptr, &nullSrvDesc, m_srvTableSources[SceneSrvSlot].cpuHandle);
+
+		// Likewise the 3D LUT slot until a LUT is first baked or loaded.
+		D3D12_SHADER_RESOURCE_VIEW_DESC nullLutSrvDesc = {};
+		nullLutSrvDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		nullLutSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+		nullLutSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		nullLutSrvDesc.Texture3D.MipLevels = 1;
+		m_device->CreateShaderResourceView(nullptr, &nullLutSrvDesc, m_srvTableSources[OutputLut3DSrvSlot].cpuHandle);
 
 		m_rtvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-		m_srvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	}
 
 	// Create a command allocator for each frame.
-	for (UINT n = 0; n < FrameCount; n++)
+	for (UINT n = 0; n < m_frameCount; n++)
 	{
 		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocators[n])));
 	}
@@ -216,9 +299,8 @@ void D3D12HDRViewer::LoadPipeline()
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE imguiCPUHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), IMGUI_HEAP_OFFSET, m_srvDescriptorSize);
-	CD3DX12_GPU_DESCRIPTOR_HANDLE imguiGPUHandle(m_srvHeap->GetGPUDescriptorHandleForHeapStart(), IMGUI_HEAP_OFFSET, m_srvDescriptorSize);
-	ImGui_ImplDX12_Init(Win32Application::GetHwnd(), FrameCount, m_device.Get(), m_swapChainFormats[m_currentSwapChainColorSpace], imguiCPUHandle, imguiGPUHandle);
+	ThrowIfFailed(m_srvHeap->Allocate(1, m_imguiFontSrv));
+	ImGui_ImplDX12_Init(Win32Application::GetHwnd(), m_frameCount, m_device.Get(), GetBackBufferFormat(), m_imguiFontSrv.cpuHandle, m_imguiFontSrv.gpuHandle);
 	ImGui::StyleColorsDark();
 }
 
@@ -230,21 +312,29 @@ void D3D12HDRViewer::LoadAssets()
 	// intermediate render targets.
 	{
 		CD3DX12_DESCRIPTOR_RANGE ranges[1];
-		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0);
+		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, SrvTableSlotCount, 0);
 
 		CD3DX12_ROOT_PARAMETER rootParameters[2];
-		rootParameters[0].InitAsConstants(4, 0);
+		rootParameters[0].InitAsConstants(RootConstantsCount, 0);
 		rootParameters[1].InitAsDescriptorTable(1, &ranges[0]);
 
-		D3D12_STATIC_SAMPLER_DESC sampler = {};
-		sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
-		sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
-		sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
-		sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
-		sampler.BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE;
-		sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
-		sampler.MaxLOD = D3D12_FLOAT32_MAX;
-		sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		D3D12_STATIC_SAMPLER_DESC samplers[2] = {};
+		samplers[0].Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
+		samplers[0].AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+		samplers[0].AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+		samplers[0].AddressW = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+		samplers[0].BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE;
+		samplers[0].ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+		samplers[0].MaxLOD = D3D12_FLOAT32_MAX;
+		samplers[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+		// Trilinear filtering of the 3D LUT.
+		samplers[1] = samplers[0];
+		samplers[1].Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+		samplers[1].AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+		samplers[1].AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+		samplers[1].AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+		samplers[1].ShaderRegister = 1;
 
 		// Allow input layout and deny uneccessary access to certain pipeline stages.
 		D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
@@ -254,7 +344,7 @@ void D3D12HDRViewer::LoadAssets()
 			D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
 
 		CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-		rootSignatureDesc.Init(_countof(rootParameters), rootParameters, 1, &sampler, rootSignatureFlags);
+		rootSignatureDesc.Init(_countof(rootParameters), rootParameters, _countof(samplers), samplers, rootSignatureFlags);
 
 		ComPtr<ID3DBlob> signature;
 		ComPtr<ID3DBlob> error;
@@ -313,6 +403,53 @@ void D3D12HDRViewer::LoadAssets()
 
 		psoDesc.RTVFormats[0] = m_swapChainFormats[_16];
 		ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineStates[Present16bitPSO])));
+
+		// Create the fused pipeline states, which sample the image and encode it
+		// for the display in a single pass. The curve is compiled into each
+		// shader, and each is built for every swap chain format.
+		const D3D12_SHADER_BYTECODE fusedShaders[DisplayCurveCount] =
+		{
+			CD3DX12_SHADER_BYTECODE(g_fusedSRGBPS, sizeof(g_fusedSRGBPS)),
+			CD3DX12_SHADER_BYTECODE(g_fusedST2084PS, sizeof(g_fusedST2084PS)),
+			CD3DX12_SHADER_BYTECODE(g_fusedLinearPS, sizeof(g_fusedLinearPS)),
+		};
+
+		for (UINT curve = 0; curve < DisplayCurveCount; curve++)
+		{
+			psoDesc.PS = fusedShaders[curve];
+			for (UINT bitDepth = 0; bitDepth < SwapChainBitDepthCount; bitDepth++)
+			{
+				psoDesc.RTVFormats[0] = m_swapChainFormats[bitDepth];
+				ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineStates[FusedPSO + curve * SwapChainBitDepthCount + bitDepth])));
+			}
+		}
+	}
+
+	// Create the root signature and pipeline state of the luminance histogram:
+	// root constants with the image size, the image SRV and two root UAVs for
+	// the results.
+	{
+		CD3DX12_DESCRIPTOR_RANGE ranges[1];
+		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+		CD3DX12_ROOT_PARAMETER rootParameters[4];
+		rootParameters[0].InitAsConstants(3, 0);
+		rootParameters[1].InitAsDescriptorTable(1, &ranges[0]);
+		rootParameters[2].InitAsUnorderedAccessView(0);
+		rootParameters[3].InitAsUnorderedAccessView(1);
+
+		CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+		rootSignatureDesc.Init(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+		ComPtr<ID3DBlob> signature;
+		ComPtr<ID3DBlob> error;
+		ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
+		ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_histogramRootSignature)));
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+		psoDesc.pRootSignature = m_histogramRootSignature.Get();
+		psoDesc.CS = CD3DX12_SHADER_BYTECODE(g_luminanceHistogramCS, sizeof(g_luminanceHistogramCS));
+		ThrowIfFailed(m_device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&m_histogramPipelineState)));
 	}
 
 	// Create the command list.
@@ -368,76 +505,129 @@ void D3D12HDRViewer::LoadAssets()
 		m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
 	}
 
-	LoadSizeDependentResources();
-	ComPtr<ID3D12Resource>	textureUploadHeap;
-
-	// Create Heat map Texture
+	// Create the ST.2084 and sRGB encoding LUT. It is static, so it is copied
+	// once with the vertex buffer and read through a typed buffer SRV.
 	{
+		const UINT lutSize = GetOutputCurveLutSize() * sizeof(float);
 
-		DirectX::TexMetadata metaData;
-		DirectX::ScratchImage scratchImage;
+		ThrowIfFailed(m_device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(lutSize),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&m_curveLut)));
+		NAME_D3D12_OBJECT(m_curveLut);
 
-		ThrowIfFailed(LoadFromDDSFile(L"heatmap.dds", 0, &metaData, scratchImage));
+		ThrowIfFailed(m_device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(lutSize),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_curveLutUpload)));
+
+		UINT8* mappedUploadHeap = nullptr;
+		ThrowIfFailed(m_curveLutUpload->Map(0, &CD3DX12_RANGE(0, 0), reinterpret_cast<void**>(&mappedUploadHeap)));
+		memcpy(mappedUploadHeap, GetOutputCurveLut(), lutSize);
+		m_curveLutUpload->Unmap(0, &CD3DX12_RANGE(0, 0));
 
-		const size_t subresoucesize = metaData.mipLevels;
+		m_commandList->CopyBufferRegion(m_curveLut.Get(), 0, m_curveLutUpload.Get(), 0, lutSize);
+		m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_curveLut.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 
-		D3D12_RESOURCE_DESC textureDesc = {};
-		textureDesc.Width = metaData.width;
-		textureDesc.Height = static_cast<UINT>(metaData.height);
-		textureDesc.MipLevels = static_cast<UINT16>(subresoucesize);
-		textureDesc.Format = metaData.format;
-		textureDesc.DepthOrArraySize = static_cast<UINT16>(metaData.arraySize);
-		textureDesc.SampleDesc.Quality = 0;
-		textureDesc.SampleDesc.Count = 1;
-		textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-		textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.NumElements = GetOutputCurveLutSize();
+		m_device->CreateShaderResourceView(m_curveLut.Get(), &srvDesc, m_srvTableSources[CurveLutSrvSlot].cpuHandle);
+	}
 
+	// Create the luminance histogram's results buffer, the initial results it is
+	// reset from before each run, and the timestamps around the dispatch. The
+	// per group sums and the readback buffer grow with the image.
+	{
 		ThrowIfFailed(m_device->CreateCommittedResource(
 			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
 			D3D12_HEAP_FLAG_NONE,
-			&textureDesc,
-			D3D12_RESOURCE_STATE_COPY_DEST,
+			&CD3DX12_RESOURCE_DESC::Buffer(HistogramResultsSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+			D3D12_RESOURCE_STATE_COMMON,
 			nullptr,
-			IID_PPV_ARGS(m_heatmapTexture.ReleaseAndGetAddressOf())));
-		NAME_D3D12_OBJECT(m_heatmapTexture);
-
-		std::vector<D3D12_SUBRESOURCE_DATA> subresouceData;
-		for (size_t i = 0; i < subresoucesize; i++)
-		{
-			D3D12_SUBRESOURCE_DATA subresouce;
-
-			subresouce.pData = scratchImage.GetImages()[i].pixels;
-			subresouce.RowPitch = scratchImage.GetImages()[i].rowPitch;
-			subresouce.SlicePitch = scratchImage.GetImages()[i].slicePitch;
+			IID_PPV_ARGS(&m_histogramResults)));
+		NAME_D3D12_OBJECT(m_histogramResults);
 
-			subresouceData.push_back(subresouce);
-		}
-		const size_t uploadBufferSize = GetRequiredIntermediateSize(m_heatmapTexture.Get(), 0, static_cast<uint32_t>(subresoucesize));
-		
-		// Create the GPU upload buffer.
 		ThrowIfFailed(m_device->CreateCommittedResource(
 			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
 			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
+			&CD3DX12_RESOURCE_DESC::Buffer(HistogramResultsSize),
 			D3D12_RESOURCE_STATE_GENERIC_READ,
 			nullptr,
-			IID_PPV_ARGS(textureUploadHeap.ReleaseAndGetAddressOf())));
-		NAME_D3D12_OBJECT(textureUploadHeap);
+			IID_PPV_ARGS(&m_histogramResultsClear)));
 
-		UpdateSubresources(m_commandList.Get(), m_heatmapTexture.Get(), textureUploadHeap.Get(), 0, 0, static_cast<UINT>(subresoucesize), &subresouceData[0]);
+		// The minimum starts at FLT_MAX, everything else at 0.
+		UINT8* mappedUploadHeap = nullptr;
+		ThrowIfFailed(m_histogramResultsClear->Map(0, &CD3DX12_RANGE(0, 0), reinterpret_cast<void**>(&mappedUploadHeap)));
+		memset(mappedUploadHeap, 0, HistogramResultsSize);
+		const float minNits = FLT_MAX;
+		memcpy(mappedUploadHeap, &minNits, sizeof(minNits));
+		m_histogramResultsClear->Unmap(0, nullptr);
+
+		D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+		queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+		queryHeapDesc.Count = 2;
+		ThrowIfFailed(m_device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_histogramQueries)));
+	}
 
-		m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_heatmapTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+	LoadSizeDependentResources();
 
-		CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), HEATMAP_HEAP_OFFSET, m_srvDescriptorSize);
+	// Every texture upload, including imgui's font atlas, is staged in one
+	// persistent upload ring.
+	m_uploadRing.reset(new UploadRing(m_device.Get(), static_cast<UINT64>(std::max<UINT>(m_uploadRingSizeMB, 1)) * 1024 * 1024));
+	m_textureUploader.reset(new TextureUploader(m_device.Get(), m_uploadRing.get(), static_cast<size_t>(m_texturePoolSizeMB) * 1024 * 1024));
 
-		// Describe and create a SRV for the texture.
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-		srvDesc.Format = textureDesc.Format;
-		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MipLevels = static_cast<UINT>(subresoucesize);
+	ImGui_ImplDX12_SetUploadTextureFn(UploadImGuiTexture, m_textureUploader.get());
+
+	// Create the ImGui pipeline state for every swap chain format up front, so
+	// switching the output curve never creates one.
+	for (UINT n = 0; n < SwapChainBitDepthCount; n++)
+	{
+		ImGui_ImplDX12_SetRenderTargetFormat(m_swapChainFormats[n]);
+	}
+	ImGui_ImplDX12_SetRenderTargetFormat(GetBackBufferFormat());
+
+	// Create Heat map Texture
+	{
+		DirectX::TexMetadata metaData;
+		DirectX::ScratchImage scratchImage;
+
+		ThrowIfFailed(LoadFromDDSFile(L"heatmap.dds", 0, &metaData, scratchImage));
+
+		// Keep the row the shaders sample (v = 0.05) for baking the 3D LUT.
+		const DirectX::Image* image = scratchImage.GetImage(0, 0, 0);
+		if (image && image->format == DXGI_FORMAT_R8G8B8A8_UNORM)
+		{
+			const uint8_t* row = image->pixels + static_cast<size_t>(0.05f * image->height) * image->rowPitch;
+			m_heatmapRow.resize(image->width * 3);
+			for (size_t x = 0; x < image->width; x++)
+			{
+				for (size_t c = 0; c < 3; c++)
+				{
+					m_heatmapRow[x * 3 + c] = row[x * 4 + c] / 255.0f;
+				}
+			}
+		}
 
-		m_device->CreateShaderResourceView(m_heatmapTexture.Get(), &srvDesc, srvHandle);
+		std::shared_ptr<UploadedTexture> heatmap;
+		ThrowIfFailed(m_textureUploader->Upload(metaData, scratchImage, heatmap));
+
+		// The heatmap is kept for the whole run, outside of the texture pool.
+		D3D12UploadedTexture* texture = static_cast<D3D12UploadedTexture*>(heatmap.get());
+		texture->pool.reset();
+		m_heatmapTexture = texture->resource;
+		NAME_D3D12_OBJECT(m_heatmapTexture);
+		ThrowIfFailed(m_commandQueue->Wait(texture->copyFence.Get(), texture->copyFenceValue));
+
+		m_device->CreateShaderResourceView(m_heatmapTexture.Get(), &texture->srvDesc, m_srvTableSources[HeatmapSrvSlot].cpuHandle);
 	}
 
 	// Close the command list and execute it to begin the vertex buffer copy into
@@ -476,8 +666,7 @@ void D3D12HDRViewer::LoadAssets()
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 		srvDesc.Texture2D.MipLevels = static_cast<UINT>(1);
 
-		CD3DX12_CPU_DESCRIPTOR_HANDLE	srvHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), HDR_TEXTURE_HEAP_OFFSET, m_srvDescriptorSize);
-		m_device->CreateShaderResourceView(m_hdrTexture.Get(), &srvDesc, srvHandle);
+		m_device->CreateShaderResourceView(m_hdrTexture.Get(), &srvDesc, m_srvTableSources[HdrTextureSrvSlot].cpuHandle);
 		
 	}
 
@@ -508,7 +697,7 @@ void D3D12HDRViewer::LoadSizeDependentResources()
 		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
 
 		// Create a RTV for each frame.
-		for (UINT n = 0; n < FrameCount; n++)
+		for (UINT n = 0; n < m_frameCount; n++)
 		{
 			ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
 			m_device->CreateRenderTargetView(m_renderTargets[n].Get(), nullptr, rtvHandle);
@@ -517,28 +706,38 @@ void D3D12HDRViewer::LoadSizeDependentResources()
 			NAME_D3D12_OBJECT_INDEXED(m_renderTargets, n);
 		}
 
-		// Create the intermediate render target and an RTV for it.
-		D3D12_RESOURCE_DESC renderTargetDesc = m_renderTargets[0]->GetDesc();
-		renderTargetDesc.Format = m_intermediateRenderTargetFormat;
-
-		D3D12_CLEAR_VALUE clearValue = {};
-		clearValue.Format = m_intermediateRenderTargetFormat;
-
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&renderTargetDesc,
-			D3D12_RESOURCE_STATE_RENDER_TARGET,
-			&clearValue,
-			IID_PPV_ARGS(&m_intermediateRenderTarget)));
-
-		NAME_D3D12_OBJECT(m_intermediateRenderTarget);
-
-		m_device->CreateRenderTargetView(m_intermediateRenderTarget.Get(), nullptr, rtvHandle);
-		rtvHandle.Offset(1, m_rtvDescriptorSize);
-
-		CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), RENDER_TARGET_OFFSET);
-		m_device->CreateShaderResourceView(m_intermediateRenderTarget.Get(), nullptr, srvHandle);
+		// Only the two-pass path needs the intermediate render target. It is
+		// allocated with some headroom and kept while the window fits in it,
+		// unless the window shrank to a fraction of it.
+		const bool fits = m_width <= m_intermediateWidth && m_height <= m_intermediateHeight;
+		const bool wasteful = static_cast<UINT64>(m_width) * m_height * 4 < static_cast<UINT64>(m_intermediateWidth) * m_intermediateHeight;
+		if (m_twoPassComposite && (!m_intermediateRenderTarget || !fits || wasteful))
+		{
+			m_intermediateRenderTarget.Reset();
+			m_intermediateWidth = AlignRenderTargetSize(m_width);
+			m_intermediateHeight = AlignRenderTargetSize(m_height);
+
+			D3D12_RESOURCE_DESC renderTargetDesc = m_renderTargets[0]->GetDesc();
+			renderTargetDesc.Format = m_intermediateRenderTargetFormat;
+			renderTargetDesc.Width = m_intermediateWidth;
+			renderTargetDesc.Height = m_intermediateHeight;
+
+			D3D12_CLEAR_VALUE clearValue = {};
+			clearValue.Format = m_intermediateRenderTargetFormat;
+
+			ThrowIfFailed(m_device->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+				D3D12_HEAP_FLAG_NONE,
+				&renderTargetDesc,
+				D3D12_RESOURCE_STATE_RENDER_TARGET,
+				&clearValue,
+				IID_PPV_ARGS(&m_intermediateRenderTarget)));
+
+			NAME_D3D12_OBJECT(m_intermediateRenderTarget);
+
+			m_device->CreateRenderTargetView(m_intermediateRenderTarget.Get(), nullptr, rtvHandle);
+			m_device->CreateShaderResourceView(m_intermediateRenderTarget.Get(), nullptr, m_srvTableSources[SceneSrvSlot].cpuHandle);
+		}
 	}
 
 	m_viewport.Width = static_cast<float>(m_width);
@@ -567,6 +766,114 @@ inline XMFLOAT3 D3D12HDRViewer::TransformVertex(XMFLOAT2 point, XMFLOAT2 offset)
 	return result;
 }
 
+// What RenderScene passes to the shaders, so that changing any of it redraws
+// the view whichever code path changed it.
+ViewState D3D12HDRViewer::GetViewState() const
+{
+	ViewState state;
+	state.exposure = m_evValue;
+	state.referenceWhiteNits = m_referenceWhiteNits;
+	state.curve = m_rootConstants[DisplayCurve];
+	state.heatmap = m_isHeatmap;
+	state.curveLut = m_useCurveLut;
+	state.lut3DSize = m_useOutputLut3D ? m_outputLut3DSize : 0;
+	return state;
+}
+
+// Keep rendering while a load is in flight so that its progress and bands show
+// up; otherwise only when something invalidated the view.
+bool D3D12HDRViewer::NeedsRender() const
+{
+	return DXSample::NeedsRender() || (m_imageLoader && m_imageLoader->IsBusy());
+}
+
+// Wakes the idle main loop when a load posts a result.
+HANDLE D3D12HDRViewer::GetWakeEvent() const
+{
+	return m_imageLoader ? m_imageLoader->GetResultEvent() : nullptr;
+}
+
+// -metadata: prints the luminance statistics of each file and the HDR10
+// metadata derived from them, then the metadata of all of them as one sequence,
+// as CSV on the console the viewer was started from. Files are measured with
+// the loader's analysis, at their own nits, without exposure or reference white.
+int D3D12HDRViewer::RunHeadless()
+{
+	// The viewer is a GUI app and has no console of its own.
+	if (AttachConsole(ATTACH_PARENT_PROCESS))
+	{
+		FILE* stream = nullptr;
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+		freopen_s(&stream, "CONOUT$", "w", stderr);
+	}
+
+	// The WIC codecs used for JPEG XR need COM on this thread.
+	HRESULT hrCOM = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	std::vector<std::wstring> files;
+	for (const std::wstring& path : m_metadataReportPaths)
+	{
+		const DWORD attributes = GetFileAttributes(path.c_str());
+		if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			std::vector<std::wstring> directoryFiles = ListImageFiles(path);
+			files.insert(files.end(), directoryFiles.begin(), directoryFiles.end());
+		}
+		else
+		{
+			files.push_back(path);
+		}
+	}
+
+	auto toUTF8 = [](const std::wstring& text)
+	{
+		const int length = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), -1, nullptr, 0, nullptr, nullptr);
+		std::string result(std::max<int>(length, 1) - 1, ' ');
+		WideCharToMultiByte(CP_UTF8, 0, text.c_str(), -1, &result[0], length, nullptr, nullptr);
+		return result;
+	};
+
+	printf("file,pixels,min_nits,mean_nits,max_nits,max_cll,max_fall,max_mastering_nits,min_mastering_nits,analyze_ms\n");
+
+	int exitCode = 0;
+	ContentLightLevels sequence;
+	for (const std::wstring& file : files)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		LuminanceStatistics statistics;
+		HRESULT hr = AnalyzeImageFile(file, statistics);
+		const double analyzeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (FAILED(hr))
+		{
+			fprintf(stderr, "\"%s\": failed (0x%08X)\n", toUTF8(file).c_str(), static_cast<unsigned int>(hr));
+			exitCode = 1;
+			continue;
+		}
+
+		ContentLightLevels levels;
+		AddContentLightLevels(statistics, levels);
+		AddContentLightLevels(statistics, sequence);
+		const HDR10Metadata metadata = DeriveHDR10Metadata(levels);
+
+		printf("\"%s\",%llu,%.4f,%.2f,%.2f,%.0f,%.0f,%.0f,%.4f,%.1f\n", toUTF8(file).c_str(),
+			static_cast<unsigned long long>(statistics.pixelCount), statistics.minNits, statistics.meanNits, statistics.maxNits,
+			metadata.maxCLL, metadata.maxFALL, metadata.maxMasteringNits, metadata.minMasteringNits, analyzeMs);
+	}
+
+	if (sequence.frameCount > 0)
+	{
+		const HDR10Metadata metadata = DeriveHDR10Metadata(sequence);
+		printf("sequence,,,,,%.0f,%.0f,%.0f,%.4f,\n", metadata.maxCLL, metadata.maxFALL, metadata.maxMasteringNits, metadata.minMasteringNits);
+	}
+	fflush(stdout);
+
+	if (SUCCEEDED(hrCOM))
+	{
+		CoUninitialize();
+	}
+	return exitCode;
+}
+
 // Update frame-based values.
 void D3D12HDRViewer::OnUpdate()
 {
@@ -574,9 +881,26 @@ void D3D12HDRViewer::OnUpdate()
 	{
 		OpenFile();
 	}
-	if (m_isLoadTexture)
+	if (m_openCubeDialog)
+	{
+		OpenCubeFile();
+	}
+
+	LoadResult result;
+	if (m_imageLoader->Poll(result))
+	{
+		PublishTexture(result);
+	}
+
+	// The loader measures every image off the render thread, so following a
+	// sequence only costs a comparison per frame and a call when a level changes.
+	if (m_hdrMetaDataSource != HDRMetaDataFromPool)
 	{
-		LoadTexture(m_textureName, m_format, HDR_TEXTURE_HEAP_OFFSET);
+		const HDR10Metadata metadata = GetHDRMetaData();
+		if (memcmp(&metadata, &m_hdrMetaData, sizeof(metadata)) != 0)
+		{
+			ApplyHDRMetaData();
+		}
 	}
 }
 
@@ -585,14 +909,35 @@ void D3D12HDRViewer::OnRender()
 {
 	if (m_windowVisible)
 	{
+		if (m_frameLatencyWaitableObject)
+		{
+			// Wait until the swap chain can take another frame, so the frame is
+			// built from current input rather than queued behind older ones.
+			WaitForSingleObjectEx(m_frameLatencyWaitableObject, 1000, TRUE);
+		}
+
+		LARGE_INTEGER frameStart;
+		QueryPerformanceCounter(&frameStart);
+		m_frameStartQpc = frameStart.QuadPart;
+
 		IMGuiUpdate();
 
 		PIXBeginEvent(m_commandQueue.Get(), 0, L"Render Scene");
 		RenderScene();
 		PIXEndEvent(m_commandQueue.Get());
 
-		// Present the frame.
-		ThrowIfFailed(m_swapChain->Present(1, 0));
+		// Present the frame. Tearing is only allowed in windowed and borderless
+		// fullscreen mode, which is all the app uses when it is supported.
+		if (m_allowTearing && m_tearingSupport)
+		{
+			ThrowIfFailed(m_swapChain->Present(0, DXGI_PRESENT_ALLOW_TEARING));
+		}
+		else
+		{
+			ThrowIfFailed(m_swapChain->Present(1, 0));
+		}
+		RecordPresent();
+		RecordFrameStatistics();
 
 		MoveToNextFrame();
 	}
@@ -619,25 +964,13 @@ void D3D12HDRViewer::OpenFile()
 		
 	if (GetOpenFileName(&ofn))
 	{
-		m_textureName = ofn.lpstrFile;
-		size_t extCount = m_textureName.find_last_of(L".");
-		std::wstring extname = m_textureName.substr(extCount, m_textureName.size() - extCount);
-
-		TextureFromat format = Unsupported;
-		if (extname == L".exr")
-		{
-			m_format = OpenEXR;
-			m_isLoadTexture = true;
-		}
-		else if (extname == L".dds")
-		{
-			m_format = DDS;
-			m_isLoadTexture = true;
-		}
-		else if (extname == L".jxr")
+		std::wstring filepath = ofn.lpstrFile;
+		if (GetImageFileFormat(filepath) != ImageFileFormat::Unsupported)
 		{
-			m_format = JXR;
-			m_isLoadTexture = true;
+			size_t separator = filepath.find_last_of(L"\\/");
+			m_directoryFiles = ListImageFiles(filepath.substr(0, separator));
+			m_sequenceLightLevels = ContentLightLevels();
+			ShowImage(filepath);
 		}
 	}
 
@@ -645,148 +978,555 @@ void D3D12HDRViewer::OpenFile()
 	SetCurrentDirectory(currentDirectry);
 }
 
-
-HRESULT D3D12HDRViewer::LoadTexture(std::wstring  filepath, const TextureFromat textureFormat, const uint32_t heapOffset)
+void D3D12HDRViewer::OpenCubeFile()
 {
-	ThrowIfFailed(m_commandAllocators[m_frameIndex]->Reset());
-	ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), m_pipelineStates[PalettePSO].Get()));
-	
-	ComPtr<ID3D12Resource>	textureUploadHeap;
+	m_openCubeDialog = false;
 
-	HRESULT hr = S_OK;
-	
-	DirectX::TexMetadata metaData;
-	std::unique_ptr<ScratchImage> scratchImage(new (std::nothrow) ScratchImage);
+	wchar_t currentDirectry[MAX_PATH];
+	GetCurrentDirectory(MAX_PATH+1, currentDirectry);
 
-	if (textureFormat== DDS)
+	OPENFILENAME ofn;
+	wchar_t szFile[MAX_PATH] = L"";
+	ZeroMemory(&ofn, sizeof(ofn));
+	ofn.lStructSize = sizeof(OPENFILENAME);
+	ofn.lpstrFilter = L"Cube LUT(*.cube)\0*.cube\0\0";
+	ofn.lpstrFile = szFile;
+	ofn.nMaxFile = MAX_PATH;
+	ofn.Flags = OFN_FILEMUSTEXIST;
+
+	if (GetOpenFileName(&ofn))
 	{
-		// DDS
-		ThrowIfFailed(LoadFromDDSFile(filepath.c_str(), 0, &metaData, *scratchImage));
+		std::wstring filepath = ofn.lpstrFile;
+		std::ifstream file(filepath);
+		std::stringstream text;
+		text << file.rdbuf();
+
+		OutputLut3D lut;
+		if (file && ParseCubeFile(text.str(), lut, m_cubeLutError))
+		{
+			m_cubeLut = std::move(lut);
+			// imgui draws UTF-8.
+			const std::wstring filename = filepath.substr(filepath.find_last_of(L"\\/") + 1);
+			const int length = WideCharToMultiByte(CP_UTF8, 0, filename.c_str(), -1, nullptr, 0, nullptr, nullptr);
+			m_cubeLutName.assign(std::max<int>(length, 1) - 1, '\0');
+			WideCharToMultiByte(CP_UTF8, 0, filename.c_str(), -1, &m_cubeLutName[0], length, nullptr, nullptr);
+			m_cubeLutError.clear();
+			m_cubeLutGeneration++;
+			m_useOutputLut3D = true;
+		}
+		else if (!file)
+		{
+			m_cubeLutError = "Cannot read the file";
+		}
 	}
-	else if (textureFormat == OpenEXR)
+
+	SetCurrentDirectory(currentDirectry);
+}
+
+// Bakes the 3D LUT again if a setting it depends on has changed since the last
+// bake, or uploads the loaded .cube file, and points the LUT slot at the result.
+void D3D12HDRViewer::UpdateOutputLut3D()
+{
+	if (!m_useOutputLut3D)
 	{
-		// OpenEXR
-		ThrowIfFailed(LoadFromEXRFile(filepath.c_str(), &metaData, *scratchImage));
+		return;
 	}
-	else if (textureFormat == JXR)
+
+	OutputTransformParams params;
+	params.curve = static_cast<OutputCurve>(std::min<UINT>(m_rootConstants[DisplayCurve], DisplayCurveCount - 1));
+	params.standardNits = m_referenceWhiteNits;
+	if (m_isHeatmap && !m_heatmapRow.empty())
 	{
-		// JPEG XR
-		ThrowIfFailed(LoadFromWICFile(filepath.c_str(), 0, &metaData, *scratchImage));
+		params.heatmap = m_heatmapRow.data();
+		params.heatmapWidth = static_cast<uint32_t>(m_heatmapRow.size() / 3);
 	}
-	else
+
+	const OutputLut3DKey key = { params.curve, params.standardNits, m_isHeatmap, m_cubeLutGeneration };
+	const bool cubeLoaded = (m_cubeLut.size > 0);
+	if (m_outputLut3D && key.cubeGeneration == m_outputLut3DKey.cubeGeneration &&
+		(cubeLoaded || (key.curve == m_outputLut3DKey.curve && key.standardNits == m_outputLut3DKey.standardNits && key.heatmap == m_outputLut3DKey.heatmap)))
 	{
-		return E_FAIL;
+		return;
 	}
+	m_outputLut3DKey = key;
 
-	const size_t subresoucesize = metaData.mipLevels;
-//	const size_t uploadBufferSize = scratchImage->GetPixelsSize();
-
+	OutputLut3D baked;
+	if (!cubeLoaded)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		BakeOutputLut3D(params, OutputLut3DDefaultSize, baked);
+		m_outputLut3DBakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		m_outputLut3DError = MeasureOutputLut3DError(params, baked, 10);
+	}
+	const OutputLut3D& lut = cubeLoaded ? m_cubeLut : baked;
 
-	D3D12_RESOURCE_DESC textureDesc = {};
-	textureDesc.Width = metaData.width;
-	textureDesc.Height = static_cast<UINT>(metaData.height);
-	textureDesc.MipLevels = static_cast<UINT16>(metaData.mipLevels);
-	textureDesc.Format = metaData.format;
-	textureDesc.DepthOrArraySize = static_cast<UINT16>(metaData.arraySize);
-	textureDesc.SampleDesc.Quality = 0;
-	textureDesc.SampleDesc.Count = 1;
-	textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-	textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	// A new texture each time: frames in flight still sample the old one.
+	if (m_outputLut3D)
+	{
+		m_retiredTextures.push_back({ m_outputLut3D, nullptr, m_fenceValues[m_frameIndex] });
+	}
 
+	const CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex3D(DXGI_FORMAT_R32G32B32A32_FLOAT, lut.size, lut.size, static_cast<UINT16>(lut.size), 1);
 	ThrowIfFailed(m_device->CreateCommittedResource(
 		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
 		D3D12_HEAP_FLAG_NONE,
 		&textureDesc,
-		D3D12_RESOURCE_STATE_COPY_DEST,
+		D3D12_RESOURCE_STATE_COMMON,
 		nullptr,
-		IID_PPV_ARGS(m_hdrTexture.ReleaseAndGetAddressOf())));
-	NAME_D3D12_OBJECT(m_hdrTexture);
-	
-	std::vector<D3D12_SUBRESOURCE_DATA> subresouceData;
-	for (size_t i = 0; i < subresoucesize; i++)
-	{
-		D3D12_SUBRESOURCE_DATA subresouce;
-
-		subresouce.pData = scratchImage->GetImage(i, 0, 0)->pixels;
-		subresouce.RowPitch = scratchImage->GetImage(i, 0, 0)->rowPitch;
-		subresouce.SlicePitch = scratchImage->GetImage(i, 0, 0)->slicePitch;
+		IID_PPV_ARGS(m_outputLut3D.ReleaseAndGetAddressOf())));
+	NAME_D3D12_OBJECT(m_outputLut3D);
 
-		subresouceData.push_back(subresouce);
+	std::vector<DirectX::Image> slices(lut.size);
+	for (UINT z = 0; z < lut.size; z++)
+	{
+		slices[z].width = lut.size;
+		slices[z].height = lut.size;
+		slices[z].format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		slices[z].rowPitch = lut.size * 4 * sizeof(float);
+		slices[z].slicePitch = slices[z].rowPitch * lut.size;
+		slices[z].pixels = reinterpret_cast<uint8_t*>(const_cast<float*>(lut.data.data())) + z * slices[z].slicePitch;
 	}
+	ThrowIfFailed(m_textureUploader->UploadVolume(m_outputLut3D.Get(), slices.data(), slices.size()));
+	m_outputLut3DSize = lut.size;
 
-	const size_t uploadBufferSize = GetRequiredIntermediateSize(m_hdrTexture.Get(), 0, static_cast<uint32_t>(subresoucesize));
-
-	// Create the GPU upload buffer.
-	ThrowIfFailed(m_device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(textureUploadHeap.ReleaseAndGetAddressOf())));
-	NAME_D3D12_OBJECT(textureUploadHeap);
-
-	UpdateSubresources(m_commandList.Get(), m_hdrTexture.Get(), textureUploadHeap.Get(), 0, 0, static_cast<UINT>(subresoucesize), &subresouceData[0]);
-
-	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_hdrTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-	ThrowIfFailed(m_commandList->Close());
-	ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
-	m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-
-	WaitForGpu();
-
-	CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), heapOffset, m_srvDescriptorSize);
-
-	// Describe and create a SRV for the texture.
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	srvDesc.Format = textureDesc.Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = static_cast<UINT>(metaData.mipLevels);
-
-	m_device->CreateShaderResourceView(m_hdrTexture.Get(), &srvDesc, srvHandle);
-	
-	m_isLoadTexture = false;
-
-	return hr;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+	srvDesc.Texture3D.MipLevels = 1;
+	m_device->CreateShaderResourceView(m_outputLut3D.Get(), &srvDesc, m_srvTableSources[OutputLut3DSrvSlot].cpuHandle);
 }
 
-//
-void D3D12HDRViewer::IMGuiUpdate()
+// Starts loading an image and prefetches its neighbours in the directory.
+void D3D12HDRViewer::ShowImage(const std::wstring& filepath)
 {
-	ImGui_ImplDX12_NewFrame(m_commandList.Get());
-	
-	int radioButton = static_cast<int>(m_currentSwapChainBitDepth);
-	
-	if (m_enableEditWindow)
+	m_textureName = filepath;
+	m_imageLoader->Request(filepath, GetImageFileFormat(filepath));
+
+	auto it = std::find_if(m_directoryFiles.begin(), m_directoryFiles.end(),
+		[&filepath](const std::wstring& file) { return _wcsicmp(file.c_str(), filepath.c_str()) == 0; });
+	if (it == m_directoryFiles.end())
 	{
-		ImGui::Begin("Edit Window", &m_enableEditWindow);
-		ImGui::SetWindowFontScale(2.0f);
+		return;
+	}
+	m_directoryIndex = static_cast<size_t>(it - m_directoryFiles.begin());
 
-		ImGui::RadioButton("sRGB", &radioButton, 0); ImGui::SameLine();
-		ImGui::RadioButton("ST.2084", &radioButton, 1); ImGui::SameLine();
-		ImGui::RadioButton("Linear", &radioButton,2);
+	// Forward stepping is the common case, so look further ahead than behind.
+	const int prefetchOffsets[] = { 1, -1, 2, 3 };
+	const size_t count = m_directoryFiles.size();
 
-		if (m_currentSwapChainBitDepth != static_cast<SwapChainBitDepth>(radioButton))
+	std::vector<std::wstring> prefetch;
+	for (int offset : prefetchOffsets)
+	{
+		if (static_cast<size_t>(std::abs(offset)) >= count)
 		{
-			m_currentSwapChainBitDepth = static_cast<SwapChainBitDepth>(radioButton);
-
-			DXGI_FORMAT newFormat = m_swapChainFormats[m_currentSwapChainBitDepth];
-			UpdateSwapChainBuffer(m_width, m_height, newFormat);
-			SetHDRMetaData(HDRMetaDataPool[m_hdrMetaDataPoolIdx][0], HDRMetaDataPool[m_hdrMetaDataPoolIdx][1], HDRMetaDataPool[m_hdrMetaDataPoolIdx][2], HDRMetaDataPool[m_hdrMetaDataPoolIdx][3]);
-
-			ImGui_ImplDX12_InvalidateDeviceObjects();
-			ImGui_ImplDX12_CreateDeviceObjects(newFormat);
+			continue;
 		}
-		
-		m_openLoadDialog = ImGui::Button("Load File");
-		ImGui::SliderFloat("EV", &m_evValue, -8.0f, 8.0f);
-
-		ImGui::Checkbox("Heatmap", &m_isHeatmap);
-		ImGui::End();
+		prefetch.push_back(m_directoryFiles[(m_directoryIndex + count + offset) % count]);
 	}
+	m_imageLoader->Prefetch(prefetch);
+}
 
-	if (m_enableDisplayInfo)
+// Moves to the next or previous image in the directory, wrapping around.
+void D3D12HDRViewer::StepImage(int step)
+{
+	const size_t count = m_directoryFiles.size();
+	if (count < 2)
+	{
+		return;
+	}
+
+	ShowImage(m_directoryFiles[(m_directoryIndex + count + step) % count]);
+}
+
+
+// Swap in a texture from the loader. Its copy may still be running on the
+// uploader's copy queue, so the direct queue waits for it on the GPU instead of
+// this thread waiting on the CPU; only the previous texture's GPU references
+// and descriptor need to drain here.
+// A progressive load publishes its texture early and then again when complete;
+// the second time only the wait for the last rows is queued.
+void D3D12HDRViewer::PublishTexture(LoadResult& result)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	if (result.complete)
+	{
+		m_lastLoad = result;
+		m_lastLoad.texture.reset();
+
+		m_imageLightLevels = ContentLightLevels();
+		if (SUCCEEDED(result.hr) && result.analyzed)
+		{
+			AddContentLightLevels(result.luminance, m_imageLightLevels);
+			AddContentLightLevels(result.luminance, m_sequenceLightLevels);
+		}
+	}
+	if (FAILED(result.hr) || !result.texture)
+	{
+		return;
+	}
+
+	D3D12UploadedTexture* texture = static_cast<D3D12UploadedTexture*>(result.texture.get());
+	if (texture->resource == m_hdrTexture)
+	{
+		ThrowIfFailed(m_commandQueue->Wait(texture->copyFence.Get(), texture->copyFenceValue));
+		return;
+	}
+
+	// Frames already submitted copied the old view into their own SRV tables,
+	// so the staging view can be rewritten now; only the texture itself has to
+	// outlive them. The frame being recorded signals m_fenceValues[m_frameIndex].
+	m_retiredTextures.push_back({ m_hdrTexture, m_hdrUpload, m_fenceValues[m_frameIndex] });
+
+	m_hdrTexture = texture->resource;
+	m_hdrUpload = result.texture;
+	m_gpuLuminanceValid = false;
+
+	m_device->CreateShaderResourceView(m_hdrTexture.Get(), &texture->srvDesc, m_srvTableSources[HdrTextureSrvSlot].cpuHandle);
+
+	// The next frame is the first to sample the texture.
+	ThrowIfFailed(m_commandQueue->Wait(texture->copyFence.Get(), texture->copyFenceValue));
+
+	m_displayPending = true;
+	m_displayRequestTime = result.requestTime;
+	m_redraw.OnImagePublished();
+
+	if (result.complete)
+	{
+		m_lastLoad.timings.publishMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+// Called after each Present: keeps the frame time history and completes the
+// load-to-display measurement for a texture published since the last frame.
+void D3D12HDRViewer::RecordPresent()
+{
+	auto now = std::chrono::steady_clock::now();
+
+	if (m_lastPresentTime != std::chrono::steady_clock::time_point())
+	{
+		m_frameTimesMs[m_frameTimeNext] = std::chrono::duration<float, std::milli>(now - m_lastPresentTime).count();
+		m_frameTimeNext = (m_frameTimeNext + 1) % FrameTimeHistory;
+		m_frameTimeCount = std::min<UINT>(m_frameTimeCount + 1, FrameTimeHistory);
+	}
+	// A frame that ends a burst of rendering starts an idle gap, which is not a
+	// frame time, so the next frame starts a new measurement.
+	m_lastPresentTime = NeedsRender() ? now : std::chrono::steady_clock::time_point();
+
+	if (m_displayPending)
+	{
+		m_displayMs = std::chrono::duration<double, std::milli>(now - m_displayRequestTime).count();
+		m_displayPending = false;
+	}
+}
+
+// Remembers when the frame just presented started, and reads back how long
+// ago the most recently displayed frame started when it reached the screen.
+void D3D12HDRViewer::RecordFrameStatistics()
+{
+	UINT presentCount = 0;
+	if (FAILED(m_swapChain->GetLastPresentCount(&presentCount)))
+	{
+		m_frameStatisticsValid = false;
+		return;
+	}
+	m_presentStartQpc[presentCount % PresentHistory] = m_frameStartQpc;
+
+	// Fails until the first frame was displayed, and while the statistics are
+	// disjoint, e.g. after a mode change.
+	DXGI_FRAME_STATISTICS statistics = {};
+	m_frameStatisticsValid = SUCCEEDED(m_swapChain->GetFrameStatistics(&statistics))
+		&& statistics.PresentCount > 0 && presentCount >= statistics.PresentCount
+		&& presentCount - statistics.PresentCount < PresentHistory;
+	if (m_frameStatisticsValid)
+	{
+		const LONGLONG startQpc = m_presentStartQpc[statistics.PresentCount % PresentHistory];
+		m_displayLatencyMs = 1000.0 * static_cast<double>(statistics.SyncQPCTime.QuadPart - startQpc) / static_cast<double>(m_qpcFrequency);
+		m_queuedFrames = presentCount - statistics.PresentCount;
+	}
+}
+
+//
+void D3D12HDRViewer::IMGuiUpdate()
+{
+	ImGui_ImplDX12_NewFrame(m_commandList.Get());
+
+	// ImGui lays out in window coordinates; while a resize is deferred the back
+	// buffers are smaller or larger than the window, so draw scaled to them.
+	ImGuiIO& io = ImGui::GetIO();
+	if (io.DisplaySize.x > 0.0f && io.DisplaySize.y > 0.0f)
+	{
+		io.DisplayFramebufferScale = ImVec2(m_width / io.DisplaySize.x, m_height / io.DisplaySize.y);
+	}
+	
+	int radioButton = static_cast<int>(m_currentSwapChainBitDepth);
+	
+	if (m_enableEditWindow)
+	{
+		ImGui::Begin("Edit Window", &m_enableEditWindow);
+		ImGui::SetWindowFontScale(2.0f);
+
+		ImGui::RadioButton("sRGB", &radioButton, 0); ImGui::SameLine();
+		ImGui::RadioButton("ST.2084", &radioButton, 1); ImGui::SameLine();
+		ImGui::RadioButton("Linear", &radioButton,2);
+
+		if (m_currentSwapChainBitDepth != static_cast<SwapChainBitDepth>(radioButton))
+		{
+			m_currentSwapChainBitDepth = static_cast<SwapChainBitDepth>(radioButton);
+
+			DXGI_FORMAT newFormat = m_swapChainFormats[m_currentSwapChainBitDepth];
+			UpdateSwapChainBuffer(m_width, m_height, newFormat);
+			ApplyHDRMetaData();
+
+			ImGui_ImplDX12_SetRenderTargetFormat(newFormat);
+		}
+		
+		ImGui::Text("HDR10 metadata:");
+		ImGui::SameLine();
+		int metaDataSource = m_hdrMetaDataSource;
+		ImGui::RadioButton("Test values", &metaDataSource, HDRMetaDataFromPool); ImGui::SameLine();
+		ImGui::RadioButton("Image", &metaDataSource, HDRMetaDataFromImage); ImGui::SameLine();
+		ImGui::RadioButton("Sequence", &metaDataSource, HDRMetaDataFromSequence);
+		if (metaDataSource != m_hdrMetaDataSource)
+		{
+			m_hdrMetaDataSource = metaDataSource;
+			ApplyHDRMetaData();
+		}
+		{
+			std::string metaDataText = "Mastering:" + float_to_string(m_hdrMetaData.maxMasteringNits, 0) + "/" + float_to_string(m_hdrMetaData.minMasteringNits, 3)
+				+ " MaxCLL:" + float_to_string(m_hdrMetaData.maxCLL, 0)
+				+ " MaxFALL:" + float_to_string(m_hdrMetaData.maxFALL, 0);
+			if (m_hdrMetaDataSource == HDRMetaDataFromSequence)
+			{
+				metaDataText += " (" + std::to_string(m_sequenceLightLevels.frameCount) + " images)";
+			}
+			ImGui::Text(metaDataText.c_str());
+		}
+
+		m_openLoadDialog = ImGui::Button("Load File");
+		ImGui::SliderFloat("EV", &m_evValue, -8.0f, 8.0f);
+
+		ImGui::Checkbox("Heatmap", &m_isHeatmap);
+		ImGui::SameLine();
+		ImGui::Checkbox("Curve LUT", &m_useCurveLut);
+		ImGui::SameLine();
+		ImGui::Checkbox("3D LUT", &m_useOutputLut3D);
+
+		m_openCubeDialog = ImGui::Button("Load .cube");
+		if (!m_cubeLutName.empty())
+		{
+			ImGui::SameLine();
+			if (ImGui::Button("Clear .cube"))
+			{
+				m_cubeLut = OutputLut3D();
+				m_cubeLutName.clear();
+				m_cubeLutGeneration++;
+			}
+		}
+
+		std::string lutText;
+		if (!m_cubeLutError.empty())
+		{
+			lutText = m_cubeLutError;
+		}
+		else if (!m_cubeLutName.empty())
+		{
+			lutText = m_cubeLutName + " " + std::to_string(m_cubeLut.size) + "^3";
+		}
+		else if (m_outputLut3D)
+		{
+			lutText = "Baked " + std::to_string(m_outputLut3DSize) + "^3 in " + float_to_string(static_cast<float>(m_outputLut3DBakeMs), 1) + "ms"
+				+ " Max error:" + float_to_string(static_cast<float>(m_outputLut3DError), 1) + " (10-bit)";
+		}
+		if (!lutText.empty())
+		{
+			ImGui::SameLine();
+			ImGui::Text(lutText.c_str());
+		}
+
+		if (ImGui::Checkbox("Progressive", &m_progressiveLoad))
+		{
+			m_imageLoader->SetProgressive(m_progressiveLoad);
+		}
+		ImGui::SameLine();
+		if (ImGui::Checkbox("Stream (low memory)", &m_streamLoads))
+		{
+			m_imageLoader->SetStreaming(m_streamLoads);
+		}
+
+		if (m_imageLoader->IsBusy())
+		{
+			ImGui::Text("Loading...");
+		}
+		else if (FAILED(m_lastLoad.hr))
+		{
+			std::ostringstream oss;
+			oss << "Load failed (0x" << std::hex << std::setw(8) << std::setfill('0') << static_cast<unsigned int>(m_lastLoad.hr) << ")";
+			ImGui::Text(oss.str().c_str());
+		}
+		else if (!m_textureName.empty())
+		{
+			if (!m_directoryFiles.empty())
+			{
+				std::string position = std::to_string(m_directoryIndex + 1) + " / " + std::to_string(m_directoryFiles.size());
+				ImGui::Text(position.c_str());
+			}
+			std::string strText = "Read:" + float_to_string(static_cast<float>(m_lastLoad.timings.readMs), 1) + "ms"
+				+ " Decode:" + float_to_string(static_cast<float>(m_lastLoad.timings.decodeMs), 1) + "ms"
+				+ " Upload:" + float_to_string(static_cast<float>(m_lastLoad.timings.uploadMs), 1) + "ms"
+				+ " Publish:" + float_to_string(static_cast<float>(m_lastLoad.timings.publishMs), 1) + "ms";
+			ImGui::Text(strText.c_str());
+
+			if (m_lastLoad.timings.firstBandMs > 0.0)
+			{
+				strText = "First band:" + float_to_string(static_cast<float>(m_lastLoad.timings.firstBandMs), 1) + "ms"
+					+ " Complete:" + float_to_string(static_cast<float>(m_lastLoad.timings.totalMs), 1) + "ms";
+				ImGui::Text(strText.c_str());
+			}
+
+			strText = "Load to display:" + float_to_string(static_cast<float>(m_displayMs), 1) + "ms";
+			ImGui::Text(strText.c_str());
+
+			if (m_lastLoad.tiled)
+			{
+				strText = "Level:" + std::to_string(m_lastLoad.levelX) + "," + std::to_string(m_lastLoad.levelY)
+					+ " (" + std::to_string(m_lastLoad.metadata.width) + "x" + std::to_string(m_lastLoad.metadata.height) + ")"
+					+ " Tiles decoded:" + std::to_string(m_lastLoad.tilesDecoded) + "/" + std::to_string(m_lastLoad.tileCount);
+				ImGui::Text(strText.c_str());
+			}
+
+			IMGuiLuminance();
+		}
+
+		IMGuiLayerSelection();
+
+		ImageCacheStats cacheStats = m_imageCache->GetStats();
+		std::string cacheText = "Cache:" + std::to_string(cacheStats.entryCount) + " images "
+			+ std::to_string(cacheStats.usedBytes >> 20) + "/" + std::to_string(cacheStats.budgetBytes >> 20) + "MB"
+			+ " Hit:" + std::to_string(cacheStats.hits)
+			+ " Miss:" + std::to_string(cacheStats.misses)
+			+ " Evict:" + std::to_string(cacheStats.evictions);
+		ImGui::Text(cacheText.c_str());
+
+		ImageCacheStats tileStats = m_tileCache->GetStats();
+		std::string tileText = "Tiles:" + std::to_string(tileStats.entryCount) + " "
+			+ std::to_string(tileStats.usedBytes >> 20) + "/" + std::to_string(tileStats.budgetBytes >> 20) + "MB"
+			+ " Hit:" + std::to_string(tileStats.hits)
+			+ " Miss:" + std::to_string(tileStats.misses)
+			+ " Evict:" + std::to_string(tileStats.evictions);
+		ImGui::Text(tileText.c_str());
+
+		// Peak working set shows what a load cost in host memory.
+		PROCESS_MEMORY_COUNTERS memoryCounters = {};
+		memoryCounters.cb = sizeof(memoryCounters);
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters)))
+		{
+			std::string memoryText = "Memory:" + std::to_string(memoryCounters.WorkingSetSize >> 20) + "MB"
+				+ " Peak:" + std::to_string(memoryCounters.PeakWorkingSetSize >> 20) + "MB"
+				+ " Committed:" + std::to_string(memoryCounters.PagefileUsage >> 20) + "MB";
+			ImGui::Text(memoryText.c_str());
+		}
+
+		TexturePoolStats poolStats = m_textureUploader->GetTexturePool()->GetStats();
+
+		std::string poolText = "Texture pool:" + std::to_string(poolStats.entryCount) + " "
+			+ std::to_string(poolStats.idleBytes >> 20) + "/" + std::to_string(poolStats.budgetBytes >> 20) + "MB"
+			+ " Reused:" + std::to_string(poolStats.hits)
+			+ " Created:" + std::to_string(poolStats.misses)
+			+ " Evict:" + std::to_string(poolStats.evictions);
+		ImGui::Text(poolText.c_str());
+
+		if (m_frameTimeCount > 0)
+		{
+			double sum = 0.0;
+			double sumSquares = 0.0;
+			float maxMs = 0.0f;
+			for (UINT i = 0; i < m_frameTimeCount; i++)
+			{
+				sum += m_frameTimesMs[i];
+				sumSquares += m_frameTimesMs[i] * m_frameTimesMs[i];
+				maxMs = std::max<float>(maxMs, m_frameTimesMs[i]);
+			}
+			const double averageMs = sum / m_frameTimeCount;
+			const double jitterMs = std::sqrt(std::max<double>(0.0, sumSquares / m_frameTimeCount - averageMs * averageMs));
+
+			std::string frameText = "Frame:" + float_to_string(static_cast<float>(averageMs), 2) + "ms"
+				+ " Max:" + float_to_string(maxMs, 2) + "ms"
+				+ " Jitter:" + float_to_string(static_cast<float>(jitterMs), 2) + "ms";
+			ImGui::Text(frameText.c_str());
+
+			// Oldest frame first once the history has wrapped.
+			const UINT offset = (m_frameTimeCount == FrameTimeHistory) ? m_frameTimeNext : 0;
+			ImGui::PlotLines("##FrameTimes", m_frameTimesMs, static_cast<int>(m_frameTimeCount), static_cast<int>(offset), nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+		}
+
+		// Present settings and the latency they result in.
+		if (m_tearingSupport)
+		{
+			ImGui::Checkbox("Allow tearing", &m_allowTearing);
+		}
+		if (m_frameLatencyWaitableObject)
+		{
+			int maxFrameLatency = static_cast<int>(m_maxFrameLatency);
+			if (ImGui::SliderInt("Max frame latency", &maxFrameLatency, 1, static_cast<int>(m_frameCount)))
+			{
+				m_maxFrameLatency = static_cast<UINT>(maxFrameLatency);
+				ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(m_maxFrameLatency));
+			}
+		}
+
+		std::string latencyText = "Buffers:" + std::to_string(m_frameCount)
+			+ (m_frameLatencyWaitableObject ? " Waitable" : "")
+			+ " Start to display:" + (m_frameStatisticsValid ? float_to_string(static_cast<float>(m_displayLatencyMs), 1) + "ms" : std::string("n/a"));
+		if (m_frameStatisticsValid)
+		{
+			latencyText += " Queued:" + std::to_string(m_queuedFrames);
+		}
+		ImGui::Text(latencyText.c_str());
+
+		if (ImGui::Button("Benchmark CPU output transform"))
+		{
+			BenchmarkOutputTransforms();
+		}
+		if (m_outputTransformMeasured)
+		{
+			std::string transformText = std::string("CPU ") + GetOutputTransformPathName(OutputTransformPath::Best) + ":";
+			for (UINT curve = 0; curve < static_cast<UINT>(OutputCurve::Count); curve++)
+			{
+				transformText += std::string(" ") + GetOutputCurveName(static_cast<OutputCurve>(curve))
+					+ " " + float_to_string(m_outputTransformMpixels[curve], 1);
+			}
+			ImGui::Text((transformText + " Mpix/s").c_str());
+		}
+
+		if (ImGui::Button("Benchmark curve LUT"))
+		{
+			BenchmarkCurveLut();
+		}
+		if (m_curveLutMeasured)
+		{
+			const char* resolutionNames[] = { "4K", "8K" };
+			for (UINT resolution = 0; resolution < 2; resolution++)
+			{
+				std::string lutText = std::string(resolutionNames[resolution]) + ":";
+				for (UINT curve = 0; curve < 2; curve++)
+				{
+					const float* mpixels = m_curveLutMpixels[resolution][curve];
+					lutText += std::string(" ") + GetOutputCurveName(static_cast<OutputCurve>(curve))
+						+ " " + float_to_string(mpixels[0], 1) + " -> " + float_to_string(mpixels[1], 1) + " Mpix/s"
+						+ " (x" + float_to_string(mpixels[0] > 0.0f ? mpixels[1] / mpixels[0] : 0.0f, 2) + ")";
+				}
+				ImGui::Text(lutText.c_str());
+			}
+			ImGui::Text(("LUT max error (10-bit codes): sRGB " + float_to_string(static_cast<float>(m_curveLutError[0]), 3)
+				+ " ST.2084 " + float_to_string(static_cast<float>(m_curveLutError[1]), 3)).c_str());
+		}
+
+		ImGui::End();
+	}
+
+	if (m_enableDisplayInfo)
 	{
 		std::string strText;
 		ImGui::Begin("Display Infomation", &m_enableDisplayInfo);
@@ -817,6 +1557,166 @@ void D3D12HDRViewer::IMGuiUpdate()
 	}
 }
 
+// Part, layer and channel pickers for multi-part and multi-layer EXRs. Picking
+// one requests the same file again with only that part and those channels decoded.
+void D3D12HDRViewer::IMGuiLayerSelection()
+{
+	const std::vector<EXRPartInfo>& parts = m_lastLoad.parts;
+	const EXRChannelSelection& shown = m_lastLoad.channels;
+	if (shown.part >= parts.size())
+	{
+		return;
+	}
+
+	if (parts.size() > 1)
+	{
+		auto partName = [](void* data, int index, const char** text)
+		{
+			const EXRPartInfo& part = static_cast<const EXRPartInfo*>(data)[index];
+			*text = part.name.empty() ? "(unnamed)" : part.name.c_str();
+			return true;
+		};
+
+		int partIndex = static_cast<int>(shown.part);
+		ImGui::Combo("Part", &partIndex, partName, const_cast<EXRPartInfo*>(parts.data()), static_cast<int>(parts.size()));
+		if (partIndex != static_cast<int>(shown.part))
+		{
+			EXRChannelSelection selection;
+			selection.part = static_cast<size_t>(partIndex);
+			m_imageLoader->Request(m_lastLoad.path, ImageFileFormat::OpenEXR, selection);
+			return;
+		}
+	}
+
+	const std::vector<EXRLayer>& layers = parts[shown.part].layers;
+	if (layers.empty() || (layers.size() == 1 && layers[0].name.empty() && layers[0].channels.size() <= 4))
+	{
+		return;
+	}
+
+	// Work out what is on screen from the channels that were decoded.
+	int layerIndex = 0;
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		const std::vector<std::string>& channels = layers[i].channels;
+		if (shown.channels[0].empty() ? layers[i].name.empty() : std::find(channels.begin(), channels.end(), shown.channels[0]) != channels.end())
+		{
+			layerIndex = static_cast<int>(i);
+			break;
+		}
+	}
+
+	const EXRLayer& layer = layers[layerIndex];
+	int channelIndex = 0;	// 0 shows the layer as colour.
+	if (!shown.channels[0].empty() && shown.channels[1].empty() && shown.channels[2].empty() && shown.channels[3].empty())
+	{
+		auto it = std::find(layer.channels.begin(), layer.channels.end(), shown.channels[0]);
+		if (it != layer.channels.end() && layer.channels.size() > 1)
+		{
+			channelIndex = static_cast<int>(it - layer.channels.begin()) + 1;
+		}
+	}
+
+	auto layerName = [](void* data, int index, const char** text)
+	{
+		const EXRLayer& layer = static_cast<const EXRLayer*>(data)[index];
+		*text = layer.name.empty() ? "(default)" : layer.name.c_str();
+		return true;
+	};
+	auto channelName = [](void* data, int index, const char** text)
+	{
+		const EXRLayer* layer = static_cast<const EXRLayer*>(data);
+		*text = (index == 0) ? "(all)" : layer->channels[index - 1].c_str();
+		return true;
+	};
+
+	int newLayerIndex = layerIndex;
+	int newChannelIndex = channelIndex;
+	ImGui::Combo("Layer", &newLayerIndex, layerName, const_cast<EXRLayer*>(layers.data()), static_cast<int>(layers.size()));
+	ImGui::Combo("Channel", &newChannelIndex, channelName, const_cast<EXRLayer*>(&layer), static_cast<int>(layer.channels.size()) + 1);
+
+	if (newLayerIndex != layerIndex)
+	{
+		EXRChannelSelection selection = GetEXRDefaultChannelSelection(layers[newLayerIndex]);
+		selection.part = shown.part;
+		m_imageLoader->Request(m_lastLoad.path, ImageFileFormat::OpenEXR, selection);
+	}
+	else if (newChannelIndex != channelIndex)
+	{
+		EXRChannelSelection selection;
+		if (newChannelIndex == 0)
+		{
+			selection = GetEXRDefaultChannelSelection(layer);
+		}
+		else
+		{
+			selection.channels[0] = layer.channels[newChannelIndex - 1];
+		}
+		selection.part = shown.part;
+		m_imageLoader->Request(m_lastLoad.path, ImageFileFormat::OpenEXR, selection);
+	}
+}
+
+// Luminance statistics of the image on screen as measured by the loader, its
+// histogram on a log scale, and the GPU histogram for comparison.
+void D3D12HDRViewer::IMGuiLuminance()
+{
+	if (m_lastLoad.analyzed)
+	{
+		const LuminanceStatistics& luminance = m_lastLoad.luminance;
+		std::string strText = "Nits min:" + float_to_string(luminance.minNits, 3)
+			+ " mean:" + float_to_string(luminance.meanNits, 1)
+			+ " median:" + float_to_string(luminance.medianNits, 1)
+			+ " 99%:" + float_to_string(luminance.percentile99Nits, 1)
+			+ " 99.9%:" + float_to_string(luminance.percentile999Nits, 1)
+			+ " max:" + float_to_string(luminance.maxNits, 1);
+		ImGui::Text(strText.c_str());
+
+		strText = "MaxCLL:" + float_to_string(luminance.maxCLL, 0)
+			+ " MaxFALL:" + float_to_string(luminance.maxFALL, 0)
+			+ " Analyze:" + float_to_string(static_cast<float>(m_lastLoad.timings.analyzeMs), 1) + "ms"
+			+ " (" + GetLuminanceAnalysisPathName(LuminanceAnalysisPath::Best) + ")";
+		ImGui::Text(strText.c_str());
+
+		// Counts span many orders of magnitude, so the bars show log10(1 + count).
+		float bars[LuminanceHistogramBins];
+		for (UINT bin = 0; bin < LuminanceHistogramBins; bin++)
+		{
+			bars[bin] = std::log10(1.0f + static_cast<float>(luminance.histogram[bin]));
+		}
+		std::string range = float_to_string(GetLuminanceBinNits(0), 4) + " - " + float_to_string(GetLuminanceBinNits(LuminanceHistogramBins), 0) + " nits";
+		ImGui::PlotHistogram("##Luminance", bars, static_cast<int>(LuminanceHistogramBins), 0, range.c_str(), 0.0f, FLT_MAX, ImVec2(0, 60));
+	}
+
+	if (ImGui::Button("Analyze on GPU"))
+	{
+		m_histogramRequested = true;
+	}
+	if (m_gpuLuminanceValid)
+	{
+		// Bins the GPU filled differently from the CPU; float rounding can move a
+		// pixel on a bin edge.
+		uint64_t differing = 0;
+		if (m_lastLoad.analyzed)
+		{
+			for (UINT bin = 0; bin < LuminanceHistogramBins; bin++)
+			{
+				const uint64_t cpu = m_lastLoad.luminance.histogram[bin];
+				const uint64_t gpu = m_gpuLuminance.histogram[bin];
+				differing += (cpu > gpu) ? cpu - gpu : gpu - cpu;
+			}
+		}
+
+		ImGui::SameLine();
+		std::string strText = "GPU:" + float_to_string(static_cast<float>(m_gpuLuminanceMs), 2) + "ms"
+			+ " MaxCLL:" + float_to_string(m_gpuLuminance.maxCLL, 0)
+			+ " MaxFALL:" + float_to_string(m_gpuLuminance.maxFALL, 0)
+			+ " Mean:" + float_to_string(m_gpuLuminance.meanNits, 1)
+			+ (m_lastLoad.analyzed ? " Bin differences:" + std::to_string(differing) : std::string());
+		ImGui::Text(strText.c_str());
+	}
+}
+
 // Fill the command list with all the render commands and dependent state and
 // submit it to the command queue.
 void D3D12HDRViewer::RenderScene()
@@ -828,9 +1728,37 @@ void D3D12HDRViewer::RenderScene()
 	// Set necessary state.
 	m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
 
-	ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap.Get() };
+	// Everything the GPU finished with can be reused from here on.
+	const UINT64 completedFenceValue = m_fence->GetCompletedValue();
+	m_srvHeap->BeginFrame(m_frameIndex, completedFenceValue);
+	m_srvStagingHeap->BeginFrame(0, completedFenceValue);
+	ReleaseRetiredTextures(completedFenceValue);
+	ReadLuminanceHistogram(completedFenceValue);
+	UpdateOutputLut3D();
+
+	// Gather this frame's SRV table from the staging heap.
+	DescriptorRange srvTable;
+	ThrowIfFailed(m_srvHeap->AllocateTransient(SrvTableSlotCount, srvTable));
+	for (UINT n = 0; n < SrvTableSlotCount; n++)
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE destination(srvTable.cpuHandle, n, m_srvHeap->GetDescriptorSize());
+		m_device->CopyDescriptorsSimple(1, destination, m_srvTableSources[n].cpuHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	}
+
+	ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap->GetHeap() };
 	m_commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
 
+	// The histogram reads the image through its slot of this frame's table. A
+	// request waits while the previous run is still being read back.
+	if (m_histogramRequested && m_histogramFenceValue == 0)
+	{
+		if (m_hdrUpload)
+		{
+			RecordLuminanceHistogram(CD3DX12_GPU_DESCRIPTOR_HANDLE(srvTable.gpuHandle, HdrTextureSrvSlot, m_srvHeap->GetDescriptorSize()));
+		}
+		m_histogramRequested = false;
+	}
+
 	m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 	m_commandList->RSSetViewports(1, &m_viewport);
 	m_commandList->RSSetScissorRects(1, &m_scissorRect);
@@ -839,19 +1767,24 @@ void D3D12HDRViewer::RenderScene()
 	m_rootConstantsF[ReferenceWhiteNits] = m_referenceWhiteNits;
 	m_rootConstantsF[EVValue] = m_evValue;
 	m_rootConstants[HeatmapFlag] = m_isHeatmap ? 1 : 0;
+	m_rootConstants[CurveLutFlag] = m_useCurveLut ? 1 : 0;
+	m_rootConstants[Lut3DSize] = m_useOutputLut3D ? m_outputLut3DSize : 0;
 
 	m_commandList->SetGraphicsRoot32BitConstants(0, RootConstantsCount, m_rootConstants, 0);
-	m_commandList->SetGraphicsRootDescriptorTable(1, m_srvHeap->GetGPUDescriptorHandleForHeapStart());
+	m_commandList->SetGraphicsRootDescriptorTable(1, srvTable.gpuHandle);
 
-	// Draw the scene into the intermediate render target.
+	// Draw the scene into the intermediate render target on the two-pass path.
+	// The fused path samples the image directly in the pass below.
+	if (m_twoPassComposite)
 	{
 		PIXBeginEvent(m_commandList.Get(), 0, L"Draw scene content");
 
-		CD3DX12_CPU_DESCRIPTOR_HANDLE intermediateRtv(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), FrameCount, m_rtvDescriptorSize);
+		CD3DX12_CPU_DESCRIPTOR_HANDLE intermediateRtv(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameCount, m_rtvDescriptorSize);
 		m_commandList->OMSetRenderTargets(1, &intermediateRtv, FALSE, nullptr);
 
+		// Only the part of the intermediate in use is cleared.
 		const float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-		m_commandList->ClearRenderTargetView(intermediateRtv, clearColor, 0, nullptr);
+		m_commandList->ClearRenderTargetView(intermediateRtv, clearColor, 1, &m_scissorRect);
 
 		m_commandList->SetPipelineState(m_pipelineStates[PalettePSO].Get());
 		
@@ -862,25 +1795,34 @@ void D3D12HDRViewer::RenderScene()
 		PIXEndEvent(m_commandList.Get());
 	}
 
-	// Indicate that the intermediates will be used as SRVs in the pixel shader
-	// and the back buffer will be used as a render target.
+	// Indicate that the back buffer will be used as a render target and, on the
+	// two-pass path, that the intermediate will be used as a SRV in the pixel shader.
 	D3D12_RESOURCE_BARRIER barriers[] = {
-		CD3DX12_RESOURCE_BARRIER::Transition(m_intermediateRenderTarget.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
 		CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET),
+		CD3DX12_RESOURCE_BARRIER::Transition(m_intermediateRenderTarget.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
 	};
-	m_commandList->ResourceBarrier(_countof(barriers), barriers);
+	const UINT barrierCount = m_twoPassComposite ? 2 : 1;
+	m_commandList->ResourceBarrier(barrierCount, barriers);
 
-	// Process the intermediate and draw into the swap chain render target.
+	// Encode the scene for the display and draw into the swap chain render target.
 	{
 		PIXBeginEvent(m_commandList.Get(), 0, L"Apply HDR");
 
-		m_commandList->SetPipelineState(m_pipelineStates[Present8bitPSO + m_currentSwapChainBitDepth].Get());
+		if (m_twoPassComposite)
+		{
+			m_commandList->SetPipelineState(m_pipelineStates[Present8bitPSO + m_currentSwapChainBitDepth].Get());
+		}
+		else
+		{
+			m_commandList->SetPipelineState(GetFusedPipelineState());
+		}
 
 		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
 		m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
 
 		m_commandList->ClearRenderTargetView(rtvHandle, ClearColor, 0, nullptr);
 
+		m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		m_commandList->IASetVertexBuffers(0, 1, &m_presentVertexBufferView);
 		m_commandList->DrawInstanced(3, 1, 0, 0);
 
@@ -891,14 +1833,14 @@ void D3D12HDRViewer::RenderScene()
 
 	}
 
-	// Indicate that the intermediates will be used as render targets and the swap chain
-	// back buffer will be used for presentation.
-	barriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
-	barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
-	barriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-	barriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+	// Indicate that the swap chain back buffer will be used for presentation and
+	// the intermediate as a render target again.
+	barriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
+	barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+	barriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	barriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
 
-	m_commandList->ResourceBarrier(_countof(barriers), barriers);
+	m_commandList->ResourceBarrier(barrierCount, barriers);
 
 	ThrowIfFailed(m_commandList->Close());
 
@@ -907,6 +1849,13 @@ void D3D12HDRViewer::RenderScene()
 	m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 }
 
+// The fused pipeline state for the current display curve and swap chain format.
+ID3D12PipelineState* D3D12HDRViewer::GetFusedPipelineState() const
+{
+	const UINT curve = std::min<UINT>(m_rootConstants[DisplayCurve], DisplayCurveCount - 1);
+	return m_pipelineStates[FusedPSO + curve * SwapChainBitDepthCount + m_currentSwapChainBitDepth].Get();
+}
+
 
 void D3D12HDRViewer::OnWindowMoved(int xPos, int yPos)
 {
@@ -925,24 +1874,78 @@ void D3D12HDRViewer::OnWindowMoved(int xPos, int yPos)
 
 void D3D12HDRViewer::OnSizeChanged(UINT width, UINT height, bool minimized)
 {
-    // Update the width, height, and aspect ratio member variables.
-    UpdateForSizeChange(width, height);
+    m_windowVisible = !minimized;
+    if (minimized)
+    {
+        // Nothing is rendered; the buffers are resized if needed on restore.
+        return;
+    }
 
-    // Update the size of swapchain buffers.
-    UpdateSwapChainBuffer(width, height, GetBackBufferFormat());
+    // While the frame is being dragged, every WM_SIZE would flush the GPU and
+    // resize the swap chain. Keep presenting the current buffers, stretched by
+    // DXGI, and resize once when the drag ends.
+    m_pendingWidth = width;
+    m_pendingHeight = height;
+    if (m_in_sizechanging)
+    {
+        m_resizePending = true;
+        return;
+    }
 
-    m_windowVisible = !minimized;
+    ApplySizeChange();
+}
 
-	ImGui_ImplDX12_InvalidateDeviceObjects();
-	ImGui_ImplDX12_CreateDeviceObjects(GetBackBufferFormat());
+void D3D12HDRViewer::OnEnterSizeMove()
+{
+    m_in_sizechanging = true;
+}
 
+void D3D12HDRViewer::OnExitSizeMove()
+{
+    m_in_sizechanging = false;
+    if (m_resizePending)
+    {
+        ApplySizeChange();
+    }
 }
 
+// Resize the swap chain to the last window size reported.
+void D3D12HDRViewer::ApplySizeChange()
+{
+    m_resizePending = false;
+    if (m_pendingWidth == m_width && m_pendingHeight == m_height)
+    {
+        return;
+    }
+
+    UpdateSwapChainBuffer(m_pendingWidth, m_pendingHeight, GetBackBufferFormat());
+
+	// A tiled image is reloaded when a different level fits the new size.
+	m_imageLoader->SetViewSize(m_width, m_height);
+	if (m_lastLoad.tiled && SUCCEEDED(m_lastLoad.hr))
+	{
+		size_t levelX, levelY;
+		ChooseEXRLevel(m_lastLoad.tiledInfo, m_width, m_height, levelX, levelY);
+		if (levelX != m_lastLoad.levelX || levelY != m_lastLoad.levelY)
+		{
+			m_imageLoader->Request(m_lastLoad.path, ImageFileFormat::OpenEXR);
+		}
+	}
+}
+
+
 void D3D12HDRViewer::OnDestroy()
 {
+	// Stop the loader first so that no upload is in flight, then let the uploader
+	// drain its copy queue.
+	m_imageLoader.reset();
+	ImGui_ImplDX12_SetUploadTextureFn(nullptr, nullptr);
+	m_textureUploader.reset();
+
 	// Ensure that the GPU is no longer referencing resources that are about to be
 	// cleaned up by the destructor.
 	WaitForGpu();
+	m_uploadRing.reset();
 
 	ImGui_ImplDX12_Shutdown();
 	ImGui::DestroyContext();
@@ -953,9 +1956,14 @@ void D3D12HDRViewer::OnDestroy()
 		m_swapChain->SetFullscreenState(FALSE, nullptr);
 		ThrowIfFailed(m_swapChain->SetFullscreenState(FALSE, nullptr));
 	}
+	if (m_frameLatencyWaitableObject)
+	{
+		CloseHandle(m_frameLatencyWaitableObject);
+	}
 	CloseHandle(m_fenceEvent);
 }
 
+
 void D3D12HDRViewer::OnKeyDown(UINT8 key)
 {
 	switch (key)
@@ -989,15 +1997,26 @@ void D3D12HDRViewer::OnKeyDown(UINT8 key)
 		    break;
 	    }
 
+	    case VK_RIGHT:
+	    {
+		    StepImage(1);
+		    break;
+	    }
+
+	    case VK_LEFT:
+	    {
+		    StepImage(-1);
+		    break;
+	    }
+
 	    case VK_PRIOR:	// Page Up
         {
             m_currentSwapChainBitDepth = static_cast<SwapChainBitDepth>((m_currentSwapChainBitDepth - 1 + SwapChainBitDepthCount) % SwapChainBitDepthCount);
             DXGI_FORMAT newFormat = m_swapChainFormats[m_currentSwapChainBitDepth];
             UpdateSwapChainBuffer(m_width, m_height, newFormat);
-            SetHDRMetaData(HDRMetaDataPool[m_hdrMetaDataPoolIdx][0], HDRMetaDataPool[m_hdrMetaDataPoolIdx][1], HDRMetaDataPool[m_hdrMetaDataPoolIdx][2], HDRMetaDataPool[m_hdrMetaDataPoolIdx][3]);
+            ApplyHDRMetaData();
 
-			ImGui_ImplDX12_InvalidateDeviceObjects();
-			ImGui_ImplDX12_CreateDeviceObjects(newFormat);
+			ImGui_ImplDX12_SetRenderTargetFormat(newFormat);
             break;
         }
 
@@ -1006,10 +2025,9 @@ void D3D12HDRViewer::OnKeyDown(UINT8 key)
             m_currentSwapChainBitDepth = static_cast<SwapChainBitDepth>((m_currentSwapChainBitDepth + 1) % SwapChainBitDepthCount);
             DXGI_FORMAT newFormat = m_swapChainFormats[m_currentSwapChainBitDepth];
             UpdateSwapChainBuffer(m_width, m_height, newFormat);
-            SetHDRMetaData(HDRMetaDataPool[m_hdrMetaDataPoolIdx][0], HDRMetaDataPool[m_hdrMetaDataPoolIdx][1], HDRMetaDataPool[m_hdrMetaDataPoolIdx][2], HDRMetaDataPool[m_hdrMetaDataPoolIdx][3]);
+            ApplyHDRMetaData();
 
-			ImGui_ImplDX12_InvalidateDeviceObjects();
-			ImGui_ImplDX12_CreateDeviceObjects(newFormat);
+			ImGui_ImplDX12_SetRenderTargetFormat(newFormat);
             break;
         }
 
@@ -1019,7 +2037,7 @@ void D3D12HDRViewer::OnKeyDown(UINT8 key)
             if (m_currentSwapChainBitDepth == _10)
             {
                 EnsureSwapChainColorSpace(m_currentSwapChainBitDepth, m_enableST2084);
-                SetHDRMetaData(HDRMetaDataPool[m_hdrMetaDataPoolIdx][0], HDRMetaDataPool[m_hdrMetaDataPoolIdx][1], HDRMetaDataPool[m_hdrMetaDataPoolIdx][2], HDRMetaDataPool[m_hdrMetaDataPoolIdx][3]);
+                ApplyHDRMetaData();
             }
 
             break;
@@ -1043,8 +2061,10 @@ void D3D12HDRViewer::OnKeyDown(UINT8 key)
         case 'M':
         {
             // Switch meta data value for testing. TV should adjust the content based on the metadata we sent.
+            // Picking a test row also leaves the content-driven modes.
             m_hdrMetaDataPoolIdx = (m_hdrMetaDataPoolIdx + 1) % 4;
-            SetHDRMetaData(HDRMetaDataPool[m_hdrMetaDataPoolIdx][0], HDRMetaDataPool[m_hdrMetaDataPoolIdx][1], HDRMetaDataPool[m_hdrMetaDataPoolIdx][2], HDRMetaDataPool[m_hdrMetaDataPoolIdx][3]);
+            m_hdrMetaDataSource = HDRMetaDataFromPool;
+            ApplyHDRMetaData();
             break;
         }
 	}
@@ -1067,6 +2087,203 @@ void D3D12HDRViewer::WaitForGpu()
 	}
 }
 
+// Times the CPU reference of the output transform at 1080p for every curve,
+// with the current brightness settings.
+void D3D12HDRViewer::BenchmarkOutputTransforms()
+{
+	OutputTransformParams params;
+	params.standardNits = m_referenceWhiteNits;
+	params.exposure = m_evValue;
+
+	for (UINT curve = 0; curve < static_cast<UINT>(OutputCurve::Count); curve++)
+	{
+		params.curve = static_cast<OutputCurve>(curve);
+		m_outputTransformMpixels[curve] = static_cast<float>(BenchmarkOutputTransform(params, OutputTransformPath::Best, 1920, 1080, 4));
+	}
+	m_outputTransformMeasured = true;
+}
+
+// Times the analytic and LUT encodings at 4K and 8K for the two curves that have
+// a LUT, and measures the LUT's error against the analytic curves.
+void D3D12HDRViewer::BenchmarkCurveLut()
+{
+	const UINT sizes[2][2] = { { 3840, 2160 }, { 7680, 4320 } };
+
+	OutputTransformParams params;
+	params.standardNits = m_referenceWhiteNits;
+	params.exposure = m_evValue;
+
+	for (UINT resolution = 0; resolution < 2; resolution++)
+	{
+		for (UINT curve = 0; curve < 2; curve++)
+		{
+			params.curve = static_cast<OutputCurve>(curve);
+			for (UINT lut = 0; lut < 2; lut++)
+			{
+				params.useLut = (lut != 0);
+				m_curveLutMpixels[resolution][curve][lut] = static_cast<float>(
+					BenchmarkOutputTransform(params, OutputTransformPath::Best, sizes[resolution][0], sizes[resolution][1], 2));
+			}
+		}
+	}
+
+	m_curveLutError[0] = MeasureOutputCurveLutError(OutputCurve::sRGB, 10);
+	m_curveLutError[1] = MeasureOutputCurveLutError(OutputCurve::ST2084, 10);
+	m_curveLutMeasured = true;
+}
+
+// Drop the textures that were swapped out once no frame in flight samples them.
+void D3D12HDRViewer::ReleaseRetiredTextures(UINT64 completedFenceValue)
+{
+	while (!m_retiredTextures.empty() && m_retiredTextures.front().fenceValue <= completedFenceValue)
+	{
+		m_retiredTextures.pop_front();
+	}
+}
+
+// Records the luminance histogram of the texture on screen into this frame:
+// reset the results, dispatch one group per block of the image and copy the
+// results, the per group sums and the timestamps to the readback buffer.
+void D3D12HDRViewer::RecordLuminanceHistogram(D3D12_GPU_DESCRIPTOR_HANDLE imageSrv)
+{
+	const D3D12_RESOURCE_DESC imageDesc = m_hdrTexture->GetDesc();
+	const UINT constants[3] =
+	{
+		static_cast<UINT>(imageDesc.Width),
+		imageDesc.Height,
+		(static_cast<UINT>(imageDesc.Width) + HistogramBlockSize - 1) / HistogramBlockSize,
+	};
+	const UINT groupsY = (imageDesc.Height + HistogramBlockSize - 1) / HistogramBlockSize;
+	const UINT groupCount = constants[2] * groupsY;
+	const UINT64 groupSumsSize = static_cast<UINT64>(groupCount) * sizeof(float) * 2;
+
+	if (groupCount > m_histogramGroupCapacity)
+	{
+		ThrowIfFailed(m_device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(groupSumsSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(m_histogramGroupSums.ReleaseAndGetAddressOf())));
+		NAME_D3D12_OBJECT(m_histogramGroupSums);
+
+		ThrowIfFailed(m_device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(HistogramGroupSumsOffset + groupSumsSize),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(m_histogramReadback.ReleaseAndGetAddressOf())));
+		NAME_D3D12_OBJECT(m_histogramReadback);
+
+		m_histogramGroupCapacity = groupCount;
+	}
+
+	PIXBeginEvent(m_commandList.Get(), 0, L"Luminance histogram");
+
+	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_histogramResults.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+	m_commandList->CopyBufferRegion(m_histogramResults.Get(), 0, m_histogramResultsClear.Get(), 0, HistogramResultsSize);
+
+	D3D12_RESOURCE_BARRIER barriers[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(m_histogramResults.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(m_histogramGroupSums.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+	};
+	m_commandList->ResourceBarrier(_countof(barriers), barriers);
+
+	m_commandList->SetComputeRootSignature(m_histogramRootSignature.Get());
+	m_commandList->SetPipelineState(m_histogramPipelineState.Get());
+	m_commandList->SetComputeRoot32BitConstants(0, _countof(constants), constants, 0);
+	m_commandList->SetComputeRootDescriptorTable(1, imageSrv);
+	m_commandList->SetComputeRootUnorderedAccessView(2, m_histogramResults->GetGPUVirtualAddress());
+	m_commandList->SetComputeRootUnorderedAccessView(3, m_histogramGroupSums->GetGPUVirtualAddress());
+
+	m_commandList->EndQuery(m_histogramQueries.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+	m_commandList->Dispatch(constants[2], groupsY, 1);
+	m_commandList->EndQuery(m_histogramQueries.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+
+	for (D3D12_RESOURCE_BARRIER& barrier : barriers)
+	{
+		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+	}
+	m_commandList->ResourceBarrier(_countof(barriers), barriers);
+
+	m_commandList->CopyBufferRegion(m_histogramReadback.Get(), 0, m_histogramResults.Get(), 0, HistogramResultsSize);
+	m_commandList->CopyBufferRegion(m_histogramReadback.Get(), HistogramGroupSumsOffset, m_histogramGroupSums.Get(), 0, groupSumsSize);
+	m_commandList->ResolveQueryData(m_histogramQueries.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, m_histogramReadback.Get(), HistogramTimestampsOffset);
+
+	for (D3D12_RESOURCE_BARRIER& barrier : barriers)
+	{
+		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COMMON;
+	}
+	m_commandList->ResourceBarrier(_countof(barriers), barriers);
+
+	PIXEndEvent(m_commandList.Get());
+
+	// The frame being recorded signals m_fenceValues[m_frameIndex].
+	m_histogramFenceValue = m_fenceValues[m_frameIndex];
+	m_histogramWidth = constants[0];
+	m_histogramHeight = constants[1];
+	m_redraw.Invalidate();
+}
+
+// Turns a finished histogram run into statistics the same way the CPU path
+// finishes its accumulators. Until the run's frame has completed it only keeps
+// frames coming, since nothing else may invalidate the view.
+void D3D12HDRViewer::ReadLuminanceHistogram(UINT64 completedFenceValue)
+{
+	if (m_histogramFenceValue == 0)
+	{
+		return;
+	}
+	if (completedFenceValue < m_histogramFenceValue)
+	{
+		m_redraw.Invalidate();
+		return;
+	}
+	m_histogramFenceValue = 0;
+
+	const UINT groupsX = (m_histogramWidth + HistogramBlockSize - 1) / HistogramBlockSize;
+	const UINT groupsY = (m_histogramHeight + HistogramBlockSize - 1) / HistogramBlockSize;
+	const SIZE_T readSize = HistogramGroupSumsOffset + static_cast<SIZE_T>(groupsX) * groupsY * sizeof(float) * 2;
+
+	UINT8* data = nullptr;
+	ThrowIfFailed(m_histogramReadback->Map(0, &CD3DX12_RANGE(0, readSize), reinterpret_cast<void**>(&data)));
+
+	LuminanceAccumulator accumulator;
+	accumulator.pixelCount = static_cast<uint64_t>(m_histogramWidth) * m_histogramHeight;
+	memcpy(&accumulator.minNits, data, sizeof(float));
+	memcpy(&accumulator.maxNits, data + 4, sizeof(float));
+	memcpy(&accumulator.maxCLL, data + 8, sizeof(float));
+
+	const UINT* histogram = reinterpret_cast<const UINT*>(data + 16);
+	for (UINT bin = 0; bin < LuminanceHistogramBins; bin++)
+	{
+		accumulator.histogram[bin] = histogram[bin];
+	}
+
+	const float* groupSums = reinterpret_cast<const float*>(data + HistogramGroupSumsOffset);
+	for (UINT group = 0; group < groupsX * groupsY; group++)
+	{
+		accumulator.sumNits += groupSums[group * 2];
+		accumulator.sumMaxComponentNits += groupSums[group * 2 + 1];
+	}
+
+	const UINT64* timestamps = reinterpret_cast<const UINT64*>(data + HistogramTimestampsOffset);
+	UINT64 frequency = 0;
+	ThrowIfFailed(m_commandQueue->GetTimestampFrequency(&frequency));
+	m_gpuLuminanceMs = (frequency > 0) ? (timestamps[1] - timestamps[0]) * 1000.0 / frequency : 0.0;
+
+	m_histogramReadback->Unmap(0, &CD3DX12_RANGE(0, 0));
+
+	FinishLuminance(accumulator, m_gpuLuminance);
+	m_gpuLuminanceValid = true;
+	m_redraw.OnUIChanged();
+}
+
 // Prepare to render the next frame.
 void D3D12HDRViewer::MoveToNextFrame()
 {
@@ -1125,6 +2342,31 @@ void D3D12HDRViewer::EnsureSwapChainColorSpace(SwapChainBitDepth swapChainBitDep
     }
 }
 
+// The metadata of the current source. Content sources fall back to the pool
+// row until an image has been measured. Scene 1.0 is shown at the reference
+// white, scaled by the exposure, and so are the measured light levels.
+HDR10Metadata D3D12HDRViewer::GetHDRMetaData() const
+{
+	HDR10Metadata metadata;
+	metadata.maxMasteringNits = HDRMetaDataPool[m_hdrMetaDataPoolIdx][0];
+	metadata.minMasteringNits = HDRMetaDataPool[m_hdrMetaDataPoolIdx][1];
+	metadata.maxCLL = HDRMetaDataPool[m_hdrMetaDataPoolIdx][2];
+	metadata.maxFALL = HDRMetaDataPool[m_hdrMetaDataPoolIdx][3];
+
+	const ContentLightLevels& levels = (m_hdrMetaDataSource == HDRMetaDataFromSequence) ? m_sequenceLightLevels : m_imageLightLevels;
+	if (m_hdrMetaDataSource != HDRMetaDataFromPool && levels.frameCount > 0)
+	{
+		metadata = DeriveHDR10Metadata(levels, m_referenceWhiteNits / ScRGBReferenceNits * std::exp2(m_evValue));
+	}
+	return metadata;
+}
+
+void D3D12HDRViewer::ApplyHDRMetaData()
+{
+	m_hdrMetaData = GetHDRMetaData();
+	SetHDRMetaData(m_hdrMetaData.maxMasteringNits, m_hdrMetaData.minMasteringNits, m_hdrMetaData.maxCLL, m_hdrMetaData.maxFALL);
+}
+
 // Set HDR meta data for output display to master the content and the luminance values of the content.
 // An app should estimate and set appropriate metadata based on its contents.
 // For demo purpose, we simply made up a few set of metadata for you to experience the effect of appling meta data.
@@ -1199,7 +2441,7 @@ void D3D12HDRViewer::UpdateSwapChainBuffer(UINT width, UINT height, DXGI_FORMAT
     // Release the resources holding references to the swap chain (requirement of
     // IDXGISwapChain::ResizeBuffers) and reset the frame fence values to the
     // current fence value.
-    for (UINT n = 0; n < FrameCount; n++)
+    for (UINT n = 0; n < m_frameCount; n++)
     {
         m_renderTargets[n].Reset();
         m_fenceValues[n] = m_fenceValues[m_frameIndex];
@@ -1208,7 +2450,7 @@ void D3D12HDRViewer::UpdateSwapChainBuffer(UINT width, UINT height, DXGI_FORMAT
     // Resize the swap chain to the desired dimensions.
     DXGI_SWAP_CHAIN_DESC1 desc = {};
     m_swapChain->GetDesc1(&desc);
-    ThrowIfFailed(m_swapChain->ResizeBuffers(FrameCount, width, height, format, desc.Flags));
+    ThrowIfFailed(m_swapChain->ResizeBuffers(m_frameCount, width, height, format, desc.Flags));
 
     EnsureSwapChainColorSpace(m_currentSwapChainBitDepth, m_enableST2084);
 
@@ -25,6 +25,10 @@
 #pragma once
 
 #include "DXSample.h"
+#include "DescriptorHeap.h"
+#include "ImageLoader.h"
+#include "OutputLut3D.h"
+#include "TextureUploader.h"
 
 using namespace DirectX;
 
@@ -43,7 +47,7 @@ public:
 	inline DXGI_FORMAT GetBackBufferFormat() { return m_swapChainFormats[m_currentSwapChainBitDepth]; }
 
     static const float HDRMetaDataPool[4][4];
-	static const UINT FrameCount = 2;
+	static const UINT MaxFrameCount = 4;	// Upper bound of the swap chain buffer count.
 
 protected:
 	virtual void OnInit();
@@ -53,7 +57,14 @@ protected:
     virtual void OnWindowMoved(int xPos, int yPos);
 	virtual void OnDestroy();
 	virtual void OnKeyDown(UINT8 key);
+	virtual ViewState GetViewState() const;
+	virtual bool NeedsRender() const;
+	virtual HANDLE GetWakeEvent() const;
+	virtual int RunHeadless();
+
     virtual void OnDisplayChanged();
+	virtual void OnEnterSizeMove();
+	virtual void OnExitSizeMove();
 
 private:
 	static const float ClearColor[4];
@@ -78,15 +89,6 @@ private:
         float WhiteY;
     };
 
-	enum PipelineStates
-	{
-		PalettePSO = 0,
-		Present8bitPSO,
-		Present10bitPSO,
-		Present16bitPSO,
-		PipelineStateCount
-	};
-
 	enum SwapChainBitDepth
 	{
 		_8 = 0,
@@ -101,6 +103,8 @@ private:
 		DisplayCurve,
 		EVValue,
 		HeatmapFlag,
+		CurveLutFlag,
+		Lut3DSize,
 		RootConstantsCount
 	};
 
@@ -108,26 +112,38 @@ private:
 	{
 		sRGB = 0,	// The display expects an sRGB signal.
 		ST2084,		// The display expects an HDR10 signal.
-		None		// The display expects a linear signal.
+		None,		// The display expects a linear signal.
+		DisplayCurveCount
 	};
 
-	enum TextureFromat
+	enum PipelineStates
 	{
-		DDS = 0,
-		OpenEXR,
-		JXR,	// JPEG XR
-		Unsupported
+		PalettePSO = 0,		// Two-pass path: image into the intermediate.
+		Present8bitPSO,		// Two-pass path: intermediate into the back buffer.
+		Present10bitPSO,
+		Present16bitPSO,
+		FusedPSO,			// One per display curve and swap chain bit depth.
+		PipelineStateCount = FusedPSO + DisplayCurveCount * SwapChainBitDepthCount
 	};
 
-	enum  DescriptorHeapOffset : uint32_t
+	// Slots of the SRV table bound each frame (t0-t4 in the shaders).
+	enum SrvTableSlot : uint32_t
 	{
-		RENDER_TARGET_OFFSET = 0,
-		HDR_TEXTURE_HEAP_OFFSET,
-		HEATMAP_HEAP_OFFSET,
-		IMGUI_HEAP_OFFSET,
-		HEAP_MAX,
+		SceneSrvSlot = 0,
+		HdrTextureSrvSlot,
+		HeatmapSrvSlot,
+		CurveLutSrvSlot,
+		OutputLut3DSrvSlot,
+		SrvTableSlotCount
 	};
 
+	// Descriptor heap sizes. The shader-visible heap holds the ImGui font
+	// persistently and one SRV table per frame in flight; the staging heap holds
+	// the views those tables are copied from.
+	static const UINT ShaderVisibleDescriptorCount = 64;
+	static const UINT TransientDescriptorCountPerFrame = 64;
+	static const UINT StagingDescriptorCount = 256;
+
 
 	// Pipeline objects.
 	CD3DX12_VIEWPORT m_viewport;
@@ -135,15 +151,19 @@ private:
 	ComPtr<IDXGIFactory4> m_dxgiFactory;
 	ComPtr<IDXGISwapChain4> m_swapChain;
 	ComPtr<ID3D12Device> m_device;
-	ComPtr<ID3D12Resource> m_renderTargets[FrameCount];
+	ComPtr<ID3D12Resource> m_renderTargets[MaxFrameCount];
 	ComPtr<ID3D12Resource> m_intermediateRenderTarget;
-	ComPtr<ID3D12CommandAllocator> m_commandAllocators[FrameCount];
+	UINT m_intermediateWidth;	// Allocated size; the frame uses its top-left m_width x m_height.
+	UINT m_intermediateHeight;
+	ComPtr<ID3D12CommandAllocator> m_commandAllocators[MaxFrameCount];
 	ComPtr<ID3D12CommandQueue> m_commandQueue;
 	ComPtr<ID3D12RootSignature> m_rootSignature;
 	ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
-	ComPtr<ID3D12DescriptorHeap> m_srvHeap;
+	std::unique_ptr<DescriptorHeap> m_srvHeap;			// Shader visible.
+	std::unique_ptr<DescriptorHeap> m_srvStagingHeap;	// CPU only.
+	DescriptorRange m_srvTableSources[SrvTableSlotCount];
+	DescriptorRange m_imguiFontSrv;
 	UINT m_rtvDescriptorSize;
-	UINT m_srvDescriptorSize;
 	DXGI_FORMAT m_swapChainFormats[SwapChainBitDepthCount];
 	DXGI_COLOR_SPACE_TYPE m_currentSwapChainColorSpace;
 	SwapChainBitDepth m_currentSwapChainBitDepth;
@@ -156,14 +176,56 @@ private:
 	ComPtr<ID3D12GraphicsCommandList> m_commandList;
 	ComPtr<ID3D12Resource> m_vertexBuffer;
 	ComPtr<ID3D12Resource> m_vertexBufferUpload;
+	ComPtr<ID3D12Resource> m_curveLut;
+	ComPtr<ID3D12Resource> m_curveLutUpload;
 	D3D12_VERTEX_BUFFER_VIEW m_presentVertexBufferView;
 	UINT m_rootConstants[RootConstantsCount];
 	float* m_rootConstantsF;
 	bool m_enableEditWindow= true;
 	bool m_enableDisplayInfo = true;
     UINT m_hdrMetaDataPoolIdx = 0;
+
+	// Where the HDR10 metadata comes from: a row of HDRMetaDataPool, or the
+	// light levels the loader measured for the image on screen or for every
+	// image shown since a file was opened. Content metadata follows new
+	// measurements, exposure and reference white as they change.
+	enum HDRMetaDataSource
+	{
+		HDRMetaDataFromPool = 0,
+		HDRMetaDataFromImage,
+		HDRMetaDataFromSequence,
+		HDRMetaDataSourceCount
+	};
+	int m_hdrMetaDataSource = HDRMetaDataFromPool;
+	ContentLightLevels m_imageLightLevels;
+	ContentLightLevels m_sequenceLightLevels;
+	HDR10Metadata m_hdrMetaData;	// Last sent to the swap chain.
 	bool m_isHeatmap = false;
+	bool m_useCurveLut = false;
 	bool m_openLoadDialog = false;
+
+	// The 3D LUT of the output transform. It is baked from the curve, reference
+	// white and heatmap whenever one of them changes, unless a .cube file was
+	// loaded, which is used as is.
+	struct OutputLut3DKey
+	{
+		OutputCurve curve;
+		float standardNits;
+		bool heatmap;
+		UINT cubeGeneration;
+	};
+	bool m_useOutputLut3D = false;
+	bool m_openCubeDialog = false;
+	ComPtr<ID3D12Resource> m_outputLut3D;
+	UINT m_outputLut3DSize = 0;
+	OutputLut3DKey m_outputLut3DKey = {};
+	double m_outputLut3DBakeMs = 0.0;
+	double m_outputLut3DError = 0.0;	// In 10-bit code values; baked LUTs only.
+	OutputLut3D m_cubeLut;
+	std::string m_cubeLutName;		// UTF-8, for imgui.
+	std::string m_cubeLutError;
+	UINT m_cubeLutGeneration = 0;
+	std::vector<float> m_heatmapRow;	// The row of heatmap.dds the shaders sample, as RGB floats.
 	
 	// Color.
 	bool m_hdrSupport = false;
@@ -174,38 +236,148 @@ private:
 	UINT m_frameIndex;
 	HANDLE m_fenceEvent;
 	ComPtr<ID3D12Fence> m_fence;
-	UINT64 m_fenceValues[FrameCount];
+	UINT64 m_fenceValues[MaxFrameCount];
+
+	// Swap chain buffers, one frame in flight each.
+	UINT m_frameCount;
+
+	// Set when the swap chain was created frame-latency waitable; each frame
+	// waits on it before sampling input so that at most m_maxFrameLatency
+	// frames are queued ahead of the display.
+	HANDLE m_frameLatencyWaitableObject;
 
 	// Track the state of the window.
 	// If it's minimized the app may decide not to render frames.
 	bool m_windowVisible;
 	bool m_windowedMode;
-    bool m_in_sizechanging;
+    bool m_in_sizechanging;	// Between WM_ENTERSIZEMOVE and WM_EXITSIZEMOVE.
+
+	// Window size the swap chain is resized to once the drag ends. Until then
+	// the back buffers keep their size and DXGI stretches them to the window.
+	UINT m_pendingWidth;
+	UINT m_pendingHeight;
+	bool m_resizePending;
 
 	//
 	float m_evValue;
-	bool m_isLoadTexture = false;
+
+	// Asynchronous image loading.
+	std::unique_ptr<UploadRing> m_uploadRing;
+	std::unique_ptr<TextureUploader> m_textureUploader;
+
+	std::unique_ptr<ImageCache> m_imageCache;
+	std::unique_ptr<ImageCache> m_tileCache;
+	std::unique_ptr<ImageLoader> m_imageLoader;
 	std::wstring m_textureName;
-	TextureFromat	m_format;
+	std::vector<std::wstring> m_directoryFiles;	// Images next to the current one, for next/previous.
+	size_t m_directoryIndex = 0;
+	LoadResult m_lastLoad;	// Without the texture, for the UI.
+	bool m_progressiveLoad = true;	// Show EXRs band by band while they decode.
+
+	// Load-to-display latency: from the request until the first frame showing
+	// the new texture was presented.
+	bool m_displayPending = false;
+	std::chrono::steady_clock::time_point m_displayRequestTime;
+	double m_displayMs = 0.0;
+
+	// Frame times over the last FrameTimeHistory presents, to show jitter during loads.
+	static const UINT FrameTimeHistory = 120;
+	float m_frameTimesMs[FrameTimeHistory] = {};
+	UINT m_frameTimeCount = 0;
+	UINT m_frameTimeNext = 0;
+	std::chrono::steady_clock::time_point m_lastPresentTime;
+
+	// Latency from the start of a frame to the vblank it was displayed at, from
+	// the swap chain's frame statistics. Frame start times are kept by present
+	// count until the statistics catch up.
+	static const UINT PresentHistory = 16;
+	LONGLONG m_frameStartQpc = 0;
+	LONGLONG m_presentStartQpc[PresentHistory] = {};
+	LONGLONG m_qpcFrequency = 0;
+	double m_displayLatencyMs = 0.0;
+	UINT m_queuedFrames = 0;
+	bool m_frameStatisticsValid = false;
+	void RecordFrameStatistics();
+
+	// Throughput of the CPU reference of the output transform, per display curve,
+	// measured on demand from the UI.
+	float m_outputTransformMpixels[3] = {};
+	bool m_outputTransformMeasured = false;
+	void BenchmarkOutputTransforms();
+
+	// Speedup of the curve LUT over the analytic ST.2084 and sRGB encoding at 4K
+	// and 8K, and the LUT's worst error in 10-bit code values.
+	float m_curveLutMpixels[2][2][2] = {};	// [resolution][curve][analytic, LUT]
+	double m_curveLutError[2] = {};
+	bool m_curveLutMeasured = false;
+	void BenchmarkCurveLut();
+
+	// GPU luminance histogram of the texture on screen, run on demand from the UI
+	// to compare with the loader's CPU statistics. The dispatch is recorded into a
+	// frame and read back once that frame's fence has passed.
+	static const UINT HistogramBlockSize = 64;	// Pixels per group in each direction.
+	static const UINT HistogramResultsSize = 16 + LuminanceHistogramBins * sizeof(UINT);
+	static const UINT HistogramTimestampsOffset = HistogramResultsSize;	// In the readback buffer.
+	static const UINT HistogramGroupSumsOffset = HistogramTimestampsOffset + 2 * sizeof(UINT64);
+	ComPtr<ID3D12RootSignature> m_histogramRootSignature;
+	ComPtr<ID3D12PipelineState> m_histogramPipelineState;
+	ComPtr<ID3D12Resource> m_histogramResults;
+	ComPtr<ID3D12Resource> m_histogramResultsClear;	// Upload heap, holding the initial results.
+	ComPtr<ID3D12Resource> m_histogramGroupSums;
+	ComPtr<ID3D12Resource> m_histogramReadback;
+	ComPtr<ID3D12QueryHeap> m_histogramQueries;
+	UINT m_histogramGroupCapacity = 0;
+	bool m_histogramRequested = false;
+	UINT64 m_histogramFenceValue = 0;	// Of the frame that ran the histogram; 0 when none is pending.
+	UINT m_histogramWidth = 0;
+	UINT m_histogramHeight = 0;
+	LuminanceStatistics m_gpuLuminance;
+	double m_gpuLuminanceMs = 0.0;
+	bool m_gpuLuminanceValid = false;
+	void RecordLuminanceHistogram(D3D12_GPU_DESCRIPTOR_HANDLE imageSrv);
+	void ReadLuminanceHistogram(UINT64 completedFenceValue);
 
 	void LoadPipeline();
 	void LoadAssets();
 	void LoadSizeDependentResources();
 	XMFLOAT3 TransformVertex(XMFLOAT2 point, XMFLOAT2 offset);
 	void RenderScene();
+	ID3D12PipelineState* GetFusedPipelineState() const;
 	void WaitForGpu();
 	void MoveToNextFrame();
     void EnsureSwapChainColorSpace(SwapChainBitDepth d, bool enableST2084);
     void CheckDisplayHDRSupport();
     void SetHDRMetaData(float MaxOutputNits = 1000.0f, float MinOutputNits = 0.001f, float MaxCLL = 2000.0f, float MaxFALL = 500.0f);
+	HDR10Metadata GetHDRMetaData() const;
+	void ApplyHDRMetaData();
     void UpdateSwapChainBuffer(UINT width, UINT height, DXGI_FORMAT format);
+	void ApplySizeChange();
 
 	//
 	DXGI_OUTPUT_DESC1		m_outputdesc1;
 	ComPtr<ID3D12Resource>	m_hdrTexture;
+	std::shared_ptr<UploadedTexture> m_hdrUpload;	// Owns m_hdrTexture while it is shown; letting go returns it to the texture pool.
 	ComPtr<ID3D12Resource>	m_heatmapTexture;
 
+	// Textures replaced while earlier frames may still sample them, released
+	// once the frame fence passes fenceValue.
+	struct RetiredTexture
+	{
+		ComPtr<ID3D12Resource> resource;
+		std::shared_ptr<UploadedTexture> upload;
+		UINT64 fenceValue;
+	};
+	std::deque<RetiredTexture> m_retiredTextures;
+	void ReleaseRetiredTextures(UINT64 completedFenceValue);
+
 	void IMGuiUpdate();
+	void IMGuiLayerSelection();
+	void IMGuiLuminance();
 	void OpenFile();
-	HRESULT LoadTexture(std::wstring  filepath, const TextureFromat textureFormat, const uint32_t heapOffset);
+	void OpenCubeFile();
+	void UpdateOutputLut3D();
+	void ShowImage(const std::wstring& filepath);
+	void StepImage(int step);
+	void PublishTexture(LoadResult& result);
+	void RecordPresent();
 };
\ No newline at end of file
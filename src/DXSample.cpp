@@ -20,7 +20,18 @@ DXSample::DXSample(UINT width, UINT height, std::wstring name) :
 	m_windowBounds{0,0,0,0},
 	m_title(name),
 	m_aspectRatio(0.0f),
-	m_useWarpDevice(false)
+	m_useWarpDevice(false),
+	m_imageCacheSizeMB(2048),
+	m_tileCacheSizeMB(512),
+	m_uploadRingSizeMB(64),
+	m_texturePoolSizeMB(256),
+	m_streamLoads(false),
+	m_swapChainBufferCount(2),
+	m_maxFrameLatency(1),
+	m_waitableSwapChain(false),
+	m_allowTearing(false),
+	m_twoPassComposite(false),
+	m_metadataReport(false)
 {
 	WCHAR assetsPath[512];
 	GetAssetsPath(assetsPath, _countof(assetsPath));
@@ -98,6 +109,67 @@ void DXSample::ParseCommandLineArgs(WCHAR* argv[], int argc)
 			m_useWarpDevice = true;
 			m_title = m_title + L" (WARP)";
 		}
+		else if ((_wcsicmp(argv[i], L"-cachesize") == 0 ||
+			_wcsicmp(argv[i], L"/cachesize") == 0) && i + 1 < argc)
+		{
+			// Decoded image cache budget in megabytes.
+			m_imageCacheSizeMB = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if ((_wcsicmp(argv[i], L"-tilecachesize") == 0 ||
+			_wcsicmp(argv[i], L"/tilecachesize") == 0) && i + 1 < argc)
+		{
+			m_tileCacheSizeMB = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if ((_wcsicmp(argv[i], L"-uploadringsize") == 0 ||
+			_wcsicmp(argv[i], L"/uploadringsize") == 0) && i + 1 < argc)
+		{
+			m_uploadRingSizeMB = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if ((_wcsicmp(argv[i], L"-texturepoolsize") == 0 ||
+			_wcsicmp(argv[i], L"/texturepoolsize") == 0) && i + 1 < argc)
+		{
+			m_texturePoolSizeMB = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (_wcsicmp(argv[i], L"-stream") == 0 ||
+			_wcsicmp(argv[i], L"/stream") == 0)
+		{
+			m_streamLoads = true;
+		}
+		else if ((_wcsicmp(argv[i], L"-buffers") == 0 ||
+			_wcsicmp(argv[i], L"/buffers") == 0) && i + 1 < argc)
+		{
+			m_swapChainBufferCount = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if ((_wcsicmp(argv[i], L"-latency") == 0 ||
+			_wcsicmp(argv[i], L"/latency") == 0) && i + 1 < argc)
+		{
+			// Only a waitable swap chain can bound the frame latency.
+			m_maxFrameLatency = static_cast<UINT>(_wtoi(argv[++i]));
+			m_waitableSwapChain = true;
+		}
+		else if (_wcsicmp(argv[i], L"-waitable") == 0 ||
+			_wcsicmp(argv[i], L"/waitable") == 0)
+		{
+			m_waitableSwapChain = true;
+		}
+		else if (_wcsicmp(argv[i], L"-tearing") == 0 ||
+			_wcsicmp(argv[i], L"/tearing") == 0)
+		{
+			m_allowTearing = true;
+		}
+		else if (_wcsicmp(argv[i], L"-twopass") == 0 ||
+			_wcsicmp(argv[i], L"/twopass") == 0)
+		{
+			m_twoPassComposite = true;
+		}
+		else if (_wcsicmp(argv[i], L"-metadata") == 0 ||
+			_wcsicmp(argv[i], L"/metadata") == 0)
+		{
+			// Every remaining argument is a file or directory to report on.
+			m_metadataReport = true;
+			m_metadataReportPaths.assign(argv + i + 1, argv + argc);
+			break;
+		}
 	}
 }
 
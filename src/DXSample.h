@@ -12,6 +12,7 @@
 #pragma once
 
 #include "DXSampleHelper.h"
+#include "RedrawTracker.h"
 #include "Win32Application.h"
 
 class DXSample
@@ -34,6 +35,22 @@ public:
 	virtual void OnLeftButtonDown(UINT /*x*/, UINT /*y*/) {}
 	virtual void OnLeftButtonUp(UINT /*x*/, UINT /*y*/) {}
 	virtual void OnDisplayChanged() {}
+	virtual void OnEnterSizeMove() {}	// The user started dragging the window frame or title bar.
+	virtual void OnExitSizeMove() {}
+
+	// Redraw tracking, see RedrawTracker. The main loop only updates and
+	// renders while NeedsRender() is true and otherwise sleeps until a window
+	// message or GetWakeEvent() is signaled.
+	RedrawTracker& GetRedrawTracker()   { return m_redraw; }
+	virtual ViewState GetViewState() const { return ViewState(); }
+	virtual bool NeedsRender() const    { return m_redraw.NeedsRender(GetViewState()); }
+	virtual HANDLE GetWakeEvent() const { return nullptr; }
+	void ConsumeFrame()                 { m_redraw.ConsumeFrame(GetViewState()); }
+
+	// Command line modes that do their work without a window and exit with the
+	// returned code instead of running the sample.
+	bool IsHeadless() const             { return m_metadataReport; }
+	virtual int RunHeadless()           { return 0; }
 	
 	// Accessors.
 	UINT GetWidth() const           { return m_width; }
@@ -66,6 +83,39 @@ protected:
 	// Adapter info.
 	bool m_useWarpDevice;
 
+	// Budgets of the decoded image cache and the tiled EXR tile cache.
+	UINT m_imageCacheSizeMB;
+	UINT m_tileCacheSizeMB;
+
+	// Size of the upload ring every texture upload is staged in.
+	UINT m_uploadRingSizeMB;
+
+	// Budget of idle textures kept for reuse by loads of the same shape.
+	UINT m_texturePoolSizeMB;
+
+	// Decode EXRs through bounded band buffers to cap host memory.
+	bool m_streamLoads;
+
+	// Swap chain buffer count, and the frames that may be queued ahead of the
+	// display when the swap chain is frame-latency waitable.
+	UINT m_swapChainBufferCount;
+	UINT m_maxFrameLatency;
+	bool m_waitableSwapChain;
+
+	// Present without vsync when the system supports tearing.
+	bool m_allowTearing;
+
+	// Render through the intermediate render target in two passes instead of
+	// the fused pass, to compare the two.
+	bool m_twoPassComposite;
+
+	// -metadata: print the HDR10 metadata of these files, or of the images in
+	// these directories, and exit.
+	bool m_metadataReport;
+	std::vector<std::wstring> m_metadataReportPaths;
+
+	RedrawTracker m_redraw;
+
 private:
 	// Root assets path.
 	std::wstring m_assetsPath;
@@ -0,0 +1,135 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+#include "DescriptorAllocator.h"
+
+#include <cassert>
+#include <iterator>
+
+DescriptorAllocator::DescriptorAllocator(uint32_t capacity) :
+	m_capacity(capacity),
+	m_freeCount(0),
+	m_pendingCount(0)
+{
+	if (capacity > 0)
+	{
+		Insert(0, capacity);
+	}
+}
+
+uint32_t DescriptorAllocator::Allocate(uint32_t count)
+{
+	if (count == 0)
+	{
+		return InvalidOffset;
+	}
+
+	for (auto it = m_free.begin(); it != m_free.end(); ++it)
+	{
+		if (it->second < count)
+		{
+			continue;
+		}
+
+		const uint32_t offset = it->first;
+		const uint32_t remaining = it->second - count;
+		m_free.erase(it);
+		if (remaining > 0)
+		{
+			m_free.emplace(offset + count, remaining);
+		}
+		m_freeCount -= count;
+		return offset;
+	}
+
+	return InvalidOffset;
+}
+
+void DescriptorAllocator::Free(uint32_t offset, uint32_t count, uint64_t fenceValue)
+{
+	assert(offset != InvalidOffset && offset + count <= m_capacity);
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (fenceValue == 0)
+	{
+		Insert(offset, count);
+		return;
+	}
+
+	PendingFree pending = { offset, count, fenceValue };
+	m_pending.push_back(pending);
+	m_pendingCount += count;
+}
+
+void DescriptorAllocator::Reclaim(uint64_t completedFenceValue)
+{
+	// Fence values need not arrive in order, so every pending range is checked.
+	size_t kept = 0;
+	for (size_t i = 0; i < m_pending.size(); ++i)
+	{
+		const PendingFree& pending = m_pending[i];
+		if (pending.fenceValue <= completedFenceValue)
+		{
+			m_pendingCount -= pending.count;
+			Insert(pending.offset, pending.count);
+		}
+		else
+		{
+			m_pending[kept++] = pending;
+		}
+	}
+	m_pending.resize(kept);
+}
+
+// Adds a range to the free list, merging it with its neighbours.
+void DescriptorAllocator::Insert(uint32_t offset, uint32_t count)
+{
+	m_freeCount += count;
+
+	auto next = m_free.lower_bound(offset);
+	assert(next == m_free.end() || offset + count <= next->first);
+
+	if (next != m_free.begin())
+	{
+		auto previous = std::prev(next);
+		assert(previous->first + previous->second <= offset);
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			count += previous->second;
+			m_free.erase(previous);
+		}
+	}
+
+	if (next != m_free.end() && offset + count == next->first)
+	{
+		count += next->second;
+		m_free.erase(next);
+	}
+
+	m_free.emplace(offset, count);
+}
@@ -0,0 +1,75 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Hands out ranges of a fixed number of descriptor slots, first fit, and takes
+// freed ranges back once the GPU work that may still read them has finished,
+// as reported by a fence value. Adjacent free ranges are merged. It only does
+// the bookkeeping, so it has no D3D12 dependency; DescriptorHeap puts a
+// descriptor heap behind it. Not thread-safe.
+class DescriptorAllocator
+{
+public:
+	static const uint32_t InvalidOffset = ~0u;
+
+	explicit DescriptorAllocator(uint32_t capacity);
+
+	// Returns the first slot of count contiguous free slots, or InvalidOffset
+	// when no free range is large enough right now.
+	uint32_t Allocate(uint32_t count);
+
+	// The range can be reused once the fence reaches fenceValue; 0 frees it
+	// right away.
+	void Free(uint32_t offset, uint32_t count, uint64_t fenceValue);
+
+	// Frees the ranges whose fence value has been reached.
+	void Reclaim(uint64_t completedFenceValue);
+
+	uint32_t GetCapacity() const { return m_capacity; }
+	uint32_t GetFreeCount() const { return m_freeCount; }
+	uint32_t GetPendingCount() const { return m_pendingCount; }
+	size_t GetFreeRangeCount() const { return m_free.size(); }
+
+private:
+	struct PendingFree
+	{
+		uint32_t offset;
+		uint32_t count;
+		uint64_t fenceValue;
+	};
+
+	void Insert(uint32_t offset, uint32_t count);
+
+	std::map<uint32_t, uint32_t> m_free;	// Offset to count, never adjacent.
+	std::vector<PendingFree> m_pending;
+	uint32_t m_capacity;
+	uint32_t m_freeCount;
+	uint32_t m_pendingCount;
+};
@@ -0,0 +1,101 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "DescriptorHeap.h"
+#include "DXSampleHelper.h"
+
+DescriptorHeap::DescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, D3D12_DESCRIPTOR_HEAP_FLAGS flags,
+	UINT persistentCount, UINT transientCountPerFrame, UINT frameCount) :
+	m_cpuStart(),
+	m_gpuStart(),
+	m_descriptorSize(device->GetDescriptorHandleIncrementSize(type)),
+	m_shaderVisible((flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE) != 0),
+	m_allocator(persistentCount),
+	m_persistentCount(persistentCount),
+	m_transientCountPerFrame(transientCountPerFrame),
+	m_transientStart(persistentCount),
+	m_transientUsed(0)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = persistentCount + transientCountPerFrame * frameCount;
+	heapDesc.Type = type;
+	heapDesc.Flags = flags;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_heap)));
+	NAME_D3D12_OBJECT(m_heap);
+
+	m_cpuStart = m_heap->GetCPUDescriptorHandleForHeapStart();
+	if (m_shaderVisible)
+	{
+		m_gpuStart = m_heap->GetGPUDescriptorHandleForHeapStart();
+	}
+}
+
+HRESULT DescriptorHeap::Allocate(UINT count, DescriptorRange& range)
+{
+	const UINT offset = m_allocator.Allocate(count);
+	if (offset == DescriptorAllocator::InvalidOffset)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	MakeRange(offset, count, range);
+	return S_OK;
+}
+
+void DescriptorHeap::Free(DescriptorRange& range, UINT64 fenceValue)
+{
+	if (range.IsValid())
+	{
+		m_allocator.Free(range.offset, range.count, fenceValue);
+	}
+	range = DescriptorRange();
+}
+
+void DescriptorHeap::BeginFrame(UINT frameIndex, UINT64 completedFenceValue)
+{
+	m_transientStart = m_persistentCount + frameIndex * m_transientCountPerFrame;
+	m_transientUsed = 0;
+	m_allocator.Reclaim(completedFenceValue);
+}
+
+HRESULT DescriptorHeap::AllocateTransient(UINT count, DescriptorRange& range)
+{
+	if (count == 0 || m_transientUsed + count > m_transientCountPerFrame)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	MakeRange(m_transientStart + m_transientUsed, count, range);
+	m_transientUsed += count;
+	return S_OK;
+}
+
+void DescriptorHeap::MakeRange(UINT offset, UINT count, DescriptorRange& range) const
+{
+	range.offset = offset;
+	range.count = count;
+	range.cpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_cpuStart, offset, m_descriptorSize);
+	range.gpuHandle = m_shaderVisible ? CD3DX12_GPU_DESCRIPTOR_HANDLE(m_gpuStart, offset, m_descriptorSize) : D3D12_GPU_DESCRIPTOR_HANDLE();
+}
@@ -0,0 +1,92 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+#pragma once
+
+#include "DescriptorAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Contiguous descriptors of a DescriptorHeap. gpuHandle is only set for
+// shader-visible heaps.
+struct DescriptorRange
+{
+	uint32_t offset = DescriptorAllocator::InvalidOffset;
+	uint32_t count = 0;
+	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = {};
+
+	bool IsValid() const { return offset != DescriptorAllocator::InvalidOffset; }
+};
+
+// A descriptor heap split into a persistent part, allocated and freed through
+// a DescriptorAllocator, and optionally one transient part per frame in flight.
+// Transient descriptors are handed out linearly while a frame is recorded and
+// all come back when that frame's slot is recorded again, which the caller
+// only does once the GPU has finished with it.
+//
+// Persistent descriptors are created once in a CPU-only heap and copied into
+// the shader-visible heap's transient part for the tables a frame binds, so a
+// view can be rewritten or freed without waiting for the frames using it.
+// Render thread only.
+class DescriptorHeap
+{
+public:
+	DescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, D3D12_DESCRIPTOR_HEAP_FLAGS flags,
+		UINT persistentCount, UINT transientCountPerFrame = 0, UINT frameCount = 0);
+
+	DescriptorHeap(const DescriptorHeap&) = delete;
+	DescriptorHeap& operator=(const DescriptorHeap&) = delete;
+
+	HRESULT Allocate(UINT count, DescriptorRange& range);
+
+	// The descriptors can be reused once the fence reaches fenceValue; 0 frees
+	// them right away. range is reset.
+	void Free(DescriptorRange& range, UINT64 fenceValue);
+
+	// Starts recording frameIndex: rewinds its transient part and takes back
+	// persistent ranges freed up to completedFenceValue.
+	void BeginFrame(UINT frameIndex, UINT64 completedFenceValue);
+
+	HRESULT AllocateTransient(UINT count, DescriptorRange& range);
+
+	ID3D12DescriptorHeap* GetHeap() const { return m_heap.Get(); }
+	UINT GetDescriptorSize() const { return m_descriptorSize; }
+	const DescriptorAllocator& GetAllocator() const { return m_allocator; }
+
+private:
+	void MakeRange(UINT offset, UINT count, DescriptorRange& range) const;
+
+	ComPtr<ID3D12DescriptorHeap> m_heap;
+	D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart;
+	D3D12_GPU_DESCRIPTOR_HANDLE m_gpuStart;
+	UINT m_descriptorSize;
+	bool m_shaderVisible;
+
+	DescriptorAllocator m_allocator;
+	UINT m_persistentCount;
+	UINT m_transientCountPerFrame;
+	UINT m_transientStart;	// First transient slot of the frame being recorded.
+	UINT m_transientUsed;
+};
@@ -11,11 +11,16 @@
 
 #include "stdafx.h"
 #include "DirectXTexEXR.h"
+#include "ThreadPool.h"
+#include "HalfConversion.h"
 
 #include <DirectXPackedVector.h>
 
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
 #include <exception>
+#include <functional>
 #include <memory>
 
 //
@@ -25,9 +30,26 @@
 #pragma warning(push)
 #pragma warning(disable : 4244 4996)
 #include <ImfRgbaFile.h>
+#include <ImfTiledRgbaFile.h>
+#include <ImfInputFile.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfInputPart.h>
+#include <ImfPartType.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfThreading.h>
+#include <ImfHeader.h>
+#include <ImfCompression.h>
 #include <ImfIO.h>
 #pragma warning(pop)
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 static_assert(sizeof(Imf::Rgba) == 8, "Mismatch size");
 
 using namespace DirectX;
@@ -87,6 +109,167 @@ namespace
 		HRESULT result;
 	};
 
+	HANDLE OpenForReading(const wchar_t* szFile)
+	{
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+		return safe_handle(CreateFile2(szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr));
+#else
+		return safe_handle(CreateFileW(szFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+#endif
+	}
+
+	// Read-only view of a whole file: a file mapping on Win32, mmap on POSIX.
+	class MappedFile
+	{
+	public:
+		MappedFile() : m_data(nullptr), m_size(0)
+#if defined(_WIN32)
+			, m_hMapping(nullptr)
+#endif
+		{}
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile& operator = (const MappedFile &) = delete;
+
+		~MappedFile()
+		{
+#if defined(_WIN32)
+			if (m_data)
+				UnmapViewOfFile(m_data);
+			if (m_hMapping)
+				CloseHandle(m_hMapping);
+#else
+			if (m_data)
+				munmap(m_data, static_cast<size_t>(m_size));
+#endif
+		}
+
+		HRESULT Open(const wchar_t* szFile)
+		{
+#if defined(_WIN32)
+			ScopedHandle hFile(OpenForReading(szFile));
+			if (!hFile)
+				return HRESULT_FROM_WIN32(GetLastError());
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(hFile.get(), &fileSize))
+				return HRESULT_FROM_WIN32(GetLastError());
+
+			// A zero-length file can't be mapped, and can't be an EXR either.
+			if (fileSize.QuadPart == 0)
+				return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+			m_hMapping = CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!m_hMapping)
+				return HRESULT_FROM_WIN32(GetLastError());
+
+			m_data = MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (!m_data)
+				return HRESULT_FROM_WIN32(GetLastError());
+
+			m_size = fileSize.QuadPart;
+#else
+			std::string path(wcslen(szFile) * MB_CUR_MAX + 1, '\0');
+			if (wcstombs(&path[0], szFile, path.size()) == static_cast<size_t>(-1))
+				return E_INVALIDARG;
+
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return E_FAIL;
+
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0)
+			{
+				close(fd);
+				return E_FAIL;
+			}
+
+			void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (data == MAP_FAILED)
+				return E_FAIL;
+
+			m_data = data;
+			m_size = st.st_size;
+#endif
+			return S_OK;
+		}
+
+		const char* data() const { return static_cast<const char*>(m_data); }
+		Imf::Int64 size() const { return m_size; }
+
+	private:
+		void* m_data;
+		Imf::Int64 m_size;
+#if defined(_WIN32)
+		HANDLE m_hMapping;
+#endif
+	};
+
+	// Imf::IStream over a block of memory. Advertising isMemoryMapped() lets the
+	// decoder take pointers straight into the mapping instead of copying chunks out.
+	class MemoryInputStream : public Imf::IStream
+	{
+	public:
+		MemoryInputStream(const char* data, Imf::Int64 size, const char fileName[]) :
+			IStream(fileName), m_data(data), m_size(size), m_pos(0) {}
+
+		MemoryInputStream(const MemoryInputStream &) = delete;
+		MemoryInputStream& operator = (const MemoryInputStream &) = delete;
+
+		virtual bool isMemoryMapped() const override
+		{
+			return true;
+		}
+
+		virtual char* readMemoryMapped(int n) override
+		{
+			// The decoder only reads through the returned pointer.
+			return const_cast<char*>(m_data + Advance(n));
+		}
+
+		virtual bool read(char c[], int n) override
+		{
+			memcpy(c, m_data + Advance(n), static_cast<size_t>(n));
+			return m_pos < m_size;
+		}
+
+		virtual Imf::Int64 tellg() override
+		{
+			return m_pos;
+		}
+
+		virtual void seekg(Imf::Int64 pos) override
+		{
+			m_pos = pos;
+		}
+
+		virtual void clear() override
+		{
+		}
+
+	private:
+		Imf::Int64 Advance(int n)
+		{
+			if (n < 0 || m_pos < 0 || m_pos + n > m_size)
+			{
+				throw com_exception(HRESULT_FROM_WIN32(ERROR_HANDLE_EOF));
+			}
+
+			Imf::Int64 pos = m_pos;
+			m_pos += n;
+			return pos;
+		}
+
+		const char* m_data;
+		Imf::Int64 m_size;
+		Imf::Int64 m_pos;
+	};
+
+	// Imf::IStream over a file handle: every read is a ReadFile plus a
+	// SetFilePointerEx, and the decoder copies each chunk out. Only used for
+	// EXR_FILE_ACCESS_READFILE, to compare against the mapping.
 	class InputStream : public Imf::IStream
 	{
 	public:
@@ -126,7 +309,7 @@ namespace
 				throw com_exception(HRESULT_FROM_WIN32(GetLastError()));
 			}
 
-			return result.QuadPart >= m_EOF;
+			return result.QuadPart < m_EOF;
 		}
 
 		virtual Imf::Int64 tellg() override
@@ -202,6 +385,45 @@ namespace
 	private:
 		HANDLE m_hFile;
 	};
+
+	// Number of scanlines stored together in one compressed chunk. Decoding a band
+	// that starts or ends inside a chunk would decompress that chunk twice.
+	int GetLinesPerBlock(Imf::Compression compression)
+	{
+		switch (compression)
+		{
+		case Imf::ZIP_COMPRESSION:
+		case Imf::PXR24_COMPRESSION:
+			return 16;
+
+		case Imf::PIZ_COMPRESSION:
+		case Imf::B44_COMPRESSION:
+		case Imf::B44A_COMPRESSION:
+		case Imf::DWAA_COMPRESSION:
+			return 32;
+
+		case Imf::DWAB_COMPRESSION:
+			return 256;
+
+		default:
+			return 1;
+		}
+	}
+
+	Imf::Compression GetImfCompression(EXR_COMPRESSION compression)
+	{
+		switch (compression)
+		{
+		case EXR_COMPRESSION_NONE:	return Imf::NO_COMPRESSION;
+		case EXR_COMPRESSION_RLE:	return Imf::RLE_COMPRESSION;
+		case EXR_COMPRESSION_ZIPS:	return Imf::ZIPS_COMPRESSION;
+		case EXR_COMPRESSION_ZIP:	return Imf::ZIP_COMPRESSION;
+		case EXR_COMPRESSION_PIZ:	return Imf::PIZ_COMPRESSION;
+		case EXR_COMPRESSION_DWAA:	return Imf::DWAA_COMPRESSION;
+		case EXR_COMPRESSION_DWAB:	return Imf::DWAB_COMPRESSION;
+		default:					return Imf::NUM_COMPRESSION_METHODS;
+		}
+	}
 }
 
 
@@ -225,20 +447,12 @@ HRESULT DirectX::GetMetadataFromEXRFile(const wchar_t* szFile, TexMetadata& meta
 		*fileName = 0;
 	}
 
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-	ScopedHandle hFile(safe_handle(CreateFile2(szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr)));
-#else
-	ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-		FILE_FLAG_SEQUENTIAL_SCAN, nullptr)));
-#endif
-	if (!hFile)
-	{
-		return HRESULT_FROM_WIN32(GetLastError());
-	}
-
-	InputStream stream(hFile.get(), fileName);
+	MappedFile mappedFile;
+	HRESULT hr = mappedFile.Open(szFile);
+	if (FAILED(hr))
+		return hr;
 
-	HRESULT hr = S_OK;
+	MemoryInputStream stream(mappedFile.data(), mappedFile.size(), fileName);
 
 	try
 	{
@@ -282,213 +496,1130 @@ HRESULT DirectX::GetMetadataFromEXRFile(const wchar_t* szFile, TexMetadata& meta
 }
 
 
-//-------------------------------------------------------------------------------------
-// Load a EXR file from disk
-//-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, TexMetadata* metadata, ScratchImage& image)
+namespace
 {
-	if (!szFile)
-		return E_INVALIDARG;
-
-	image.Release();
+	// Creates a decoder of its own for a worker thread and runs the callback with
+	// it. The decoder only lives for the duration of the call.
+	template<typename TDecoder>
+	using WorkerDecoderFactory = std::function<void(const std::function<void(TDecoder&)>&)>;
 
-	if (metadata)
+	std::function<void(size_t, size_t)> MakeBandNotifier(const ScratchImage& image, const EXRBandCallback& onBand)
 	{
-		memset(metadata, 0, sizeof(TexMetadata));
+		if (!onBand)
+		{
+			return nullptr;
+		}
+		return [&image, &onBand](size_t firstRow, size_t rowCount) { onBand(image, firstRow, rowCount); };
 	}
 
-	char fileName[MAX_PATH];
-	int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
-	if (result <= 0)
+	template<typename TFile>
+	WorkerDecoderFactory<TFile> MakeStreamDecoderFactory(const char* data, Imf::Int64 size, const char* fileName)
 	{
-		*fileName = 0;
+		return [=](const std::function<void(TFile&)>& use)
+		{
+			MemoryInputStream stream(data, size, fileName);
+			TFile file(stream);
+			use(file);
+		};
 	}
 
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-	ScopedHandle hFile(safe_handle(CreateFile2(szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr)));
-#else
-	ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-		FILE_FLAG_SEQUENTIAL_SCAN, nullptr)));
-#endif
-	if (!hFile)
+	// A handle has a single file pointer, so every worker opens the file again.
+	template<typename TFile>
+	WorkerDecoderFactory<TFile> MakeFileDecoderFactory(const wchar_t* szFile, const char* fileName)
 	{
-		return HRESULT_FROM_WIN32(GetLastError());
-	}
-
-	InputStream stream(hFile.get(), fileName);
+		return [=](const std::function<void(TFile&)>& use)
+		{
+			ScopedHandle hFile(OpenForReading(szFile));
+			if (!hFile)
+			{
+				throw com_exception(HRESULT_FROM_WIN32(GetLastError()));
+			}
 
-	HRESULT hr = S_OK;
+			InputStream stream(hFile.get(), fileName);
+			TFile file(stream);
+			use(file);
+		};
+	}
 
-	try
+	// Reads the whole data window of a scanline file in compression-block aligned
+	// row bands. Decoders are not safe to share between threads, so every worker
+	// past the first gets its own from createWorkerDecoder, set up through
+	// setFrameBuffer, and pulls bands until none are left. onBand, if set, gets the
+	// rows of each finished band relative to the top of the data window.
+	template<typename TDecoder, typename TSetFrameBuffer>
+	void ReadPixelsInBands(TDecoder& decoder, const WorkerDecoderFactory<TDecoder>& createWorkerDecoder,
+		size_t threadCount, TSetFrameBuffer setFrameBuffer, const std::function<void(size_t, size_t)>& onBand)
 	{
-		Imf::RgbaInputFile file(stream);
-
-		auto dw = file.dataWindow();
-
-		int width = dw.max.x - dw.min.x + 1;
+		auto dw = decoder.header().dataWindow();
 		int height = dw.max.y - dw.min.y + 1;
 
-		if (width < 1 || height < 1)
-			return E_FAIL;
-
-		if (metadata)
+		ThreadPool& pool = ThreadPool::GetDefault();
+		if (threadCount == 0)
 		{
-			metadata->width = static_cast<size_t>(width);
-			metadata->height = static_cast<size_t>(height);
-			metadata->depth = metadata->arraySize = metadata->mipLevels = 1;
-			metadata->format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-			metadata->dimension = TEX_DIMENSION_TEXTURE2D;
+			threadCount = pool.GetConcurrency();
 		}
 
-		hr = image.Initialize2D(DXGI_FORMAT_R16G16B16A16_FLOAT, width, height, 1, 1);
-		if (FAILED(hr))
-			return hr;
-
-		file.setFrameBuffer(reinterpret_cast<Imf::Rgba*>(image.GetPixels()) - dw.min.x - dw.min.y * width, 1, width);
-		file.readPixels(dw.min.y, dw.max.y);
-	}
-	catch (const com_exception& exc)
-	{
-#ifdef _DEBUG
-		OutputDebugStringA(exc.what());
-#endif
-		hr = exc.hr();
-	}
-	catch (const std::exception& exc)
-	{
-		exc;
-#ifdef _DEBUG
-		OutputDebugStringA(exc.what());
-#endif
-		hr = E_FAIL;
-	}
-	catch (...)
-	{
-		hr = E_UNEXPECTED;
-	}
-
-	if (FAILED(hr))
-	{
-		image.Release();
-	}
-
-	return hr;
-}
+		// Aim for a few bands per worker so that uneven chunk sizes still balance out.
+		const int linesPerBlock = GetLinesPerBlock(decoder.header().compression());
+		int bandLines = height / static_cast<int>(threadCount * 4);
+		bandLines = std::max(linesPerBlock, (bandLines + linesPerBlock - 1) / linesPerBlock * linesPerBlock);
 
+		const size_t bandCount = static_cast<size_t>((height + bandLines - 1) / bandLines);
+		const size_t workerCount = std::min(std::min(threadCount, bandCount), pool.GetConcurrency());
 
-//-------------------------------------------------------------------------------------
-// Save a EXR file to disk
-//-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-HRESULT DirectX::SaveToEXRFile(const Image& image, const wchar_t* szFile)
-{
-	if (!szFile)
-		return E_INVALIDARG;
+		if (workerCount <= 1 && !onBand)
+		{
+			setFrameBuffer(decoder);
+			decoder.readPixels(dw.min.y, dw.max.y);
+			return;
+		}
 
-	if (!image.pixels)
-		return E_POINTER;
+		std::atomic<size_t> nextBand(0);
 
-	if (image.width > INT32_MAX || image.height > INT32_MAX)
-		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		pool.ParallelFor(workerCount, [&](size_t worker)
+		{
+			std::function<void(TDecoder&)> readBands = [&](TDecoder& workerDecoder)
+			{
+				setFrameBuffer(workerDecoder);
 
-	switch (image.format)
-	{
-	case DXGI_FORMAT_R16G16B16A16_FLOAT:
-		if ((image.rowPitch % 8) > 0)
-			return E_FAIL;
-		break;
+				for (size_t band = nextBand++; band < bandCount; band = nextBand++)
+				{
+					int y0 = dw.min.y + static_cast<int>(band) * bandLines;
+					int y1 = std::min(y0 + bandLines - 1, dw.max.y);
+					workerDecoder.readPixels(y0, y1);
 
-	case DXGI_FORMAT_R32G32B32A32_FLOAT:
-	case DXGI_FORMAT_R32G32B32_FLOAT:
-		break;
+					if (onBand)
+					{
+						onBand(static_cast<size_t>(y0 - dw.min.y), static_cast<size_t>(y1 - y0 + 1));
+					}
+				}
+			};
 
-	default:
-		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+			if (worker == 0)
+			{
+				readBands(decoder);
+			}
+			else
+			{
+				createWorkerDecoder(readBands);
+			}
+		});
 	}
 
-	char fileName[MAX_PATH];
-	int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
-	if (result <= 0)
-	{
-		*fileName = 0;
-	}
-	// Create file and write header
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-	ScopedHandle hFile(safe_handle(CreateFile2(szFile, GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr)));
-#else
-	ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr)));
-#endif
-	if (!hFile)
+	// Like ReadPixelsInBands, but the rows go through band buffers instead of a
+	// whole image. Every worker allocates one buffer of whole bands, prepared by
+	// initBand, points its decoder at it with setFrameBuffer(decoder, pixels, y0)
+	// for each band it pulls, and hands the decoded rows to onBand before the next.
+	template<typename TDecoder, typename TSetFrameBuffer>
+	void ReadPixelsStreamed(TDecoder& decoder, const WorkerDecoderFactory<TDecoder>& createWorkerDecoder,
+		size_t threadCount, const TexMetadata& metadata, size_t maxBandBytes, TSetFrameBuffer setFrameBuffer,
+		const std::function<void(const Image&)>& initBand, const EXRStreamCallback& onBand)
 	{
-		return HRESULT_FROM_WIN32(GetLastError());
-	}
+		auto dw = decoder.header().dataWindow();
+		int height = dw.max.y - dw.min.y + 1;
 
-	auto_delete_file delonfail(hFile.get());
+		ThreadPool& pool = ThreadPool::GetDefault();
+		if (threadCount == 0)
+		{
+			threadCount = pool.GetConcurrency();
+		}
 
-	OutputStream stream(hFile.get(), fileName);
+		size_t rowPitch, slicePitch;
+		HRESULT hr = ComputePitch(metadata.format, metadata.width, 1, rowPitch, slicePitch);
+		if (FAILED(hr))
+			throw com_exception(hr);
 
-	HRESULT hr = S_OK;
+		const int linesPerBlock = GetLinesPerBlock(decoder.header().compression());
+		int bandLines = static_cast<int>(std::min<size_t>(maxBandBytes / rowPitch, static_cast<size_t>(height)));
+		bandLines = std::max(linesPerBlock, bandLines / linesPerBlock * linesPerBlock);
 
-	try
-	{
-		int width = static_cast<int>(image.width);
-		int height = static_cast<int>(image.height);
+		const size_t bandCount = static_cast<size_t>((height + bandLines - 1) / bandLines);
+		const size_t workerCount = std::max<size_t>(1, std::min(std::min(threadCount, bandCount), pool.GetConcurrency()));
 
-		Imf::RgbaOutputFile file(stream, Imf::Header(width, height), Imf::WRITE_RGBA);
+		std::atomic<size_t> nextBand(0);
 
-		if (image.format == DXGI_FORMAT_R16G16B16A16_FLOAT)
-		{
-			file.setFrameBuffer(reinterpret_cast<const Imf::Rgba*>(image.pixels), 1, image.rowPitch / 8);
-			file.writePixels(height);
-		}
-		else
+		pool.ParallelFor(workerCount, [&](size_t worker)
 		{
-			std::unique_ptr<XMHALF4> temp(new (std::nothrow) XMHALF4[width * height]);
-			if (!temp)
-				return E_OUTOFMEMORY;
+			std::function<void(TDecoder&)> readBands = [&](TDecoder& workerDecoder)
+			{
+				ScratchImage buffer;
+				HRESULT hrBuffer = buffer.Initialize2D(metadata.format, metadata.width, static_cast<size_t>(bandLines), 1, 1);
+				if (FAILED(hrBuffer))
+					throw com_exception(hrBuffer);
 
-			file.setFrameBuffer(reinterpret_cast<const Imf::Rgba*>(temp.get()), 1, width);
+				const Image& bandImage = *buffer.GetImage(0, 0, 0);
+				if (initBand)
+				{
+					initBand(bandImage);
+				}
 
-			auto sPtr = image.pixels;
-			auto dPtr = temp.get();
-			if (image.format == DXGI_FORMAT_R32G32B32A32_FLOAT)
-			{
-				for (int j = 0; j < height; ++j)
+				for (size_t band = nextBand++; band < bandCount; band = nextBand++)
 				{
-					auto srcPtr = reinterpret_cast<const XMFLOAT4*>(sPtr);
-					auto destPtr = dPtr;
-					for (int k = 0; k < width; ++k, ++srcPtr, ++destPtr)
+					int y0 = dw.min.y + static_cast<int>(band) * bandLines;
+					int y1 = std::min(y0 + bandLines - 1, dw.max.y);
+					setFrameBuffer(workerDecoder, bandImage.pixels, y0);
+					workerDecoder.readPixels(y0, y1);
+
+					Image rows = bandImage;
+					rows.height = static_cast<size_t>(y1 - y0 + 1);
+					rows.slicePitch = rows.rowPitch * rows.height;
+					HRESULT hrBand = onBand(metadata, rows, static_cast<size_t>(y0 - dw.min.y));
+					if (FAILED(hrBand))
 					{
-						XMVECTOR v = XMLoadFloat4(srcPtr);
-						PackedVector::XMStoreHalf4(destPtr, v);
+						// Stop the other workers after their current band.
+						nextBand = bandCount;
+						throw com_exception(hrBand);
 					}
-
-					sPtr += image.rowPitch;
-					dPtr += width;
-
-					file.writePixels(1);
 				}
+			};
+
+			if (worker == 0)
+			{
+				readBands(decoder);
 			}
 			else
 			{
-				assert(image.format == DXGI_FORMAT_R32G32B32_FLOAT);
+				createWorkerDecoder(readBands);
+			}
+		});
+	}
 
-				for (int j = 0; j < height; ++j)
-				{
-					auto srcPtr = reinterpret_cast<const XMFLOAT3*>(sPtr);
-					auto destPtr = dPtr;
-					for (int k = 0; k < width; ++k, ++srcPtr, ++destPtr)
-					{
-						XMVECTOR v = XMLoadFloat3(srcPtr);
-						v = XMVectorSelect(g_XMIdentityR3, v, g_XMSelect1110);
-						PackedVector::XMStoreHalf4(destPtr, v);
-					}
+	// Decodes an EXR from stream, with workers past the first reading through
+	// decoders from createWorkerDecoder. With onStream, the rows go to it in bands
+	// of at most maxBandBytes and image is left empty.
+	HRESULT LoadFromEXRStream(Imf::IStream& stream, const WorkerDecoderFactory<Imf::RgbaInputFile>& createWorkerDecoder,
+		size_t threadCount, TexMetadata* metadata, ScratchImage& image, const EXRBandCallback& onBand = nullptr,
+		size_t maxBandBytes = 0, const EXRStreamCallback& onStream = nullptr)
+	{
+		HRESULT hr = S_OK;
+
+		try
+		{
+			Imf::RgbaInputFile file(stream);
+
+			auto dw = file.dataWindow();
+
+			int width = dw.max.x - dw.min.x + 1;
+			int height = dw.max.y - dw.min.y + 1;
+
+			if (width < 1 || height < 1)
+				return E_FAIL;
+
+			TexMetadata info = {};
+			info.width = static_cast<size_t>(width);
+			info.height = static_cast<size_t>(height);
+			info.depth = info.arraySize = info.mipLevels = 1;
+			info.format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+			info.dimension = TEX_DIMENSION_TEXTURE2D;
 
-					sPtr += image.rowPitch;
-					dPtr += width;
+			if (metadata)
+			{
+				*metadata = info;
+			}
+
+			if (onStream)
+			{
+				ReadPixelsStreamed(file, createWorkerDecoder, threadCount, info, maxBandBytes,
+					[&](Imf::RgbaInputFile& decoder, uint8_t* pixels, int y0)
+				{
+					decoder.setFrameBuffer(reinterpret_cast<Imf::Rgba*>(pixels) - dw.min.x - static_cast<ptrdiff_t>(y0) * width, 1, width);
+				}, nullptr, onStream);
+				return S_OK;
+			}
+
+			hr = image.Initialize2D(DXGI_FORMAT_R16G16B16A16_FLOAT, width, height, 1, 1);
+			if (FAILED(hr))
+				return hr;
+
+			auto frameBuffer = reinterpret_cast<Imf::Rgba*>(image.GetPixels()) - dw.min.x - dw.min.y * width;
+
+			ReadPixelsInBands(file, createWorkerDecoder, threadCount, [&](Imf::RgbaInputFile& decoder)
+			{
+				decoder.setFrameBuffer(frameBuffer, 1, width);
+			}, MakeBandNotifier(image, onBand));
+		}
+		catch (const com_exception& exc)
+		{
+#ifdef _DEBUG
+			OutputDebugStringA(exc.what());
+#endif
+			hr = exc.hr();
+		}
+		catch (const std::exception& exc)
+		{
+			exc;
+#ifdef _DEBUG
+			OutputDebugStringA(exc.what());
+#endif
+			hr = E_FAIL;
+		}
+		catch (...)
+		{
+			hr = E_UNEXPECTED;
+		}
+
+		if (FAILED(hr))
+		{
+			image.Release();
+		}
+
+		return hr;
+	}
+
+	// Decodes an EXR that is already in memory (a mapped file or a caller's buffer).
+	HRESULT LoadFromEXRStream(const char* data, Imf::Int64 size, const char* fileName,
+		size_t threadCount, TexMetadata* metadata, ScratchImage& image, const EXRBandCallback& onBand = nullptr,
+		size_t maxBandBytes = 0, const EXRStreamCallback& onStream = nullptr)
+	{
+		MemoryInputStream stream(data, size, fileName);
+		return LoadFromEXRStream(stream, MakeStreamDecoderFactory<Imf::RgbaInputFile>(data, size, fileName),
+			threadCount, metadata, image, onBand, maxBandBytes, onStream);
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+// Load a EXR file from disk
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, TexMetadata* metadata, ScratchImage& image)
+{
+	return LoadFromEXRFile(szFile, 1, metadata, image);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, size_t threadCount, TexMetadata* metadata, ScratchImage& image)
+{
+	return LoadFromEXRFile(szFile, threadCount, EXR_FILE_ACCESS_MAPPED, metadata, image);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, size_t threadCount, EXR_FILE_ACCESS access, TexMetadata* metadata, ScratchImage& image)
+{
+	if (!szFile)
+		return E_INVALIDARG;
+
+	image.Release();
+
+	if (metadata)
+	{
+		memset(metadata, 0, sizeof(TexMetadata));
+	}
+
+	char fileName[MAX_PATH];
+	int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
+	if (result <= 0)
+	{
+		*fileName = 0;
+	}
+
+	if (access == EXR_FILE_ACCESS_READFILE)
+	{
+		ScopedHandle hFile(OpenForReading(szFile));
+		if (!hFile)
+			return HRESULT_FROM_WIN32(GetLastError());
+
+		try
+		{
+			InputStream stream(hFile.get(), fileName);
+			return LoadFromEXRStream(stream, MakeFileDecoderFactory<Imf::RgbaInputFile>(szFile, fileName), threadCount, metadata, image);
+		}
+		catch (const com_exception& exc)
+		{
+			return exc.hr();
+		}
+	}
+
+	MappedFile mappedFile;
+	HRESULT hr = mappedFile.Open(szFile);
+	if (FAILED(hr))
+		return hr;
+
+	return LoadFromEXRStream(mappedFile.data(), mappedFile.size(), fileName, threadCount, metadata, image);
+}
+
+
+//-------------------------------------------------------------------------------------
+// Load a EXR file from memory
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromEXRMemory(const void* pSource, size_t size, size_t threadCount, TexMetadata* metadata, ScratchImage& image, const EXRBandCallback& onBand)
+{
+	if (!pSource || !size)
+		return E_INVALIDARG;
+
+	image.Release();
+
+	if (metadata)
+	{
+		memset(metadata, 0, sizeof(TexMetadata));
+	}
+
+	return LoadFromEXRStream(static_cast<const char*>(pSource), static_cast<Imf::Int64>(size), "", threadCount, metadata, image, onBand);
+}
+
+
+namespace
+{
+	HRESULT GetEXRPartsFromStream(const char* data, Imf::Int64 size, const char* fileName, std::vector<EXRPartInfo>& parts)
+	{
+		MemoryInputStream stream(data, size, fileName);
+
+		HRESULT hr = S_OK;
+
+		try
+		{
+			// Only the headers are parsed; no pixel data is touched.
+			Imf::MultiPartInputFile file(stream);
+
+			for (int p = 0; p < file.parts(); ++p)
+			{
+				const Imf::Header& header = file.header(p);
+
+				parts.push_back(EXRPartInfo());
+				EXRPartInfo& part = parts.back();
+
+				part.name = header.hasName() ? header.name() : std::string();
+
+				auto dw = header.dataWindow();
+				part.width = static_cast<size_t>(std::max(dw.max.x - dw.min.x + 1, 0));
+				part.height = static_cast<size_t>(std::max(dw.max.y - dw.min.y + 1, 0));
+				part.tiled = header.hasTileDescription();
+				part.deep = header.hasType() && (header.type() == Imf::DEEPSCANLINE || header.type() == Imf::DEEPTILE);
+
+				// Layers are listed in the order their first channel appears. The channel
+				// list is sorted by name, so "A" and "B" can surround "Albedo.R".
+				const Imf::ChannelList& channels = header.channels();
+				for (auto it = channels.begin(); it != channels.end(); ++it)
+				{
+					std::string name(it.name());
+					size_t dot = name.find_last_of('.');
+					std::string layerName = (dot == std::string::npos) ? std::string() : name.substr(0, dot);
+
+					auto layer = std::find_if(part.layers.begin(), part.layers.end(), [&layerName](const EXRLayer& l) { return l.name == layerName; });
+					if (layer == part.layers.end())
+					{
+						part.layers.push_back(EXRLayer());
+						part.layers.back().name = layerName;
+						layer = part.layers.end() - 1;
+					}
+					layer->channels.push_back(name);
+				}
+			}
+		}
+		catch (const com_exception& exc)
+		{
+#ifdef _DEBUG
+			OutputDebugStringA(exc.what());
+#endif
+			hr = exc.hr();
+		}
+		catch (const std::exception& exc)
+		{
+			exc;
+#ifdef _DEBUG
+			OutputDebugStringA(exc.what());
+#endif
+			hr = E_FAIL;
+		}
+		catch (...)
+		{
+			hr = E_UNEXPECTED;
+		}
+
+		if (FAILED(hr))
+		{
+			parts.clear();
+		}
+
+		return hr;
+	}
+
+	// Decodes only the selected channels, packed into the smallest R, RG or RGBA
+	// format that holds them. Half channels stay half; anything else becomes float.
+	// With onStream, the rows go to it in bands of at most maxBandBytes and image
+	// is left empty.
+	HRESULT LoadEXRChannelsFromStream(const char* data, Imf::Int64 size, const char* fileName,
+		const EXRChannelSelection& selection, size_t threadCount, TexMetadata* metadata, ScratchImage& image, const EXRBandCallback& onBand,
+		size_t maxBandBytes = 0, const EXRStreamCallback& onStream = nullptr)
+	{
+		size_t selectedCount = 0;
+		for (size_t c = 0; c < _countof(selection.channels); ++c)
+		{
+			if (!selection.channels[c].empty())
+			{
+				selectedCount = c + 1;
+			}
+		}
+		if (selectedCount == 0)
+			return E_INVALIDARG;
+
+		MemoryInputStream stream(data, size, fileName);
+
+		HRESULT hr = S_OK;
+
+		try
+		{
+			Imf::MultiPartInputFile multiPartFile(stream);
+			if (selection.part >= static_cast<size_t>(multiPartFile.parts()))
+				return E_INVALIDARG;
+
+			const int partIndex = static_cast<int>(selection.part);
+			const Imf::Header& partHeader = multiPartFile.header(partIndex);
+			if (partHeader.hasType() && (partHeader.type() == Imf::DEEPSCANLINE || partHeader.type() == Imf::DEEPTILE))
+				return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+			// Single-part files are read as part 0.
+			Imf::InputPart file(multiPartFile, partIndex);
+
+			auto dw = file.header().dataWindow();
+
+			int width = dw.max.x - dw.min.x + 1;
+			int height = dw.max.y - dw.min.y + 1;
+
+			if (width < 1 || height < 1)
+				return E_FAIL;
+
+			const Imf::ChannelList& channels = file.header().channels();
+
+			Imf::PixelType pixelType = Imf::HALF;
+			for (size_t c = 0; c < selectedCount; ++c)
+			{
+				if (selection.channels[c].empty())
+					continue;
+
+				const Imf::Channel* channel = channels.findChannel(selection.channels[c].c_str());
+				if (!channel)
+					return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+
+				// Subsampled channels would need upsampling; leave them to a later change.
+				if (channel->xSampling != 1 || channel->ySampling != 1)
+					return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+				if (channel->type != Imf::HALF)
+				{
+					pixelType = Imf::FLOAT;
+				}
+			}
+
+			// There is no three-component 16-bit format, so RGB is padded to RGBA.
+			const size_t componentCount = (selectedCount == 3) ? 4 : selectedCount;
+			static const DXGI_FORMAT halfFormats[] = { DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_R16G16_FLOAT, DXGI_FORMAT_UNKNOWN, DXGI_FORMAT_R16G16B16A16_FLOAT };
+			static const DXGI_FORMAT floatFormats[] = { DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_UNKNOWN, DXGI_FORMAT_R32G32B32A32_FLOAT };
+			const DXGI_FORMAT format = (pixelType == Imf::HALF) ? halfFormats[componentCount - 1] : floatFormats[componentCount - 1];
+
+			TexMetadata info = {};
+			info.width = static_cast<size_t>(width);
+			info.height = static_cast<size_t>(height);
+			info.depth = info.arraySize = info.mipLevels = 1;
+			info.format = format;
+			info.dimension = TEX_DIMENSION_TEXTURE2D;
+
+			if (metadata)
+			{
+				*metadata = info;
+			}
+
+			const size_t componentSize = (pixelType == Imf::HALF) ? sizeof(uint16_t) : sizeof(float);
+			const size_t pixelSize = componentSize * componentCount;
+
+			// Unselected components read as 0, and the padding alpha as 1.
+			const bool padded = (componentCount != selectedCount);
+			bool hasGaps = false;
+			for (size_t c = 0; c < selectedCount; ++c)
+			{
+				hasGaps |= selection.channels[c].empty();
+			}
+			auto initPixels = [&](const Image& target)
+			{
+				if (padded || hasGaps)
+				{
+					memset(target.pixels, 0, target.rowPitch * target.height);
+				}
+				if (padded)
+				{
+					const uint16_t halfOne = 0x3C00;
+					const float floatOne = 1.0f;
+					for (size_t y = 0; y < target.height; ++y)
+					{
+						uint8_t* alpha = target.pixels + y * target.rowPitch + 3 * componentSize;
+						for (size_t x = 0; x < target.width; ++x, alpha += pixelSize)
+						{
+							memcpy(alpha, (pixelType == Imf::HALF) ? static_cast<const void*>(&halfOne) : static_cast<const void*>(&floatOne), componentSize);
+						}
+					}
+				}
+			};
+
+			// Maps the data window so that row y0 lands on the first row of pixels.
+			auto makeFrameBuffer = [&](uint8_t* pixels, int y0, size_t rowPitch)
+			{
+				char* base = reinterpret_cast<char*>(pixels)
+					- static_cast<ptrdiff_t>(dw.min.x) * static_cast<ptrdiff_t>(pixelSize)
+					- static_cast<ptrdiff_t>(y0) * static_cast<ptrdiff_t>(rowPitch);
+
+				Imf::FrameBuffer frameBuffer;
+				for (size_t c = 0; c < selectedCount; ++c)
+				{
+					if (selection.channels[c].empty())
+						continue;
+
+					frameBuffer.insert(selection.channels[c].c_str(),
+						Imf::Slice(pixelType, base + c * componentSize, pixelSize, rowPitch));
+				}
+				return frameBuffer;
+			};
+
+			WorkerDecoderFactory<Imf::InputPart> createWorkerDecoder = [=](const std::function<void(Imf::InputPart&)>& use)
+			{
+				MemoryInputStream workerStream(data, size, fileName);
+				Imf::MultiPartInputFile workerFile(workerStream);
+				Imf::InputPart workerPart(workerFile, partIndex);
+				use(workerPart);
+			};
+
+			if (onStream)
+			{
+				size_t bandRowPitch, bandSlicePitch;
+				hr = ComputePitch(format, info.width, 1, bandRowPitch, bandSlicePitch);
+				if (FAILED(hr))
+					return hr;
+
+				ReadPixelsStreamed(file, createWorkerDecoder, threadCount, info, maxBandBytes, [&](Imf::InputPart& decoder, uint8_t* pixels, int y0)
+				{
+					decoder.setFrameBuffer(makeFrameBuffer(pixels, y0, bandRowPitch));
+				}, initPixels, onStream);
+				return S_OK;
+			}
+
+			hr = image.Initialize2D(format, width, height, 1, 1);
+			if (FAILED(hr))
+				return hr;
+
+			const Image& target = *image.GetImage(0, 0, 0);
+			initPixels(target);
+			const Imf::FrameBuffer frameBuffer = makeFrameBuffer(target.pixels, dw.min.y, target.rowPitch);
+
+			ReadPixelsInBands(file, createWorkerDecoder, threadCount, [&](Imf::InputPart& decoder)
+			{
+				decoder.setFrameBuffer(frameBuffer);
+			}, MakeBandNotifier(image, onBand));
+		}
+		catch (const com_exception& exc)
+		{
+#ifdef _DEBUG
+			OutputDebugStringA(exc.what());
+#endif
+			hr = exc.hr();
+		}
+		catch (const std::exception& exc)
+		{
+			exc;
+#ifdef _DEBUG
+			OutputDebugStringA(exc.what());
+#endif
+			hr = E_FAIL;
+		}
+		catch (...)
+		{
+			hr = E_UNEXPECTED;
+		}
+
+		if (FAILED(hr))
+		{
+			image.Release();
+		}
+
+		return hr;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+// Parts, layers and channels
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::GetEXRPartsFromMemory(const void* pSource, size_t size, std::vector<EXRPartInfo>& parts)
+{
+	parts.clear();
+
+	if (!pSource || !size)
+		return E_INVALIDARG;
+
+	return GetEXRPartsFromStream(static_cast<const char*>(pSource), static_cast<Imf::Int64>(size), "", parts);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::GetEXRPartsFromFile(const wchar_t* szFile, std::vector<EXRPartInfo>& parts)
+{
+	parts.clear();
+
+	if (!szFile)
+		return E_INVALIDARG;
+
+	char fileName[MAX_PATH];
+	int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
+	if (result <= 0)
+	{
+		*fileName = 0;
+	}
+
+	MappedFile mappedFile;
+	HRESULT hr = mappedFile.Open(szFile);
+	if (FAILED(hr))
+		return hr;
+
+	return GetEXRPartsFromStream(mappedFile.data(), mappedFile.size(), fileName, parts);
+}
+
+_Use_decl_annotations_
+EXRChannelSelection DirectX::GetEXRDefaultChannelSelection(const EXRLayer& layer)
+{
+	EXRChannelSelection selection;
+
+	// Prefer R, G, B, A in that order; a layer without them shows its first channels.
+	static const char* suffixes[] = { "R", "G", "B", "A" };
+	bool found = false;
+	for (size_t c = 0; c < _countof(suffixes); ++c)
+	{
+		std::string name = layer.name.empty() ? std::string(suffixes[c]) : layer.name + "." + suffixes[c];
+		if (std::find(layer.channels.begin(), layer.channels.end(), name) != layer.channels.end())
+		{
+			selection.channels[c] = name;
+			found = true;
+		}
+	}
+
+	if (!found)
+	{
+		for (size_t c = 0; c < _countof(selection.channels) && c < layer.channels.size(); ++c)
+		{
+			selection.channels[c] = layer.channels[c];
+		}
+	}
+
+	return selection;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromEXRMemory(const void* pSource, size_t size, const EXRChannelSelection& selection, size_t threadCount, TexMetadata* metadata, ScratchImage& image, const EXRBandCallback& onBand)
+{
+	if (!pSource || !size)
+		return E_INVALIDARG;
+
+	image.Release();
+
+	if (metadata)
+	{
+		memset(metadata, 0, sizeof(TexMetadata));
+	}
+
+	return LoadEXRChannelsFromStream(static_cast<const char*>(pSource), static_cast<Imf::Int64>(size), "", selection, threadCount, metadata, image, onBand);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromEXRFileStreamed(const wchar_t* szFile, const EXRChannelSelection& selection, size_t threadCount, size_t maxBandBytes, TexMetadata* metadata, const EXRStreamCallback& onBand)
+{
+	if (!szFile || !onBand)
+		return E_INVALIDARG;
+
+	if (metadata)
+	{
+		memset(metadata, 0, sizeof(TexMetadata));
+	}
+
+	char fileName[MAX_PATH];
+	int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
+	if (result <= 0)
+	{
+		*fileName = 0;
+	}
+
+	MappedFile mappedFile;
+	HRESULT hr = mappedFile.Open(szFile);
+	if (FAILED(hr))
+		return hr;
+
+	bool hasChannels = false;
+	for (size_t c = 0; c < _countof(selection.channels); ++c)
+	{
+		hasChannels |= !selection.channels[c].empty();
+	}
+
+	// Nothing is decoded into this; the bands live in the workers' buffers.
+	ScratchImage image;
+	if (!hasChannels)
+	{
+		return LoadFromEXRStream(mappedFile.data(), mappedFile.size(), fileName, threadCount, metadata, image, nullptr, maxBandBytes, onBand);
+	}
+	return LoadEXRChannelsFromStream(mappedFile.data(), mappedFile.size(), fileName, selection, threadCount, metadata, image, nullptr, maxBandBytes, onBand);
+}
+
+
+//-------------------------------------------------------------------------------------
+// Tiled EXR files
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::GetEXRTiledInfoFromFile(const wchar_t* szFile, EXRTiledInfo& info)
+{
+	if (!szFile)
+		return E_INVALIDARG;
+
+	info = EXRTiledInfo();
+
+	char fileName[MAX_PATH];
+	int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
+	if (result <= 0)
+	{
+		*fileName = 0;
+	}
+
+	MappedFile mappedFile;
+	HRESULT hr = mappedFile.Open(szFile);
+	if (FAILED(hr))
+		return hr;
+
+	try
+	{
+		{
+			// Multi-part files are decoded a part at a time instead.
+			MemoryInputStream stream(mappedFile.data(), mappedFile.size(), fileName);
+			Imf::MultiPartInputFile file(stream);
+			if (file.parts() != 1 || !file.header(0).hasTileDescription())
+				return S_FALSE;
+		}
+
+		MemoryInputStream stream(mappedFile.data(), mappedFile.size(), fileName);
+		Imf::TiledRgbaInputFile file(stream);
+
+		info.tileWidth = file.tileXSize();
+		info.tileHeight = file.tileYSize();
+
+		switch (file.levelMode())
+		{
+		case Imf::MIPMAP_LEVELS:	info.levels = EXR_LEVELS_MIPMAP; break;
+		case Imf::RIPMAP_LEVELS:	info.levels = EXR_LEVELS_RIPMAP; break;
+		default:					info.levels = EXR_LEVELS_ONE; break;
+		}
+
+		for (int lx = 0; lx < file.numXLevels(); ++lx)
+		{
+			info.levelWidths.push_back(static_cast<size_t>(file.levelWidth(lx)));
+		}
+		for (int ly = 0; ly < file.numYLevels(); ++ly)
+		{
+			info.levelHeights.push_back(static_cast<size_t>(file.levelHeight(ly)));
+		}
+	}
+	catch (const com_exception& exc)
+	{
+#ifdef _DEBUG
+		OutputDebugStringA(exc.what());
+#endif
+		hr = exc.hr();
+	}
+	catch (const std::exception& exc)
+	{
+		exc;
+#ifdef _DEBUG
+		OutputDebugStringA(exc.what());
+#endif
+		hr = E_FAIL;
+	}
+	catch (...)
+	{
+		hr = E_UNEXPECTED;
+	}
+
+	return hr;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::LoadEXRTilesFromFile(const wchar_t* szFile, const EXRTile* tiles, size_t tileCount, size_t threadCount, ScratchImage* images)
+{
+	if (!szFile || !tiles || !images)
+		return E_INVALIDARG;
+
+	for (size_t i = 0; i < tileCount; ++i)
+	{
+		images[i].Release();
+	}
+
+	char fileName[MAX_PATH];
+	int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
+	if (result <= 0)
+	{
+		*fileName = 0;
+	}
+
+	MappedFile mappedFile;
+	HRESULT hr = mappedFile.Open(szFile);
+	if (FAILED(hr))
+		return hr;
+
+	ThreadPool& pool = ThreadPool::GetDefault();
+	if (threadCount == 0)
+	{
+		threadCount = pool.GetConcurrency();
+	}
+	const size_t workerCount = std::min(std::min(threadCount, tileCount), pool.GetConcurrency());
+
+	// Each worker decodes through its own stream and file object; tiles are
+	// handed out one at a time since their compressed sizes vary a lot.
+	std::atomic<size_t> nextTile(0);
+	std::vector<HRESULT> results(workerCount, S_OK);
+
+	pool.ParallelFor(workerCount, [&](size_t worker)
+	{
+		HRESULT workerResult = S_OK;
+		try
+		{
+			MemoryInputStream stream(mappedFile.data(), mappedFile.size(), fileName);
+			Imf::TiledRgbaInputFile file(stream);
+
+			for (size_t i = nextTile++; i < tileCount; i = nextTile++)
+			{
+				const EXRTile& tile = tiles[i];
+				const int dx = static_cast<int>(tile.tileX);
+				const int dy = static_cast<int>(tile.tileY);
+				const int lx = static_cast<int>(tile.levelX);
+				const int ly = static_cast<int>(tile.levelY);
+
+				if (!file.isValidTile(dx, dy, lx, ly))
+					throw com_exception(E_INVALIDARG);
+
+				auto dw = file.dataWindowForTile(dx, dy, lx, ly);
+				const int width = dw.max.x - dw.min.x + 1;
+				const int height = dw.max.y - dw.min.y + 1;
+
+				HRESULT hrTile = images[i].Initialize2D(DXGI_FORMAT_R16G16B16A16_FLOAT, static_cast<size_t>(width), static_cast<size_t>(height), 1, 1);
+				if (FAILED(hrTile))
+					throw com_exception(hrTile);
+
+				auto frameBuffer = reinterpret_cast<Imf::Rgba*>(images[i].GetPixels()) - dw.min.x - dw.min.y * width;
+				file.setFrameBuffer(frameBuffer, 1, static_cast<size_t>(width));
+				file.readTile(dx, dy, lx, ly);
+			}
+		}
+		catch (const com_exception& exc)
+		{
+#ifdef _DEBUG
+			OutputDebugStringA(exc.what());
+#endif
+			workerResult = exc.hr();
+		}
+		catch (const std::exception& exc)
+		{
+			exc;
+#ifdef _DEBUG
+			OutputDebugStringA(exc.what());
+#endif
+			workerResult = E_FAIL;
+		}
+		catch (...)
+		{
+			workerResult = E_UNEXPECTED;
+		}
+
+		if (FAILED(workerResult))
+		{
+			// Stop the other workers early.
+			nextTile = tileCount;
+			results[worker] = workerResult;
+		}
+	});
+
+	for (HRESULT workerResult : results)
+	{
+		if (FAILED(workerResult))
+		{
+			hr = workerResult;
+			break;
+		}
+	}
+
+	if (FAILED(hr))
+	{
+		for (size_t i = 0; i < tileCount; ++i)
+		{
+			images[i].Release();
+		}
+	}
+
+	return hr;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Save a EXR file to disk
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::SaveToEXRFile(const Image& image, const wchar_t* szFile)
+{
+	// Keep the original single-threaded scanline output.
+	EXRSaveOptions options;
+	options.threadCount = 1;
+	return SaveToEXRFile(image, szFile, options);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::SaveToEXRFile(const Image& image, const wchar_t* szFile, const EXRSaveOptions& options)
+{
+	if (!szFile)
+		return E_INVALIDARG;
+
+	if (!image.pixels)
+		return E_POINTER;
+
+	if (image.width > INT32_MAX || image.height > INT32_MAX)
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+	switch (image.format)
+	{
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		if ((image.rowPitch % 8) > 0)
+			return E_FAIL;
+		break;
+
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+		break;
+
+	default:
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	Imf::Compression compression = GetImfCompression(options.compression);
+	if (compression == Imf::NUM_COMPRESSION_METHODS)
+		return E_INVALIDARG;
+
+	// Only tiled files can store more than one resolution level.
+	if (!options.tiled && options.levels != EXR_LEVELS_ONE)
+		return E_INVALIDARG;
+
+	if (options.tiled && (options.tileWidth == 0 || options.tileHeight == 0 || options.tileWidth > INT32_MAX || options.tileHeight > INT32_MAX))
+		return E_INVALIDARG;
+
+	char fileName[MAX_PATH];
+	int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
+	if (result <= 0)
+	{
+		*fileName = 0;
+	}
+	// Create file and write header
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+	ScopedHandle hFile(safe_handle(CreateFile2(szFile, GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr)));
+#else
+	ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr)));
+#endif
+	if (!hFile)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	auto_delete_file delonfail(hFile.get());
+
+	OutputStream stream(hFile.get(), fileName);
+
+	HRESULT hr = S_OK;
+
+	try
+	{
+		int width = static_cast<int>(image.width);
+		int height = static_cast<int>(image.height);
+
+		// OpenEXR wants RGBA halves; convert float input up front.
+		Image baseLevel = image;
+		std::unique_ptr<XMHALF4[]> temp;
+		if (image.format != DXGI_FORMAT_R16G16B16A16_FLOAT)
+		{
+			temp.reset(new (std::nothrow) XMHALF4[static_cast<size_t>(width) * static_cast<size_t>(height)]);
+			if (!temp)
+				return E_OUTOFMEMORY;
+
+			// Convert bands of rows in parallel; OpenEXR then gets the whole image
+			// in one call so it can compress its line blocks together.
+			const bool hasAlpha = (image.format == DXGI_FORMAT_R32G32B32A32_FLOAT);
+			assert(hasAlpha || image.format == DXGI_FORMAT_R32G32B32_FLOAT);
+
+			ThreadPool& pool = ThreadPool::GetDefault();
+			const size_t rowCount = static_cast<size_t>(height);
+			const size_t pixelCount = static_cast<size_t>(width);
+			const size_t bandCount = std::min(rowCount, pool.GetConcurrency() * 4);
+			pool.ParallelFor(bandCount, [&](size_t band)
+			{
+				const size_t firstRow = rowCount * band / bandCount;
+				const size_t lastRow = rowCount * (band + 1) / bandCount;
+				for (size_t j = firstRow; j < lastRow; ++j)
+				{
+					auto srcPtr = reinterpret_cast<const float*>(image.pixels + j * image.rowPitch);
+					auto destPtr = reinterpret_cast<uint16_t*>(temp.get() + j * pixelCount);
+					if (hasAlpha)
+					{
+						ConvertFloat4ToHalf4(srcPtr, destPtr, pixelCount);
+					}
+					else
+					{
+						ConvertFloat3ToHalf4(srcPtr, destPtr, pixelCount);
+					}
+				}
+			});
+
+			baseLevel.format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+			baseLevel.rowPitch = pixelCount * sizeof(XMHALF4);
+			baseLevel.slicePitch = baseLevel.rowPitch * rowCount;
+			baseLevel.pixels = reinterpret_cast<uint8_t*>(temp.get());
+		}
+
+		// OpenEXR compresses line blocks and tiles on its global thread pool.
+		const int threadCount = static_cast<int>((options.threadCount > 0) ? options.threadCount : ThreadPool::GetDefault().GetConcurrency());
+		if (threadCount > 1 && Imf::globalThreadCount() < threadCount)
+		{
+			Imf::setGlobalThreadCount(threadCount);
+		}
+		const int fileThreadCount = (threadCount > 1) ? threadCount : 0;
+
+		Imf::Header header(width, height);
+		header.compression() = compression;
+
+		if (!options.tiled)
+		{
+			Imf::RgbaOutputFile file(stream, header, Imf::WRITE_RGBA, fileThreadCount);
+			file.setFrameBuffer(reinterpret_cast<const Imf::Rgba*>(baseLevel.pixels), 1, baseLevel.rowPitch / 8);
+			file.writePixels(height);
+		}
+		else
+		{
+			Imf::LevelMode levelMode = (options.levels == EXR_LEVELS_MIPMAP) ? Imf::MIPMAP_LEVELS
+				: (options.levels == EXR_LEVELS_RIPMAP) ? Imf::RIPMAP_LEVELS : Imf::ONE_LEVEL;
+
+			Imf::TiledRgbaOutputFile file(stream, header, Imf::WRITE_RGBA,
+				static_cast<int>(options.tileWidth), static_cast<int>(options.tileHeight),
+				levelMode, Imf::ROUND_DOWN, fileThreadCount);
+
+			// Mip levels are (l, l); rip levels cover every (lx, ly) pair.
+			const bool ripmap = (levelMode == Imf::RIPMAP_LEVELS);
+			const int yLevels = ripmap ? file.numYLevels() : 1;
+			const int xLevels = ripmap ? file.numXLevels() : file.numLevels();
+			for (int ry = 0; ry < yLevels; ++ry)
+			{
+				for (int lx = 0; lx < xLevels; ++lx)
+				{
+					const int ly = ripmap ? ry : lx;
+
+					// Lower levels are filtered down from the full-resolution image.
+					ScratchImage resized;
+					const Image* level = &baseLevel;
+					if (lx > 0 || ly > 0)
+					{
+						hr = Resize(baseLevel, static_cast<size_t>(file.levelWidth(lx)), static_cast<size_t>(file.levelHeight(ly)), TEX_FILTER_DEFAULT, resized);
+						if (FAILED(hr))
+							throw com_exception(hr);
+						level = resized.GetImage(0, 0, 0);
+					}
 
-					file.writePixels(1);
+					file.setFrameBuffer(reinterpret_cast<const Imf::Rgba*>(level->pixels), 1, level->rowPitch / 8);
+					file.writeTiles(0, file.numXTiles(lx) - 1, 0, file.numYTiles(ly) - 1, lx, ly);
 				}
 			}
 		}
@@ -6,17 +6,158 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+#pragma once
+
 #include "directxtex.h"
 
+#include <functional>
+#include <string>
+#include <vector>
+
 #pragma comment(lib,"IlmImf-2_2.lib")
 
 namespace DirectX
 {
+	enum EXR_COMPRESSION
+	{
+		EXR_COMPRESSION_NONE = 0,
+		EXR_COMPRESSION_RLE,
+		EXR_COMPRESSION_ZIPS,	// zlib, one scanline per chunk
+		EXR_COMPRESSION_ZIP,	// zlib, 16 scanlines per chunk
+		EXR_COMPRESSION_PIZ,	// wavelet, 32 scanlines per chunk
+		EXR_COMPRESSION_DWAA,	// lossy DCT, 32 scanlines per chunk
+		EXR_COMPRESSION_DWAB,	// lossy DCT, 256 scanlines per chunk
+	};
+
+	enum EXR_LEVELS
+	{
+		EXR_LEVELS_ONE = 0,
+		EXR_LEVELS_MIPMAP,	// Tiled only; each level halves both dimensions.
+		EXR_LEVELS_RIPMAP,	// Tiled only; every combination of halved width and height.
+	};
+
+	struct EXRSaveOptions
+	{
+		EXR_COMPRESSION compression = EXR_COMPRESSION_ZIP;
+		bool tiled = false;
+		size_t tileWidth = 64;
+		size_t tileHeight = 64;
+		EXR_LEVELS levels = EXR_LEVELS_ONE;
+		size_t threadCount = 0;	// Chunks compressed in parallel; 0 = all cores.
+	};
+
+	// Progressive decoding: called each time a band of rows of image is complete,
+	// from whichever thread decoded it. Bands can finish out of order.
+	typedef std::function<void(const ScratchImage& image, size_t firstRow, size_t rowCount)> EXRBandCallback;
+
+	// Streaming decoding: called with each band of rows, starting at firstRow of the
+	// image metadata describes, from whichever thread decoded it. band points into a
+	// buffer that is reused once the call returns. Returning a failure stops the
+	// decode with that result.
+	typedef std::function<HRESULT(const TexMetadata& metadata, const Image& band, size_t firstRow)> EXRStreamCallback;
+
 	HRESULT __cdecl GetMetadataFromEXRFile(_In_z_ const wchar_t* szFile,
 		_Out_ TexMetadata& metadata);
 
 	HRESULT __cdecl LoadFromEXRFile(_In_z_ const wchar_t* szFile,
 		_Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image);
 
+	// Splits the data window into compression-block aligned row bands and decodes them
+	// on up to threadCount workers (0 = all cores), each with its own view of the file.
+	HRESULT __cdecl LoadFromEXRFile(_In_z_ const wchar_t* szFile, _In_ size_t threadCount,
+		_Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image);
+
+	enum EXR_FILE_ACCESS
+	{
+		EXR_FILE_ACCESS_MAPPED = 0,	// Map the file; the decoders read chunks in place.
+		EXR_FILE_ACCESS_READFILE,	// ReadFile and SetFilePointerEx for every read, through a handle per worker.
+	};
+
+	// Like above, but also picks how the file is read. The mapping is faster; reading
+	// through handles is kept to compare against.
+	HRESULT __cdecl LoadFromEXRFile(_In_z_ const wchar_t* szFile, _In_ size_t threadCount, _In_ EXR_FILE_ACCESS access,
+		_Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image);
+
+	HRESULT __cdecl LoadFromEXRMemory(_In_reads_bytes_(size) const void* pSource, _In_ size_t size, _In_ size_t threadCount,
+		_Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image, _In_ const EXRBandCallback& onBand = nullptr);
+
+	// Channels grouped by layer: "diffuse.R" belongs to layer "diffuse", plain "R" to
+	// the unnamed layer. Channel names are the full names stored in the file.
+	struct EXRLayer
+	{
+		std::string name;
+		std::vector<std::string> channels;
+	};
+
+	// One part of a multi-part file; single-part files have exactly one.
+	struct EXRPartInfo
+	{
+		std::string name;	// Empty for single-part files.
+		size_t width = 0;
+		size_t height = 0;
+		bool tiled = false;
+		bool deep = false;	// Deep parts cannot be decoded.
+		std::vector<EXRLayer> layers;
+	};
+
+	// A part and up to four of its channels, in the order they are packed into the
+	// image. Empty entries read as zero.
+	struct EXRChannelSelection
+	{
+		size_t part = 0;
+		std::string channels[4];
+	};
+
+	// Reads only the headers.
+	HRESULT __cdecl GetEXRPartsFromMemory(_In_reads_bytes_(size) const void* pSource, _In_ size_t size,
+		_Out_ std::vector<EXRPartInfo>& parts);
+
+	HRESULT __cdecl GetEXRPartsFromFile(_In_z_ const wchar_t* szFile, _Out_ std::vector<EXRPartInfo>& parts);
+
+	// R, G, B and A of the layer when present, otherwise its first four channels.
+	EXRChannelSelection __cdecl GetEXRDefaultChannelSelection(_In_ const EXRLayer& layer);
+
+	// Decodes only the selected channels into R16/R16G16/R16G16B16A16_FLOAT, or the
+	// R32 equivalents when a selected channel is not half. Three channels get alpha = 1.
+	HRESULT __cdecl LoadFromEXRMemory(_In_reads_bytes_(size) const void* pSource, _In_ size_t size,
+		_In_ const EXRChannelSelection& selection, _In_ size_t threadCount,
+		_Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image, _In_ const EXRBandCallback& onBand = nullptr);
+
+	// Decodes a scanline file without ever holding the whole image: each worker
+	// decodes compression-block aligned bands of at most maxBandBytes (at least one
+	// block) into a buffer of its own and passes them to onBand. The file is mapped,
+	// not read. An empty selection decodes RGBA like the RGBA interface does.
+	HRESULT __cdecl LoadFromEXRFileStreamed(_In_z_ const wchar_t* szFile,
+		_In_ const EXRChannelSelection& selection, _In_ size_t threadCount, _In_ size_t maxBandBytes,
+		_Out_opt_ TexMetadata* metadata, _In_ const EXRStreamCallback& onBand);
+
+	struct EXRTiledInfo
+	{
+		size_t tileWidth = 0;
+		size_t tileHeight = 0;
+		EXR_LEVELS levels = EXR_LEVELS_ONE;
+		std::vector<size_t> levelWidths;	// Indexed by x level.
+		std::vector<size_t> levelHeights;	// Indexed by y level. Mip level n is (n, n).
+	};
+
+	struct EXRTile
+	{
+		size_t levelX;
+		size_t levelY;
+		size_t tileX;
+		size_t tileY;
+	};
+
+	// Reads only the header. Returns S_FALSE for scanline and multi-part files.
+	HRESULT __cdecl GetEXRTiledInfoFromFile(_In_z_ const wchar_t* szFile, _Out_ EXRTiledInfo& info);
+
+	// Decodes each requested tile into its own R16G16B16A16_FLOAT image, sized to the
+	// tile's data window (edge tiles are smaller), on up to threadCount workers.
+	HRESULT __cdecl LoadEXRTilesFromFile(_In_z_ const wchar_t* szFile,
+		_In_reads_(tileCount) const EXRTile* tiles, _In_ size_t tileCount, _In_ size_t threadCount,
+		_Out_writes_(tileCount) ScratchImage* images);
+
 	HRESULT __cdecl SaveToEXRFile(_In_ const Image& image, _In_z_ const wchar_t* szFile);
+
+	HRESULT __cdecl SaveToEXRFile(_In_ const Image& image, _In_z_ const wchar_t* szFile, _In_ const EXRSaveOptions& options);
 };
\ No newline at end of file
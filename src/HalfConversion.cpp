@@ -0,0 +1,461 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "HalfConversion.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HALF_CONVERSION_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles AVX intrinsics anywhere; GCC and Clang only inside functions
+// built for the target, which is why the F16C kernels carry this attribute.
+#if defined(HALF_CONVERSION_X86) && (defined(__GNUC__) || defined(__clang__))
+#define HALF_CONVERSION_F16C_TARGET __attribute__((target("avx,f16c")))
+#else
+#define HALF_CONVERSION_F16C_TARGET
+#endif
+
+namespace
+{
+	const uint16_t HalfOne = 0x3C00;
+
+	inline uint32_t AsUInt(float f)
+	{
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	inline float AsFloat(uint32_t u)
+	{
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	//-------------------------------------------------------------------------
+	// Scalar
+	//-------------------------------------------------------------------------
+
+	void ConvertFloat4Scalar(const float* src, uint16_t* dst, size_t pixelCount)
+	{
+		for (size_t i = 0; i < pixelCount * 4; ++i)
+		{
+			dst[i] = ConvertFloatToHalf(src[i]);
+		}
+	}
+
+	void ConvertFloat3Scalar(const float* src, uint16_t* dst, size_t pixelCount)
+	{
+		for (size_t i = 0; i < pixelCount; ++i, src += 3, dst += 4)
+		{
+			dst[0] = ConvertFloatToHalf(src[0]);
+			dst[1] = ConvertFloatToHalf(src[1]);
+			dst[2] = ConvertFloatToHalf(src[2]);
+			dst[3] = HalfOne;
+		}
+	}
+
+	void ConvertHalf4Scalar(const uint16_t* src, float* dst, size_t pixelCount)
+	{
+		for (size_t i = 0; i < pixelCount * 4; ++i)
+		{
+			dst[i] = ConvertHalfToFloat(src[i]);
+		}
+	}
+
+#if defined(HALF_CONVERSION_X86)
+	//-------------------------------------------------------------------------
+	// SSE2: the scalar algorithm on four lanes.
+	//-------------------------------------------------------------------------
+
+	inline __m128i ConvertSSE2(__m128 value)
+	{
+		const __m128i signMask = _mm_set1_epi32(0x80000000);
+		const __m128i f32Infinity = _mm_set1_epi32(255 << 23);
+		const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);
+		const __m128i normalMin = _mm_set1_epi32(113 << 23);
+		const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i rebias = _mm_set1_epi32(static_cast<int>(0xFFFu - (112u << 23)));
+		const __m128i one = _mm_set1_epi32(1);
+
+		__m128i u = _mm_castps_si128(value);
+		__m128i sign = _mm_and_si128(u, signMask);
+		u = _mm_xor_si128(u, sign);
+
+		// Subnormal results: let the FPU round while adding the magic number.
+		__m128i denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(u), _mm_castsi128_ps(denormMagic))), denormMagic);
+
+		// Normal results: rebias the exponent and round to nearest even.
+		__m128i odd = _mm_and_si128(_mm_srli_epi32(u, 13), one);
+		__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(u, rebias), odd), 13);
+
+		// Overflow goes to infinity, NaN to a quiet NaN.
+		__m128i special = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(_mm_cmpgt_epi32(u, f32Infinity), _mm_set1_epi32(0x0200)));
+
+		// All magnitudes are below 0x80000000, so signed compares are safe.
+		__m128i isDenorm = _mm_cmplt_epi32(u, normalMin);
+		__m128i isSpecial = _mm_cmpgt_epi32(u, _mm_sub_epi32(f16Max, one));
+
+		__m128i result = _mm_or_si128(_mm_and_si128(isDenorm, denorm), _mm_andnot_si128(isDenorm, normal));
+		result = _mm_or_si128(_mm_and_si128(isSpecial, special), _mm_andnot_si128(isSpecial, result));
+		result = _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+
+		// Sign-extend so the saturating pack keeps the low 16 bits.
+		return _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+	}
+
+	// Splits four packed RGB pixels into four RGBA vectors with alpha = 1.
+	inline void LoadRGBx4(const float* src, __m128 pixels[4])
+	{
+		const __m128 rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+		const __m128 alphaOne = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+		__m128 a = _mm_loadu_ps(src);		// r0 g0 b0 r1
+		__m128 b = _mm_loadu_ps(src + 4);	// g1 b1 r2 g2
+		__m128 c = _mm_loadu_ps(src + 8);	// b2 r3 g3 b3
+
+		__m128 p1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 3, 3));
+		p1 = _mm_shuffle_ps(p1, p1, _MM_SHUFFLE(3, 3, 2, 1));
+		__m128 p2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 0, 3, 2));
+		__m128 p3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 2, 1));
+
+		pixels[0] = _mm_or_ps(_mm_and_ps(a, rgbMask), alphaOne);
+		pixels[1] = _mm_or_ps(_mm_and_ps(p1, rgbMask), alphaOne);
+		pixels[2] = _mm_or_ps(_mm_and_ps(p2, rgbMask), alphaOne);
+		pixels[3] = _mm_or_ps(_mm_and_ps(p3, rgbMask), alphaOne);
+	}
+
+	// Four halves, zero-extended to 32 bits, to floats; ConvertHalfToFloat on
+	// four lanes, after Fabian Giesen's half_to_float_fast3.
+	inline __m128 ConvertHalfSSE2(__m128i value)
+	{
+		const __m128i shiftedExponent = _mm_set1_epi32(0x7C00 << 13);
+		const __m128i rebias = _mm_set1_epi32((127 - 15) << 23);
+		const __m128 denormMagic = _mm_castsi128_ps(_mm_set1_epi32(113 << 23));
+
+		__m128i u = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x7FFF)), 13);
+		__m128i exponent = _mm_and_si128(u, shiftedExponent);
+		u = _mm_add_epi32(u, rebias);
+
+		// Infinity and NaN: rebias once more, to the float exponent of 255.
+		__m128i isSpecial = _mm_cmpeq_epi32(exponent, shiftedExponent);
+		u = _mm_add_epi32(u, _mm_and_si128(isSpecial, rebias));
+
+		// Subnormal or zero: let the FPU renormalize.
+		__m128 isDenorm = _mm_castsi128_ps(_mm_cmpeq_epi32(exponent, _mm_setzero_si128()));
+		__m128 denorm = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(u, _mm_set1_epi32(1 << 23))), denormMagic);
+		__m128 result = _mm_or_ps(_mm_and_ps(isDenorm, denorm), _mm_andnot_ps(isDenorm, _mm_castsi128_ps(u)));
+
+		__m128i sign = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x8000)), 16);
+		return _mm_or_ps(result, _mm_castsi128_ps(sign));
+	}
+
+	void ConvertHalf4SSE2(const uint16_t* src, float* dst, size_t pixelCount)
+	{
+		size_t i = 0;
+		for (; i + 2 <= pixelCount; i += 2, src += 8, dst += 8)
+		{
+			__m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			_mm_storeu_ps(dst, ConvertHalfSSE2(_mm_unpacklo_epi16(halves, _mm_setzero_si128())));
+			_mm_storeu_ps(dst + 4, ConvertHalfSSE2(_mm_unpackhi_epi16(halves, _mm_setzero_si128())));
+		}
+		ConvertHalf4Scalar(src, dst, pixelCount - i);
+	}
+
+	void ConvertFloat4SSE2(const float* src, uint16_t* dst, size_t pixelCount)
+	{
+		size_t i = 0;
+		for (; i + 2 <= pixelCount; i += 2, src += 8, dst += 8)
+		{
+			__m128i lo = ConvertSSE2(_mm_loadu_ps(src));
+			__m128i hi = ConvertSSE2(_mm_loadu_ps(src + 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packs_epi32(lo, hi));
+		}
+		ConvertFloat4Scalar(src, dst, pixelCount - i);
+	}
+
+	void ConvertFloat3SSE2(const float* src, uint16_t* dst, size_t pixelCount)
+	{
+		size_t i = 0;
+		for (; i + 4 <= pixelCount; i += 4, src += 12, dst += 16)
+		{
+			__m128 pixels[4];
+			LoadRGBx4(src, pixels);
+
+			__m128i p01 = _mm_packs_epi32(ConvertSSE2(pixels[0]), ConvertSSE2(pixels[1]));
+			__m128i p23 = _mm_packs_epi32(ConvertSSE2(pixels[2]), ConvertSSE2(pixels[3]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), p01);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), p23);
+		}
+		ConvertFloat3Scalar(src, dst, pixelCount - i);
+	}
+
+	//-------------------------------------------------------------------------
+	// F16C
+	//-------------------------------------------------------------------------
+
+	HALF_CONVERSION_F16C_TARGET void ConvertFloat4F16C(const float* src, uint16_t* dst, size_t pixelCount)
+	{
+		size_t i = 0;
+		for (; i + 4 <= pixelCount; i += 4, src += 16, dst += 16)
+		{
+			__m128i lo = _mm256_cvtps_ph(_mm256_loadu_ps(src), _MM_FROUND_TO_NEAREST_INT);
+			__m128i hi = _mm256_cvtps_ph(_mm256_loadu_ps(src + 8), _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), hi);
+		}
+		for (; i < pixelCount; ++i, src += 4, dst += 4)
+		{
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_cvtps_ph(_mm_loadu_ps(src), _MM_FROUND_TO_NEAREST_INT));
+		}
+		_mm256_zeroupper();
+	}
+
+	HALF_CONVERSION_F16C_TARGET void ConvertHalf4F16C(const uint16_t* src, float* dst, size_t pixelCount)
+	{
+		size_t i = 0;
+		for (; i + 2 <= pixelCount; i += 2, src += 8, dst += 8)
+		{
+			_mm256_storeu_ps(dst, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))));
+		}
+		for (; i < pixelCount; ++i, src += 4, dst += 4)
+		{
+			_mm_storeu_ps(dst, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))));
+		}
+		_mm256_zeroupper();
+	}
+
+	HALF_CONVERSION_F16C_TARGET void ConvertFloat3F16C(const float* src, uint16_t* dst, size_t pixelCount)
+	{
+		size_t i = 0;
+		for (; i + 4 <= pixelCount; i += 4, src += 12, dst += 16)
+		{
+			__m128 pixels[4];
+			LoadRGBx4(src, pixels);
+
+			__m256 p01 = _mm256_insertf128_ps(_mm256_castps128_ps256(pixels[0]), pixels[1], 1);
+			__m256 p23 = _mm256_insertf128_ps(_mm256_castps128_ps256(pixels[2]), pixels[3], 1);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_cvtps_ph(p01, _MM_FROUND_TO_NEAREST_INT));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), _mm256_cvtps_ph(p23, _MM_FROUND_TO_NEAREST_INT));
+		}
+		_mm256_zeroupper();
+		ConvertFloat3Scalar(src, dst, pixelCount - i);
+	}
+
+	void CpuId(int info[4], int leaf)
+	{
+#if defined(_MSC_VER)
+		__cpuid(info, leaf);
+#else
+		__cpuid(leaf, info[0], info[1], info[2], info[3]);
+#endif
+	}
+
+	bool IsF16CSupported()
+	{
+		int info[4];
+		CpuId(info, 0);
+		if (info[0] < 1)
+		{
+			return false;
+		}
+
+		CpuId(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		const bool f16c = (info[2] & (1 << 29)) != 0;
+		if (!osxsave || !avx || !f16c)
+		{
+			return false;
+		}
+
+		// The OS must save the YMM registers on context switches.
+#if defined(_MSC_VER)
+		unsigned long long xcr0 = _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		unsigned long long xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+		return (xcr0 & 0x6) == 0x6;
+	}
+#endif
+
+	HalfConversionPath DetectPath()
+	{
+#if defined(HALF_CONVERSION_X86)
+		return IsF16CSupported() ? HalfConversionPath::F16C : HalfConversionPath::SSE2;
+#else
+		return HalfConversionPath::Scalar;
+#endif
+	}
+
+	HalfConversionPath Resolve(HalfConversionPath path)
+	{
+		static const HalfConversionPath best = DetectPath();
+		if (path == HalfConversionPath::Best)
+		{
+			return best;
+		}
+		// Never run a kernel the CPU cannot execute.
+		return (path > best) ? best : path;
+	}
+}
+
+HalfConversionPath GetHalfConversionPath()
+{
+	return Resolve(HalfConversionPath::Best);
+}
+
+const char* GetHalfConversionPathName(HalfConversionPath path)
+{
+	switch (Resolve(path))
+	{
+	case HalfConversionPath::F16C:	return "F16C";
+	case HalfConversionPath::SSE2:	return "SSE2";
+	default:						return "Scalar";
+	}
+}
+
+// Round-to-nearest-even float to half, after Fabian Giesen's float_to_half_fast3_rtne.
+uint16_t ConvertFloatToHalf(float value)
+{
+	const uint32_t f32Infinity = 255 << 23;
+	const uint32_t f16Max = (127 + 16) << 23;
+	const uint32_t denormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+	uint32_t u = AsUInt(value);
+	const uint32_t sign = u & 0x80000000;
+	u ^= sign;
+
+	uint32_t result;
+	if (u >= f16Max)
+	{
+		// Overflow to infinity; NaN to a quiet NaN.
+		result = (u > f32Infinity) ? 0x7E00 : 0x7C00;
+	}
+	else if (u < (113 << 23))
+	{
+		// Subnormal or zero: the float add rounds the mantissa for us.
+		result = AsUInt(AsFloat(u) + AsFloat(denormMagic)) - denormMagic;
+	}
+	else
+	{
+		const uint32_t odd = (u >> 13) & 1;
+		// Rebias the exponent from 127 to 15; u is at least 113 << 23, so this cannot wrap.
+		result = (u - (112u << 23) + 0xFFF + odd) >> 13;
+	}
+
+	return static_cast<uint16_t>(result | (sign >> 16));
+}
+
+// Exact; every half is representable as a float.
+float ConvertHalfToFloat(uint16_t value)
+{
+	const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	const uint32_t magnitude = value & 0x7FFF;
+
+	if (magnitude >= 0x7C00)
+	{
+		// Infinity or NaN, keeping the payload.
+		return AsFloat(sign | 0x7F800000 | ((magnitude & 0x3FF) << 13));
+	}
+	if (magnitude >= 0x0400)
+	{
+		return AsFloat(sign | ((magnitude << 13) + ((127 - 15) << 23)));
+	}
+
+	// Subnormal or zero: the mantissa counts units of 2^-24.
+	return AsFloat(sign | AsUInt(static_cast<float>(magnitude) * 5.9604644775390625e-8f));
+}
+
+void ConvertFloat4ToHalf4(const float* src, uint16_t* dst, size_t pixelCount, HalfConversionPath path)
+{
+	switch (Resolve(path))
+	{
+#if defined(HALF_CONVERSION_X86)
+	case HalfConversionPath::F16C:
+		ConvertFloat4F16C(src, dst, pixelCount);
+		break;
+
+	case HalfConversionPath::SSE2:
+		ConvertFloat4SSE2(src, dst, pixelCount);
+		break;
+#endif
+
+	default:
+		ConvertFloat4Scalar(src, dst, pixelCount);
+		break;
+	}
+}
+
+void ConvertFloat3ToHalf4(const float* src, uint16_t* dst, size_t pixelCount, HalfConversionPath path)
+{
+	switch (Resolve(path))
+	{
+#if defined(HALF_CONVERSION_X86)
+	case HalfConversionPath::F16C:
+		ConvertFloat3F16C(src, dst, pixelCount);
+		break;
+
+	case HalfConversionPath::SSE2:
+		ConvertFloat3SSE2(src, dst, pixelCount);
+		break;
+#endif
+
+	default:
+		ConvertFloat3Scalar(src, dst, pixelCount);
+		break;
+	}
+}
+
+void ConvertHalf4ToFloat4(const uint16_t* src, float* dst, size_t pixelCount, HalfConversionPath path)
+{
+	switch (Resolve(path))
+	{
+#if defined(HALF_CONVERSION_X86)
+	case HalfConversionPath::F16C:
+		ConvertHalf4F16C(src, dst, pixelCount);
+		break;
+
+	case HalfConversionPath::SSE2:
+		ConvertHalf4SSE2(src, dst, pixelCount);
+		break;
+#endif
+
+	default:
+		ConvertHalf4Scalar(src, dst, pixelCount);
+		break;
+	}
+}
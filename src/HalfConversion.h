@@ -0,0 +1,54 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels that convert float32 pixels to IEEE half (binary16) RGBA and back,
+// rounding to nearest even like the F16C instructions do. Every path returns the
+// same bits for all finite and infinite inputs; NaNs stay NaN but their payloads
+// may differ.
+enum class HalfConversionPath
+{
+	Scalar = 0,
+	SSE2,
+	F16C,	// AVX + F16C, 8 floats per instruction.
+	Best	// The fastest path this CPU supports, detected once.
+};
+
+HalfConversionPath GetHalfConversionPath();
+const char* GetHalfConversionPathName(HalfConversionPath path);
+
+uint16_t ConvertFloatToHalf(float value);
+float ConvertHalfToFloat(uint16_t value);
+
+// dst receives pixelCount RGBA halves. For RGB input alpha is set to 1.0.
+void ConvertFloat4ToHalf4(const float* src, uint16_t* dst, size_t pixelCount, HalfConversionPath path = HalfConversionPath::Best);
+void ConvertFloat3ToHalf4(const float* src, uint16_t* dst, size_t pixelCount, HalfConversionPath path = HalfConversionPath::Best);
+
+// The other way: pixelCount RGBA halves to RGBA floats. Exact, like ConvertHalfToFloat.
+void ConvertHalf4ToFloat4(const uint16_t* src, float* dst, size_t pixelCount, HalfConversionPath path = HalfConversionPath::Best);
@@ -0,0 +1,135 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "ImageCache.h"
+
+#include <algorithm>
+#include <cwctype>
+
+ImageCache::ImageCache(size_t budgetBytes) :
+	m_budgetBytes(budgetBytes),
+	m_usedBytes(0),
+	m_hits(0),
+	m_misses(0),
+	m_evictions(0)
+{
+}
+
+// Windows paths are case-insensitive.
+std::wstring ImageCache::MakeKey(const std::wstring& path)
+{
+	std::wstring key(path);
+	std::transform(key.begin(), key.end(), key.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+	return key;
+}
+
+std::shared_ptr<const DecodedImage> ImageCache::Find(const std::wstring& path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_entries.find(MakeKey(path));
+	if (it == m_entries.end())
+	{
+		m_misses++;
+		return nullptr;
+	}
+
+	m_hits++;
+	m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+	return it->second.image;
+}
+
+bool ImageCache::Contains(const std::wstring& path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.find(MakeKey(path)) != m_entries.end();
+}
+
+void ImageCache::Insert(const std::wstring& path, std::shared_ptr<const DecodedImage> image)
+{
+	const size_t bytes = image->image.GetPixelsSize();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (bytes > m_budgetBytes)
+	{
+		return;
+	}
+
+	std::wstring key = MakeKey(path);
+	auto it = m_entries.find(key);
+	if (it != m_entries.end())
+	{
+		m_usedBytes -= it->second.bytes;
+		m_lru.erase(it->second.lru);
+		m_entries.erase(it);
+	}
+
+	m_lru.push_front(key);
+
+	Entry entry;
+	entry.image = std::move(image);
+	entry.bytes = bytes;
+	entry.lru = m_lru.begin();
+	m_entries.emplace(std::move(key), std::move(entry));
+	m_usedBytes += bytes;
+
+	EvictToBudget();
+}
+
+void ImageCache::SetBudget(size_t budgetBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budgetBytes = budgetBytes;
+	EvictToBudget();
+}
+
+ImageCacheStats ImageCache::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	ImageCacheStats stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.evictions = m_evictions;
+	stats.entryCount = m_entries.size();
+	stats.usedBytes = m_usedBytes;
+	stats.budgetBytes = m_budgetBytes;
+	return stats;
+}
+
+// Called with m_mutex held.
+void ImageCache::EvictToBudget()
+{
+	while (m_usedBytes > m_budgetBytes && !m_lru.empty())
+	{
+		auto it = m_entries.find(m_lru.back());
+		m_usedBytes -= it->second.bytes;
+		m_entries.erase(it);
+		m_lru.pop_back();
+		m_evictions++;
+	}
+}
@@ -0,0 +1,108 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <DirectXTex.h>
+
+#include "DirectXTexEXR.h"
+#include "LuminanceAnalysis.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// A decoded image shared between the cache and the loader stages.
+struct DecodedImage
+{
+	DirectX::TexMetadata metadata;
+	DirectX::ScratchImage image;
+
+	// EXR only: every part in the file, and the part and channels that were decoded
+	// (empty when the RGBA interface was used).
+	std::vector<DirectX::EXRPartInfo> parts;
+	DirectX::EXRChannelSelection channels;
+
+	// Measured once after decoding, so a cached image keeps its statistics.
+	LuminanceStatistics luminance;
+	bool analyzed = false;
+};
+
+struct ImageCacheStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	size_t entryCount = 0;
+	size_t usedBytes = 0;
+	size_t budgetBytes = 0;
+};
+
+// Keeps recently decoded images in memory up to a byte budget, evicting the
+// least recently used ones first. Entries are shared_ptrs, so an evicted image
+// stays alive until the stage that is still using it lets go. Thread-safe.
+class ImageCache
+{
+public:
+	explicit ImageCache(size_t budgetBytes);
+
+	ImageCache(const ImageCache&) = delete;
+	ImageCache& operator=(const ImageCache&) = delete;
+
+	// Returns nullptr on a miss. A hit makes the entry the most recently used.
+	std::shared_ptr<const DecodedImage> Find(const std::wstring& path);
+
+	// Like Find(), but does not count towards the statistics or touch the LRU order.
+	bool Contains(const std::wstring& path);
+
+	// Images larger than the whole budget are not cached.
+	void Insert(const std::wstring& path, std::shared_ptr<const DecodedImage> image);
+
+	void SetBudget(size_t budgetBytes);
+	ImageCacheStats GetStats();
+
+private:
+	typedef std::list<std::wstring> LruList;
+
+	struct Entry
+	{
+		std::shared_ptr<const DecodedImage> image;
+		size_t bytes;
+		LruList::iterator lru;
+	};
+
+	static std::wstring MakeKey(const std::wstring& path);
+	void EvictToBudget();
+
+	std::mutex m_mutex;
+	std::unordered_map<std::wstring, Entry> m_entries;
+	LruList m_lru;	// Front is the most recently used.
+	size_t m_budgetBytes;
+	size_t m_usedBytes;
+	uint64_t m_hits;
+	uint64_t m_misses;
+	uint64_t m_evictions;
+};
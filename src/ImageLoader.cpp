@@ -0,0 +1,985 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "ImageLoader.h"
+#include "DirectXTexEXR.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	HRESULT ReadWholeFile(const wchar_t* path, Blob& blob)
+	{
+		Microsoft::WRL::Wrappers::FileHandle file(CreateFile2(path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr));
+		if (!file.IsValid())
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file.Get(), &fileSize))
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		HRESULT hr = blob.Initialize(static_cast<size_t>(fileSize.QuadPart));
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		// ReadFile takes a DWORD, so files over 4GB are read in pieces.
+		auto dest = static_cast<uint8_t*>(blob.GetBufferPointer());
+		size_t remaining = blob.GetBufferSize();
+		while (remaining > 0)
+		{
+			DWORD chunk = static_cast<DWORD>(std::min<size_t>(remaining, 0x40000000));
+			DWORD bytesRead = 0;
+			if (!ReadFile(file.Get(), dest, chunk, &bytesRead, nullptr))
+			{
+				return HRESULT_FROM_WIN32(GetLastError());
+			}
+			if (bytesRead == 0)
+			{
+				return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+			}
+
+			dest += bytesRead;
+			remaining -= bytesRead;
+		}
+
+		return S_OK;
+	}
+
+	bool HasChannels(const EXRChannelSelection& channels)
+	{
+		for (const std::string& channel : channels.channels)
+		{
+			if (!channel.empty())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Each part and channel selection of a file is cached separately.
+	std::wstring MakeCacheKey(const std::wstring& path, const EXRChannelSelection& channels)
+	{
+		std::wstring key = path;
+		if (channels.part != 0)
+		{
+			key += L"#" + std::to_wstring(channels.part);
+		}
+		if (HasChannels(channels))
+		{
+			for (const std::string& channel : channels.channels)
+			{
+				key += L"|" + std::wstring(channel.begin(), channel.end());
+			}
+		}
+		return key;
+	}
+
+	// Rows per worker buffer of a streamed decode: 4MB is 256 rows of a 16K wide
+	// half-float image.
+	const size_t StreamBandBytes = 4 * 1024 * 1024;
+
+	// Picks the channels to show from decoded.parts and stores them in
+	// decoded.channels. An empty selection means the RGBA interface.
+	HRESULT ResolveEXRChannels(const EXRChannelSelection& channels, DecodedImage& decoded)
+	{
+		if (channels.part >= decoded.parts.size())
+		{
+			return E_INVALIDARG;
+		}
+
+		const EXRPartInfo& part = decoded.parts[channels.part];
+		if (part.deep)
+		{
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+
+		EXRChannelSelection selection = channels;
+		if (!HasChannels(selection) && !part.layers.empty())
+		{
+			// The RGBA interface only sees the unnamed layer of the first part, so
+			// other parts, and parts without colour channels there (a pure AOV
+			// dump), start on their first colour layer.
+			auto defaultLayer = std::find_if(part.layers.begin(), part.layers.end(), [](const EXRLayer& layer) { return layer.name.empty(); });
+			bool hasColor = false;
+			if (defaultLayer != part.layers.end())
+			{
+				for (const std::string& channel : defaultLayer->channels)
+				{
+					hasColor |= (channel == "R" || channel == "G" || channel == "B" || channel == "Y");
+				}
+			}
+			if (!hasColor)
+			{
+				selection = GetEXRDefaultChannelSelection(part.layers.front());
+			}
+			else if (channels.part != 0)
+			{
+				selection = GetEXRDefaultChannelSelection(*defaultLayer);
+			}
+			selection.part = channels.part;
+		}
+
+		decoded.channels = selection;
+		return S_OK;
+	}
+
+	HRESULT DecodeEXR(const void* source, size_t sourceSize, const EXRChannelSelection& channels, const EXRBandCallback& onBand, DecodedImage& decoded)
+	{
+		HRESULT hr = GetEXRPartsFromMemory(source, sourceSize, decoded.parts);
+		if (SUCCEEDED(hr))
+		{
+			hr = ResolveEXRChannels(channels, decoded);
+		}
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		if (!HasChannels(decoded.channels))
+		{
+			return LoadFromEXRMemory(source, sourceSize, 0, &decoded.metadata, decoded.image, onBand);
+		}
+		return LoadFromEXRMemory(source, sourceSize, decoded.channels, 0, &decoded.metadata, decoded.image, onBand);
+	}
+
+	// Decodes straight from the file into onStream's bands. decoded gets the
+	// metadata, parts and channels, but no pixels.
+	HRESULT DecodeEXRStreamed(const std::wstring& path, const EXRChannelSelection& channels, const EXRStreamCallback& onStream, DecodedImage& decoded)
+	{
+		HRESULT hr = GetEXRPartsFromFile(path.c_str(), decoded.parts);
+		if (SUCCEEDED(hr))
+		{
+			hr = ResolveEXRChannels(channels, decoded);
+		}
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		return LoadFromEXRFileStreamed(path.c_str(), decoded.channels, 0, StreamBandBytes, &decoded.metadata, onStream);
+	}
+
+	// onBand only applies to EXR; the other decoders produce the image in one go.
+	HRESULT DecodeImage(const Blob& fileData, ImageFileFormat format, const EXRChannelSelection& channels, const EXRBandCallback& onBand, DecodedImage& decoded)
+	{
+		const void* source = fileData.GetBufferPointer();
+		const size_t sourceSize = fileData.GetBufferSize();
+
+		switch (format)
+		{
+		case ImageFileFormat::DDS:
+			return LoadFromDDSMemory(source, sourceSize, DDS_FLAGS_NONE, &decoded.metadata, decoded.image);
+
+		case ImageFileFormat::OpenEXR:
+			return DecodeEXR(source, sourceSize, channels, onBand, decoded);
+
+		case ImageFileFormat::JXR:
+			return LoadFromWICMemory(source, sourceSize, WIC_FLAGS_NONE, &decoded.metadata, decoded.image);
+
+		default:
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+	}
+
+	bool GetAnalysisPixelFormat(DXGI_FORMAT format, AnalysisPixelFormat& analysisFormat)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			analysisFormat = AnalysisPixelFormat::R32G32B32A32_Float;
+			return true;
+
+		case DXGI_FORMAT_R32G32B32_FLOAT:
+			analysisFormat = AnalysisPixelFormat::R32G32B32_Float;
+			return true;
+
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			analysisFormat = AnalysisPixelFormat::R16G16B16A16_Float;
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	// Fills decoded.luminance; a failure only leaves the image unanalyzed.
+	void AnalyzeDecodedImage(DecodedImage& decoded, double& analyzeMs)
+	{
+		auto start = std::chrono::steady_clock::now();
+		decoded.analyzed = SUCCEEDED(AnalyzeImage(decoded.image, decoded.luminance));
+		analyzeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+ImageFileFormat GetImageFileFormat(const std::wstring& path)
+{
+	size_t extCount = path.find_last_of(L".");
+	if (extCount == std::wstring::npos)
+	{
+		return ImageFileFormat::Unsupported;
+	}
+
+	std::wstring extname = path.substr(extCount, path.size() - extCount);
+	if (_wcsicmp(extname.c_str(), L".exr") == 0)
+	{
+		return ImageFileFormat::OpenEXR;
+	}
+	else if (_wcsicmp(extname.c_str(), L".dds") == 0)
+	{
+		return ImageFileFormat::DDS;
+	}
+	else if (_wcsicmp(extname.c_str(), L".jxr") == 0)
+	{
+		return ImageFileFormat::JXR;
+	}
+
+	return ImageFileFormat::Unsupported;
+}
+
+std::vector<std::wstring> ListImageFiles(const std::wstring& directory)
+{
+	std::vector<std::wstring> files;
+
+	std::wstring pattern = directory + L"\\*";
+	WIN32_FIND_DATAW findData;
+	HANDLE find = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return files;
+	}
+
+	do
+	{
+		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+			GetImageFileFormat(findData.cFileName) != ImageFileFormat::Unsupported)
+		{
+			files.push_back(directory + L"\\" + findData.cFileName);
+		}
+	} while (FindNextFileW(find, &findData));
+
+	FindClose(find);
+
+	std::sort(files.begin(), files.end(), [](const std::wstring& a, const std::wstring& b) { return _wcsicmp(a.c_str(), b.c_str()) < 0; });
+	return files;
+}
+
+void ChooseEXRLevel(const EXRTiledInfo& info, size_t viewWidth, size_t viewHeight, size_t& levelX, size_t& levelY)
+{
+	auto choose = [](const std::vector<size_t>& sizes, size_t view)
+	{
+		size_t level = 0;
+		while (level + 1 < sizes.size() && sizes[level + 1] >= view)
+		{
+			level++;
+		}
+		return level;
+	};
+
+	levelX = choose(info.levelWidths, viewWidth);
+	levelY = choose(info.levelHeights, viewHeight);
+
+	if (info.levels != EXR_LEVELS_RIPMAP)
+	{
+		levelX = levelY = std::min(levelX, levelY);
+	}
+}
+
+HRESULT AnalyzeImage(const ScratchImage& image, LuminanceStatistics& statistics)
+{
+	const Image* top = image.GetImage(0, 0, 0);
+	if (!top)
+	{
+		return E_INVALIDARG;
+	}
+
+	AnalysisPixelFormat format;
+	if (GetAnalysisPixelFormat(top->format, format))
+	{
+		AnalyzeLuminance(top->pixels, top->rowPitch, static_cast<uint32_t>(top->width), static_cast<uint32_t>(top->height), format, statistics);
+		return S_OK;
+	}
+
+	ScratchImage converted;
+	HRESULT hr = IsCompressed(top->format) ?
+		Decompress(*top, DXGI_FORMAT_R32G32B32A32_FLOAT, converted) :
+		Convert(*top, DXGI_FORMAT_R32G32B32A32_FLOAT, TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, converted);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	const Image* floats = converted.GetImage(0, 0, 0);
+	AnalyzeLuminance(floats->pixels, floats->rowPitch, static_cast<uint32_t>(floats->width), static_cast<uint32_t>(floats->height),
+		AnalysisPixelFormat::R32G32B32A32_Float, statistics);
+	return S_OK;
+}
+
+HRESULT AccumulateImageLuminance(const Image& image, LuminanceAccumulator& accumulator)
+{
+	AnalysisPixelFormat format;
+	if (!GetAnalysisPixelFormat(image.format, format))
+	{
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	AccumulateLuminance(image.pixels, image.rowPitch, static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height), format, accumulator);
+	return S_OK;
+}
+
+HRESULT AnalyzeImageFile(const std::wstring& path, LuminanceStatistics& statistics)
+{
+	const ImageFileFormat format = GetImageFileFormat(path);
+	DecodedImage decoded;
+
+	EXRTiledInfo tiledInfo;
+	if (format == ImageFileFormat::OpenEXR && GetEXRTiledInfoFromFile(path.c_str(), tiledInfo) != S_OK)
+	{
+		// Bands arrive from the decoder's workers, which each measure their own.
+		std::mutex mutex;
+		LuminanceAccumulator total;
+		HRESULT hr = DecodeEXRStreamed(path, EXRChannelSelection(), [&](const TexMetadata&, const Image& band, size_t)
+		{
+			LuminanceAccumulator luminance;
+			HRESULT hrBand = AccumulateImageLuminance(band, luminance);
+			if (SUCCEEDED(hrBand))
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				MergeLuminance(luminance, total);
+			}
+			return hrBand;
+		}, decoded);
+		if (SUCCEEDED(hr))
+		{
+			FinishLuminance(total, statistics);
+		}
+		return hr;
+	}
+
+	Blob fileData;
+	HRESULT hr = ReadWholeFile(path.c_str(), fileData);
+	if (SUCCEEDED(hr))
+	{
+		hr = DecodeImage(fileData, format, EXRChannelSelection(), nullptr, decoded);
+	}
+	if (SUCCEEDED(hr))
+	{
+		hr = AnalyzeImage(decoded.image, statistics);
+	}
+	return hr;
+}
+
+void ImageLoader::JobQueue::Push(std::unique_ptr<Job> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_cv.notify_one();
+}
+
+std::unique_ptr<ImageLoader::Job> ImageLoader::JobQueue::Pop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [this] { return m_closed || !m_jobs.empty(); });
+	if (m_closed)
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<Job> job = std::move(m_jobs.front());
+	m_jobs.pop_front();
+	return job;
+}
+
+void ImageLoader::JobQueue::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+	}
+	m_cv.notify_all();
+}
+
+ImageLoader::ImageLoader(ITextureUploader* uploader, ImageCache* cache, ImageCache* tileCache) :
+	m_uploader(uploader),
+	m_cache(cache),
+	m_tileCache(tileCache),
+	m_viewWidth(0),
+	m_viewHeight(0),
+	m_generation(0),
+	m_prefetchGeneration(0),
+	m_pending(0),
+	m_progressive(false),
+	m_streaming(false),
+	m_resultEvent(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE))
+{
+	m_readThread = std::thread(&ImageLoader::ReadStage, this);
+	m_decodeThread = std::thread(&ImageLoader::DecodeStage, this);
+	m_uploadThread = std::thread(&ImageLoader::UploadStage, this);
+	if (m_cache)
+	{
+		m_prefetchThread = std::thread(&ImageLoader::PrefetchStage, this);
+	}
+}
+
+ImageLoader::~ImageLoader()
+{
+	// Make every in-flight job stale so the stages drop them, then stop the threads.
+	m_generation++;
+	m_prefetchGeneration++;
+
+	m_readQueue.Close();
+	m_decodeQueue.Close();
+	m_uploadQueue.Close();
+	m_prefetchQueue.Close();
+
+	m_readThread.join();
+	m_decodeThread.join();
+	m_uploadThread.join();
+	if (m_prefetchThread.joinable())
+	{
+		m_prefetchThread.join();
+	}
+}
+
+void ImageLoader::Request(const std::wstring& path, ImageFileFormat format, const EXRChannelSelection& channels)
+{
+	std::unique_ptr<Job> job(new Job);
+	job->generation = ++m_generation;
+	job->path = path;
+	job->format = format;
+	job->channels = channels;
+	job->requestTime = Clock::now();
+	job->result.path = path;
+	job->result.requestTime = job->requestTime;
+
+	m_pending++;
+	m_readQueue.Push(std::move(job));
+}
+
+void ImageLoader::Prefetch(const std::vector<std::wstring>& paths)
+{
+	if (!m_cache)
+	{
+		return;
+	}
+
+	// Bumping the generation drops whatever is still queued from the last call.
+	const uint64_t generation = ++m_prefetchGeneration;
+	for (const std::wstring& path : paths)
+	{
+		ImageFileFormat format = GetImageFileFormat(path);
+		if (format == ImageFileFormat::Unsupported || m_cache->Contains(path))
+		{
+			continue;
+		}
+
+		std::unique_ptr<Job> job(new Job);
+		job->generation = generation;
+		job->path = path;
+		job->format = format;
+		job->requestTime = Clock::now();
+		m_prefetchQueue.Push(std::move(job));
+	}
+}
+
+void ImageLoader::SetViewSize(uint32_t width, uint32_t height)
+{
+	m_viewWidth = width;
+	m_viewHeight = height;
+}
+
+void ImageLoader::SetProgressive(bool progressive)
+{
+	m_progressive = progressive;
+}
+
+void ImageLoader::SetStreaming(bool streaming)
+{
+	m_streaming = streaming;
+}
+
+bool ImageLoader::Poll(LoadResult& result)
+{
+	std::lock_guard<std::mutex> lock(m_resultMutex);
+	if (!m_result)
+	{
+		return false;
+	}
+
+	result = std::move(*m_result);
+	m_result.reset();
+	return true;
+}
+
+bool ImageLoader::IsBusy() const
+{
+	return m_pending > 0;
+}
+
+// A job leaves the pipeline, either finished, failed or superseded.
+void ImageLoader::Finish(std::unique_ptr<Job> job)
+{
+	if (!IsSuperseded(*job))
+	{
+		job->result.timings.totalMs = ElapsedMs(job->requestTime);
+
+		std::lock_guard<std::mutex> lock(m_resultMutex);
+		m_result.reset(new LoadResult(std::move(job->result)));
+	}
+
+	m_pending--;
+	SetEvent(m_resultEvent.Get());
+}
+
+void ImageLoader::ReadStage()
+{
+	while (std::unique_ptr<Job> job = m_readQueue.Pop())
+	{
+		if (IsSuperseded(*job))
+		{
+			Finish(std::move(job));
+			continue;
+		}
+
+		auto start = Clock::now();
+
+		// Tiled EXRs skip the read; their tiles are decoded straight from the file.
+		if (job->format == ImageFileFormat::OpenEXR &&
+			GetEXRTiledInfoFromFile(job->path.c_str(), job->result.tiledInfo) == S_OK)
+		{
+			job->result.tiled = true;
+			job->result.timings.readMs = ElapsedMs(start);
+			m_decodeQueue.Push(std::move(job));
+			continue;
+		}
+
+		if (m_cache)
+		{
+			WaitForPrefetch(job->path);
+
+			job->decoded = m_cache->Find(MakeCacheKey(job->path, job->channels));
+			if (job->decoded)
+			{
+				m_uploadQueue.Push(std::move(job));
+				continue;
+			}
+		}
+
+		// Streamed EXRs are mapped by the decode stage instead of read whole.
+		if (m_streaming && job->format == ImageFileFormat::OpenEXR)
+		{
+			job->streamed = true;
+			job->result.timings.readMs = ElapsedMs(start);
+			m_decodeQueue.Push(std::move(job));
+			continue;
+		}
+
+		// Switching parts, layers or channels of the file on screen decodes from
+		// the bytes that were already read.
+		if (job->path == m_lastFilePath)
+		{
+			job->fileData = m_lastFileData;
+		}
+		else
+		{
+			m_lastFileData.reset();
+			m_lastFilePath.clear();
+
+			job->fileData = std::make_shared<Blob>();
+			job->result.hr = ReadWholeFile(job->path.c_str(), *job->fileData);
+			job->result.timings.readMs = ElapsedMs(start);
+
+			if (FAILED(job->result.hr))
+			{
+				Finish(std::move(job));
+				continue;
+			}
+
+			if (job->format == ImageFileFormat::OpenEXR)
+			{
+				m_lastFileData = job->fileData;
+				m_lastFilePath = job->path;
+			}
+		}
+
+		m_decodeQueue.Push(std::move(job));
+	}
+}
+
+void ImageLoader::DecodeStage()
+{
+	// The WIC codecs used for JPEG XR need COM on this thread.
+	HRESULT hrCOM = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	while (std::unique_ptr<Job> job = m_decodeQueue.Pop())
+	{
+		if (IsSuperseded(*job))
+		{
+			Finish(std::move(job));
+			continue;
+		}
+
+		auto start = Clock::now();
+
+		std::shared_ptr<DecodedImage> decoded = std::make_shared<DecodedImage>();
+		HRESULT hr;
+		if (job->result.tiled)
+		{
+			hr = DecodeTiledLevel(*job, *decoded);
+		}
+		else if (job->streamed)
+		{
+			hr = DecodeEXRStreamed(job->path, job->channels, [this, &job](const TexMetadata& metadata, const Image& band, size_t firstRow)
+			{
+				// Measured before the band buffer goes back to the decoder, outside
+				// the lock so that the workers analyze in parallel.
+				auto analyzeStart = Clock::now();
+				LuminanceAccumulator luminance;
+				HRESULT hrLuminance = AccumulateImageLuminance(band, luminance);
+				double analyzeMs = ElapsedMs(analyzeStart);
+				{
+					std::lock_guard<std::mutex> lock(job->bandMutex);
+					MergeLuminance(luminance, job->bandLuminance);
+					job->result.timings.analyzeMs += analyzeMs;
+					if (FAILED(hrLuminance))
+					{
+						job->bandLuminanceResult = hrLuminance;
+					}
+				}
+
+				return UploadBand(*job, metadata, band, firstRow);
+			}, *decoded);
+
+			if (SUCCEEDED(hr) && SUCCEEDED(job->bandLuminanceResult))
+			{
+				FinishLuminance(job->bandLuminance, decoded->luminance);
+				decoded->analyzed = true;
+			}
+		}
+		else
+		{
+			EXRBandCallback onBand;
+			if (m_progressive && job->format == ImageFileFormat::OpenEXR)
+			{
+				onBand = [this, &job](const ScratchImage& image, size_t firstRow, size_t rowCount)
+				{
+					Image rows = *image.GetImage(0, 0, 0);
+					rows.pixels += firstRow * rows.rowPitch;
+					rows.height = rowCount;
+					rows.slicePitch = rows.rowPitch * rowCount;
+					UploadBand(*job, image.GetMetadata(), rows, firstRow);
+				};
+			}
+
+			hr = DecodeImage(*job->fileData, job->format, job->channels, onBand, *decoded);
+
+			// The encoded bytes are no longer needed once decoded.
+			job->fileData.reset();
+		}
+
+		if (SUCCEEDED(hr) && !job->streamed)
+		{
+			AnalyzeDecodedImage(*decoded, job->result.timings.analyzeMs);
+		}
+
+		job->result.hr = hr;
+		job->result.timings.decodeMs = ElapsedMs(start);
+
+		if (FAILED(hr))
+		{
+			Finish(std::move(job));
+			continue;
+		}
+
+		// Tiled files are cached per tile instead, and streamed ones not at all.
+		if (m_cache && !job->result.tiled && !job->streamed)
+		{
+			m_cache->Insert(MakeCacheKey(job->path, job->channels), decoded);
+		}
+		job->decoded = std::move(decoded);
+
+		m_uploadQueue.Push(std::move(job));
+	}
+
+	if (SUCCEEDED(hrCOM))
+	{
+		CoUninitialize();
+	}
+}
+
+void ImageLoader::UploadStage()
+{
+	while (std::unique_ptr<Job> job = m_uploadQueue.Pop())
+	{
+		if (IsSuperseded(*job))
+		{
+			Finish(std::move(job));
+			continue;
+		}
+
+		auto start = Clock::now();
+
+		job->result.metadata = job->decoded->metadata;
+		job->result.parts = job->decoded->parts;
+		job->result.channels = job->decoded->channels;
+		job->result.luminance = job->decoded->luminance;
+		job->result.analyzed = job->decoded->analyzed;
+
+		// A progressive load already has every row on the GPU.
+		if (!job->result.texture)
+		{
+			job->result.hr = m_uploader->Upload(job->decoded->metadata, job->decoded->image, job->result.texture);
+			job->result.timings.uploadMs = ElapsedMs(start);
+		}
+
+		job->decoded.reset();
+
+		Finish(std::move(job));
+	}
+}
+
+void ImageLoader::PrefetchStage()
+{
+	HRESULT hrCOM = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	while (std::unique_ptr<Job> job = m_prefetchQueue.Pop())
+	{
+		if (job->generation != m_prefetchGeneration || m_cache->Contains(job->path))
+		{
+			continue;
+		}
+
+		// Tiled EXRs can be far larger than memory; they are only loaded on request.
+		// So are all EXRs while streaming, which is there to bound memory.
+		EXRTiledInfo tiledInfo;
+		if (job->format == ImageFileFormat::OpenEXR &&
+			(m_streaming || GetEXRTiledInfoFromFile(job->path.c_str(), tiledInfo) == S_OK))
+		{
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_prefetchMutex);
+			m_prefetchPath = job->path;
+		}
+
+		Blob fileData;
+		HRESULT hr = ReadWholeFile(job->path.c_str(), fileData);
+		if (SUCCEEDED(hr))
+		{
+			std::shared_ptr<DecodedImage> decoded = std::make_shared<DecodedImage>();
+			if (SUCCEEDED(DecodeImage(fileData, job->format, job->channels, nullptr, *decoded)))
+			{
+				double analyzeMs;
+				AnalyzeDecodedImage(*decoded, analyzeMs);
+				m_cache->Insert(job->path, decoded);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_prefetchMutex);
+			m_prefetchPath.clear();
+		}
+		m_prefetchCv.notify_all();
+	}
+
+	if (SUCCEEDED(hrCOM))
+	{
+		CoUninitialize();
+	}
+}
+
+// Uploads one decoded band of a progressive or streamed load, creating the
+// texture on the first one and handing it to the render thread straight away.
+// After a failure the remaining bands are dropped: a progressive load then
+// uploads the whole image in the upload stage, a streamed one stops decoding.
+HRESULT ImageLoader::UploadBand(Job& job, const TexMetadata& metadata, const Image& rows, size_t firstRow)
+{
+	std::lock_guard<std::mutex> lock(job.bandMutex);
+	if (IsSuperseded(job))
+	{
+		return E_ABORT;
+	}
+	if (FAILED(job.bandResult))
+	{
+		return job.bandResult;
+	}
+
+	auto start = Clock::now();
+
+	if (!job.result.texture)
+	{
+		job.bandResult = m_uploader->CreateTexture(metadata, job.result.texture);
+	}
+	if (SUCCEEDED(job.bandResult))
+	{
+		job.bandResult = m_uploader->UploadRows(rows, firstRow, *job.result.texture);
+	}
+	job.result.timings.uploadMs += ElapsedMs(start);
+
+	if (FAILED(job.bandResult))
+	{
+		job.result.texture.reset();
+		return job.bandResult;
+	}
+
+	if (job.result.timings.firstBandMs == 0.0)
+	{
+		job.result.timings.firstBandMs = ElapsedMs(job.requestTime);
+
+		std::unique_ptr<LoadResult> partial(new LoadResult(job.result));
+		partial->metadata = metadata;
+		partial->complete = false;
+
+		{
+			std::lock_guard<std::mutex> resultLock(m_resultMutex);
+			m_result = std::move(partial);
+		}
+		SetEvent(m_resultEvent.Get());
+	}
+
+	return S_OK;
+}
+
+// Blocks while the prefetch thread is decoding the same file; its result is
+// in the cache afterwards unless the decode failed.
+void ImageLoader::WaitForPrefetch(const std::wstring& path)
+{
+	std::unique_lock<std::mutex> lock(m_prefetchMutex);
+	m_prefetchCv.wait(lock, [this, &path] { return _wcsicmp(m_prefetchPath.c_str(), path.c_str()) != 0; });
+}
+
+// Assembles the view-sized level of a tiled EXR. Resident tiles come from the
+// tile cache; the rest are decoded in parallel and added to it.
+HRESULT ImageLoader::DecodeTiledLevel(Job& job, DecodedImage& decoded)
+{
+	const EXRTiledInfo& info = job.result.tiledInfo;
+	if (info.levelWidths.empty() || info.levelHeights.empty() || info.tileWidth == 0 || info.tileHeight == 0)
+	{
+		return E_FAIL;
+	}
+
+	ChooseEXRLevel(info, m_viewWidth, m_viewHeight, job.result.levelX, job.result.levelY);
+	const size_t levelX = job.result.levelX;
+	const size_t levelY = job.result.levelY;
+
+	const size_t width = info.levelWidths[levelX];
+	const size_t height = info.levelHeights[levelY];
+	const size_t tilesX = (width + info.tileWidth - 1) / info.tileWidth;
+	const size_t tilesY = (height + info.tileHeight - 1) / info.tileHeight;
+
+	HRESULT hr = decoded.image.Initialize2D(DXGI_FORMAT_R16G16B16A16_FLOAT, width, height, 1, 1);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	decoded.metadata = decoded.image.GetMetadata();
+
+	std::vector<std::shared_ptr<const DecodedImage>> tiles(tilesX * tilesY);
+	std::vector<std::wstring> keys(tiles.size());
+	std::vector<EXRTile> missing;
+	std::vector<size_t> missingIndices;
+	for (size_t ty = 0; ty < tilesY; ++ty)
+	{
+		for (size_t tx = 0; tx < tilesX; ++tx)
+		{
+			const size_t index = ty * tilesX + tx;
+			keys[index] = job.path + L"|" + std::to_wstring(levelX) + L"," + std::to_wstring(levelY) + L"|" + std::to_wstring(tx) + L"," + std::to_wstring(ty);
+
+			if (m_tileCache)
+			{
+				tiles[index] = m_tileCache->Find(keys[index]);
+			}
+			if (!tiles[index])
+			{
+				EXRTile tile = { levelX, levelY, tx, ty };
+				missing.push_back(tile);
+				missingIndices.push_back(index);
+			}
+		}
+	}
+
+	if (!missing.empty())
+	{
+		std::vector<ScratchImage> images(missing.size());
+		hr = LoadEXRTilesFromFile(job.path.c_str(), missing.data(), missing.size(), 0, images.data());
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		for (size_t i = 0; i < missing.size(); ++i)
+		{
+			std::shared_ptr<DecodedImage> tile = std::make_shared<DecodedImage>();
+			tile->image = std::move(images[i]);
+			tile->metadata = tile->image.GetMetadata();
+
+			if (m_tileCache)
+			{
+				m_tileCache->Insert(keys[missingIndices[i]], tile);
+			}
+			tiles[missingIndices[i]] = std::move(tile);
+		}
+	}
+
+	job.result.tileCount = tiles.size();
+	job.result.tilesDecoded = missing.size();
+
+	const Image* dest = decoded.image.GetImage(0, 0, 0);
+	const size_t bytesPerPixel = sizeof(uint16_t) * 4;
+	for (size_t ty = 0; ty < tilesY; ++ty)
+	{
+		for (size_t tx = 0; tx < tilesX; ++tx)
+		{
+			const Image* source = tiles[ty * tilesX + tx]->image.GetImage(0, 0, 0);
+			const size_t x = tx * info.tileWidth;
+			const size_t y = ty * info.tileHeight;
+			if (x + source->width > width || y + source->height > height)
+			{
+				return E_UNEXPECTED;
+			}
+
+			for (size_t row = 0; row < source->height; ++row)
+			{
+				memcpy(dest->pixels + (y + row) * dest->rowPitch + x * bytesPerPixel,
+					source->pixels + row * source->rowPitch,
+					source->width * bytesPerPixel);
+			}
+		}
+	}
+
+	return S_OK;
+}
@@ -0,0 +1,284 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <DirectXTex.h>
+
+#include "DirectXTexEXR.h"
+#include "ImageCache.h"
+#include "LuminanceAnalysis.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class ImageFileFormat
+{
+	DDS = 0,
+	OpenEXR,
+	JXR,	// JPEG XR
+	Unsupported
+};
+
+// Picks the decoder from the file extension.
+ImageFileFormat GetImageFileFormat(const std::wstring& path);
+
+// Full paths of the supported images in a directory, sorted by name.
+std::vector<std::wstring> ListImageFiles(const std::wstring& directory);
+
+// Picks the smallest level of a tiled EXR that still covers the view in both
+// directions, so the GPU only ever minifies. Mip levels come back with levelX == levelY.
+void ChooseEXRLevel(const DirectX::EXRTiledInfo& info, size_t viewWidth, size_t viewHeight, size_t& levelX, size_t& levelY);
+
+// Luminance statistics of the top level of an image. Formats the analysis
+// cannot read directly are converted to float first.
+HRESULT AnalyzeImage(const DirectX::ScratchImage& image, LuminanceStatistics& statistics);
+
+// Adds rows of an image to an accumulator on the calling thread. Fails for
+// formats the analysis cannot read directly.
+HRESULT AccumulateImageLuminance(const DirectX::Image& image, LuminanceAccumulator& accumulator);
+
+// Decodes and analyzes a file on the calling thread, without the loader's
+// pipeline or a GPU; for headless use. Scanline EXRs are streamed, so memory
+// stays bounded. JPEG XR needs COM initialized on the calling thread.
+HRESULT AnalyzeImageFile(const std::wstring& path, LuminanceStatistics& statistics);
+
+// GPU-side result of an upload. The renderer's uploader derives from this.
+struct UploadedTexture
+{
+	virtual ~UploadedTexture() {}
+};
+
+// Creates a texture from a decoded image. Upload() is called on the loader's
+// upload thread, so implementations must not touch render-thread state. The
+// copy may still be in flight when it returns; the texture carries whatever
+// the renderer needs to wait for it. NullTextureUploader implements it without
+// a GPU, for headless runs.
+class ITextureUploader
+{
+public:
+	virtual ~ITextureUploader() {}
+	virtual HRESULT Upload(const DirectX::TexMetadata& metadata, const DirectX::ScratchImage& image, std::shared_ptr<UploadedTexture>& texture) = 0;
+
+	// Progressive and streamed loads: CreateTexture() makes a texture that can be
+	// bound right away, and UploadRows() fills in rows of its top level as they are
+	// decoded. rows holds rows [firstRow, firstRow + rows.height) only.
+	virtual HRESULT CreateTexture(const DirectX::TexMetadata& metadata, std::shared_ptr<UploadedTexture>& texture) = 0;
+	virtual HRESULT UploadRows(const DirectX::Image& rows, size_t firstRow, UploadedTexture& texture) = 0;
+};
+
+// Wall-clock time spent in each stage of a load, in milliseconds.
+struct LoadTimings
+{
+	double readMs = 0.0;
+	double decodeMs = 0.0;
+	double analyzeMs = 0.0;	// Part of decodeMs.
+	double uploadMs = 0.0;
+	double publishMs = 0.0;	// Filled in by the render thread.
+	double totalMs = 0.0;	// From Request() until the upload was submitted.
+	double firstBandMs = 0.0;	// From Request() until the first rows were submitted; 0 unless progressive.
+};
+
+struct LoadResult
+{
+	std::wstring path;
+	HRESULT hr = S_OK;
+	DirectX::TexMetadata metadata = {};
+	std::shared_ptr<UploadedTexture> texture;
+	LoadTimings timings;
+	std::chrono::steady_clock::time_point requestTime;
+
+	// A progressive load posts its texture as soon as the first band is on the
+	// GPU; the final result with the same texture follows once decoding is done.
+	bool complete = true;
+
+	// Tiled EXRs are loaded one level at a time.
+	bool tiled = false;
+	DirectX::EXRTiledInfo tiledInfo;
+	size_t levelX = 0;
+	size_t levelY = 0;
+	size_t tileCount = 0;
+	size_t tilesDecoded = 0;	// Tiles that were not resident in the tile cache.
+
+	// EXR parts in the file and the part and channels that were decoded.
+	std::vector<DirectX::EXRPartInfo> parts;
+	DirectX::EXRChannelSelection channels;
+
+	// Luminance histogram and content light levels of the decoded image (of the
+	// loaded level for tiled EXRs); analyzed is false if it could not be measured.
+	LuminanceStatistics luminance;
+	bool analyzed = false;
+};
+
+// Loads images off the render thread. Each request flows through a read, a
+// decode and an upload stage, each with its own thread, so one file can be read
+// while the previous one is decoded. The render thread publishes the result by
+// polling. A newer request supersedes the ones that have not finished yet.
+//
+// With a cache, decoded images are kept so that revisiting one only costs the
+// upload, and Prefetch() decodes likely next images into it on a background
+// thread.
+//
+// With progressive loading on, scanline EXRs are uploaded band by band while
+// they decode, into a texture the render thread can show from the first band.
+// Streaming goes further for memory: the file is mapped rather than read, and
+// the decoder's workers each reuse one small band buffer instead of filling a
+// whole image, so host memory no longer grows with the image size. Streamed
+// images are neither cached nor prefetched.
+//
+// Tiled EXRs are never read whole. Only the level matching the view size is
+// assembled, from tiles kept in the tile cache or decoded on demand.
+//
+// The decode stage also measures the luminance statistics of every image,
+// across the thread pool; streamed images are measured band by band as the
+// decoder's workers produce them.
+class ImageLoader
+{
+public:
+	ImageLoader(ITextureUploader* uploader, ImageCache* cache = nullptr, ImageCache* tileCache = nullptr);
+	~ImageLoader();
+
+	ImageLoader(const ImageLoader&) = delete;
+	ImageLoader& operator=(const ImageLoader&) = delete;
+
+	// For EXR, channels picks the part and the layer or channels to decode. Left
+	// empty, the unnamed RGBA layer of the part is shown, or its first layer if it
+	// has none. Each part is decoded the first time it is requested.
+	void Request(const std::wstring& path, ImageFileFormat format, const DirectX::EXRChannelSelection& channels = DirectX::EXRChannelSelection());
+
+	// Replaces the pending prefetch list. Images already cached are skipped.
+	void Prefetch(const std::vector<std::wstring>& paths);
+
+	// Size of the area the image is drawn into; selects the tiled EXR level.
+	void SetViewSize(uint32_t width, uint32_t height);
+
+	// Stream decoded rows to the GPU instead of uploading the finished image.
+	void SetProgressive(bool progressive);
+
+	// Decode EXRs through bounded band buffers and never hold the whole image.
+	void SetStreaming(bool streaming);
+
+	// Returns the most recent finished load, if any. Called on the render thread.
+	bool Poll(LoadResult& result);
+
+	// True while a request is somewhere in the pipeline.
+	bool IsBusy() const;
+
+	// Auto-reset event set whenever a result is posted or a request leaves the
+	// pipeline, so a render loop that sleeps while idle can wait on it.
+	HANDLE GetResultEvent() const { return m_resultEvent.Get(); }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Job
+	{
+		uint64_t generation;
+		std::wstring path;
+		ImageFileFormat format;
+		DirectX::EXRChannelSelection channels;
+		Clock::time_point requestTime;
+		std::shared_ptr<DirectX::Blob> fileData;
+		std::shared_ptr<const DecodedImage> decoded;
+		LoadResult result;
+		bool streamed = false;	// Decoded band by band from the mapped file.
+
+		// Progressive and streamed loads: band callbacks come from the decoder's workers.
+		std::mutex bandMutex;
+		HRESULT bandResult = S_OK;
+		LuminanceAccumulator bandLuminance;
+		HRESULT bandLuminanceResult = S_OK;
+	};
+
+	// Hand-off point between two stages.
+	class JobQueue
+	{
+	public:
+		void Push(std::unique_ptr<Job> job);
+		std::unique_ptr<Job> Pop();	// Blocks; returns nullptr once closed.
+		void Close();
+
+	private:
+		std::deque<std::unique_ptr<Job>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		bool m_closed = false;
+	};
+
+	bool IsSuperseded(const Job& job) const { return job.generation != m_generation; }
+	void Finish(std::unique_ptr<Job> job);
+
+	void ReadStage();
+	void DecodeStage();
+	void UploadStage();
+	void PrefetchStage();
+
+	HRESULT UploadBand(Job& job, const DirectX::TexMetadata& metadata, const DirectX::Image& rows, size_t firstRow);
+	void WaitForPrefetch(const std::wstring& path);
+	HRESULT DecodeTiledLevel(Job& job, DecodedImage& decoded);
+
+	static double ElapsedMs(Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); }
+
+	ITextureUploader* m_uploader;
+	ImageCache* m_cache;
+	ImageCache* m_tileCache;
+	std::atomic<uint32_t> m_viewWidth;
+	std::atomic<uint32_t> m_viewHeight;
+	std::atomic<uint64_t> m_generation;
+	std::atomic<uint64_t> m_prefetchGeneration;
+	std::atomic<uint32_t> m_pending;
+	std::atomic<bool> m_progressive;
+	std::atomic<bool> m_streaming;
+
+	JobQueue m_readQueue;
+	JobQueue m_decodeQueue;
+	JobQueue m_uploadQueue;
+	JobQueue m_prefetchQueue;
+
+	// The image the prefetch thread is decoding, so a request for it can wait
+	// for that decode instead of starting a second one.
+	std::mutex m_prefetchMutex;
+	std::condition_variable m_prefetchCv;
+	std::wstring m_prefetchPath;
+
+	// Bytes of the last EXR the read stage loaded. Read stage only.
+	std::shared_ptr<DirectX::Blob> m_lastFileData;
+	std::wstring m_lastFilePath;
+
+	std::mutex m_resultMutex;
+	std::unique_ptr<LoadResult> m_result;
+	Microsoft::WRL::Wrappers::Event m_resultEvent;
+
+	std::thread m_readThread;
+	std::thread m_decodeThread;
+	std::thread m_uploadThread;
+	std::thread m_prefetchThread;
+};
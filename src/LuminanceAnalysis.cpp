@@ -0,0 +1,441 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "LuminanceAnalysis.h"
+#include "HalfConversion.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LUMINANCE_ANALYSIS_X86 1
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define LUMINANCE_ANALYSIS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	const float FP16Max = 65504.0f;
+	const float LuminanceRed = 0.2126f;
+	const float LuminanceGreen = 0.7152f;
+	const float LuminanceBlue = 0.0722f;
+
+	// Float bits >> BinShift are the exponent and the leading mantissa bits that pick a bin.
+	const uint32_t BinShift = 23 - LuminanceBinsPerStopBits;
+	const uint32_t BinBase = (127 + LuminanceMinStop) << LuminanceBinsPerStopBits;
+
+	// Pixels converted to RGBA float at a time, for the formats the kernels do not read directly.
+	const size_t ChunkPixels = 256;
+
+	inline float AsFloat(uint32_t u)
+	{
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	inline uint32_t AsUInt(float f)
+	{
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	// Luminance is clamped into the histogram range before the bits are taken,
+	// so every bin index is in range without integer min/max (SSE4.1).
+	const float BinLowest = AsFloat((127 + LuminanceMinStop) << 23);
+	const float BinHighest = AsFloat(((127 + LuminanceMaxStop) << 23) - 1);
+
+	//-------------------------------------------------------------------------
+	// Kernel
+	//-------------------------------------------------------------------------
+
+	// Min and Max return b when a is NaN, like minps and maxps, so NaN
+	// components drop out as 0.
+	struct ScalarOps
+	{
+		typedef float F;
+		typedef uint32_t I;
+		static const size_t Width = 1;
+
+		static void LoadRGB(const float* src, F& r, F& g, F& b) { r = src[0]; g = src[1]; b = src[2]; }
+		static F Splat(float value) { return value; }
+		static F Add(F a, F b) { return a + b; }
+		static F Mul(F a, F b) { return a * b; }
+		static F Min(F a, F b) { return (a < b) ? a : b; }
+		static F Max(F a, F b) { return (a > b) ? a : b; }
+		static I Bin(F a) { return (AsUInt(a) >> BinShift) - BinBase; }
+		static void StoreBins(uint32_t* dst, I a) { dst[0] = a; }
+		static float ReduceAdd(F a) { return a; }
+		static float ReduceMin(F a) { return a; }
+		static float ReduceMax(F a) { return a; }
+	};
+
+#if defined(LUMINANCE_ANALYSIS_X86)
+	struct SSE2Ops
+	{
+		typedef __m128 F;
+		typedef __m128i I;
+		static const size_t Width = 4;
+
+		static void LoadRGB(const float* src, F& r, F& g, F& b)
+		{
+			F p0 = _mm_loadu_ps(src);
+			F p1 = _mm_loadu_ps(src + 4);
+			F p2 = _mm_loadu_ps(src + 8);
+			F p3 = _mm_loadu_ps(src + 12);
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+			r = p0;
+			g = p1;
+			b = p2;
+		}
+		static F Splat(float value) { return _mm_set1_ps(value); }
+		static F Add(F a, F b) { return _mm_add_ps(a, b); }
+		static F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+		static F Min(F a, F b) { return _mm_min_ps(a, b); }
+		static F Max(F a, F b) { return _mm_max_ps(a, b); }
+		static I Bin(F a) { return _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(a), BinShift), _mm_set1_epi32(BinBase)); }
+		static void StoreBins(uint32_t* dst, I a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), a); }
+		static float ReduceAdd(F a)
+		{
+			a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+			return _mm_cvtss_f32(_mm_add_ss(a, _mm_shuffle_ps(a, a, 1)));
+		}
+		static float ReduceMin(F a)
+		{
+			a = _mm_min_ps(a, _mm_movehl_ps(a, a));
+			return _mm_cvtss_f32(_mm_min_ss(a, _mm_shuffle_ps(a, a, 1)));
+		}
+		static float ReduceMax(F a)
+		{
+			a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+			return _mm_cvtss_f32(_mm_max_ss(a, _mm_shuffle_ps(a, a, 1)));
+		}
+	};
+	typedef SSE2Ops SIMD128Ops;
+#elif defined(LUMINANCE_ANALYSIS_NEON)
+	// vmaxq/vminq propagate NaN, so Min and Max are built from compares to keep the SSE semantics.
+	struct NEONOps
+	{
+		typedef float32x4_t F;
+		typedef uint32x4_t I;
+		static const size_t Width = 4;
+
+		static void LoadRGB(const float* src, F& r, F& g, F& b)
+		{
+			float32x4x4_t p = vld4q_f32(src);
+			r = p.val[0];
+			g = p.val[1];
+			b = p.val[2];
+		}
+		static F Splat(float value) { return vdupq_n_f32(value); }
+		static F Add(F a, F b) { return vaddq_f32(a, b); }
+		static F Mul(F a, F b) { return vmulq_f32(a, b); }
+		static F Min(F a, F b) { return vbslq_f32(vcltq_f32(a, b), a, b); }
+		static F Max(F a, F b) { return vbslq_f32(vcgtq_f32(a, b), a, b); }
+		static I Bin(F a) { return vsubq_u32(vshrq_n_u32(vreinterpretq_u32_f32(a), BinShift), vdupq_n_u32(BinBase)); }
+		static void StoreBins(uint32_t* dst, I a) { vst1q_u32(dst, a); }
+		static float ReduceAdd(F a) { return vaddvq_f32(a); }
+		static float ReduceMin(F a) { return vminvq_f32(a); }
+		static float ReduceMax(F a) { return vmaxvq_f32(a); }
+	};
+	typedef NEONOps SIMD128Ops;
+#endif
+
+	// Adds RGBA float pixels. Sums stay in float lanes for the chunk and go to
+	// double once at the end.
+	template <typename Ops>
+	void AccumulateChunk(const float* src, size_t pixelCount, float nitsPerUnit, LuminanceAccumulator& accumulator)
+	{
+		typedef typename Ops::F F;
+		const size_t width = Ops::Width;
+
+		const F zero = Ops::Splat(0.0f);
+		const F fp16Max = Ops::Splat(FP16Max);
+		const F red = Ops::Splat(LuminanceRed * nitsPerUnit);
+		const F green = Ops::Splat(LuminanceGreen * nitsPerUnit);
+		const F blue = Ops::Splat(LuminanceBlue * nitsPerUnit);
+		const F scale = Ops::Splat(nitsPerUnit);
+		const F binLowest = Ops::Splat(BinLowest);
+		const F binHighest = Ops::Splat(BinHighest);
+
+		F minNits = Ops::Splat(accumulator.minNits);
+		F maxNits = zero;
+		F maxComponent = zero;
+		F sumNits = zero;
+		F sumComponent = zero;
+		uint32_t bins[width];
+
+		size_t i = 0;
+		for (; i + width <= pixelCount; i += width)
+		{
+			F r, g, b;
+			Ops::LoadRGB(src + i * 4, r, g, b);
+			r = Ops::Min(Ops::Max(r, zero), fp16Max);
+			g = Ops::Min(Ops::Max(g, zero), fp16Max);
+			b = Ops::Min(Ops::Max(b, zero), fp16Max);
+
+			F nits = Ops::Add(Ops::Add(Ops::Mul(r, red), Ops::Mul(g, green)), Ops::Mul(b, blue));
+			F component = Ops::Mul(Ops::Max(r, Ops::Max(g, b)), scale);
+
+			minNits = Ops::Min(minNits, nits);
+			maxNits = Ops::Max(maxNits, nits);
+			maxComponent = Ops::Max(maxComponent, component);
+			sumNits = Ops::Add(sumNits, nits);
+			sumComponent = Ops::Add(sumComponent, component);
+
+			Ops::StoreBins(bins, Ops::Bin(Ops::Min(Ops::Max(nits, binLowest), binHighest)));
+			for (size_t lane = 0; lane < width; lane++)
+			{
+				accumulator.histogram[bins[lane]]++;
+			}
+		}
+
+		accumulator.pixelCount += i;
+		accumulator.minNits = Ops::ReduceMin(minNits);
+		accumulator.maxNits = std::max<float>(accumulator.maxNits, Ops::ReduceMax(maxNits));
+		accumulator.maxCLL = std::max<float>(accumulator.maxCLL, Ops::ReduceMax(maxComponent));
+		accumulator.sumNits += Ops::ReduceAdd(sumNits);
+		accumulator.sumMaxComponentNits += Ops::ReduceAdd(sumComponent);
+
+		if (i < pixelCount)
+		{
+			AccumulateChunk<ScalarOps>(src + i * 4, pixelCount - i, nitsPerUnit, accumulator);
+		}
+	}
+
+	LuminanceAnalysisPath Resolve(LuminanceAnalysisPath path)
+	{
+#if defined(LUMINANCE_ANALYSIS_X86) || defined(LUMINANCE_ANALYSIS_NEON)
+		const LuminanceAnalysisPath best = LuminanceAnalysisPath::SIMD128;
+#else
+		const LuminanceAnalysisPath best = LuminanceAnalysisPath::Scalar;
+#endif
+		return (path > best) ? best : path;
+	}
+
+	void AccumulateRow(const float* src, size_t pixelCount, LuminanceAccumulator& accumulator, LuminanceAnalysisPath path)
+	{
+		// Pieces of 4096 pixels keep the float lane sums short enough to stay accurate.
+		for (size_t x = 0; x < pixelCount; x += 4096)
+		{
+			size_t count = std::min<size_t>(pixelCount - x, 4096);
+#if defined(LUMINANCE_ANALYSIS_X86) || defined(LUMINANCE_ANALYSIS_NEON)
+			if (path == LuminanceAnalysisPath::SIMD128)
+			{
+				AccumulateChunk<SIMD128Ops>(src + x * 4, count, ScRGBReferenceNits, accumulator);
+				continue;
+			}
+#endif
+			AccumulateChunk<ScalarOps>(src + x * 4, count, ScRGBReferenceNits, accumulator);
+		}
+	}
+}
+
+float GetLuminanceBinNits(uint32_t bin)
+{
+	return AsFloat((bin + BinBase) << BinShift);
+}
+
+LuminanceAnalysisPath GetLuminanceAnalysisPath()
+{
+	return Resolve(LuminanceAnalysisPath::Best);
+}
+
+const char* GetLuminanceAnalysisPathName(LuminanceAnalysisPath path)
+{
+	switch (Resolve(path))
+	{
+#if defined(LUMINANCE_ANALYSIS_NEON)
+	case LuminanceAnalysisPath::SIMD128:	return "NEON";
+#else
+	case LuminanceAnalysisPath::SIMD128:	return "SSE2";
+#endif
+	default:								return "Scalar";
+	}
+}
+
+void AccumulateLuminance(const void* pixels, size_t rowPitch, uint32_t width, uint32_t height, AnalysisPixelFormat format,
+	LuminanceAccumulator& accumulator, LuminanceAnalysisPath path)
+{
+	path = Resolve(path);
+
+	std::vector<float> chunk;
+	if (format != AnalysisPixelFormat::R32G32B32A32_Float)
+	{
+		chunk.resize(ChunkPixels * 4);
+	}
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* row = static_cast<const uint8_t*>(pixels) + y * rowPitch;
+		switch (format)
+		{
+		case AnalysisPixelFormat::R32G32B32A32_Float:
+			AccumulateRow(reinterpret_cast<const float*>(row), width, accumulator, path);
+			break;
+
+		case AnalysisPixelFormat::R32G32B32_Float:
+			for (size_t x = 0; x < width; x += ChunkPixels)
+			{
+				size_t count = std::min<size_t>(width - x, ChunkPixels);
+				const float* src = reinterpret_cast<const float*>(row) + x * 3;
+				for (size_t i = 0; i < count; i++)
+				{
+					chunk[i * 4 + 0] = src[i * 3 + 0];
+					chunk[i * 4 + 1] = src[i * 3 + 1];
+					chunk[i * 4 + 2] = src[i * 3 + 2];
+				}
+				AccumulateRow(chunk.data(), count, accumulator, path);
+			}
+			break;
+
+		case AnalysisPixelFormat::R16G16B16A16_Float:
+			for (size_t x = 0; x < width; x += ChunkPixels)
+			{
+				size_t count = std::min<size_t>(width - x, ChunkPixels);
+				ConvertHalf4ToFloat4(reinterpret_cast<const uint16_t*>(row) + x * 4, chunk.data(), count);
+				AccumulateRow(chunk.data(), count, accumulator, path);
+			}
+			break;
+		}
+	}
+}
+
+void MergeLuminance(const LuminanceAccumulator& from, LuminanceAccumulator& into)
+{
+	into.pixelCount += from.pixelCount;
+	into.minNits = std::min<float>(into.minNits, from.minNits);
+	into.maxNits = std::max<float>(into.maxNits, from.maxNits);
+	into.maxCLL = std::max<float>(into.maxCLL, from.maxCLL);
+	into.sumNits += from.sumNits;
+	into.sumMaxComponentNits += from.sumMaxComponentNits;
+	for (uint32_t bin = 0; bin < LuminanceHistogramBins; bin++)
+	{
+		into.histogram[bin] += from.histogram[bin];
+	}
+}
+
+void FinishLuminance(const LuminanceAccumulator& accumulator, LuminanceStatistics& statistics)
+{
+	statistics = LuminanceStatistics();
+	statistics.pixelCount = accumulator.pixelCount;
+	memcpy(statistics.histogram, accumulator.histogram, sizeof(statistics.histogram));
+	if (accumulator.pixelCount == 0)
+	{
+		return;
+	}
+
+	statistics.minNits = accumulator.minNits;
+	statistics.maxNits = accumulator.maxNits;
+	statistics.meanNits = static_cast<float>(accumulator.sumNits / accumulator.pixelCount);
+	statistics.maxCLL = accumulator.maxCLL;
+	statistics.maxFALL = static_cast<float>(accumulator.sumMaxComponentNits / accumulator.pixelCount);
+	statistics.medianNits = GetLuminancePercentile(statistics, 0.5);
+	statistics.percentile99Nits = GetLuminancePercentile(statistics, 0.99);
+	statistics.percentile999Nits = GetLuminancePercentile(statistics, 0.999);
+}
+
+void AnalyzeLuminance(const void* pixels, size_t rowPitch, uint32_t width, uint32_t height, AnalysisPixelFormat format,
+	LuminanceStatistics& statistics, LuminanceAnalysisPath path)
+{
+	// A few bands per thread balance the load; each band has its own accumulator.
+	ThreadPool& pool = ThreadPool::GetDefault();
+	uint32_t bandRows = std::max<uint32_t>(1, static_cast<uint32_t>(height / (pool.GetConcurrency() * 4)));
+	uint32_t bandCount = (height + bandRows - 1) / bandRows;
+
+	std::vector<LuminanceAccumulator> bands(bandCount);
+	pool.ParallelFor(bandCount, [&](size_t band)
+	{
+		uint32_t y = static_cast<uint32_t>(band) * bandRows;
+		uint32_t rows = std::min<uint32_t>(bandRows, height - y);
+		AccumulateLuminance(static_cast<const uint8_t*>(pixels) + y * rowPitch, rowPitch, width, rows, format, bands[band], path);
+	});
+
+	LuminanceAccumulator total;
+	for (const LuminanceAccumulator& band : bands)
+	{
+		MergeLuminance(band, total);
+	}
+	FinishLuminance(total, statistics);
+}
+
+float GetLuminancePercentile(const LuminanceStatistics& statistics, double fraction)
+{
+	if (statistics.pixelCount == 0)
+	{
+		return 0.0f;
+	}
+
+	double target = std::min<double>(std::max<double>(fraction, 0.0), 1.0) * statistics.pixelCount;
+	double below = 0.0;
+	for (uint32_t bin = 0; bin < LuminanceHistogramBins; bin++)
+	{
+		double count = static_cast<double>(statistics.histogram[bin]);
+		if (count > 0.0 && below + count >= target)
+		{
+			float lower = GetLuminanceBinNits(bin);
+			float upper = GetLuminanceBinNits(bin + 1);
+			float nits = lower + static_cast<float>((target - below) / count) * (upper - lower);
+			return std::min<float>(std::max<float>(nits, statistics.minNits), statistics.maxNits);
+		}
+		below += count;
+	}
+	return statistics.maxNits;
+}
+
+void AddContentLightLevels(const LuminanceStatistics& frame, ContentLightLevels& levels)
+{
+	levels.maxCLL = std::max<float>(levels.maxCLL, frame.maxCLL);
+	levels.maxFALL = std::max<float>(levels.maxFALL, frame.maxFALL);
+	levels.frameCount++;
+}
+
+HDR10Metadata DeriveHDR10Metadata(const ContentLightLevels& levels, float nitsScale)
+{
+	const float ST2084PeakNits = 10000.0f;
+	const float MasteringPeaks[] = { 400.0f, 600.0f, 1000.0f, 2000.0f, 4000.0f, ST2084PeakNits };
+
+	HDR10Metadata metadata;
+	metadata.maxCLL = std::min<float>(std::ceil(levels.maxCLL * nitsScale), ST2084PeakNits);
+	metadata.maxFALL = std::min<float>(std::ceil(levels.maxFALL * nitsScale), metadata.maxCLL);
+	metadata.minMasteringNits = 0.001f;
+
+	metadata.maxMasteringNits = ST2084PeakNits;
+	for (float peak : MasteringPeaks)
+	{
+		if (metadata.maxCLL <= peak)
+		{
+			metadata.maxMasteringNits = peak;
+			break;
+		}
+	}
+	return metadata;
+}
@@ -0,0 +1,142 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Luminance statistics of linear scRGB images (Rec.709 primaries, 1.0 = 80
+// nits): a log-binned luminance histogram with its range, mean and percentiles,
+// and the CTA-861.3 content light levels. Platform neutral, so that it runs
+// headless. Computed in parallel bands on the default thread pool, with SSE2 or
+// NEON within a band.
+//
+// Luminance is Rec.709 Y. MaxCLL is the largest max(R, G, B) of any pixel and
+// MaxFALL the mean of max(R, G, B) over the image. Negative components count
+// as 0, and components are clamped to the FP16 maximum.
+enum class LuminanceAnalysisPath
+{
+	Scalar = 0,
+	SIMD128,	// SSE2 on x86, NEON on ARM64; 4 pixels per iteration.
+	Best
+};
+
+// Pixel layouts the analysis reads directly.
+enum class AnalysisPixelFormat
+{
+	R32G32B32A32_Float = 0,
+	R32G32B32_Float,
+	R16G16B16A16_Float
+};
+
+const float ScRGBReferenceNits = 80.0f;
+
+// The histogram has 2^LuminanceBinsPerStopBits bins per stop (doubling) of
+// luminance between 2^LuminanceMinStop and 2^LuminanceMaxStop nits; darker
+// pixels, black included, count in the first bin and brighter ones in the last.
+// Like the curve LUTs, bins are picked by the exponent and leading mantissa bits
+// of the value, so they are even within a stop.
+const uint32_t LuminanceBinsPerStopBits = 3;
+const int LuminanceMinStop = -14;
+const int LuminanceMaxStop = 16;
+const uint32_t LuminanceHistogramBins = (LuminanceMaxStop - LuminanceMinStop) << LuminanceBinsPerStopBits;
+
+// Nits at the lower edge of a bin; bin LuminanceHistogramBins is the upper edge of the last.
+float GetLuminanceBinNits(uint32_t bin);
+
+struct LuminanceStatistics
+{
+	uint64_t pixelCount = 0;
+	float minNits = 0.0f;
+	float maxNits = 0.0f;
+	float meanNits = 0.0f;
+	float medianNits = 0.0f;
+	float percentile99Nits = 0.0f;
+	float percentile999Nits = 0.0f;	// 99.9%
+	float maxCLL = 0.0f;
+	float maxFALL = 0.0f;
+	uint64_t histogram[LuminanceHistogramBins] = {};
+};
+
+// Running sums for images that arrive in pieces, such as the bands of a
+// streamed decode or the frames of a sequence: accumulate the pieces, merge the
+// accumulators of parallel workers, then finish.
+struct LuminanceAccumulator
+{
+	uint64_t pixelCount = 0;
+	float minNits = 3.402823466e+38f;
+	float maxNits = 0.0f;
+	float maxCLL = 0.0f;
+	double sumNits = 0.0;
+	double sumMaxComponentNits = 0.0;
+	uint64_t histogram[LuminanceHistogramBins] = {};
+};
+
+LuminanceAnalysisPath GetLuminanceAnalysisPath();
+const char* GetLuminanceAnalysisPathName(LuminanceAnalysisPath path);
+
+// Adds width x height pixels to an accumulator on the calling thread; the pitch is in bytes.
+void AccumulateLuminance(const void* pixels, size_t rowPitch, uint32_t width, uint32_t height, AnalysisPixelFormat format,
+	LuminanceAccumulator& accumulator, LuminanceAnalysisPath path = LuminanceAnalysisPath::Best);
+void MergeLuminance(const LuminanceAccumulator& from, LuminanceAccumulator& into);
+void FinishLuminance(const LuminanceAccumulator& accumulator, LuminanceStatistics& statistics);
+
+// A whole image, in bands of rows across the default thread pool.
+void AnalyzeLuminance(const void* pixels, size_t rowPitch, uint32_t width, uint32_t height, AnalysisPixelFormat format,
+	LuminanceStatistics& statistics, LuminanceAnalysisPath path = LuminanceAnalysisPath::Best);
+
+// The luminance below which the given fraction of the pixels falls, from the
+// histogram. Interpolated linearly within the bin, so it is accurate to about a
+// bin width (9%), and clamped to the measured range.
+float GetLuminancePercentile(const LuminanceStatistics& statistics, double fraction);
+
+// Static HDR10 metadata in nits: the SMPTE ST 2086 mastering display luminance
+// range and the CTA-861.3 content light levels.
+struct HDR10Metadata
+{
+	float maxMasteringNits = 0.0f;
+	float minMasteringNits = 0.0f;
+	float maxCLL = 0.0f;
+	float maxFALL = 0.0f;
+};
+
+// Content light levels of a sequence: MaxCLL is the brightest pixel of any
+// frame and MaxFALL the brightest frame average. A still image is a sequence of one.
+struct ContentLightLevels
+{
+	float maxCLL = 0.0f;
+	float maxFALL = 0.0f;
+	uint32_t frameCount = 0;
+};
+
+void AddContentLightLevels(const LuminanceStatistics& frame, ContentLightLevels& levels);
+
+// Metadata for content shown at nitsScale times its measured nits, as the
+// viewer does with exposure and reference white. The light levels are rounded
+// up to whole nits and capped at ST.2084's 10000. The mastering peak is the
+// smallest common mastering display peak that covers MaxCLL; the mastering
+// black cannot be measured from content and is a typical 0.001 nits.
+HDR10Metadata DeriveHDR10Metadata(const ContentLightLevels& levels, float nitsScale = 1.0f);
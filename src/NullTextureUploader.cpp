@@ -0,0 +1,74 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "NullTextureUploader.h"
+
+using namespace DirectX;
+
+NullTextureUploader::NullTextureUploader() :
+	m_uploadCount(0),
+	m_createCount(0),
+	m_uploadedRowCount(0)
+{
+}
+
+HRESULT NullTextureUploader::Upload(const TexMetadata& metadata, const ScratchImage& image, std::shared_ptr<UploadedTexture>& texture)
+{
+	texture.reset();
+	if (!image.GetImages())
+	{
+		return E_INVALIDARG;
+	}
+
+	std::shared_ptr<NullUploadedTexture> result = std::make_shared<NullUploadedTexture>();
+	result->metadata = metadata;
+	texture = result;
+
+	m_uploadCount++;
+	return S_OK;
+}
+
+HRESULT NullTextureUploader::CreateTexture(const TexMetadata& metadata, std::shared_ptr<UploadedTexture>& texture)
+{
+	std::shared_ptr<NullUploadedTexture> result = std::make_shared<NullUploadedTexture>();
+	result->metadata = metadata;
+	texture = result;
+
+	m_createCount++;
+	return S_OK;
+}
+
+HRESULT NullTextureUploader::UploadRows(const Image& rows, size_t firstRow, UploadedTexture& texture)
+{
+	const TexMetadata& metadata = static_cast<NullUploadedTexture&>(texture).metadata;
+	if (firstRow + rows.height > metadata.height || rows.width != metadata.width || rows.format != metadata.format)
+	{
+		return E_INVALIDARG;
+	}
+
+	m_uploadedRowCount += rows.height;
+	return S_OK;
+}
@@ -0,0 +1,60 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include "ImageLoader.h"
+
+#include <atomic>
+
+// What NullTextureUploader hands back: the shape of the image, no pixels.
+struct NullUploadedTexture : public UploadedTexture
+{
+	DirectX::TexMetadata metadata;
+};
+
+// An uploader without a GPU. It accepts every image and band, checks that bands
+// fit the texture like TextureUploader does, and only counts what it was given,
+// so the loader's pipeline can run headless in tests and benchmarks.
+// Thread-safe.
+class NullTextureUploader : public ITextureUploader
+{
+public:
+	NullTextureUploader();
+	virtual ~NullTextureUploader() {}
+
+	virtual HRESULT Upload(const DirectX::TexMetadata& metadata, const DirectX::ScratchImage& image, std::shared_ptr<UploadedTexture>& texture) override;
+	virtual HRESULT CreateTexture(const DirectX::TexMetadata& metadata, std::shared_ptr<UploadedTexture>& texture) override;
+	virtual HRESULT UploadRows(const DirectX::Image& rows, size_t firstRow, UploadedTexture& texture) override;
+
+	size_t GetUploadCount() const { return m_uploadCount; }
+	size_t GetCreateCount() const { return m_createCount; }
+	size_t GetUploadedRowCount() const { return m_uploadedRowCount; }	// Rows passed to UploadRows().
+
+private:
+	std::atomic<size_t> m_uploadCount;
+	std::atomic<size_t> m_createCount;
+	std::atomic<size_t> m_uploadedRowCount;
+};
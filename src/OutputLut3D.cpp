@@ -0,0 +1,311 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "OutputLut3D.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+	// The inverse of the ST.2084 curve in double precision, for the grid nodes.
+	double ST2084ToLinear(double value)
+	{
+		const double m1 = 2610.0 / 4096.0 / 4;
+		const double m2 = 2523.0 / 4096.0 * 128;
+		const double c1 = 3424.0 / 4096.0;
+		const double c2 = 2413.0 / 4096.0 * 32;
+		const double c3 = 2392.0 / 4096.0 * 32;
+		const double np = std::pow(value, 1.0 / m2);
+		return std::pow(std::max<double>(np - c1, 0.0) / (c2 - c3 * np), 1.0 / m1);
+	}
+
+	bool ReadCubeValues(std::istringstream& fields, float* values, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (!(fields >> values[i]))
+			{
+				return false;
+			}
+		}
+		std::string extra;
+		return !(fields >> extra);
+	}
+}
+
+void ApplyOutputLut3DShaper(const float scene[3], float standardNits, float shaped[3])
+{
+	const float hdrScalar = standardNits / 10000.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		const float value = std::min<float>(std::max<float>(scene[i] * hdrScalar, 0.0f), 1.0f);
+		shaped[i] = LookupOutputCurveLut(OutputCurve::ST2084, value);
+	}
+}
+
+void BakeOutputLut3D(const OutputTransformParams& params, uint32_t size, OutputLut3D& lut)
+{
+	size = std::max<uint32_t>(size, 2);
+	lut.size = size;
+	lut.data.assign(static_cast<size_t>(size) * size * size * 4, 0.0f);
+
+	// Exposure is applied before the shaper, so it is not baked in.
+	OutputTransformParams bakeParams = params;
+	bakeParams.exposure = 0.0f;
+
+	// The scene value of each node along an axis.
+	std::vector<double> nodes(size);
+	const double sceneScale = 10000.0 / params.standardNits;
+	for (uint32_t n = 0; n < size; n++)
+	{
+		nodes[n] = ST2084ToLinear(static_cast<double>(n) / (size - 1)) * sceneScale;
+	}
+
+	// Each slice writes its nodes in place and runs them through the SIMD transform.
+	ThreadPool::GetDefault().ParallelFor(size, [&](size_t blue)
+	{
+		float* slice = &lut.data[blue * size * size * 4];
+		for (uint32_t green = 0; green < size; green++)
+		{
+			for (uint32_t red = 0; red < size; red++)
+			{
+				float* entry = &slice[(static_cast<size_t>(green) * size + red) * 4];
+				entry[0] = static_cast<float>(nodes[red]);
+				entry[1] = static_cast<float>(nodes[green]);
+				entry[2] = static_cast<float>(nodes[blue]);
+				entry[3] = 1.0f;
+			}
+		}
+
+		ApplyOutputTransform(slice, slice, static_cast<size_t>(size) * size, bakeParams);
+
+		// sRGB goes to UNORM render targets, which saturate anyway. Saturating the
+		// entries as well keeps the interpolation next to white from
+		// undershooting.
+		if (params.curve == OutputCurve::sRGB)
+		{
+			for (size_t i = 0; i < static_cast<size_t>(size) * size * 4; i++)
+			{
+				slice[i] = std::min<float>(std::max<float>(slice[i], 0.0f), 1.0f);
+			}
+		}
+	});
+}
+
+bool ParseCubeFile(const std::string& text, OutputLut3D& lut, std::string& error)
+{
+	std::istringstream stream(text);
+	std::string line;
+	uint32_t size = 0;
+	std::vector<float> data;
+	size_t lineNumber = 0;
+
+	while (std::getline(stream, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream fields(line);
+		std::string keyword;
+		if (!(fields >> keyword))
+		{
+			continue;
+		}
+
+		const std::string where = "Line " + std::to_string(lineNumber) + ": ";
+		const char first = keyword[0];
+		if (std::isdigit(static_cast<unsigned char>(first)) || first == '-' || first == '+' || first == '.')
+		{
+			if (size == 0)
+			{
+				error = where + "LUT data before LUT_3D_SIZE";
+				return false;
+			}
+
+			float rgb[3];
+			std::istringstream values(line);
+			if (!ReadCubeValues(values, rgb, 3))
+			{
+				error = where + "expected three values";
+				return false;
+			}
+			if (data.size() >= static_cast<size_t>(size) * size * size * 4)
+			{
+				error = where + "more entries than LUT_3D_SIZE^3";
+				return false;
+			}
+			data.insert(data.end(), { rgb[0], rgb[1], rgb[2], 1.0f });
+		}
+		else if (keyword == "TITLE")
+		{
+			continue;
+		}
+		else if (keyword == "LUT_3D_SIZE")
+		{
+			if (!(fields >> size) || size < 2 || size > 256)
+			{
+				error = where + "LUT_3D_SIZE must be 2 to 256";
+				return false;
+			}
+			data.reserve(static_cast<size_t>(size) * size * size * 4);
+		}
+		else if (keyword == "LUT_1D_SIZE" || keyword == "LUT_1D_INPUT_RANGE")
+		{
+			error = where + "1D LUTs are not supported";
+			return false;
+		}
+		else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX" || keyword == "LUT_3D_INPUT_RANGE")
+		{
+			// Only the default domain maps onto the shaper.
+			float values[3];
+			const bool range = (keyword == "LUT_3D_INPUT_RANGE");
+			const float expected = (keyword == "DOMAIN_MIN") ? 0.0f : 1.0f;
+			if (!ReadCubeValues(fields, values, range ? 2 : 3) ||
+				(range ? (values[0] != 0.0f || values[1] != 1.0f) : (values[0] != expected || values[1] != expected || values[2] != expected)))
+			{
+				error = where + "only the 0..1 input domain is supported";
+				return false;
+			}
+		}
+		else
+		{
+			error = where + "unknown keyword " + keyword;
+			return false;
+		}
+	}
+
+	if (size == 0 || data.size() != static_cast<size_t>(size) * size * size * 4)
+	{
+		error = "Expected LUT_3D_SIZE^3 entries";
+		return false;
+	}
+
+	lut.size = size;
+	lut.data.swap(data);
+	return true;
+}
+
+void ApplyOutputLut3D(const OutputLut3D& lut, const float* src, float* dst, size_t pixelCount, float standardNits, float exposure)
+{
+	if (lut.size < 2)
+	{
+		return;
+	}
+
+	const uint32_t size = lut.size;
+	const float scale = std::pow(2.0f, exposure);
+	for (size_t pixel = 0; pixel < pixelCount; pixel++)
+	{
+		const float scene[3] = { src[pixel * 4] * scale, src[pixel * 4 + 1] * scale, src[pixel * 4 + 2] * scale };
+		float shaped[3];
+		ApplyOutputLut3DShaper(scene, standardNits, shaped);
+
+		uint32_t index[3];
+		float weight[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const float position = shaped[i] * (size - 1);
+			index[i] = std::min<uint32_t>(static_cast<uint32_t>(position), size - 2);
+			weight[i] = position - index[i];
+		}
+
+		float result[3] = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			const uint32_t red = index[0] + (corner & 1);
+			const uint32_t green = index[1] + ((corner >> 1) & 1);
+			const uint32_t blue = index[2] + ((corner >> 2) & 1);
+			const float cornerWeight =
+				((corner & 1) ? weight[0] : 1.0f - weight[0]) *
+				((corner & 2) ? weight[1] : 1.0f - weight[1]) *
+				((corner & 4) ? weight[2] : 1.0f - weight[2]);
+
+			const float* entry = &lut.data[((static_cast<size_t>(blue) * size + green) * size + red) * 4];
+			for (int i = 0; i < 3; i++)
+			{
+				result[i] += cornerWeight * entry[i];
+			}
+		}
+
+		dst[pixel * 4] = result[0];
+		dst[pixel * 4 + 1] = result[1];
+		dst[pixel * 4 + 2] = result[2];
+		dst[pixel * 4 + 3] = 1.0f;
+	}
+}
+
+double MeasureOutputLut3DError(const OutputTransformParams& params, const OutputLut3D& lut, uint32_t bits)
+{
+	// Grey and 12 hues at full and half saturation, each from 1e-4 to 10,000 nits.
+	const uint32_t colorCount = 25;
+	const uint32_t steps = 256;
+	std::vector<float> ramp(static_cast<size_t>(colorCount) * steps * 4);
+	for (uint32_t color = 0; color < colorCount; color++)
+	{
+		const float hue = static_cast<float>((color + 11) % 12) / 12.0f;
+		const float saturation = (color == 0) ? 0.0f : (color <= 12) ? 1.0f : 0.5f;
+		float rgb[3];
+		for (int i = 0; i < 3; i++)
+		{
+			rgb[i] = 1.0f - saturation + saturation * (0.5f + 0.5f * std::cos(6.2831853f * (hue - i / 3.0f)));
+		}
+
+		for (uint32_t step = 0; step < steps; step++)
+		{
+			const float nits = 1.0e-4f * std::pow(1.0e8f, static_cast<float>(step) / (steps - 1));
+			float* pixel = &ramp[(static_cast<size_t>(color) * steps + step) * 4];
+			for (int i = 0; i < 3; i++)
+			{
+				pixel[i] = rgb[i] * nits / params.standardNits;
+			}
+			pixel[3] = 1.0f;
+		}
+	}
+
+	OutputTransformParams referenceParams = params;
+	referenceParams.exposure = 0.0f;
+
+	const size_t pixelCount = static_cast<size_t>(colorCount) * steps;
+	std::vector<float> expected(ramp.size());
+	std::vector<float> actual(ramp.size());
+	ApplyOutputTransform(ramp.data(), expected.data(), pixelCount, referenceParams, OutputTransformPath::Scalar);
+	ApplyOutputLut3D(lut, ramp.data(), actual.data(), pixelCount, params.standardNits, 0.0f);
+
+	auto saturate = [](float value) { return std::min<float>(std::max<float>(value, 0.0f), 1.0f); };
+
+	double maxError = 0.0;
+	for (size_t i = 0; i < ramp.size(); i++)
+	{
+		if ((i & 3) != 3)
+		{
+			maxError = std::max<double>(maxError, std::abs(saturate(expected[i]) - saturate(actual[i])));
+		}
+	}
+	return maxError * ((1u << bits) - 1);
+}
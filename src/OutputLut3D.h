@@ -0,0 +1,71 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include "OutputTransform.h"
+
+#include <string>
+#include <vector>
+
+// A 3D LUT that stands in for the whole output transform: exposure aside, a
+// pixel costs the shaper and one trilinear fetch, whatever the LUT was baked
+// from. The shaders sample it as g_outputLut.
+//
+// The LUT is indexed by the shaper, which scales the exposed scene so that 1.0
+// is 10,000 nits with the reference white at standardNits, and encodes it with
+// the ST.2084 curve LUT. This spaces the grid perceptually from black to 10,000
+// nits. The grid keeps the Rec.709 primaries of the scene: in Rec.2020 the
+// Rec.709 outputs would be differences of large neighbouring nodes, and bright
+// saturated colors would be off by hundreds of code values. Negative components
+// (colors outside Rec.709) and values above 10,000 nits clamp to the grid.
+const uint32_t OutputLut3DDefaultSize = 65;
+
+struct OutputLut3D
+{
+	uint32_t size = 0;			// Entries along each axis; 0 when empty.
+	std::vector<float> data;	// RGBA entries, red varying fastest, then green, then blue.
+};
+
+// The shaper of one linear Rec.709 scene color. The results are in [0, 1].
+void ApplyOutputLut3DShaper(const float scene[3], float standardNits, float shaped[3]);
+
+// Bakes the transform of params, except exposure, into a size^3 LUT. The blue
+// slices are baked in parallel on the default thread pool.
+void BakeOutputLut3D(const OutputTransformParams& params, uint32_t size, OutputLut3D& lut);
+
+// Parses the text of a .cube file. The input of the LUT is the shaper signal
+// and its output is written to the render target as is. Only 3D LUTs over the
+// default 0..1 domain are accepted; on failure, error says why.
+bool ParseCubeFile(const std::string& text, OutputLut3D& lut, std::string& error);
+
+// The CPU reference of the shaders' LUT path: exposure, the shaper and
+// trilinear interpolation. Alpha is written as 1.0.
+void ApplyOutputLut3D(const OutputLut3D& lut, const float* src, float* dst, size_t pixelCount, float standardNits, float exposure);
+
+// The largest difference between the transform of params and the LUT baked from
+// it, after both are saturated, in code values of a UNORM signal of the given
+// bit depth. Measured over a ramp of hues and brightness up to 10,000 nits.
+double MeasureOutputLut3DError(const OutputTransformParams& params, const OutputLut3D& lut, uint32_t bits);
@@ -0,0 +1,712 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+#include "OutputTransform.h"
+#include "OutputTransformKernel.h"
+#include "HalfConversion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OUTPUT_TRANSFORM_X86 1
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define OUTPUT_TRANSFORM_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	//-------------------------------------------------------------------------
+	// Scalar
+	//-------------------------------------------------------------------------
+
+	float RoundToHalf(float value)
+	{
+		return ConvertHalfToFloat(ConvertFloatToHalf(value));
+	}
+
+	void TransformPixel(const float src[4], float dst[4], const OutputTransformParams& params, float scale)
+	{
+		// palettePS.hlsl, or the first half of the fused shaders.
+		float result[3] = { src[0] * scale, src[1] * scale, src[2] * scale };
+		if (params.twoPass)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				result[i] = RoundToHalf(result[i]);
+			}
+		}
+
+		// ApplyOutputTransform in outputTransform.hlsli.
+		if (params.curve == OutputCurve::sRGB)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				result[i] = params.useLut ? LookupOutputCurveLut(OutputCurve::sRGB, result[i]) : LinearToSRGB(result[i]);
+			}
+		}
+		else if (params.curve == OutputCurve::ST2084)
+		{
+			const float st2084max = 10000.0f;
+			const float hdrScalar = params.standardNits / st2084max;
+
+			// The HDR scene is in Rec.709, but the display is Rec.2020
+			float rec2020[3];
+			Rec709ToRec2020(result, rec2020);
+
+			for (int i = 0; i < 3; i++)
+			{
+				result[i] = params.useLut ? LookupOutputCurveLut(OutputCurve::ST2084, rec2020[i] * hdrScalar) : LinearToST2084(rec2020[i] * hdrScalar);
+			}
+		}
+
+		dst[0] = result[0];
+		dst[1] = result[1];
+		dst[2] = result[2];
+		dst[3] = 1.0f;
+
+		if (params.heatmap)
+		{
+			ApplyOutputTransformHeatmap(dst, 1, params);
+		}
+	}
+
+	void ApplyOutputTransformScalar(const float* src, float* dst, size_t pixelCount, const OutputTransformParams& params)
+	{
+		const float scale = std::pow(2.0f, params.exposure);
+		for (size_t i = 0; i < pixelCount; ++i, src += 4, dst += 4)
+		{
+			TransformPixel(src, dst, params, scale);
+		}
+	}
+
+#if defined(OUTPUT_TRANSFORM_X86)
+	//-------------------------------------------------------------------------
+	// SSE2
+	//-------------------------------------------------------------------------
+
+	struct SSE2Ops
+	{
+		typedef __m128 F;
+		typedef __m128i I;
+		static const size_t Width = 4;
+
+		static F Splat(float value) { return _mm_set1_ps(value); }
+		static F Add(F a, F b) { return _mm_add_ps(a, b); }
+		static F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+		static F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+		static F Div(F a, F b) { return _mm_div_ps(a, b); }
+		static F Min(F a, F b) { return _mm_min_ps(a, b); }
+		static F Max(F a, F b) { return _mm_max_ps(a, b); }
+		static F Abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		static F Less(F a, F b) { return _mm_cmplt_ps(a, b); }
+		static F Select(F mask, F a, F b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+		static I AsInt(F a) { return _mm_castps_si128(a); }
+		static F AsFloat(I a) { return _mm_castsi128_ps(a); }
+		static I SplatInt(int32_t value) { return _mm_set1_epi32(value); }
+		static I AddInt(I a, I b) { return _mm_add_epi32(a, b); }
+		static I SubInt(I a, I b) { return _mm_sub_epi32(a, b); }
+		static I AndInt(I a, I b) { return _mm_and_si128(a, b); }
+		static I OrInt(I a, I b) { return _mm_or_si128(a, b); }
+		static I ShiftRight(I a, int count) { return _mm_srli_epi32(a, count); }
+		static I ShiftLeft(I a, int count) { return _mm_slli_epi32(a, count); }
+		static F IntToFloat(I a) { return _mm_cvtepi32_ps(a); }
+		static I RoundToInt(F a) { return _mm_cvtps_epi32(a); }
+
+		static F Gather(const float* table, I index)
+		{
+			alignas(16) int32_t indices[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+			return _mm_setr_ps(table[indices[0]], table[indices[1]], table[indices[2]], table[indices[3]]);
+		}
+
+		static void Load(const float* src, F& r, F& g, F& b)
+		{
+			F p0 = _mm_loadu_ps(src);
+			F p1 = _mm_loadu_ps(src + 4);
+			F p2 = _mm_loadu_ps(src + 8);
+			F p3 = _mm_loadu_ps(src + 12);
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+			r = p0;
+			g = p1;
+			b = p2;
+		}
+
+		static void Store(float* dst, F r, F g, F b)
+		{
+			F a = _mm_set1_ps(1.0f);
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			_mm_storeu_ps(dst, r);
+			_mm_storeu_ps(dst + 4, g);
+			_mm_storeu_ps(dst + 8, b);
+			_mm_storeu_ps(dst + 12, a);
+		}
+	};
+
+	void CpuId(int info[4], int leaf)
+	{
+#if defined(_MSC_VER)
+		__cpuidex(info, leaf, 0);
+#else
+		__cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+#endif
+	}
+
+	bool IsAVX2Supported()
+	{
+		int info[4];
+		CpuId(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		CpuId(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!fma || !osxsave || !avx)
+		{
+			return false;
+		}
+
+		CpuId(info, 7);
+		if ((info[1] & (1 << 5)) == 0)
+		{
+			return false;
+		}
+
+		// The OS must save the YMM registers on context switches.
+#if defined(_MSC_VER)
+		unsigned long long xcr0 = _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		unsigned long long xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+		return (xcr0 & 0x6) == 0x6;
+	}
+#elif defined(OUTPUT_TRANSFORM_NEON)
+	//-------------------------------------------------------------------------
+	// NEON
+	//-------------------------------------------------------------------------
+
+	struct NEONOps
+	{
+		typedef float32x4_t F;
+		typedef int32x4_t I;
+		static const size_t Width = 4;
+
+		static F Splat(float value) { return vdupq_n_f32(value); }
+		static F Add(F a, F b) { return vaddq_f32(a, b); }
+		static F Sub(F a, F b) { return vsubq_f32(a, b); }
+		static F Mul(F a, F b) { return vmulq_f32(a, b); }
+		static F Div(F a, F b) { return vdivq_f32(a, b); }
+		static F Min(F a, F b) { return vminq_f32(a, b); }
+		static F Max(F a, F b) { return vmaxq_f32(a, b); }
+		static F Abs(F a) { return vabsq_f32(a); }
+		static F Less(F a, F b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+		static F Select(F mask, F a, F b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+
+		static I AsInt(F a) { return vreinterpretq_s32_f32(a); }
+		static F AsFloat(I a) { return vreinterpretq_f32_s32(a); }
+		static I SplatInt(int32_t value) { return vdupq_n_s32(value); }
+		static I AddInt(I a, I b) { return vaddq_s32(a, b); }
+		static I SubInt(I a, I b) { return vsubq_s32(a, b); }
+		static I AndInt(I a, I b) { return vandq_s32(a, b); }
+		static I OrInt(I a, I b) { return vorrq_s32(a, b); }
+		static I ShiftRight(I a, int count) { return vreinterpretq_s32_u32(vshlq_u32(vreinterpretq_u32_s32(a), vdupq_n_s32(-count))); }
+		static I ShiftLeft(I a, int count) { return vshlq_s32(a, vdupq_n_s32(count)); }
+		static F IntToFloat(I a) { return vcvtq_f32_s32(a); }
+		static I RoundToInt(F a) { return vcvtnq_s32_f32(a); }
+
+		static F Gather(const float* table, I index)
+		{
+			int32_t indices[4];
+			vst1q_s32(indices, index);
+			const float values[4] = { table[indices[0]], table[indices[1]], table[indices[2]], table[indices[3]] };
+			return vld1q_f32(values);
+		}
+
+		static void Load(const float* src, F& r, F& g, F& b)
+		{
+			float32x4x4_t pixels = vld4q_f32(src);
+			r = pixels.val[0];
+			g = pixels.val[1];
+			b = pixels.val[2];
+		}
+
+		static void Store(float* dst, F r, F g, F b)
+		{
+			float32x4x4_t pixels;
+			pixels.val[0] = r;
+			pixels.val[1] = g;
+			pixels.val[2] = b;
+			pixels.val[3] = vdupq_n_f32(1.0f);
+			vst4q_f32(dst, pixels);
+		}
+	};
+#endif
+
+	OutputTransformPath DetectPath()
+	{
+#if defined(OUTPUT_TRANSFORM_X86)
+		return (IsOutputTransformAVX2Built() && IsAVX2Supported()) ? OutputTransformPath::AVX2 : OutputTransformPath::SIMD128;
+#elif defined(OUTPUT_TRANSFORM_NEON)
+		return OutputTransformPath::SIMD128;
+#else
+		return OutputTransformPath::Scalar;
+#endif
+	}
+
+	OutputTransformPath Resolve(OutputTransformPath path)
+	{
+		static const OutputTransformPath best = DetectPath();
+		if (path == OutputTransformPath::Best)
+		{
+			return best;
+		}
+		// Never run a kernel the CPU cannot execute.
+		return (path > best) ? best : path;
+	}
+
+	inline float AsFloat(uint32_t u)
+	{
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	inline uint32_t AsUInt(float f)
+	{
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	// The analytic curves in double precision, to fill the LUTs. sRGB is the
+	// power segment only; the linear segment never goes through the LUT.
+	double EvaluateCurve(OutputCurve curve, double value)
+	{
+		if (curve == OutputCurve::sRGB)
+		{
+			return 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+		}
+
+		const double m1 = 2610.0 / 4096.0 / 4;
+		const double m2 = 2523.0 / 4096.0 * 128;
+		const double c1 = 3424.0 / 4096.0;
+		const double c2 = 2413.0 / 4096.0 * 32;
+		const double c3 = 2392.0 / 4096.0 * 32;
+		const double cp = std::pow(value, m1);
+		return std::pow((c1 + c2 * cp) / (1 + c3 * cp), m2);
+	}
+
+	// The node of entry n is the float whose bits are the range's first bits plus n
+	// segments, so an input's bits give its entry and interpolation weight directly.
+	std::vector<float> BuildOutputCurveLut()
+	{
+		std::vector<float> lut(GetOutputCurveLutSize());
+		for (OutputCurve curve : { OutputCurve::sRGB, OutputCurve::ST2084 })
+		{
+			const OutputCurveLutRange range = GetOutputCurveLutRange(curve);
+			const uint32_t minBits = static_cast<uint32_t>(127 + range.minExponent) << 23;
+			for (uint32_t n = 0; n < range.count; n++)
+			{
+				const float node = AsFloat(minBits + (n << (23 - OutputCurveLutSegmentBits)));
+				lut[range.offset + n] = static_cast<float>(EvaluateCurve(curve, node));
+			}
+		}
+		return lut;
+	}
+
+	// Point sampling with a white border, like the static sampler of the root signature.
+	void SampleHeatmap(const OutputTransformParams& params, float u, float rgb[3])
+	{
+		if (u >= 0.0f && u < 1.0f)
+		{
+			const size_t texel = std::min<size_t>(static_cast<size_t>(u * params.heatmapWidth), params.heatmapWidth - 1);
+			rgb[0] = params.heatmap[texel * 3];
+			rgb[1] = params.heatmap[texel * 3 + 1];
+			rgb[2] = params.heatmap[texel * 3 + 2];
+		}
+		else
+		{
+			rgb[0] = rgb[1] = rgb[2] = 1.0f;
+		}
+	}
+}
+
+OutputTransformPath GetOutputTransformPath()
+{
+	return Resolve(OutputTransformPath::Best);
+}
+
+const char* GetOutputTransformPathName(OutputTransformPath path)
+{
+	switch (Resolve(path))
+	{
+	case OutputTransformPath::AVX2:		return "AVX2";
+#if defined(OUTPUT_TRANSFORM_NEON)
+	case OutputTransformPath::SIMD128:	return "NEON";
+#else
+	case OutputTransformPath::SIMD128:	return "SSE2";
+#endif
+	default:							return "Scalar";
+	}
+}
+
+const char* GetOutputCurveName(OutputCurve curve)
+{
+	switch (curve)
+	{
+	case OutputCurve::sRGB:		return "sRGB";
+	case OutputCurve::ST2084:	return "ST.2084";
+	default:					return "Linear";
+	}
+}
+
+float LinearToSRGB(float value)
+{
+	// Approximately pow(color, 1.0 / 2.2)
+	return value < 0.0031308f ? 12.92f * value : 1.055f * std::pow(std::abs(value), 1.0f / 2.4f) - 0.055f;
+}
+
+float LinearToST2084(float value)
+{
+	const float m1 = 2610.0f / 4096.0f / 4;
+	const float m2 = 2523.0f / 4096.0f * 128;
+	const float c1 = 3424.0f / 4096.0f;
+	const float c2 = 2413.0f / 4096.0f * 32;
+	const float c3 = 2392.0f / 4096.0f * 32;
+	const float cp = std::pow(std::abs(value), m1);
+	return std::pow((c1 + c2 * cp) / (1 + c3 * cp), m2);
+}
+
+void Rec709ToRec2020(const float rgb[3], float result[3])
+{
+	static const float conversion[3][3] =
+	{
+		{ 0.627402f, 0.329292f, 0.043306f },
+		{ 0.069095f, 0.919544f, 0.011360f },
+		{ 0.016394f, 0.088028f, 0.895578f }
+	};
+	for (int i = 0; i < 3; i++)
+	{
+		result[i] = conversion[i][0] * rgb[0] + conversion[i][1] * rgb[1] + conversion[i][2] * rgb[2];
+	}
+}
+
+// The Y row of Rec2020ToXYZ.
+float Rec2020Luminance(const float rgb[3])
+{
+	return 0.262700230f * rgb[0] + 0.677998126f * rgb[1] + 0.0593017153f * rgb[2];
+}
+
+OutputCurveLutRange GetOutputCurveLutRange(OutputCurve curve)
+{
+	// sRGB needs the LUT from 0.0031308 up, ST.2084 down to where it is well
+	// below half a 10-bit code value. Both go one octave above 1.0, past which
+	// the UNORM render targets saturate anyway.
+	const uint32_t segments = 1 << OutputCurveLutSegmentBits;
+	switch (curve)
+	{
+	case OutputCurve::sRGB:		return { -9, 1, 0, 10 * segments + 1 };
+	case OutputCurve::ST2084:	return { -36, 1, 10 * segments + 1, 37 * segments + 1 };
+	default:					return { 0, 0, 0, 0 };
+	}
+}
+
+const float* GetOutputCurveLut()
+{
+	static const std::vector<float> lut = BuildOutputCurveLut();
+	return lut.data();
+}
+
+uint32_t GetOutputCurveLutSize()
+{
+	const OutputCurveLutRange range = GetOutputCurveLutRange(OutputCurve::ST2084);
+	return range.offset + range.count;
+}
+
+float LookupOutputCurveLut(OutputCurve curve, float value)
+{
+	if (curve == OutputCurve::sRGB && value < 0.0031308f)
+	{
+		return 12.92f * value;
+	}
+	if (curve != OutputCurve::sRGB && curve != OutputCurve::ST2084)
+	{
+		return value;
+	}
+
+	const OutputCurveLutRange range = GetOutputCurveLutRange(curve);
+	const uint32_t mantissaBits = 23 - OutputCurveLutSegmentBits;
+	const uint32_t minBits = static_cast<uint32_t>(127 + range.minExponent) << 23;
+	const uint32_t maxBits = (static_cast<uint32_t>(127 + range.maxExponent) << 23) - 1;
+
+	// ST.2084 takes the magnitude, like the pow(abs(color), m1) it replaces.
+	const uint32_t bits = std::min<uint32_t>(std::max<uint32_t>(AsUInt(std::abs(value)), minBits), maxBits);
+	const uint32_t index = (bits - minBits) >> mantissaBits;
+	const float t = static_cast<float>(bits & ((1 << mantissaBits) - 1)) * (1.0f / (1 << mantissaBits));
+
+	const float* lut = GetOutputCurveLut() + range.offset;
+	return lut[index] + t * (lut[index + 1] - lut[index]);
+}
+
+double MeasureOutputCurveLutError(OutputCurve curve, uint32_t bits)
+{
+	const OutputCurveLutRange range = GetOutputCurveLutRange(curve);
+	if (range.count == 0)
+	{
+		return 0.0;
+	}
+
+	auto saturate = [](double value) { return std::min<double>(std::max<double>(value, 0.0), 1.0); };
+
+	// 64 samples per segment, from 4 octaves below the range to its top.
+	const uint32_t samplesPerOctave = 64 << OutputCurveLutSegmentBits;
+	double maxError = 0.0;
+	for (int exponent = range.minExponent - 4; exponent < range.maxExponent; exponent++)
+	{
+		for (uint32_t n = 0; n < samplesPerOctave; n++)
+		{
+			const float value = std::ldexp(1.0f + static_cast<float>(n) / samplesPerOctave, exponent);
+			const double analytic = (curve == OutputCurve::sRGB) ? LinearToSRGB(value) : LinearToST2084(value);
+			const double error = std::abs(saturate(LookupOutputCurveLut(curve, value)) - saturate(analytic));
+			maxError = std::max<double>(maxError, error);
+		}
+	}
+	return maxError * ((1u << bits) - 1);
+}
+
+void ApplyOutputTransformPixel(const float src[4], float dst[4], const OutputTransformParams& params)
+{
+	TransformPixel(src, dst, params, std::pow(2.0f, params.exposure));
+}
+
+void PrepareOutputTransformBlock(const float* src, float* block, size_t pixelCount, size_t blockWidth, const OutputTransformParams& params)
+{
+	const float scale = std::pow(2.0f, params.exposure);
+	for (size_t i = 0; i < pixelCount * 4; i++)
+	{
+		block[i] = params.twoPass ? RoundToHalf(src[i] * scale) : src[i] * scale;
+	}
+	for (size_t i = pixelCount * 4; i < blockWidth * 4; i++)
+	{
+		block[i] = 0.0f;
+	}
+}
+
+void ApplyOutputTransformHeatmap(float* pixels, size_t pixelCount, const OutputTransformParams& params)
+{
+	for (size_t i = 0; i < pixelCount; i++, pixels += 4)
+	{
+		SampleHeatmap(params, Rec2020Luminance(pixels), pixels);
+	}
+}
+
+void ApplyOutputTransform(const float* src, float* dst, size_t pixelCount, const OutputTransformParams& params, OutputTransformPath path)
+{
+	OutputTransformKernelParams kernelParams;
+	kernelParams.curve = params.curve;
+	kernelParams.scale = std::pow(2.0f, params.exposure);
+	kernelParams.hdrScalar = params.standardNits / 10000.0f;
+	kernelParams.lut = nullptr;
+	kernelParams.lutMinExponent = 0;
+	kernelParams.lutMaxExponent = 0;
+	kernelParams.params = &params;
+
+	const OutputCurveLutRange range = GetOutputCurveLutRange(params.curve);
+	if (params.useLut && range.count > 0)
+	{
+		kernelParams.lut = GetOutputCurveLut() + range.offset;
+		kernelParams.lutMinExponent = range.minExponent;
+		kernelParams.lutMaxExponent = range.maxExponent;
+	}
+
+	switch (Resolve(path))
+	{
+#if defined(OUTPUT_TRANSFORM_X86)
+	case OutputTransformPath::AVX2:
+		ApplyOutputTransformAVX2(src, dst, pixelCount, kernelParams);
+		break;
+
+	case OutputTransformPath::SIMD128:
+		OutputTransformKernel::ApplyOutputTransform<SSE2Ops>(src, dst, pixelCount, kernelParams);
+		break;
+#elif defined(OUTPUT_TRANSFORM_NEON)
+	case OutputTransformPath::SIMD128:
+		OutputTransformKernel::ApplyOutputTransform<NEONOps>(src, dst, pixelCount, kernelParams);
+		break;
+#endif
+
+	default:
+		ApplyOutputTransformScalar(src, dst, pixelCount, params);
+		break;
+	}
+}
+
+void ApplyOutputTransform(const float* src, size_t srcRowPitch, float* dst, size_t dstRowPitch, uint32_t width, uint32_t height,
+	const OutputTransformParams& params, OutputTransformPath path)
+{
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const float* srcRow = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(src) + y * srcRowPitch);
+		float* dstRow = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(dst) + y * dstRowPitch);
+		ApplyOutputTransform(srcRow, dstRow, width, params, path);
+	}
+}
+
+size_t GetOutputFormatPixelSize(OutputFormat format)
+{
+	return (format == OutputFormat::R16G16B16A16_Float) ? 8 : 4;
+}
+
+void EncodeOutput(const float* src, void* dst, size_t pixelCount, OutputFormat format)
+{
+	if (format == OutputFormat::R16G16B16A16_Float)
+	{
+		ConvertFloat4ToHalf4(src, static_cast<uint16_t*>(dst), pixelCount);
+		return;
+	}
+
+	const bool tenBit = (format == OutputFormat::R10G10B10A2_UNorm);
+	const float colorMax = tenBit ? 1023.0f : 255.0f;
+	const float alphaMax = tenBit ? 3.0f : 255.0f;
+	const uint32_t colorShift = tenBit ? 10 : 8;
+
+	// Saturate, NaN to zero, then round to nearest.
+	auto quantize = [](float value, float max)
+	{
+		value = (value > 0.0f) ? std::min<float>(value, 1.0f) : 0.0f;
+		return static_cast<uint32_t>(value * max + 0.5f);
+	};
+
+	uint32_t* packed = static_cast<uint32_t*>(dst);
+	for (size_t i = 0; i < pixelCount; i++, src += 4)
+	{
+		packed[i] = quantize(src[0], colorMax)
+			| (quantize(src[1], colorMax) << colorShift)
+			| (quantize(src[2], colorMax) << (colorShift * 2))
+			| (quantize(src[3], alphaMax) << (colorShift * 3));
+	}
+}
+
+uint32_t GetMaxOutputDifference(const void* a, const void* b, size_t pixelCount, OutputFormat format)
+{
+	uint32_t maxDifference = 0;
+	if (format == OutputFormat::R16G16B16A16_Float)
+	{
+		// Map the halves to integers that are ordered like their values.
+		auto ordered = [](uint16_t half)
+		{
+			return (half & 0x8000) ? -static_cast<int32_t>(half & 0x7FFF) : static_cast<int32_t>(half);
+		};
+
+		const uint16_t* halvesA = static_cast<const uint16_t*>(a);
+		const uint16_t* halvesB = static_cast<const uint16_t*>(b);
+		for (size_t i = 0; i < pixelCount * 4; i++)
+		{
+			const int32_t difference = ordered(halvesA[i]) - ordered(halvesB[i]);
+			maxDifference = std::max<uint32_t>(maxDifference, static_cast<uint32_t>(difference < 0 ? -difference : difference));
+		}
+		return maxDifference;
+	}
+
+	const uint32_t channelBits = (format == OutputFormat::R10G10B10A2_UNorm) ? 10 : 8;
+	const uint32_t channelMask = (1u << channelBits) - 1;
+
+	const uint32_t* packedA = static_cast<const uint32_t*>(a);
+	const uint32_t* packedB = static_cast<const uint32_t*>(b);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		for (uint32_t channel = 0; channel < 4; channel++)
+		{
+			const uint32_t shift = channel * channelBits;
+			const uint32_t valueA = (packedA[i] >> shift) & channelMask;
+			const uint32_t valueB = (packedB[i] >> shift) & channelMask;
+			maxDifference = std::max<uint32_t>(maxDifference, valueA > valueB ? valueA - valueB : valueB - valueA);
+		}
+	}
+	return maxDifference;
+}
+
+double BenchmarkOutputTransform(const OutputTransformParams& params, OutputTransformPath path, uint32_t width, uint32_t height, uint32_t iterations)
+{
+	// Brightness rises from 1e-4 to 100 times reference white across each row,
+	// and the hue changes down the band. The frame is processed as repeats of
+	// the band, so 8K frames fit in memory and the source stays cache-warm the
+	// way a tiled reader would keep it.
+	const uint32_t bandHeight = std::min<uint32_t>(std::max<uint32_t>(height, 1), 64);
+	std::vector<float> band(static_cast<size_t>(width) * bandHeight * 4);
+	for (uint32_t y = 0; y < bandHeight; y++)
+	{
+		const float hue = static_cast<float>(y) / bandHeight;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const float luminance = std::pow(10.0f, -4.0f + 6.0f * x / std::max<uint32_t>(width, 1));
+			float* pixel = &band[(static_cast<size_t>(y) * width + x) * 4];
+			pixel[0] = luminance * (0.5f + 0.5f * std::cos(6.2831853f * hue));
+			pixel[1] = luminance * (0.5f + 0.5f * std::cos(6.2831853f * (hue - 1.0f / 3.0f)));
+			pixel[2] = luminance * (0.5f + 0.5f * std::cos(6.2831853f * (hue - 2.0f / 3.0f)));
+			pixel[3] = 1.0f;
+		}
+	}
+
+	std::vector<float> output(band.size());
+	auto transformFrame = [&](uint32_t rows)
+	{
+		for (uint32_t y = 0; y < rows; y += bandHeight)
+		{
+			const size_t pixelCount = static_cast<size_t>(width) * std::min<uint32_t>(bandHeight, rows - y);
+			ApplyOutputTransform(band.data(), output.data(), pixelCount, params, path);
+		}
+	};
+
+	// Warm up the caches, the dispatch and the LUT before timing.
+	GetOutputCurveLut();
+	transformFrame(bandHeight);
+
+	const auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		transformFrame(height);
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	return (seconds > 0.0) ? static_cast<double>(pixelCount) * iterations / seconds / 1.0e6 : 0.0;
+}
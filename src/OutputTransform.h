@@ -0,0 +1,149 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A CPU reference of the output transform in presentPS.hlsl and the fused pixel
+// shaders: exposure, the display curve from color.hlsli and the heatmap, for
+// whole images of linear Rec.709 RGBA floats. Platform neutral, so that it runs
+// headless and can produce golden images without a D3D12 device.
+//
+// The scalar path follows the HLSL expression by expression with std::pow.
+// The SIMD paths evaluate pow with polynomial log2/exp2 instead. Encoded for
+// any of the swap chain formats, the paths differ by at most one code value
+// (one half ULP for FP16), except where the heatmap picks a neighbouring texel.
+enum class OutputTransformPath
+{
+	Scalar = 0,
+	SIMD128,	// SSE2 on x86, NEON on ARM64; 4 pixels per iteration.
+	AVX2,		// AVX2 + FMA, 8 pixels per iteration.
+	Best		// The fastest path this CPU supports, detected once.
+};
+
+// These values match the DisplayCurve enum in D3D12HDRViewer.h.
+enum class OutputCurve
+{
+	sRGB = 0,
+	ST2084,
+	Linear,
+	Count
+};
+
+// Render target formats of the swap chain, one per SwapChainBitDepth.
+enum class OutputFormat
+{
+	R8G8B8A8_UNorm = 0,
+	R10G10B10A2_UNorm,
+	R16G16B16A16_Float
+};
+
+struct OutputTransformParams
+{
+	OutputCurve curve = OutputCurve::sRGB;
+	float standardNits = 80.0f;		// Reference white; scales the ST.2084 signal.
+	float exposure = 0.0f;			// In stops, applied as 2^exposure.
+
+	// The row of heatmap.dds the shaders sample (v = 0.05), as RGB floats.
+	// Null disables the heatmap.
+	const float* heatmap = nullptr;
+	uint32_t heatmapWidth = 0;
+
+	// Round the exposed scene to half precision first, as the FP16
+	// intermediate of the two-pass path does.
+	bool twoPass = false;
+
+	// Encode sRGB and ST.2084 through the curve LUTs instead of pow.
+	bool useLut = false;
+};
+
+// Curve LUTs, used by the LUT path here and in the shaders. A LUT covers the
+// inputs [2^minExponent, 2^maxExponent) with 2^OutputCurveLutSegmentBits even
+// segments per octave. It is indexed straight from the exponent and leading
+// mantissa bits of the input, which makes the index logarithmic without a log2,
+// and interpolated linearly within a segment. Inputs outside the range clamp to
+// it; sRGB inputs below 0.0031308 keep the linear segment of the curve.
+const uint32_t OutputCurveLutSegmentBits = 5;
+
+// Where a curve's entries are in GetOutputCurveLut(). These must match the
+// LUT_* values in outputTransform.hlsli.
+struct OutputCurveLutRange
+{
+	int minExponent;
+	int maxExponent;
+	uint32_t offset;
+	uint32_t count;
+};
+
+// Ranges of sRGB and ST.2084; the linear curve has no LUT and a count of 0.
+OutputCurveLutRange GetOutputCurveLutRange(OutputCurve curve);
+
+// Both LUTs one after the other, as uploaded for the shaders. Built on first use.
+const float* GetOutputCurveLut();
+uint32_t GetOutputCurveLutSize();
+
+// The curve through its LUT, like LinearToSRGB and LinearToST2084.
+float LookupOutputCurveLut(OutputCurve curve, float value);
+
+// The largest difference between the LUT and the analytic curve, after both are
+// saturated, in code values of a UNORM signal of the given bit depth. Sampled
+// densely across the whole range and a few octaves below it.
+double MeasureOutputCurveLutError(OutputCurve curve, uint32_t bits);
+
+OutputTransformPath GetOutputTransformPath();
+const char* GetOutputTransformPathName(OutputTransformPath path);
+const char* GetOutputCurveName(OutputCurve curve);
+
+// The color.hlsli functions the transform is made of.
+float LinearToSRGB(float value);
+float LinearToST2084(float value);
+void Rec709ToRec2020(const float rgb[3], float result[3]);
+float Rec2020Luminance(const float rgb[3]);
+
+// The reference transform of a single RGBA pixel; alpha is written as 1.0.
+void ApplyOutputTransformPixel(const float src[4], float dst[4], const OutputTransformParams& params);
+
+// Transforms pixelCount RGBA float pixels. src and dst may be the same buffer.
+void ApplyOutputTransform(const float* src, float* dst, size_t pixelCount, const OutputTransformParams& params, OutputTransformPath path = OutputTransformPath::Best);
+
+// Transforms a width x height image; the pitches are in bytes.
+void ApplyOutputTransform(const float* src, size_t srcRowPitch, float* dst, size_t dstRowPitch, uint32_t width, uint32_t height,
+	const OutputTransformParams& params, OutputTransformPath path = OutputTransformPath::Best);
+
+// Stores transformed pixels the way the render target would: UNORM formats are
+// saturated and rounded to nearest, FP16 is rounded to nearest even.
+size_t GetOutputFormatPixelSize(OutputFormat format);
+void EncodeOutput(const float* src, void* dst, size_t pixelCount, OutputFormat format);
+
+// Largest difference between two encoded images over all channels, in code
+// values for the UNORM formats and in half ULPs for FP16. For golden images.
+uint32_t GetMaxOutputDifference(const void* a, const void* b, size_t pixelCount, OutputFormat format);
+
+// Throughput of the transform over a synthetic HDR ramp, in megapixels per second.
+// The frame is processed as repeats of one band of rows, so that 4K and 8K
+// frames need no frame-sized buffers; this times the math, not memory bandwidth.
+double BenchmarkOutputTransform(const OutputTransformParams& params, OutputTransformPath path, uint32_t width, uint32_t height, uint32_t iterations);
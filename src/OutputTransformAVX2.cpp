@@ -0,0 +1,122 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+// The AVX2 output transform. This file alone is compiled with AVX2 enabled,
+// and only called once the CPU is known to support it.
+
+#include "OutputTransformKernel.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace
+{
+	struct AVX2Ops
+	{
+		typedef __m256 F;
+		typedef __m256i I;
+		static const size_t Width = 8;
+
+		static F Splat(float value) { return _mm256_set1_ps(value); }
+		static F Add(F a, F b) { return _mm256_add_ps(a, b); }
+		static F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+		static F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+		static F Div(F a, F b) { return _mm256_div_ps(a, b); }
+		static F Min(F a, F b) { return _mm256_min_ps(a, b); }
+		static F Max(F a, F b) { return _mm256_max_ps(a, b); }
+		static F Abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static F Less(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static F Select(F mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+
+		static I AsInt(F a) { return _mm256_castps_si256(a); }
+		static F AsFloat(I a) { return _mm256_castsi256_ps(a); }
+		static I SplatInt(int32_t value) { return _mm256_set1_epi32(value); }
+		static I AddInt(I a, I b) { return _mm256_add_epi32(a, b); }
+		static I SubInt(I a, I b) { return _mm256_sub_epi32(a, b); }
+		static I AndInt(I a, I b) { return _mm256_and_si256(a, b); }
+		static I OrInt(I a, I b) { return _mm256_or_si256(a, b); }
+		static I ShiftRight(I a, int count) { return _mm256_srli_epi32(a, count); }
+		static I ShiftLeft(I a, int count) { return _mm256_slli_epi32(a, count); }
+		static F IntToFloat(I a) { return _mm256_cvtepi32_ps(a); }
+		static I RoundToInt(F a) { return _mm256_cvtps_epi32(a); }
+		static F Gather(const float* table, I index) { return _mm256_i32gather_ps(table, index, 4); }
+
+		// Eight RGBA pixels, two per register, transposed within each 128-bit
+		// lane. The channels come out as pixels 0 2 4 6 1 3 5 7, which Store
+		// undoes with the same transpose.
+		static void Transpose(F& p0, F& p1, F& p2, F& p3)
+		{
+			const F t0 = _mm256_unpacklo_ps(p0, p1);
+			const F t1 = _mm256_unpackhi_ps(p0, p1);
+			const F t2 = _mm256_unpacklo_ps(p2, p3);
+			const F t3 = _mm256_unpackhi_ps(p2, p3);
+			p0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+			p1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			p2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			p3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		}
+
+		static void Load(const float* src, F& r, F& g, F& b)
+		{
+			F p0 = _mm256_loadu_ps(src);
+			F p1 = _mm256_loadu_ps(src + 8);
+			F p2 = _mm256_loadu_ps(src + 16);
+			F p3 = _mm256_loadu_ps(src + 24);
+			Transpose(p0, p1, p2, p3);
+			r = p0;
+			g = p1;
+			b = p2;
+		}
+
+		static void Store(float* dst, F r, F g, F b)
+		{
+			F a = _mm256_set1_ps(1.0f);
+			Transpose(r, g, b, a);
+			_mm256_storeu_ps(dst, r);
+			_mm256_storeu_ps(dst + 8, g);
+			_mm256_storeu_ps(dst + 16, b);
+			_mm256_storeu_ps(dst + 24, a);
+		}
+	};
+}
+
+bool IsOutputTransformAVX2Built()
+{
+	return true;
+}
+
+void ApplyOutputTransformAVX2(const float* src, float* dst, size_t pixelCount, const OutputTransformKernelParams& kernelParams)
+{
+	OutputTransformKernel::ApplyOutputTransform<AVX2Ops>(src, dst, pixelCount, kernelParams);
+}
+#else
+bool IsOutputTransformAVX2Built()
+{
+	return false;
+}
+
+void ApplyOutputTransformAVX2(const float*, float*, size_t, const OutputTransformKernelParams&)
+{
+}
+#endif
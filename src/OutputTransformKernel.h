@@ -0,0 +1,283 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include "OutputTransform.h"
+
+// Internal to OutputTransform.cpp and OutputTransformAVX2.cpp.
+//
+// The SIMD output transform is written once against a few vector operations
+// (the Ops template argument) and instantiated for each instruction set. The
+// templates are in an unnamed namespace so that every translation unit keeps
+// the copy built with its own compiler flags.
+
+// What the kernels need, resolved from OutputTransformParams.
+struct OutputTransformKernelParams
+{
+	OutputCurve curve;
+	float scale;		// 2^exposure; 1 when the block was prepared.
+	float hdrScalar;	// standardNits / 10000.
+	const float* lut;	// The curve's LUT on the LUT path, otherwise null.
+	int lutMinExponent;
+	int lutMaxExponent;
+	const OutputTransformParams* params;
+};
+
+// Scalar helpers of the kernels, compiled without any extended instruction set.
+// Copies pixelCount pixels into a block of blockWidth, padding it with black,
+// and applies the exposure and the half rounding of the two-pass path.
+void PrepareOutputTransformBlock(const float* src, float* block, size_t pixelCount, size_t blockWidth, const OutputTransformParams& params);
+void ApplyOutputTransformHeatmap(float* pixels, size_t pixelCount, const OutputTransformParams& params);
+
+// Defined by OutputTransformAVX2.cpp, which must be compiled with AVX2 enabled
+// (/arch:AVX2, -mavx2 -mfma) for the AVX2 path to exist.
+bool IsOutputTransformAVX2Built();
+void ApplyOutputTransformAVX2(const float* src, float* dst, size_t pixelCount, const OutputTransformKernelParams& kernelParams);
+
+namespace
+{
+	namespace OutputTransformKernel
+	{
+		// ST.2084 constants, as in color.hlsli.
+		const float ST2084M1 = 2610.0f / 4096.0f / 4;
+		const float ST2084M2 = 2523.0f / 4096.0f * 128;
+		const float ST2084C1 = 3424.0f / 4096.0f;
+		const float ST2084C2 = 2413.0f / 4096.0f * 32;
+		const float ST2084C3 = 2392.0f / 4096.0f * 32;
+
+		// log2 after Cephes log2f: x = m * 2^e with m in [sqrt(1/2), sqrt(2)),
+		// and a polynomial for log(m). Only for positive normal x.
+		template <class Ops>
+		inline typename Ops::F Log2(typename Ops::F x)
+		{
+			typedef typename Ops::F F;
+			typedef typename Ops::I I;
+
+			const I bits = Ops::AsInt(x);
+			F e = Ops::IntToFloat(Ops::SubInt(Ops::ShiftRight(bits, 23), Ops::SplatInt(126)));
+			F m = Ops::AsFloat(Ops::OrInt(Ops::AndInt(bits, Ops::SplatInt(0x007FFFFF)), Ops::SplatInt(0x3F000000)));
+
+			const F small = Ops::Less(m, Ops::Splat(0.707106781186547524f));
+			e = Ops::Sub(e, Ops::Select(small, Ops::Splat(1.0f), Ops::Splat(0.0f)));
+			m = Ops::Add(m, Ops::Select(small, m, Ops::Splat(0.0f)));
+
+			const F t = Ops::Sub(m, Ops::Splat(1.0f));
+			const F z = Ops::Mul(t, t);
+
+			F p = Ops::Splat(7.0376836292e-2f);
+			p = Ops::Add(Ops::Mul(p, t), Ops::Splat(-1.1514610310e-1f));
+			p = Ops::Add(Ops::Mul(p, t), Ops::Splat(1.1676998740e-1f));
+			p = Ops::Add(Ops::Mul(p, t), Ops::Splat(-1.2420140846e-1f));
+			p = Ops::Add(Ops::Mul(p, t), Ops::Splat(1.4249322787e-1f));
+			p = Ops::Add(Ops::Mul(p, t), Ops::Splat(-1.6668057665e-1f));
+			p = Ops::Add(Ops::Mul(p, t), Ops::Splat(2.0000714765e-1f));
+			p = Ops::Add(Ops::Mul(p, t), Ops::Splat(-2.4999993993e-1f));
+			p = Ops::Add(Ops::Mul(p, t), Ops::Splat(3.3333331174e-1f));
+
+			F y = Ops::Mul(t, Ops::Mul(z, p));
+			y = Ops::Sub(y, Ops::Mul(Ops::Splat(0.5f), z));
+
+			// log2(e) is split into 1 + LOG2EA to keep the low bits.
+			const F log2ea = Ops::Splat(0.44269504088896340736f);
+			F result = Ops::Mul(y, log2ea);
+			result = Ops::Add(result, Ops::Mul(t, log2ea));
+			result = Ops::Add(result, y);
+			result = Ops::Add(result, t);
+			return Ops::Add(result, e);
+		}
+
+		// exp2 after Cephes exp2f: 2^n times a polynomial for 2^f, f in [-0.5, 0.5].
+		// The pipeline never leaves the normal range, which is all this handles.
+		template <class Ops>
+		inline typename Ops::F Exp2(typename Ops::F x)
+		{
+			typedef typename Ops::F F;
+			typedef typename Ops::I I;
+
+			x = Ops::Min(Ops::Max(x, Ops::Splat(-126.0f)), Ops::Splat(127.0f));
+			const I n = Ops::RoundToInt(x);
+			const F f = Ops::Sub(x, Ops::IntToFloat(n));
+
+			F p = Ops::Splat(1.535336188319500e-4f);
+			p = Ops::Add(Ops::Mul(p, f), Ops::Splat(1.339887440266574e-3f));
+			p = Ops::Add(Ops::Mul(p, f), Ops::Splat(9.618437357674640e-3f));
+			p = Ops::Add(Ops::Mul(p, f), Ops::Splat(5.550332471162809e-2f));
+			p = Ops::Add(Ops::Mul(p, f), Ops::Splat(2.402264791363012e-1f));
+			p = Ops::Add(Ops::Mul(p, f), Ops::Splat(6.931472028550421e-1f));
+			p = Ops::Add(Ops::Mul(p, f), Ops::Splat(1.0f));
+
+			const F scale = Ops::AsFloat(Ops::ShiftLeft(Ops::AddInt(n, Ops::SplatInt(127)), 23));
+			return Ops::Mul(p, scale);
+		}
+
+		// pow for x >= 0; zero and denormals give 0, as a GPU that flushes them does.
+		template <class Ops>
+		inline typename Ops::F Pow(typename Ops::F x, float y)
+		{
+			typedef typename Ops::F F;
+
+			const F result = Exp2<Ops>(Ops::Mul(Log2<Ops>(x), Ops::Splat(y)));
+			return Ops::Select(Ops::Less(x, Ops::Splat(1.17549435e-38f)), Ops::Splat(0.0f), result);
+		}
+
+		template <class Ops>
+		inline typename Ops::F LinearToSRGB(typename Ops::F color)
+		{
+			typedef typename Ops::F F;
+
+			const F linear = Ops::Mul(Ops::Splat(12.92f), color);
+			const F curve = Ops::Sub(Ops::Mul(Ops::Splat(1.055f), Pow<Ops>(Ops::Abs(color), 1.0f / 2.4f)), Ops::Splat(0.055f));
+			return Ops::Select(Ops::Less(color, Ops::Splat(0.0031308f)), linear, curve);
+		}
+
+		template <class Ops>
+		inline typename Ops::F LinearToST2084(typename Ops::F color)
+		{
+			typedef typename Ops::F F;
+
+			const F cp = Pow<Ops>(Ops::Abs(color), ST2084M1);
+			const F numerator = Ops::Add(Ops::Splat(ST2084C1), Ops::Mul(Ops::Splat(ST2084C2), cp));
+			const F denominator = Ops::Add(Ops::Splat(1.0f), Ops::Mul(Ops::Splat(ST2084C3), cp));
+			return Pow<Ops>(Ops::Div(numerator, denominator), ST2084M2);
+		}
+
+		// The curve LUT lookup of LookupOutputCurveLut in OutputTransform.cpp.
+		template <class Ops>
+		inline typename Ops::F LookupLut(typename Ops::F value, const OutputTransformKernelParams& kernelParams)
+		{
+			typedef typename Ops::F F;
+			typedef typename Ops::I I;
+
+			const int mantissaBits = 23 - OutputCurveLutSegmentBits;
+			const int minBits = (127 + kernelParams.lutMinExponent) << 23;
+			const int maxBits = ((127 + kernelParams.lutMaxExponent) << 23) - 1;
+
+			value = Ops::Min(Ops::Max(value, Ops::AsFloat(Ops::SplatInt(minBits))), Ops::AsFloat(Ops::SplatInt(maxBits)));
+
+			const I bits = Ops::AsInt(value);
+			const I index = Ops::ShiftRight(Ops::SubInt(bits, Ops::SplatInt(minBits)), mantissaBits);
+			const F t = Ops::Mul(Ops::IntToFloat(Ops::AndInt(bits, Ops::SplatInt((1 << mantissaBits) - 1))), Ops::Splat(1.0f / (1 << mantissaBits)));
+
+			const F a = Ops::Gather(kernelParams.lut, index);
+			const F b = Ops::Gather(kernelParams.lut + 1, index);
+			return Ops::Add(a, Ops::Mul(t, Ops::Sub(b, a)));
+		}
+
+		template <class Ops>
+		inline typename Ops::F LinearToSRGBLut(typename Ops::F color, const OutputTransformKernelParams& kernelParams)
+		{
+			const typename Ops::F linear = Ops::Mul(Ops::Splat(12.92f), color);
+			return Ops::Select(Ops::Less(color, Ops::Splat(0.0031308f)), linear, LookupLut<Ops>(color, kernelParams));
+		}
+
+		template <class Ops>
+		inline void TransformVector(typename Ops::F& r, typename Ops::F& g, typename Ops::F& b, const OutputTransformKernelParams& kernelParams)
+		{
+			typedef typename Ops::F F;
+
+			const F scale = Ops::Splat(kernelParams.scale);
+			r = Ops::Mul(r, scale);
+			g = Ops::Mul(g, scale);
+			b = Ops::Mul(b, scale);
+
+			if (kernelParams.curve == OutputCurve::sRGB && kernelParams.lut)
+			{
+				r = LinearToSRGBLut<Ops>(r, kernelParams);
+				g = LinearToSRGBLut<Ops>(g, kernelParams);
+				b = LinearToSRGBLut<Ops>(b, kernelParams);
+			}
+			else if (kernelParams.curve == OutputCurve::sRGB)
+			{
+				r = LinearToSRGB<Ops>(r);
+				g = LinearToSRGB<Ops>(g);
+				b = LinearToSRGB<Ops>(b);
+			}
+			else if (kernelParams.curve == OutputCurve::ST2084)
+			{
+				// The scene is in Rec.709, but the display is Rec.2020.
+				const F r2020 = Ops::Add(Ops::Add(Ops::Mul(Ops::Splat(0.627402f), r), Ops::Mul(Ops::Splat(0.329292f), g)), Ops::Mul(Ops::Splat(0.043306f), b));
+				const F g2020 = Ops::Add(Ops::Add(Ops::Mul(Ops::Splat(0.069095f), r), Ops::Mul(Ops::Splat(0.919544f), g)), Ops::Mul(Ops::Splat(0.011360f), b));
+				const F b2020 = Ops::Add(Ops::Add(Ops::Mul(Ops::Splat(0.016394f), r), Ops::Mul(Ops::Splat(0.088028f), g)), Ops::Mul(Ops::Splat(0.895578f), b));
+
+				const F hdrScalar = Ops::Splat(kernelParams.hdrScalar);
+				if (kernelParams.lut)
+				{
+					r = LookupLut<Ops>(Ops::Abs(Ops::Mul(r2020, hdrScalar)), kernelParams);
+					g = LookupLut<Ops>(Ops::Abs(Ops::Mul(g2020, hdrScalar)), kernelParams);
+					b = LookupLut<Ops>(Ops::Abs(Ops::Mul(b2020, hdrScalar)), kernelParams);
+				}
+				else
+				{
+					r = LinearToST2084<Ops>(Ops::Mul(r2020, hdrScalar));
+					g = LinearToST2084<Ops>(Ops::Mul(g2020, hdrScalar));
+					b = LinearToST2084<Ops>(Ops::Mul(b2020, hdrScalar));
+				}
+			}
+		}
+
+		// Transforms pixelCount RGBA pixels, Ops::Width at a time. Partial blocks
+		// and two-pass blocks go through a staging block prepared by scalar code.
+		template <class Ops>
+		void ApplyOutputTransform(const float* src, float* dst, size_t pixelCount, const OutputTransformKernelParams& kernelParams)
+		{
+			typedef typename Ops::F F;
+
+			const OutputTransformParams& params = *kernelParams.params;
+			OutputTransformKernelParams preparedParams = kernelParams;
+			preparedParams.scale = 1.0f;
+
+			float block[4 * Ops::Width];
+			for (size_t i = 0; i < pixelCount; i += Ops::Width, src += 4 * Ops::Width, dst += 4 * Ops::Width)
+			{
+				const size_t count = (pixelCount - i < Ops::Width) ? pixelCount - i : Ops::Width;
+
+				F r, g, b;
+				if (count == Ops::Width && !params.twoPass)
+				{
+					Ops::Load(src, r, g, b);
+					TransformVector<Ops>(r, g, b, kernelParams);
+					Ops::Store(dst, r, g, b);
+				}
+				else
+				{
+					PrepareOutputTransformBlock(src, block, count, Ops::Width, params);
+					Ops::Load(block, r, g, b);
+					TransformVector<Ops>(r, g, b, preparedParams);
+					Ops::Store(block, r, g, b);
+					for (size_t n = 0; n < 4 * count; n++)
+					{
+						dst[n] = block[n];
+					}
+				}
+
+				if (params.heatmap)
+				{
+					ApplyOutputTransformHeatmap(dst, count, params);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,63 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "RedrawTracker.h"
+
+bool ViewState::operator==(const ViewState& other) const
+{
+	return exposure == other.exposure
+		&& referenceWhiteNits == other.referenceWhiteNits
+		&& curve == other.curve
+		&& heatmap == other.heatmap
+		&& curveLut == other.curveLut
+		&& lut3DSize == other.lut3DSize;
+}
+
+RedrawTracker::RedrawTracker() :
+	m_framesToRender(1)
+{
+}
+
+void RedrawTracker::Invalidate(uint32_t frames)
+{
+	if (frames > m_framesToRender)
+	{
+		m_framesToRender = frames;
+	}
+}
+
+bool RedrawTracker::NeedsRender(const ViewState& current) const
+{
+	return m_framesToRender > 0 || current != m_renderedState;
+}
+
+void RedrawTracker::ConsumeFrame(const ViewState& current)
+{
+	if (m_framesToRender > 0)
+	{
+		m_framesToRender--;
+	}
+	m_renderedState = current;
+}
@@ -0,0 +1,84 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <cstdint>
+
+// What a frame of the viewer is rendered from, besides the image itself. A
+// view whose state differs from the one its last frame started from is redrawn,
+// whatever changed it.
+struct ViewState
+{
+	float exposure = 0.0f;			// In stops.
+	float referenceWhiteNits = 80.0f;
+	uint32_t curve = 0;				// DisplayCurve.
+	bool heatmap = false;
+	bool curveLut = false;
+	uint32_t lut3DSize = 0;			// 0 when no 3D LUT is applied.
+
+	bool operator==(const ViewState& other) const;
+	bool operator!=(const ViewState& other) const { return !(*this == other); }
+};
+
+// Decides when the view has to be redrawn, so that the main loop renders only
+// while something on screen changes and otherwise sleeps. The application
+// reports events; the loop asks NeedsRender() and calls ConsumeFrame() for each
+// frame it renders. No window or device dependency. Render thread only.
+class RedrawTracker
+{
+public:
+	// ImGui shows the effect of input one frame late, so input and window
+	// changes ask for this many frames.
+	static const uint32_t InputFrameCount = 2;
+
+	RedrawTracker();
+
+	// Keyboard, mouse and focus messages.
+	void OnInput()              { Invalidate(InputFrameCount); }
+	// The window was resized or moved, or the display changed.
+	void OnWindowChanged()      { Invalidate(InputFrameCount); }
+	// A texture, or more bands of one, became visible.
+	void OnImagePublished()     { Invalidate(); }
+	// The UI shows something new without any input, such as statistics that
+	// arrived from the GPU.
+	void OnUIChanged()          { Invalidate(); }
+
+	// Asks for at least frames more frames.
+	void Invalidate(uint32_t frames = 1);
+
+	// Whether a frame is owed, or the view has changed since the last frame
+	// started. The first frame is always owed.
+	bool NeedsRender(const ViewState& current) const;
+
+	// Takes one frame off the owed frames; current is what it starts from.
+	void ConsumeFrame(const ViewState& current);
+
+	uint32_t GetFramesToRender() const { return m_framesToRender; }
+
+private:
+	ViewState m_renderedState;
+	uint32_t m_framesToRender;
+};
@@ -0,0 +1,133 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "RingAllocator.h"
+
+#include <cassert>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+RingAllocator::RingAllocator(uint64_t capacity) :
+	m_capacity(capacity),
+	m_head(0),
+	m_tail(0),
+	m_usedBytes(0),
+	m_nextId(0)
+{
+}
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& id)
+{
+	if (size == 0 || size > m_capacity || alignment == 0 || (alignment & (alignment - 1)) != 0)
+	{
+		return InvalidOffset;
+	}
+
+	// An empty ring starts over at the beginning, so anything up to the capacity fits.
+	if (m_allocations.empty())
+	{
+		m_head = m_tail = 0;
+	}
+
+	uint64_t offset = AlignUp(m_head, alignment);
+	uint64_t end = offset + size;
+	if (m_allocations.empty() || m_head > m_tail)
+	{
+		// Free space is [head, capacity) followed by [0, tail).
+		if (end > m_capacity)
+		{
+			offset = 0;
+			end = size;
+			if (!m_allocations.empty() && end > m_tail)
+			{
+				return InvalidOffset;
+			}
+		}
+	}
+	else if (end > m_tail)
+	{
+		// Free space is [head, tail), which is empty when the ring is full.
+		return InvalidOffset;
+	}
+
+	// Padding and a skipped end of the ring belong to this allocation, so they
+	// are freed together with it.
+	const uint64_t bytes = (offset >= m_head) ? end - m_head : (m_capacity - m_head) + end;
+
+	Allocation allocation = { m_nextId++, bytes, 0 };
+	m_allocations.push_back(allocation);
+	m_usedBytes += bytes;
+	m_head = (end == m_capacity) ? 0 : end;
+
+	id = allocation.id;
+	return offset;
+}
+
+void RingAllocator::Retire(uint64_t id, uint64_t fenceValue)
+{
+	assert(fenceValue > 0);
+	if (m_allocations.empty() || id < m_allocations.front().id)
+	{
+		return;
+	}
+
+	const uint64_t index = id - m_allocations.front().id;
+	if (index < m_allocations.size())
+	{
+		m_allocations[static_cast<size_t>(index)].fenceValue = fenceValue;
+	}
+}
+
+void RingAllocator::Reclaim(uint64_t completedFenceValue)
+{
+	while (!m_allocations.empty())
+	{
+		const Allocation& oldest = m_allocations.front();
+		if (oldest.fenceValue == 0 || oldest.fenceValue > completedFenceValue)
+		{
+			break;
+		}
+
+		m_tail = (m_tail + oldest.bytes) % m_capacity;
+		m_usedBytes -= oldest.bytes;
+		m_allocations.pop_front();
+	}
+
+	if (m_allocations.empty())
+	{
+		m_head = m_tail = 0;
+	}
+}
+
+uint64_t RingAllocator::GetOldestFenceValue() const
+{
+	return m_allocations.empty() ? 0 : m_allocations.front().fenceValue;
+}
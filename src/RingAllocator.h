@@ -0,0 +1,76 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Hands out ranges of a fixed-size ring in allocation order and takes them back
+// once the GPU work that reads them has finished, as reported by a fence value.
+// It only does the bookkeeping, so it has no D3D12 dependency; UploadRing puts a
+// mapped upload buffer and a fence behind it. Not thread-safe.
+class RingAllocator
+{
+public:
+	static const uint64_t InvalidOffset = ~0ull;
+
+	explicit RingAllocator(uint64_t capacity);
+
+	// Returns the offset of size bytes at the given power-of-two alignment, or
+	// InvalidOffset when no contiguous free range is large enough right now.
+	// id identifies the allocation for Retire().
+	uint64_t Allocate(uint64_t size, uint64_t alignment, uint64_t& id);
+
+	// The range can be reused once the fence reaches fenceValue (> 0).
+	void Retire(uint64_t id, uint64_t fenceValue);
+
+	// Frees retired allocations, oldest first, whose fence value has been
+	// reached. Stops at the first one that is still in use or not retired.
+	void Reclaim(uint64_t completedFenceValue);
+
+	// Fence value that frees the oldest allocation; 0 when there is none or it
+	// has not been retired yet.
+	uint64_t GetOldestFenceValue() const;
+
+	uint64_t GetCapacity() const { return m_capacity; }
+	uint64_t GetUsedBytes() const { return m_usedBytes; }
+	size_t GetAllocationCount() const { return m_allocations.size(); }
+
+private:
+	struct Allocation
+	{
+		uint64_t id;
+		uint64_t bytes;			// Including alignment padding and the skipped end of the ring.
+		uint64_t fenceValue;	// 0 until retired.
+	};
+
+	std::deque<Allocation> m_allocations;	// Front is the oldest, and starts at m_tail.
+	uint64_t m_capacity;
+	uint64_t m_head;	// Where the next allocation starts looking.
+	uint64_t m_tail;
+	uint64_t m_usedBytes;
+	uint64_t m_nextId;
+};
@@ -0,0 +1,140 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "TexturePool.h"
+#include "DXSampleHelper.h"
+
+TexturePool::TexturePool(ID3D12Device* device, ID3D12Fence* fence, size_t budgetBytes) :
+	m_device(device),
+	m_fence(fence),
+	m_budgetBytes(budgetBytes),
+	m_idleBytes(0),
+	m_hits(0),
+	m_misses(0),
+	m_evictions(0)
+{
+}
+
+HRESULT TexturePool::Acquire(const D3D12_RESOURCE_DESC& desc, ComPtr<ID3D12Resource>& resource)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		const UINT64 completedValue = m_fence->GetCompletedValue();
+		for (auto it = m_idle.begin(); it != m_idle.end(); ++it)
+		{
+			if (IsSameShape(it->desc, desc) && it->fenceValue <= completedValue)
+			{
+				resource = it->resource;
+				m_idleBytes -= it->bytes;
+				m_idle.erase(it);
+				m_hits++;
+				return S_OK;
+			}
+		}
+		m_misses++;
+	}
+
+	HRESULT hr = m_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(resource.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	NAME_D3D12_OBJECT(resource);
+
+	return S_OK;
+}
+
+void TexturePool::Release(ComPtr<ID3D12Resource> resource, UINT64 fenceValue)
+{
+	Entry entry;
+	entry.desc = resource->GetDesc();
+	entry.bytes = static_cast<size_t>(m_device->GetResourceAllocationInfo(0, 1, &entry.desc).SizeInBytes);
+	entry.fenceValue = fenceValue;
+	entry.resource = std::move(resource);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (entry.bytes > m_budgetBytes)
+	{
+		m_evictions++;
+		return;
+	}
+
+	m_idleBytes += entry.bytes;
+	m_idle.push_front(std::move(entry));
+	EvictToBudget();
+}
+
+void TexturePool::SetBudget(size_t budgetBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budgetBytes = budgetBytes;
+	EvictToBudget();
+}
+
+TexturePoolStats TexturePool::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	TexturePoolStats stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.evictions = m_evictions;
+	stats.entryCount = m_idle.size();
+	stats.idleBytes = m_idleBytes;
+	stats.budgetBytes = m_budgetBytes;
+	return stats;
+}
+
+bool TexturePool::IsSameShape(const D3D12_RESOURCE_DESC& a, const D3D12_RESOURCE_DESC& b)
+{
+	return a.Dimension == b.Dimension
+		&& a.Width == b.Width
+		&& a.Height == b.Height
+		&& a.DepthOrArraySize == b.DepthOrArraySize
+		&& a.MipLevels == b.MipLevels
+		&& a.Format == b.Format
+		&& a.SampleDesc.Count == b.SampleDesc.Count
+		&& a.Flags == b.Flags;
+}
+
+// Drops the least recently released textures first.
+void TexturePool::EvictToBudget()
+{
+	while (m_idleBytes > m_budgetBytes && !m_idle.empty())
+	{
+		m_idleBytes -= m_idle.back().bytes;
+		m_idle.pop_back();
+		m_evictions++;
+	}
+}
@@ -0,0 +1,93 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+using Microsoft::WRL::ComPtr;
+
+struct TexturePoolStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	size_t entryCount = 0;
+	size_t idleBytes = 0;
+	size_t budgetBytes = 0;
+};
+
+// Recycles default-heap textures between loads. A texture that is let go is
+// kept idle, up to a byte budget, and handed out again for the next texture
+// with the same width, height, format, mip count, array size and flags, so
+// flipping through frames of the same shape does no GPU allocation at all.
+//
+// The pool only knows about the copies into a texture, through its fence;
+// anything that samples a texture must hold on to it until the GPU is done.
+// Recycled textures keep the previous contents. Thread-safe.
+class TexturePool
+{
+public:
+	TexturePool(ID3D12Device* device, ID3D12Fence* fence, size_t budgetBytes);
+
+	TexturePool(const TexturePool&) = delete;
+	TexturePool& operator=(const TexturePool&) = delete;
+
+	// Returns an idle texture matching desc whose copies have executed, or
+	// creates one. Either way it is in the common state.
+	HRESULT Acquire(const D3D12_RESOURCE_DESC& desc, ComPtr<ID3D12Resource>& resource);
+
+	// Takes a texture back once its last copy, fenceValue on the pool's fence,
+	// has been submitted. Textures larger than the whole budget are released.
+	void Release(ComPtr<ID3D12Resource> resource, UINT64 fenceValue);
+
+	void SetBudget(size_t budgetBytes);
+	TexturePoolStats GetStats();
+
+private:
+	struct Entry
+	{
+		ComPtr<ID3D12Resource> resource;
+		D3D12_RESOURCE_DESC desc;
+		size_t bytes;
+		UINT64 fenceValue;
+	};
+
+	static bool IsSameShape(const D3D12_RESOURCE_DESC& a, const D3D12_RESOURCE_DESC& b);
+	void EvictToBudget();
+
+	ComPtr<ID3D12Device> m_device;
+	ComPtr<ID3D12Fence> m_fence;
+
+	std::mutex m_mutex;
+	std::list<Entry> m_idle;	// Front is the most recently released. Only a handful of textures, so a linear search is enough.
+	size_t m_budgetBytes;
+	size_t m_idleBytes;
+	uint64_t m_hits;
+	uint64_t m_misses;
+	uint64_t m_evictions;
+};
@@ -0,0 +1,423 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "TextureUploader.h"
+#include "DXSampleHelper.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+D3D12UploadedTexture::~D3D12UploadedTexture()
+{
+	std::shared_ptr<TexturePool> texturePool = pool.lock();
+	if (texturePool && resource)
+	{
+		texturePool->Release(std::move(resource), copyFenceValue);
+	}
+}
+
+TextureUploader::TextureUploader(ID3D12Device* device, UploadRing* uploadRing, size_t texturePoolBudgetBytes) :
+	m_device(device),
+	m_uploadRing(uploadRing),
+	m_allocatorIndex(0),
+	m_fenceValue(0),
+	m_fenceEvent(nullptr)
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_copyQueue)));
+	NAME_D3D12_OBJECT(m_copyQueue);
+
+	for (UINT n = 0; n < AllocatorCount; n++)
+	{
+		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&m_commandAllocators[n])));
+		NAME_D3D12_OBJECT_INDEXED(m_commandAllocators, n);
+		m_allocatorFenceValues[n] = 0;
+	}
+
+	ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, m_commandAllocators[0].Get(), nullptr, IID_PPV_ARGS(&m_commandList)));
+	ThrowIfFailed(m_commandList->Close());
+	NAME_D3D12_OBJECT(m_commandList);
+
+	ThrowIfFailed(m_device->CreateFence(m_fenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+	m_texturePool = std::make_shared<TexturePool>(m_device.Get(), m_fence.Get(), texturePoolBudgetBytes);
+
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if (m_fenceEvent == nullptr)
+	{
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
+}
+
+TextureUploader::~TextureUploader()
+{
+	// The allocators must outlive the copies recorded into them.
+	WaitForIdle();
+	CloseHandle(m_fenceEvent);
+}
+
+// Returns as soon as the copies are submitted. The texture's fence value tells
+// the renderer what to wait for before sampling it.
+HRESULT TextureUploader::Upload(const TexMetadata& metadata, const ScratchImage& image, std::shared_ptr<UploadedTexture>& texture)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	texture.reset();
+
+	std::shared_ptr<D3D12UploadedTexture> result = std::make_shared<D3D12UploadedTexture>();
+	HRESULT hr = CreateResource(metadata, D3D12_RESOURCE_FLAG_NONE, *result);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Subresources are ordered mip-major within each array slice.
+	std::vector<Image> images;
+	for (size_t item = 0; item < metadata.arraySize; item++)
+	{
+		for (size_t level = 0; level < metadata.mipLevels; level++)
+		{
+			images.push_back(*image.GetImage(level, item, 0));
+		}
+	}
+
+	hr = CopySubresources(result->resource.Get(), images.data(), images.size());
+	result->copyFenceValue = m_fenceValue;
+	KeepAlive(result->resource.Get());
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	texture = result;
+	return S_OK;
+}
+
+HRESULT TextureUploader::UploadSubresources(ID3D12Resource* resource, const Image* images, size_t imageCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	HRESULT hr = CopySubresources(resource, images, imageCount);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	WaitForFence(m_fenceValue);
+	return S_OK;
+}
+
+HRESULT TextureUploader::UploadVolume(ID3D12Resource* resource, const Image* slices, size_t sliceCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	HRESULT hr = BeginCommands();
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	for (size_t i = 0; i < sliceCount && SUCCEEDED(hr); ++i)
+	{
+		hr = CopyRows(resource, 0, slices[i], 0, static_cast<UINT>(i));
+	}
+
+	HRESULT hrExecute = Execute();
+	if (FAILED(hr) || FAILED(hrExecute))
+	{
+		return FAILED(hr) ? hr : hrExecute;
+	}
+
+	WaitForFence(m_fenceValue);
+	return S_OK;
+}
+
+void TextureUploader::WaitForIdle()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	WaitForFence(m_fenceValue);
+	ReleaseCompleted();
+}
+
+// The texture allows simultaneous access, so the copy queue can write rows
+// while frames on the direct queue sample the ones already there. Rows that
+// have not been uploaded yet must show as black, so these textures are always
+// new and never go through the pool, where they would keep the previous image.
+HRESULT TextureUploader::CreateTexture(const TexMetadata& metadata, std::shared_ptr<UploadedTexture>& texture)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	texture.reset();
+
+	std::shared_ptr<D3D12UploadedTexture> result = std::make_shared<D3D12UploadedTexture>();
+	HRESULT hr = CreateResource(metadata, D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS, *result);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	texture = result;
+	return S_OK;
+}
+
+// Moves the texture's fence value on to cover the new rows.
+HRESULT TextureUploader::UploadRows(const Image& rows, size_t firstRow, UploadedTexture& texture)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	D3D12UploadedTexture& target = static_cast<D3D12UploadedTexture&>(texture);
+	ID3D12Resource* resource = target.resource.Get();
+	const D3D12_RESOURCE_DESC textureDesc = resource->GetDesc();
+	if (firstRow + rows.height > textureDesc.Height || rows.width != textureDesc.Width || rows.format != textureDesc.Format)
+	{
+		return E_INVALIDARG;
+	}
+
+	HRESULT hr = BeginCommands();
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = CopyRows(resource, 0, rows, firstRow, 0);
+
+	HRESULT hrExecute = Execute();
+	target.copyFenceValue = m_fenceValue;
+	KeepAlive(resource);
+	return FAILED(hr) ? hr : hrExecute;
+}
+
+// Fills subresources 0..imageCount-1 of a texture in the common or copy-dest
+// state. The copy queue leaves it in the common state.
+HRESULT TextureUploader::CopySubresources(ID3D12Resource* resource, const Image* images, size_t imageCount)
+{
+	HRESULT hr = BeginCommands();
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	for (size_t i = 0; i < imageCount && SUCCEEDED(hr); ++i)
+	{
+		hr = CopyRows(resource, static_cast<UINT>(i), images[i], 0, 0);
+	}
+
+	// Partly recorded copies still run, so that their ring space comes back.
+	HRESULT hrExecute = Execute();
+	return FAILED(hr) ? hr : hrExecute;
+}
+
+// Records copies of all rows of image into a subresource, starting at destRow
+// of depth slice destSlice.
+// The rows go through the upload ring in chunks of at most half of it. When the
+// ring is full, the commands so far are submitted so their space can be
+// recycled, and recording continues in a fresh list.
+HRESULT TextureUploader::CopyRows(ID3D12Resource* resource, UINT subresource, const Image& image, size_t destRow, UINT destSlice)
+{
+	// Block-compressed formats are copied in rows of 4x4 blocks.
+	const size_t blockSize = IsCompressed(image.format) ? 4 : 1;
+	const UINT64 uploadPitch = (image.rowPitch + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~static_cast<UINT64>(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+	const size_t chunkRows = static_cast<size_t>(std::max<UINT64>(1, (m_uploadRing->GetSize() / 2) / uploadPitch));
+
+	const size_t endRow = (image.height + blockSize - 1) / blockSize;
+	for (size_t row = 0; row < endRow;)
+	{
+		const size_t rows = std::min<size_t>(chunkRows, endRow - row);
+
+		UploadAllocation allocation;
+		if (!m_uploadRing->TryAllocate(rows * uploadPitch, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation))
+		{
+			HRESULT hr = Execute();
+			if (SUCCEEDED(hr))
+			{
+				hr = BeginCommands();
+			}
+			if (SUCCEEDED(hr))
+			{
+				hr = m_uploadRing->Allocate(rows * uploadPitch, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation);
+			}
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+		}
+		m_allocations.push_back(allocation);
+
+		for (size_t i = 0; i < rows; ++i)
+		{
+			memcpy(allocation.cpuAddress + i * uploadPitch, image.pixels + (row + i) * image.rowPitch, image.rowPitch);
+		}
+
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+		footprint.Offset = allocation.offset;
+		footprint.Footprint.Format = image.format;
+		footprint.Footprint.Width = static_cast<UINT>(image.width);
+		footprint.Footprint.Height = static_cast<UINT>(std::min<size_t>(rows * blockSize, image.height - row * blockSize));
+		footprint.Footprint.Depth = 1;
+		footprint.Footprint.RowPitch = static_cast<UINT>(uploadPitch);
+
+		CD3DX12_TEXTURE_COPY_LOCATION dest(resource, subresource);
+		CD3DX12_TEXTURE_COPY_LOCATION source(allocation.buffer, footprint);
+		m_commandList->CopyTextureRegion(&dest, 0, static_cast<UINT>(destRow + row * blockSize), destSlice, &source, nullptr);
+
+		row += rows;
+	}
+
+	return S_OK;
+}
+
+// Opens the command list on the next allocator, first waiting for the copies
+// last recorded into it if the copy engine is that far behind.
+HRESULT TextureUploader::BeginCommands()
+{
+	m_allocatorIndex = (m_allocatorIndex + 1) % AllocatorCount;
+	WaitForFence(m_allocatorFenceValues[m_allocatorIndex]);
+	ReleaseCompleted();
+
+	HRESULT hr = m_commandAllocators[m_allocatorIndex]->Reset();
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	return m_commandList->Reset(m_commandAllocators[m_allocatorIndex].Get(), nullptr);
+}
+
+// Textures come from the pool in the common state: the copy queue writes them
+// from there, and the direct queue promotes them to a shader resource on first use.
+HRESULT TextureUploader::CreateResource(const TexMetadata& metadata, D3D12_RESOURCE_FLAGS flags, D3D12UploadedTexture& texture)
+{
+	D3D12_RESOURCE_DESC textureDesc = {};
+	textureDesc.Width = metadata.width;
+	textureDesc.Height = static_cast<UINT>(metadata.height);
+	textureDesc.MipLevels = static_cast<UINT16>(metadata.mipLevels);
+	textureDesc.Format = metadata.format;
+	textureDesc.DepthOrArraySize = static_cast<UINT16>(metadata.arraySize);
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	textureDesc.Flags = flags;
+
+	HRESULT hr;
+	if (flags & D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS)
+	{
+		hr = m_device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&textureDesc,
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(texture.resource.ReleaseAndGetAddressOf()));
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+		NAME_D3D12_OBJECT(texture.resource);
+	}
+	else
+	{
+		hr = m_texturePool->Acquire(textureDesc, texture.resource);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+		texture.pool = m_texturePool;
+	}
+	texture.copyFence = m_fence;
+	texture.copyFenceValue = m_fenceValue;
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC& srvDesc = texture.srvDesc;
+	srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	if (textureDesc.Format == DXGI_FORMAT_R16_FLOAT || textureDesc.Format == DXGI_FORMAT_R32_FLOAT)
+	{
+		// Show a single channel as grey instead of red.
+		srvDesc.Shader4ComponentMapping = D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(
+			D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+			D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+			D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+			D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1);
+	}
+	srvDesc.Format = textureDesc.Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = static_cast<UINT>(metadata.mipLevels);
+
+	return S_OK;
+}
+
+// Closes and submits the command list and hands its ring space back. The
+// uploader's fence reaches m_fenceValue once the copy engine is done with it;
+// nothing waits for that here.
+HRESULT TextureUploader::Execute()
+{
+	HRESULT hr = m_commandList->Close();
+	if (SUCCEEDED(hr))
+	{
+		ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
+		m_copyQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	}
+
+	HRESULT hrSubmit = m_uploadRing->Submit(m_copyQueue.Get(), m_allocations.data(), m_allocations.size());
+	m_allocations.clear();
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	if (FAILED(hrSubmit))
+	{
+		return hrSubmit;
+	}
+
+	m_fenceValue++;
+	m_allocatorFenceValues[m_allocatorIndex] = m_fenceValue;
+	return m_copyQueue->Signal(m_fence.Get(), m_fenceValue);
+}
+
+void TextureUploader::WaitForFence(UINT64 fenceValue)
+{
+	if (m_fence->GetCompletedValue() < fenceValue && SUCCEEDED(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent)))
+	{
+		WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+	}
+}
+
+// Holds resource until the copies submitted so far have executed.
+void TextureUploader::KeepAlive(ID3D12Resource* resource)
+{
+	PendingResource pending = { resource, m_fenceValue };
+	m_pendingResources.push_back(pending);
+}
+
+void TextureUploader::ReleaseCompleted()
+{
+	const UINT64 completedValue = m_fence->GetCompletedValue();
+	while (!m_pendingResources.empty() && m_pendingResources.front().fenceValue <= completedValue)
+	{
+		m_pendingResources.pop_front();
+	}
+}
@@ -0,0 +1,122 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include "ImageLoader.h"
+#include "TexturePool.h"
+#include "UploadRing.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+using Microsoft::WRL::ComPtr;
+
+// A texture created by TextureUploader. Its copies may still be running on the
+// copy queue: a queue that samples it has to Wait() for copyFence to reach
+// copyFenceValue first. Textures come back in the common state, which the
+// direct queue promotes to a shader resource on first use.
+//
+// The resource goes back to the uploader's texture pool when the last reference
+// to this object is dropped, so a renderer must keep the object, not just the
+// resource, for as long as it samples the texture. Textures filled in bands
+// through CreateTexture have no pool and are simply released.
+struct D3D12UploadedTexture : public UploadedTexture
+{
+	virtual ~D3D12UploadedTexture();
+
+	ComPtr<ID3D12Resource> resource;
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	ComPtr<ID3D12Fence> copyFence;
+	std::atomic<UINT64> copyFenceValue;
+	std::weak_ptr<TexturePool> pool;
+};
+
+// Uploads decoded images into default-heap textures on a dedicated copy queue,
+// so the copy engine streams texture data while the render thread keeps
+// submitting frames on the direct queue. Submissions rotate through a few
+// command allocators; only running out of those, or of upload ring space,
+// blocks the calling thread. Pixels are staged in the shared upload ring, in
+// chunks when they do not fit.
+class TextureUploader : public ITextureUploader
+{
+public:
+	TextureUploader(ID3D12Device* device, UploadRing* uploadRing, size_t texturePoolBudgetBytes);
+	virtual ~TextureUploader();
+
+	virtual HRESULT Upload(const DirectX::TexMetadata& metadata, const DirectX::ScratchImage& image, std::shared_ptr<UploadedTexture>& texture) override;
+	virtual HRESULT CreateTexture(const DirectX::TexMetadata& metadata, std::shared_ptr<UploadedTexture>& texture) override;
+	virtual HRESULT UploadRows(const DirectX::Image& rows, size_t firstRow, UploadedTexture& texture) override;
+
+	// Fills the first imageCount subresources of a texture the caller created in
+	// the common or copy-dest state, and returns once the copy has executed.
+	HRESULT UploadSubresources(ID3D12Resource* resource, const DirectX::Image* images, size_t imageCount);
+
+	// Fills the depth slices of a single-mip 3D texture created like above, one
+	// image per slice, and returns once the copy has executed.
+	HRESULT UploadVolume(ID3D12Resource* resource, const DirectX::Image* slices, size_t sliceCount);
+
+	// Blocks until every submitted copy has executed.
+	void WaitForIdle();
+
+	TexturePool* GetTexturePool() const { return m_texturePool.get(); }
+
+private:
+	static const UINT AllocatorCount = 3;
+
+	HRESULT CreateResource(const DirectX::TexMetadata& metadata, D3D12_RESOURCE_FLAGS flags, D3D12UploadedTexture& texture);
+	HRESULT CopySubresources(ID3D12Resource* resource, const DirectX::Image* images, size_t imageCount);
+	HRESULT CopyRows(ID3D12Resource* resource, UINT subresource, const DirectX::Image& image, size_t destRow, UINT destSlice);
+	HRESULT BeginCommands();
+	HRESULT Execute();
+	void WaitForFence(UINT64 fenceValue);
+	void KeepAlive(ID3D12Resource* resource);
+	void ReleaseCompleted();
+
+	ComPtr<ID3D12Device> m_device;
+	ComPtr<ID3D12CommandQueue> m_copyQueue;
+	UploadRing* m_uploadRing;
+	std::shared_ptr<TexturePool> m_texturePool;
+	std::vector<UploadAllocation> m_allocations;	// Ring space used by the list being recorded.
+
+	// Textures referenced by submitted copies, held until the copies have executed
+	// so that a load that is dropped meanwhile cannot free them under the GPU.
+	struct PendingResource
+	{
+		ComPtr<ID3D12Resource> resource;
+		UINT64 fenceValue;
+	};
+	std::deque<PendingResource> m_pendingResources;
+
+	ComPtr<ID3D12CommandAllocator> m_commandAllocators[AllocatorCount];
+	UINT64 m_allocatorFenceValues[AllocatorCount];
+	UINT m_allocatorIndex;
+	ComPtr<ID3D12GraphicsCommandList> m_commandList;
+	ComPtr<ID3D12Fence> m_fence;
+	UINT64 m_fenceValue;
+	HANDLE m_fenceEvent;
+	std::mutex m_mutex;
+};
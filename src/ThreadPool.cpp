@@ -0,0 +1,172 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) :
+	m_shutdown(false)
+{
+	if (threadCount == 0)
+	{
+		size_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+	}
+
+	m_workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerMain, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_wakeWorkers.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+ThreadPool& ThreadPool::GetDefault()
+{
+	static ThreadPool s_pool;
+	return s_pool;
+}
+
+// Pull indices from the job until it is exhausted.
+void ThreadPool::RunJob(Job& job)
+{
+	size_t completed = 0;
+	for (size_t index = job.next++; index < job.count; index = job.next++)
+	{
+		try
+		{
+			(*job.func)(index);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(job.errorMutex);
+			if (!job.error)
+			{
+				job.error = std::current_exception();
+			}
+		}
+		completed++;
+	}
+
+	if (completed > 0)
+	{
+		job.done += completed;
+	}
+}
+
+void ThreadPool::WorkerMain()
+{
+	for (;;)
+	{
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeWorkers.wait(lock, [this] { return m_shutdown || !m_jobs.empty(); });
+			if (m_shutdown)
+			{
+				return;
+			}
+
+			job = m_jobs.front();
+
+			// Every index has been handed out; retire the job from the queue.
+			if (job->next >= job->count)
+			{
+				m_jobs.pop_front();
+				continue;
+			}
+		}
+
+		RunJob(*job);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+		}
+		m_jobFinished.notify_all();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Not worth waking anybody for a single item.
+	if (count == 1 || m_workers.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			func(i);
+		}
+		return;
+	}
+
+	auto job = std::make_shared<Job>();
+	job->func = &func;
+	job->count = count;
+	job->next = 0;
+	job->done = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+	}
+	m_wakeWorkers.notify_all();
+
+	// The caller works on its own job too.
+	RunJob(*job);
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobFinished.wait(lock, [&job] { return job->done >= job->count; });
+
+		auto it = std::find(m_jobs.begin(), m_jobs.end(), job);
+		if (it != m_jobs.end())
+		{
+			m_jobs.erase(it);
+		}
+	}
+
+	if (job->error)
+	{
+		std::rethrow_exception(job->error);
+	}
+}
@@ -0,0 +1,82 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small fixed-size worker pool used for data-parallel loops (image decode,
+// pixel conversion, analysis). The calling thread always takes part in the
+// work, so nested ParallelFor calls from inside a task cannot deadlock.
+class ThreadPool
+{
+public:
+	// threadCount is the number of background workers. 0 selects
+	// hardware_concurrency() - 1 so that, together with the caller, every core is used.
+	explicit ThreadPool(size_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Number of threads that can run tasks concurrently (workers + caller).
+	size_t GetConcurrency() const { return m_workers.size() + 1; }
+
+	// Calls func(index) for every index in [0, count) and returns once all calls have finished.
+	// The first exception thrown by a task is rethrown on the calling thread.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+	// Shared pool sized to the machine.
+	static ThreadPool& GetDefault();
+
+private:
+	struct Job
+	{
+		const std::function<void(size_t)>* func;
+		size_t count;
+		std::atomic<size_t> next;
+		std::atomic<size_t> done;
+		std::exception_ptr error;
+		std::mutex errorMutex;
+	};
+
+	static void RunJob(Job& job);
+	void WorkerMain();
+
+	std::vector<std::thread> m_workers;
+	std::deque<std::shared_ptr<Job>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeWorkers;
+	std::condition_variable m_jobFinished;
+	bool m_shutdown;
+};
@@ -0,0 +1,147 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "UploadRing.h"
+#include "DXSampleHelper.h"
+
+UploadRing::UploadRing(ID3D12Device* device, UINT64 size) :
+	m_mapped(nullptr),
+	m_size(size),
+	m_fenceValue(0),
+	m_allocator(size)
+{
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_buffer)));
+	NAME_D3D12_OBJECT(m_buffer);
+
+	// Upload heaps can stay mapped for their whole lifetime.
+	ThrowIfFailed(m_buffer->Map(0, &CD3DX12_RANGE(0, 0), reinterpret_cast<void**>(&m_mapped)));
+
+	ThrowIfFailed(device->CreateFence(m_fenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+}
+
+// The owner makes sure the GPU is done with the ring before destroying it.
+UploadRing::~UploadRing()
+{
+	m_buffer->Unmap(0, nullptr);
+}
+
+bool UploadRing::TryAllocate(UINT64 size, UINT64 alignment, UploadAllocation& allocation)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return TryAllocateLocked(size, alignment, allocation);
+}
+
+HRESULT UploadRing::Allocate(UINT64 size, UINT64 alignment, UploadAllocation& allocation)
+{
+	if (size == 0 || size > m_size)
+	{
+		return E_INVALIDARG;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!TryAllocateLocked(size, alignment, allocation))
+	{
+		const UINT64 fenceValue = m_allocator.GetOldestFenceValue();
+		if (fenceValue == 0)
+		{
+			// The oldest range belongs to another thread that has not submitted yet.
+			m_submitted.wait(lock);
+			continue;
+		}
+
+		// A null event makes this call block until the fence gets there.
+		lock.unlock();
+		HRESULT hr = m_fence->SetEventOnCompletion(fenceValue, nullptr);
+		lock.lock();
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	return S_OK;
+}
+
+HRESULT UploadRing::Submit(ID3D12CommandQueue* queue, const UploadAllocation* allocations, size_t count)
+{
+	if (count == 0)
+	{
+		return S_OK;
+	}
+
+	HRESULT hr;
+	{
+		// Signals go out under the lock so the fence only ever moves forward.
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_fenceValue++;
+		hr = queue->Signal(m_fence.Get(), m_fenceValue);
+		if (FAILED(hr))
+		{
+			// Most likely a removed device; the ranges are never handed out again.
+			return hr;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			m_allocator.Retire(allocations[i].id, m_fenceValue);
+		}
+	}
+	m_submitted.notify_all();
+
+	return S_OK;
+}
+
+UINT64 UploadRing::GetUsedBytes()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_allocator.Reclaim(m_fence->GetCompletedValue());
+	return m_allocator.GetUsedBytes();
+}
+
+bool UploadRing::TryAllocateLocked(UINT64 size, UINT64 alignment, UploadAllocation& allocation)
+{
+	m_allocator.Reclaim(m_fence->GetCompletedValue());
+
+	uint64_t id = 0;
+	const uint64_t offset = m_allocator.Allocate(size, alignment, id);
+	if (offset == RingAllocator::InvalidOffset)
+	{
+		return false;
+	}
+
+	allocation.buffer = m_buffer.Get();
+	allocation.offset = offset;
+	allocation.cpuAddress = m_mapped + offset;
+	allocation.id = id;
+	return true;
+}
@@ -0,0 +1,87 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+#pragma once
+
+#include "RingAllocator.h"
+
+#include <condition_variable>
+#include <mutex>
+
+using Microsoft::WRL::ComPtr;
+
+// A range of the upload ring, mapped for writing. offset is where the data
+// sits in buffer for CopyBufferRegion/CopyTextureRegion.
+struct UploadAllocation
+{
+	ID3D12Resource* buffer;
+	UINT64 offset;
+	uint8_t* cpuAddress;
+	uint64_t id;
+};
+
+// One persistently mapped upload buffer shared by every CPU to GPU copy, in
+// place of a committed upload heap per upload. Ranges are recycled once the
+// ring's fence shows that the commands reading them have executed.
+//
+// Thread-safe. A thread must Submit() the allocations it holds before it calls
+// Allocate() with the ring full, or it would wait on itself.
+class UploadRing
+{
+public:
+	UploadRing(ID3D12Device* device, UINT64 size);
+	~UploadRing();
+
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+
+	UINT64 GetSize() const { return m_size; }
+
+	// Returns false instead of waiting when the range is not free yet.
+	bool TryAllocate(UINT64 size, UINT64 alignment, UploadAllocation& allocation);
+
+	// Waits until the range is free. Uploads larger than the ring fail with
+	// E_INVALIDARG and have to be split by the caller.
+	HRESULT Allocate(UINT64 size, UINT64 alignment, UploadAllocation& allocation);
+
+	// Call after the command lists reading the allocations have been executed
+	// on queue. Failed uploads still submit, so their ranges come back.
+	HRESULT Submit(ID3D12CommandQueue* queue, const UploadAllocation* allocations, size_t count);
+
+	UINT64 GetUsedBytes();
+
+private:
+	bool TryAllocateLocked(UINT64 size, UINT64 alignment, UploadAllocation& allocation);
+
+	ComPtr<ID3D12Resource> m_buffer;
+	uint8_t* m_mapped;
+	UINT64 m_size;
+
+	ComPtr<ID3D12Fence> m_fence;
+	UINT64 m_fenceValue;
+
+	std::mutex m_mutex;
+	std::condition_variable m_submitted;
+	RingAllocator m_allocator;
+};
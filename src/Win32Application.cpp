@@ -28,6 +28,11 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 	pSample->ParseCommandLineArgs(argv, argc);
 	LocalFree(argv);
 
+	if (pSample->IsHeadless())
+	{
+		return pSample->RunHeadless();
+	}
+
 	// Initialize the window class.
 	WNDCLASSEX windowClass = { 0 };
 	windowClass.cbSize = sizeof(WNDCLASSEX);
@@ -60,7 +65,8 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 
 	ShowWindow(m_hwnd, nCmdShow);
 
-	// Main sample loop.
+	// Main sample loop. Frames are only rendered while something on screen
+	// changed; an idle viewer sleeps in MsgWaitForMultipleObjectsEx.
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
 	{
@@ -69,6 +75,21 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 		{
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
+			continue;
+		}
+
+		if (pSample->NeedsRender())
+		{
+			RenderFrame(pSample);
+			continue;
+		}
+
+		HANDLE wakeEvent = pSample->GetWakeEvent();
+		const DWORD handleCount = wakeEvent ? 1 : 0;
+		const DWORD result = MsgWaitForMultipleObjectsEx(handleCount, &wakeEvent, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		if (handleCount > 0 && result == WAIT_OBJECT_0)
+		{
+			pSample->GetRedrawTracker().Invalidate();
 		}
 	}
 
@@ -78,6 +99,14 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 	return static_cast<char>(msg.wParam);
 }
 
+// Update and render one frame, taking it off the frames the sample still owes.
+void Win32Application::RenderFrame(DXSample* pSample)
+{
+	pSample->ConsumeFrame();
+	pSample->OnUpdate();
+	pSample->OnRender();
+}
+
 // Convert a styled window into a fullscreen borderless window and back again.
 void Win32Application::ToggleFullscreenWindow()
 {
@@ -134,6 +163,20 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 
 	DXSample* pSample = reinterpret_cast<DXSample*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
 
+	// Anything the user does may change the UI.
+	if (pSample)
+	{
+		if ((message >= WM_KEYFIRST && message <= WM_KEYLAST) || (message >= WM_MOUSEFIRST && message <= WM_MOUSELAST) ||
+			message == WM_SETFOCUS || message == WM_KILLFOCUS)
+		{
+			pSample->GetRedrawTracker().OnInput();
+		}
+		else if (message == WM_SIZE || message == WM_MOVE || message == WM_EXITSIZEMOVE || message == WM_DISPLAYCHANGE)
+		{
+			pSample->GetRedrawTracker().OnWindowChanged();
+		}
+	}
+
 	switch (message)
 	{
 	case WM_CREATE:
@@ -172,11 +215,15 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 		break;
 
 	case WM_PAINT:
+		// The main loop does not run while the window is being moved or sized,
+		// so the frame is rendered here, and validating the window stops Windows
+		// from sending WM_PAINT again until something is exposed.
 		if (pSample)
 		{
-			pSample->OnUpdate();
-			pSample->OnRender();
+			pSample->GetRedrawTracker().Invalidate();
+			RenderFrame(pSample);
 		}
+		ValidateRect(hWnd, nullptr);
 		return 0;
 
 	case WM_SIZE:
@@ -205,7 +252,22 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 		}
 		return 0;
 		
+	case WM_ENTERSIZEMOVE:
+		if (pSample)
+		{
+			pSample->OnEnterSizeMove();
+		}
+		return 0;
+
+	case WM_EXITSIZEMOVE:
+		if (pSample)
+		{
+			pSample->OnExitSizeMove();
+		}
+		return 0;
+
     case WM_DISPLAYCHANGE:
+
         if (pSample)
         {
             pSample->OnDisplayChanged();
@@ -26,6 +26,9 @@ protected:
 	static LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
 private:
+	static void RenderFrame(DXSample* pSample);
+
+
 	static HWND m_hwnd;
 	static bool m_fullscreenMode;
 	static const UINT m_windowStyle = WS_OVERLAPPEDWINDOW;
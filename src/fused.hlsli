@@ -0,0 +1,29 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+// Shared by the fused*PS.hlsl shaders, which define OUTPUT_CURVE first.
+//
+// The fused pass samples the image, applies the exposure and encodes for the
+// display in one draw, the same math as palettePS.hlsl followed by
+// presentPS.hlsl without the intermediate render target in between.
+
+#include "present.hlsli"
+#include "color.hlsli"
+#include "outputTransform.hlsli"
+
+float4 PSMain(PSInput input) : SV_TARGET
+{
+	float4 color = g_hdrTexture.Sample(g_sampler, input.uv);
+	color = color * pow(2.0, EVValue);
+
+	return float4(ApplyOutputTransform(color.rgb), 1.0f);
+}
@@ -0,0 +1,12 @@
+//*********************************************************
+//
+// Shared by imguiVS.hlsl and imguiPS.hlsl.
+//
+//*********************************************************
+
+struct PSInput
+{
+	float4 pos : SV_POSITION;
+	float4 col : COLOR0;
+	float2 uv  : TEXCOORD0;
+};
@@ -0,0 +1,16 @@
+//*********************************************************
+//
+// ImGui pixel shader, precompiled so that imgui_impl_dx12 does not need
+// D3DCompile at run time.
+//
+//*********************************************************
+
+#include "imgui.hlsli"
+
+SamplerState sampler0 : register(s0);
+Texture2D texture0 : register(t0);
+
+float4 PSMain(PSInput input) : SV_Target
+{
+	return input.col * texture0.Sample(sampler0, input.uv);
+}
@@ -0,0 +1,29 @@
+//*********************************************************
+//
+// ImGui vertex shader, precompiled so that imgui_impl_dx12 does not need
+// D3DCompile at run time.
+//
+//*********************************************************
+
+#include "imgui.hlsli"
+
+cbuffer vertexBuffer : register(b0)
+{
+	float4x4 ProjectionMatrix;
+};
+
+struct VSInput
+{
+	float2 pos : POSITION;
+	float4 col : COLOR0;
+	float2 uv  : TEXCOORD0;
+};
+
+PSInput VSMain(VSInput input)
+{
+	PSInput output;
+	output.pos = mul(ProjectionMatrix, float4(input.pos.xy, 0.f, 1.f));
+	output.col = input.col;
+	output.uv  = input.uv;
+	return output;
+}
@@ -12,6 +12,7 @@
 enum DXGI_FORMAT;
 struct ID3D12Device;
 struct ID3D12GraphicsCommandList;
+struct ID3D12Resource;
 struct D3D12_CPU_DESCRIPTOR_HANDLE;
 struct D3D12_GPU_DESCRIPTOR_HANDLE;
 
@@ -33,6 +34,18 @@ IMGUI_API void        ImGui_ImplDX12_InvalidateDeviceObjects();
 IMGUI_API bool        ImGui_ImplDX12_CreateDeviceObjects();
 IMGUI_API bool        ImGui_ImplDX12_CreateDeviceObjects(DXGI_FORMAT rtv_format);
 
+// Switches the render target format imgui draws to. Pipeline states are cached per format and the font
+// texture is kept, so this only creates a pipeline state the first time a format is used.
+IMGUI_API bool        ImGui_ImplDX12_SetRenderTargetFormat(DXGI_FORMAT rtv_format);
+
+
+// Optional: uploads the font atlas through the app's own upload path instead of a temporary queue and upload heap.
+// texture is R8G8B8A8_UNORM in the COPY_DEST state; it must be ready to sample when the callback returns, either in
+// PIXEL_SHADER_RESOURCE or in COMMON (e.g. written on a copy queue) for implicit promotion.
+typedef bool (*ImGui_ImplDX12_UploadTextureFn)(ID3D12Resource* texture, const unsigned char* pixels, int width, int height, void* user_data);
+IMGUI_API void        ImGui_ImplDX12_SetUploadTextureFn(ImGui_ImplDX12_UploadTextureFn upload_fn, void* user_data);
+
+
 // Handler for Win32 messages, update mouse/keyboard data.
 // You may or not need this for your implementation, but it can serve as reference for handling inputs.
 // Commented out to avoid dragging dependencies on <windows.h> types. You can copy the extern declaration in your code.
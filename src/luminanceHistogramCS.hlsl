@@ -0,0 +1,127 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+// The GPU counterpart of AnalyzeLuminance (LuminanceAnalysis.cpp): each group
+// reduces a 64x64 block of the image in groupshared memory and adds it to the
+// results with one atomic per bin. The bins must match the CPU histogram.
+
+#define THREADS 16
+#define PIXELS_PER_THREAD 4
+#define BLOCK_SIZE (THREADS * PIXELS_PER_THREAD)
+
+#define BIN_SHIFT 20						// 23 - LuminanceBinsPerStopBits
+#define BIN_BASE ((127 - 14) << 3)			// LuminanceMinStop
+#define BIN_COUNT 240						// LuminanceHistogramBins
+#define BIN_LOWEST asfloat((127 - 14) << 23)
+#define BIN_HIGHEST asfloat(((127 + 16) << 23) - 1)
+
+#define SCRGB_REFERENCE_NITS 80.0
+#define FP16_MAX 65504.0
+
+cbuffer Constants : register(b0)
+{
+	uint2 imageSize;
+	uint groupCountX;
+};
+
+Texture2D<float4> g_image : register(t0);
+
+// Bytes 0, 4 and 8: minimum and maximum luminance and MaxCLL, as float bits
+// (which order like uints for positive floats); the histogram follows from byte 16.
+RWByteAddressBuffer g_results : register(u0);
+
+// Per group sums of luminance and max(R, G, B), added up on the CPU in double.
+RWStructuredBuffer<float2> g_groupSums : register(u1);
+
+groupshared uint gs_histogram[BIN_COUNT];
+groupshared uint gs_minNits;
+groupshared uint gs_maxNits;
+groupshared uint gs_maxCLL;
+groupshared float2 gs_sums[THREADS * THREADS];
+
+[numthreads(THREADS, THREADS, 1)]
+void CSMain(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID, uint threadIndex : SV_GroupIndex)
+{
+	for (uint bin = threadIndex; bin < BIN_COUNT; bin += THREADS * THREADS)
+	{
+		gs_histogram[bin] = 0;
+	}
+	if (threadIndex == 0)
+	{
+		gs_minNits = asuint(3.402823466e+38f);
+		gs_maxNits = 0;
+		gs_maxCLL = 0;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	float minNits = 3.402823466e+38f;
+	float maxNits = 0.0;
+	float maxCLL = 0.0;
+	float2 sums = 0.0;
+
+	// Threads step through the block THREADS pixels apart so that neighbours read neighbours.
+	const uint2 origin = groupId.xy * BLOCK_SIZE + threadId.xy;
+	for (uint y = 0; y < PIXELS_PER_THREAD; y++)
+	{
+		for (uint x = 0; x < PIXELS_PER_THREAD; x++)
+		{
+			const uint2 pixel = origin + uint2(x, y) * THREADS;
+			if (all(pixel < imageSize))
+			{
+				// min and max return the other operand for NaN, so NaN counts as 0.
+				float3 rgb = min(max(g_image.Load(int3(pixel, 0)).rgb, 0.0), FP16_MAX);
+				float nits = dot(rgb, float3(0.2126, 0.7152, 0.0722) * SCRGB_REFERENCE_NITS);
+				float component = max(rgb.r, max(rgb.g, rgb.b)) * SCRGB_REFERENCE_NITS;
+
+				minNits = min(minNits, nits);
+				maxNits = max(maxNits, nits);
+				maxCLL = max(maxCLL, component);
+				sums += float2(nits, component);
+
+				uint binIndex = (asuint(clamp(nits, BIN_LOWEST, BIN_HIGHEST)) >> BIN_SHIFT) - BIN_BASE;
+				InterlockedAdd(gs_histogram[binIndex], 1);
+			}
+		}
+	}
+
+	InterlockedMin(gs_minNits, asuint(minNits));
+	InterlockedMax(gs_maxNits, asuint(maxNits));
+	InterlockedMax(gs_maxCLL, asuint(maxCLL));
+
+	gs_sums[threadIndex] = sums;
+	GroupMemoryBarrierWithGroupSync();
+
+	for (uint stride = THREADS * THREADS / 2; stride > 0; stride >>= 1)
+	{
+		if (threadIndex < stride)
+		{
+			gs_sums[threadIndex] += gs_sums[threadIndex + stride];
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	for (uint resultBin = threadIndex; resultBin < BIN_COUNT; resultBin += THREADS * THREADS)
+	{
+		if (gs_histogram[resultBin] != 0)
+		{
+			g_results.InterlockedAdd(16 + resultBin * 4, gs_histogram[resultBin]);
+		}
+	}
+
+	if (threadIndex == 0)
+	{
+		g_results.InterlockedMin(0, gs_minNits);
+		g_results.InterlockedMax(4, gs_maxNits);
+		g_results.InterlockedMax(8, gs_maxCLL);
+		g_groupSums[groupId.y * groupCountX + groupId.x] = gs_sums[0];
+	}
+}
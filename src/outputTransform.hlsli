@@ -0,0 +1,114 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+// The output transform shared by presentPS.hlsl and the fused pixel shaders.
+// Include after present.hlsli and color.hlsli.
+//
+// Define OUTPUT_CURVE to one of the DISPLAY_CURVE values to build a shader for
+// a single curve; otherwise the curve is picked by the displayCurve constant.
+
+// Layout of g_curveLut; must match GetOutputCurveLutRange() in OutputTransform.cpp.
+// Each curve has 2^LUT_SEGMENT_BITS entries per octave between 2^MIN and 2^MAX.
+#define LUT_SEGMENT_BITS		5
+#define LUT_SRGB_OFFSET			0
+#define LUT_SRGB_MIN_EXPONENT	-9
+#define LUT_SRGB_MAX_EXPONENT	1
+#define LUT_ST2084_OFFSET		321
+#define LUT_ST2084_MIN_EXPONENT	-36
+#define LUT_ST2084_MAX_EXPONENT	1
+
+// The float bits of the input give the entry (exponent and top mantissa bits)
+// and the interpolation weight (the remaining mantissa bits).
+float3 LookupCurveLut(float3 value, uint offset, int minExponent, int maxExponent)
+{
+	const uint mantissaBits = 23 - LUT_SEGMENT_BITS;
+	const uint minBits = uint(127 + minExponent) << 23;
+	const uint maxBits = (uint(127 + maxExponent) << 23) - 1;
+
+	uint3 bits = clamp(asuint(abs(value)), minBits, maxBits) - minBits;
+	uint3 index = offset + (bits >> mantissaBits);
+	float3 t = float3(bits & ((1 << mantissaBits) - 1)) / (1 << mantissaBits);
+
+	float3 a = float3(g_curveLut[index.r], g_curveLut[index.g], g_curveLut[index.b]);
+	float3 b = float3(g_curveLut[index.r + 1], g_curveLut[index.g + 1], g_curveLut[index.b + 1]);
+	return lerp(a, b, t);
+}
+
+float3 LinearToSRGBLut(float3 color)
+{
+	float3 lut = LookupCurveLut(color, LUT_SRGB_OFFSET, LUT_SRGB_MIN_EXPONENT, LUT_SRGB_MAX_EXPONENT);
+	return (color < 0.0031308f) ? 12.92f * color : lut;
+}
+
+float3 LinearToST2084Lut(float3 color)
+{
+	return LookupCurveLut(color, LUT_ST2084_OFFSET, LUT_ST2084_MIN_EXPONENT, LUT_ST2084_MAX_EXPONENT);
+}
+
+// The whole transform through the 3D LUT; see OutputLut3D.h. The shaper must
+// match ApplyOutputLut3DShaper() in OutputLut3D.cpp.
+float3 SampleOutputLut3D(float3 scene)
+{
+	const float st2084max = 10000.0;
+	float3 shaped = LinearToST2084Lut(saturate(scene * (standardNits / st2084max)));
+
+	// Map [0, 1] onto the centers of the first and last texels.
+	float3 uvw = (shaped * (Lut3DSize - 1) + 0.5) / Lut3DSize;
+	return g_outputLut.SampleLevel(g_linearSampler, uvw, 0).rgb;
+}
+
+float3 ApplyOutputTransform(float3 scene)
+{
+	// The scene is linear with Rec.709 primaries. (DXGI_COLOR_SPACE_RGB_FULL_G10_NONE_P709)
+	float3 result = scene;
+
+	// A baked or loaded 3D LUT replaces everything below, the heatmap included.
+	if (Lut3DSize > 0)
+	{
+		return SampleOutputLut3D(scene);
+	}
+
+#ifdef OUTPUT_CURVE
+	const uint curve = OUTPUT_CURVE;
+#else
+	const uint curve = displayCurve;
+#endif
+
+	if (curve == DISPLAY_CURVE_SRGB)
+	{
+		result = CurveLutFlag ? LinearToSRGBLut(result) : LinearToSRGB(result);
+	}
+	else if (curve == DISPLAY_CURVE_ST2084)
+	{
+		const float st2084max = 10000.0;
+		const float hdrScalar = standardNits / st2084max;
+
+		// The HDR scene is in Rec.709, but the display is Rec.2020
+		result = Rec709ToRec2020(result);
+
+		// Apply the ST.2084 curve to the scene.
+		result = CurveLutFlag ? LinearToST2084Lut(result * hdrScalar) : LinearToST2084(result * hdrScalar);
+	}
+	else // curve == DISPLAY_CURVE_LINEAR
+	{
+		// Just pass through
+	}
+
+	if (HeatmapFlag)
+	{
+		float luminance = Rec2020ToXYZ(result).y;
+		float2 uv = float2(luminance / 1.0f, 0.05f);
+		result = g_heatMapTexture.Sample(g_sampler, uv).rgb;
+	}
+
+	return result;
+}
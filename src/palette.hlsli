@@ -21,9 +21,14 @@ cbuffer RootConstants : register(b0)
 	uint displayCurve;		// The expected format of the output signal.
 	float EVValue;
 	uint HeatmapFlag;
+	uint CurveLutFlag;		// Encode through g_curveLut instead of the analytic curves.
+	uint Lut3DSize;			// Edge length of g_outputLut, or 0 to transform analytically.
 };
 
 Texture2D g_scene : register(t0);
 Texture2D g_hdrTexture : register(t1);
 Texture2D g_heatMapTexture : register(t2);
+Buffer<float> g_curveLut : register(t3);
+Texture3D g_outputLut : register(t4);
 SamplerState g_sampler : register(s0);
+SamplerState g_linearSampler : register(s1);
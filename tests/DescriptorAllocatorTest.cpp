@@ -0,0 +1,139 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// DescriptorAllocator bookkeeping: first fit, merging of freed neighbours,
+// fence-deferred frees reclaimed out of order, and exhaustion.
+
+#include "DescriptorAllocator.h"
+#include "TestCommon.h"
+
+namespace
+{
+	const uint32_t Invalid = DescriptorAllocator::InvalidOffset;
+
+	void TestFirstFit()
+	{
+		DescriptorAllocator allocator(16);
+		CHECK(allocator.Allocate(4) == 0);
+		const uint32_t middle = allocator.Allocate(4);
+		CHECK(middle == 4);
+		CHECK(allocator.Allocate(4) == 8);
+
+		// A hole at 4..7 and the tail at 12..15: the first range large enough wins.
+		allocator.Free(middle, 4, 0);
+		CHECK(allocator.GetFreeRangeCount() == 2);
+		CHECK(allocator.Allocate(2) == 4);
+		CHECK(allocator.Allocate(3) == 12);
+		CHECK(allocator.Allocate(2) == 6);
+		CHECK(allocator.Allocate(1) == 15);
+		CHECK(allocator.GetFreeCount() == 0);
+		CHECK(allocator.GetFreeRangeCount() == 0);
+	}
+
+	void TestMerge()
+	{
+		DescriptorAllocator allocator(12);
+		const uint32_t a = allocator.Allocate(4);
+		const uint32_t b = allocator.Allocate(4);
+		const uint32_t c = allocator.Allocate(4);
+
+		// Neither neighbour is free yet.
+		allocator.Free(a, 4, 0);
+		allocator.Free(c, 4, 0);
+		CHECK(allocator.GetFreeRangeCount() == 2);
+
+		// Both neighbours are: the three ranges become one.
+		allocator.Free(b, 4, 0);
+		CHECK(allocator.GetFreeRangeCount() == 1);
+		CHECK(allocator.GetFreeCount() == 12);
+		CHECK(allocator.Allocate(12) == 0);
+
+		// Merging with only the previous and only the next range.
+		allocator.Free(0, 2, 0);
+		allocator.Free(2, 2, 0);
+		CHECK(allocator.GetFreeRangeCount() == 1);
+		allocator.Free(6, 2, 0);
+		allocator.Free(4, 2, 0);
+		CHECK(allocator.GetFreeRangeCount() == 1);
+		CHECK(allocator.Allocate(8) == 0);
+	}
+
+	void TestDeferredFree()
+	{
+		DescriptorAllocator allocator(8);
+		const uint32_t a = allocator.Allocate(4);
+		const uint32_t b = allocator.Allocate(4);
+
+		// Freed for frames that finish in the opposite order they were freed in.
+		allocator.Free(a, 4, 5);
+		allocator.Free(b, 4, 3);
+		CHECK(allocator.GetFreeCount() == 0);
+		CHECK(allocator.GetPendingCount() == 8);
+		CHECK(allocator.Allocate(1) == Invalid);
+
+		allocator.Reclaim(2);
+		CHECK(allocator.GetPendingCount() == 8);
+
+		allocator.Reclaim(3);
+		CHECK(allocator.GetPendingCount() == 4);
+		CHECK(allocator.GetFreeCount() == 4);
+		CHECK(allocator.Allocate(5) == Invalid);
+
+		allocator.Reclaim(5);
+		CHECK(allocator.GetPendingCount() == 0);
+		CHECK(allocator.GetFreeRangeCount() == 1);
+		CHECK(allocator.Allocate(8) == 0);
+	}
+
+	void TestExhaustion()
+	{
+		DescriptorAllocator allocator(4);
+		CHECK(allocator.Allocate(0) == Invalid);
+		CHECK(allocator.Allocate(5) == Invalid);
+		CHECK(allocator.Allocate(4) == 0);
+		CHECK(allocator.Allocate(1) == Invalid);
+		CHECK(allocator.GetFreeCount() == 0);
+
+		// Fragmented: two free slots, but not next to each other.
+		allocator.Free(0, 1, 0);
+		allocator.Free(2, 1, 0);
+		CHECK(allocator.GetFreeCount() == 2);
+		CHECK(allocator.Allocate(2) == Invalid);
+		CHECK(allocator.Allocate(1) == 0);
+
+		DescriptorAllocator empty(0);
+		CHECK(empty.Allocate(1) == Invalid);
+		CHECK(empty.GetFreeRangeCount() == 0);
+	}
+}
+
+int main()
+{
+	TestFirstFit();
+	TestMerge();
+	TestDeferredFree();
+	TestExhaustion();
+	return Test::Finish("DescriptorAllocatorTest");
+}
@@ -0,0 +1,146 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// DescriptorHeap on a WARP device: transient parts per frame that rewind in
+// BeginFrame, persistent ranges that come back once their fence completes,
+// and the CPU and GPU handles of both. Skipped where WARP is unavailable.
+
+#include "stdafx.h"
+#include "DescriptorHeap.h"
+#include "TestCommon.h"
+
+namespace
+{
+	// ctest reports this exit code as a skipped test.
+	const int SkipTest = 77;
+
+	const UINT PersistentCount = 8;
+	const UINT TransientCount = 4;
+	const UINT FrameCount = 2;
+
+	bool CreateWarpDevice(ComPtr<ID3D12Device>& device)
+	{
+		ComPtr<IDXGIFactory4> factory;
+		ComPtr<IDXGIAdapter> adapter;
+		return SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(&factory)))
+			&& SUCCEEDED(factory->EnumWarpAdapter(IID_PPV_ARGS(&adapter)))
+			&& SUCCEEDED(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device)));
+	}
+
+	bool HasHandles(const DescriptorHeap& heap, const DescriptorRange& range)
+	{
+		const SIZE_T cpuStart = heap.GetHeap()->GetCPUDescriptorHandleForHeapStart().ptr;
+		const UINT64 gpuStart = heap.GetHeap()->GetGPUDescriptorHandleForHeapStart().ptr;
+		return range.cpuHandle.ptr == cpuStart + range.offset * heap.GetDescriptorSize()
+			&& range.gpuHandle.ptr == gpuStart + range.offset * heap.GetDescriptorSize();
+	}
+
+	void TestTransientRewind(ID3D12Device* device)
+	{
+		DescriptorHeap heap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+			PersistentCount, TransientCount, FrameCount);
+		CHECK(heap.GetHeap()->GetDesc().NumDescriptors == PersistentCount + TransientCount * FrameCount);
+
+		// Frame 0 uses the slots right after the persistent part, linearly.
+		DescriptorRange range;
+		heap.BeginFrame(0, 0);
+		CHECK(SUCCEEDED(heap.AllocateTransient(3, range)));
+		CHECK(range.offset == PersistentCount);
+		CHECK(HasHandles(heap, range));
+		CHECK(SUCCEEDED(heap.AllocateTransient(1, range)));
+		CHECK(range.offset == PersistentCount + 3);
+		CHECK(heap.AllocateTransient(1, range) == E_OUTOFMEMORY);
+		CHECK(heap.AllocateTransient(0, range) == E_OUTOFMEMORY);
+
+		// Frame 1 has its own part.
+		heap.BeginFrame(1, 0);
+		CHECK(SUCCEEDED(heap.AllocateTransient(2, range)));
+		CHECK(range.offset == PersistentCount + TransientCount);
+		CHECK(HasHandles(heap, range));
+
+		// Recording frame 0 again rewinds its part, all of it.
+		heap.BeginFrame(0, 0);
+		CHECK(SUCCEEDED(heap.AllocateTransient(TransientCount, range)));
+		CHECK(range.offset == PersistentCount);
+		CHECK(heap.AllocateTransient(TransientCount + 1, range) == E_OUTOFMEMORY);
+	}
+
+	void TestPersistent(ID3D12Device* device)
+	{
+		DescriptorHeap heap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+			PersistentCount, TransientCount, FrameCount);
+
+		DescriptorRange first;
+		DescriptorRange second;
+		DescriptorRange third;
+		CHECK(SUCCEEDED(heap.Allocate(6, first)));
+		CHECK(first.offset == 0 && first.count == 6);
+		CHECK(HasHandles(heap, first));
+		CHECK(SUCCEEDED(heap.Allocate(2, second)));
+		CHECK(second.offset == 6);
+		CHECK(heap.Allocate(1, third) == E_OUTOFMEMORY);
+		CHECK(!third.IsValid());
+
+		// Freed while frame 5 may still read it; Free resets the range.
+		heap.Free(first, 5);
+		CHECK(!first.IsValid());
+		heap.BeginFrame(1, 4);
+		CHECK(heap.Allocate(1, third) == E_OUTOFMEMORY);
+		heap.BeginFrame(0, 5);
+		CHECK(SUCCEEDED(heap.Allocate(6, third)));
+		CHECK(third.offset == 0);
+
+		// Transient slots never come from the persistent part.
+		CHECK(SUCCEEDED(heap.AllocateTransient(1, first)));
+		CHECK(first.offset >= PersistentCount);
+	}
+
+	void TestCpuOnlyHeap(ID3D12Device* device)
+	{
+		DescriptorHeap heap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_NONE, PersistentCount);
+
+		DescriptorRange range;
+		CHECK(SUCCEEDED(heap.Allocate(2, range)));
+		CHECK(SUCCEEDED(heap.Allocate(3, range)));
+		CHECK(range.cpuHandle.ptr == heap.GetHeap()->GetCPUDescriptorHandleForHeapStart().ptr + 2 * heap.GetDescriptorSize());
+		CHECK(range.gpuHandle.ptr == 0);
+		CHECK(heap.AllocateTransient(1, range) == E_OUTOFMEMORY);
+	}
+}
+
+int main()
+{
+	ComPtr<ID3D12Device> device;
+	if (!CreateWarpDevice(device))
+	{
+		printf("DescriptorHeapTest: skipped, no WARP device\n");
+		return SkipTest;
+	}
+
+	TestTransientRewind(device.Get());
+	TestPersistent(device.Get());
+	TestCpuOnlyHeap(device.Get());
+	return Test::Finish("DescriptorHeapTest");
+}
@@ -0,0 +1,137 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// Times the parallel band decode of LoadFromEXRFile on a synthetic 4K frame
+// written with each compression SaveToEXRFile offers, from one worker up to
+// every core, and reports decoded MB/s and the speedup over one worker.
+//
+// usage: EXRDecodeBenchmark [runs [width height]]
+
+#include "stdafx.h"
+#include "SyntheticEXR.h"
+#include "TestCommon.h"
+
+#include <cstdlib>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Compression
+	{
+		const char* name;
+		EXR_COMPRESSION compression;
+	};
+
+	const Compression Compressions[] =
+	{
+		{ "NONE", EXR_COMPRESSION_NONE },
+		{ "RLE", EXR_COMPRESSION_RLE },
+		{ "ZIPS", EXR_COMPRESSION_ZIPS },
+		{ "ZIP", EXR_COMPRESSION_ZIP },
+		{ "PIZ", EXR_COMPRESSION_PIZ },
+		{ "DWAA", EXR_COMPRESSION_DWAA },
+		{ "DWAB", EXR_COMPRESSION_DWAB },
+	};
+
+	// 1, 2, 4, ... workers, ending with every core.
+	std::vector<size_t> GetThreadCounts()
+	{
+		const size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+		std::vector<size_t> counts;
+		for (size_t count = 1; count < cores; count *= 2)
+		{
+			counts.push_back(count);
+		}
+		counts.push_back(cores);
+		return counts;
+	}
+
+	double GetFileMB(const std::wstring& path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes))
+		{
+			return 0.0;
+		}
+		return (static_cast<double>(attributes.nFileSizeHigh) * 4294967296.0 + attributes.nFileSizeLow) / (1024.0 * 1024.0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const int runs = (argc > 1) ? std::max<int>(1, atoi(argv[1])) : 5;
+	const size_t width = (argc > 3) ? std::max<int>(1, atoi(argv[2])) : 3840;
+	const size_t height = (argc > 3) ? std::max<int>(1, atoi(argv[3])) : 2160;
+	const std::vector<size_t> threadCounts = GetThreadCounts();
+	const double decodedMB = static_cast<double>(width * height * 8) / (1024.0 * 1024.0);
+
+	printf("LoadFromEXRFile, %zux%zu RGBA half (%.1f MB decoded), best of %d, decoded MB/s and speedup over 1 worker\n", width, height, decodedMB, runs);
+	printf("%-6s %8s", "codec", "file MB");
+	for (size_t threadCount : threadCounts)
+	{
+		printf(" %8zu thr     ", threadCount);
+	}
+	printf("\n");
+
+	const std::wstring path = Test::TempFilePath(L"EXRDecodeBenchmark.exr");
+	for (const Compression& compression : Compressions)
+	{
+		EXRSaveOptions options;
+		options.compression = compression.compression;
+		if (FAILED(Test::WriteSyntheticEXR(path, width, height, options)))
+		{
+			printf("%-6s could not be written\n", compression.name);
+			continue;
+		}
+
+		printf("%-6s %8.1f", compression.name, GetFileMB(path));
+		double singleMs = 0.0;
+		for (size_t threadCount : threadCounts)
+		{
+			HRESULT hr = S_OK;
+			const double ms = Test::BestOfMilliseconds(runs, [&]
+			{
+				ScratchImage image;
+				hr = LoadFromEXRFile(path.c_str(), threadCount, nullptr, image);
+			});
+			if (FAILED(hr))
+			{
+				printf(" %17s", "failed");
+				continue;
+			}
+
+			if (threadCount == 1)
+			{
+				singleMs = ms;
+			}
+			printf(" %8.0f (x%5.2f)", decodedMB * 1000.0 / ms, singleMs / ms);
+		}
+		printf("\n");
+	}
+	DeleteFileW(path.c_str());
+	return 0;
+}
@@ -0,0 +1,148 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// Compares the two ways LoadFromEXRFile reads a file: the mapping, where the
+// decoders read chunks in place, and the former stream that does a ReadFile
+// and a SetFilePointerEx for every read. For each it reports the decode time
+// and MB/s, and for one load the read and other I/O operations the process
+// issued (GetProcessIoCounters) and its page faults, which is what reading a
+// mapping costs instead. The file was just written, so it is in the cache.
+//
+// usage: EXRFileAccessBenchmark [runs [width height]]
+
+#include "stdafx.h"
+#include "SyntheticEXR.h"
+#include "TestCommon.h"
+
+#include <cstdlib>
+#include <psapi.h>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Compression
+	{
+		const char* name;
+		EXR_COMPRESSION compression;
+	};
+
+	const Compression Compressions[] =
+	{
+		{ "NONE", EXR_COMPRESSION_NONE },
+		{ "ZIPS", EXR_COMPRESSION_ZIPS },
+		{ "ZIP", EXR_COMPRESSION_ZIP },
+		{ "PIZ", EXR_COMPRESSION_PIZ },
+	};
+
+	struct Access
+	{
+		const char* name;
+		EXR_FILE_ACCESS access;
+	};
+
+	const Access Accesses[] =
+	{
+		{ "mapped", EXR_FILE_ACCESS_MAPPED },
+		{ "ReadFile", EXR_FILE_ACCESS_READFILE },
+	};
+
+	struct Counts
+	{
+		ULONGLONG reads;
+		ULONGLONG others;
+		DWORD pageFaults;
+	};
+
+	Counts GetCounts()
+	{
+		IO_COUNTERS io = {};
+		GetProcessIoCounters(GetCurrentProcess(), &io);
+		PROCESS_MEMORY_COUNTERS memory = {};
+		GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+
+		Counts counts;
+		counts.reads = io.ReadOperationCount;
+		counts.others = io.OtherOperationCount;
+		counts.pageFaults = memory.PageFaultCount;
+		return counts;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const int runs = (argc > 1) ? std::max<int>(1, atoi(argv[1])) : 5;
+	const size_t width = (argc > 3) ? std::max<int>(1, atoi(argv[2])) : 3840;
+	const size_t height = (argc > 3) ? std::max<int>(1, atoi(argv[3])) : 2160;
+	const double decodedMB = static_cast<double>(width * height * 8) / (1024.0 * 1024.0);
+	const size_t threadCounts[] = { 1, std::max<size_t>(1, std::thread::hardware_concurrency()) };
+
+	printf("LoadFromEXRFile, %zux%zu RGBA half (%.1f MB decoded), best of %d\n", width, height, decodedMB, runs);
+	printf("%-6s %4s %-9s %10s %9s %10s %10s %10s\n", "codec", "thr", "access", "time", "MB/s", "reads", "other I/O", "faults");
+
+	const std::wstring path = Test::TempFilePath(L"EXRFileAccessBenchmark.exr");
+	for (const Compression& compression : Compressions)
+	{
+		EXRSaveOptions options;
+		options.compression = compression.compression;
+		if (FAILED(Test::WriteSyntheticEXR(path, width, height, options)))
+		{
+			printf("%-6s could not be written\n", compression.name);
+			continue;
+		}
+
+		for (size_t threadCount : threadCounts)
+		{
+			for (const Access& access : Accesses)
+			{
+				HRESULT hr = S_OK;
+				const double ms = Test::BestOfMilliseconds(runs, [&]
+				{
+					ScratchImage image;
+					hr = LoadFromEXRFile(path.c_str(), threadCount, access.access, nullptr, image);
+				});
+
+				// Counted over a load of its own, so that the runs above do not add up.
+				const Counts before = GetCounts();
+				{
+					ScratchImage image;
+					LoadFromEXRFile(path.c_str(), threadCount, access.access, nullptr, image);
+				}
+				const Counts after = GetCounts();
+
+				if (FAILED(hr))
+				{
+					printf("%-6s %4zu %-9s failed with %08X\n", compression.name, threadCount, access.name, static_cast<unsigned>(hr));
+					continue;
+				}
+				printf("%-6s %4zu %-9s %7.1f ms %9.0f %10llu %10llu %10lu\n", compression.name, threadCount, access.name,
+					ms, decodedMB * 1000.0 / ms, after.reads - before.reads, after.others - before.others, after.pageFaults - before.pageFaults);
+			}
+		}
+	}
+	DeleteFileW(path.c_str());
+	return 0;
+}
@@ -0,0 +1,115 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// Times the float to half conversion used by SaveToEXRFile on 4K and 8K RGBA
+// frames: the per-pixel XMStoreHalf4 loop it replaced (Windows only, where
+// DirectXMath is available) against the scalar, SSE2 and F16C kernels.
+//
+// usage: HalfConversionBenchmark [runs]
+
+#include "HalfConversion.h"
+#include "TestCommon.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#if defined(_WIN32)
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#endif
+
+namespace
+{
+	struct Frame
+	{
+		const char* name;
+		size_t width;
+		size_t height;
+	};
+
+	// Magnitudes from 2^-16 to 2^16, so every kernel sees subnormal, normal
+	// and overflowing halves.
+	void FillPixels(float* pixels, size_t count)
+	{
+		uint32_t state = 0x12345678;
+		for (size_t i = 0; i < count; ++i)
+		{
+			state = state * 1664525u + 1013904223u;
+			pixels[i] = std::exp2(static_cast<float>(state >> 8) / static_cast<float>(1 << 24) * 32.0f - 16.0f);
+		}
+	}
+
+#if defined(_WIN32)
+	void ConvertXMStoreHalf4(const float* src, uint16_t* dst, size_t pixelCount)
+	{
+		using namespace DirectX;
+		auto srcPtr = reinterpret_cast<const XMFLOAT4*>(src);
+		auto destPtr = reinterpret_cast<PackedVector::XMHALF4*>(dst);
+		for (size_t k = 0; k < pixelCount; ++k, ++srcPtr, ++destPtr)
+		{
+			XMVECTOR v = XMLoadFloat4(srcPtr);
+			PackedVector::XMStoreHalf4(destPtr, v);
+		}
+	}
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	const int runs = (argc > 1) ? std::max<int>(1, atoi(argv[1])) : 5;
+	const Frame frames[] = { { "4K", 3840, 2160 }, { "8K", 7680, 4320 } };
+	const HalfConversionPath paths[] = { HalfConversionPath::Scalar, HalfConversionPath::SSE2, HalfConversionPath::F16C };
+
+	printf("Float4 to half4, single thread, best of %d (best path on this CPU: %s)\n", runs, GetHalfConversionPathName(HalfConversionPath::Best));
+	printf("%-6s %12s", "frame", "XMStoreHalf4");
+	for (HalfConversionPath path : paths)
+	{
+		printf(" %12s", GetHalfConversionPathName(path));
+	}
+	printf("\n");
+
+	for (const Frame& frame : frames)
+	{
+		const size_t pixelCount = frame.width * frame.height;
+		std::unique_ptr<float[]> src(new float[pixelCount * 4]);
+		std::unique_ptr<uint16_t[]> dst(new uint16_t[pixelCount * 4]);
+		FillPixels(src.get(), pixelCount * 4);
+
+		printf("%-6s", frame.name);
+#if defined(_WIN32)
+		printf(" %9.1f ms", Test::BestOfMilliseconds(runs, [&] { ConvertXMStoreHalf4(src.get(), dst.get(), pixelCount); }));
+#else
+		printf(" %12s", "n/a");
+#endif
+		for (HalfConversionPath path : paths)
+		{
+			printf(" %9.1f ms", Test::BestOfMilliseconds(runs, [&] { ConvertFloat4ToHalf4(src.get(), dst.get(), pixelCount, path); }));
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,271 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// ImageLoader against a NullTextureUploader: each request goes through read,
+// decode, upload and publish in that order, a newer request supersedes the
+// older ones wherever they are in the pipeline, and every stage reports its
+// time.
+
+#include "stdafx.h"
+#include "ImageLoader.h"
+#include "NullTextureUploader.h"
+#include "SyntheticEXR.h"
+#include "TestCommon.h"
+
+#include <condition_variable>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const int TimeoutMs = 30000;
+	const int UploadDelayMs = 50;
+
+	// Holds every Upload() until the test lets it through, and records the width
+	// of each image it is given, which tells the test images apart.
+	class GatedUploader : public NullTextureUploader
+	{
+	public:
+		GatedUploader() : m_permits(0) {}
+
+		virtual HRESULT Upload(const TexMetadata& metadata, const ScratchImage& image, std::shared_ptr<UploadedTexture>& texture) override
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_widths.push_back(metadata.width);
+				m_cv.notify_all();
+				m_cv.wait(lock, [this] { return m_permits > 0; });
+				m_permits--;
+			}
+			return NullTextureUploader::Upload(metadata, image, texture);
+		}
+
+		// Lets count waiting or future uploads through.
+		void Allow(size_t count)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_permits += count;
+			}
+			m_cv.notify_all();
+		}
+
+		// Waits until count uploads have started.
+		bool WaitForUploads(size_t count)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			return m_cv.wait_for(lock, std::chrono::milliseconds(TimeoutMs), [this, count] { return m_widths.size() >= count; });
+		}
+
+		std::vector<size_t> GetWidths()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_widths;
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		size_t m_permits;
+		std::vector<size_t> m_widths;
+	};
+
+	// Takes UploadDelayMs for every Upload(), like a large copy would.
+	class SlowUploader : public NullTextureUploader
+	{
+	public:
+		virtual HRESULT Upload(const TexMetadata& metadata, const ScratchImage& image, std::shared_ptr<UploadedTexture>& texture) override
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(UploadDelayMs));
+			return NullTextureUploader::Upload(metadata, image, texture);
+		}
+	};
+
+	bool WaitForIdle(ImageLoader& loader)
+	{
+		const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(TimeoutMs);
+		while (loader.IsBusy())
+		{
+			if (Clock::now() > deadline)
+			{
+				return false;
+			}
+			WaitForSingleObject(loader.GetResultEvent(), 10);
+		}
+		return true;
+	}
+
+	size_t GetTextureWidth(const LoadResult& result)
+	{
+		std::shared_ptr<NullUploadedTexture> texture = std::dynamic_pointer_cast<NullUploadedTexture>(result.texture);
+		return texture ? texture->metadata.width : 0;
+	}
+
+	void CheckOrdering(const std::wstring& path, size_t width)
+	{
+		GatedUploader uploader;
+		ImageLoader loader(&uploader);
+		loader.Request(path, ImageFileFormat::OpenEXR);
+
+		// The upload starts with the decoded image, and nothing is published
+		// before it returns.
+		CHECK(uploader.WaitForUploads(1));
+		LoadResult result;
+		CHECK(!loader.Poll(result));
+		CHECK(loader.IsBusy());
+
+		uploader.Allow(1);
+		CHECK(WaitForIdle(loader));
+		CHECK(loader.Poll(result));
+		CHECK(result.hr == S_OK);
+		CHECK(result.path == path);
+		CHECK(result.complete);
+		CHECK(result.metadata.width == width);
+		CHECK(GetTextureWidth(result) == width);
+		CHECK(uploader.GetWidths() == std::vector<size_t>(1, width));
+		CHECK(uploader.GetUploadCount() == 1);
+		CHECK(uploader.GetCreateCount() == 0);
+		CHECK(!loader.Poll(result));
+	}
+
+	// Bands go straight into the texture made for the first one, so the upload
+	// stage has nothing left to upload.
+	void CheckProgressiveOrdering(const std::wstring& path, size_t width, size_t height)
+	{
+		NullTextureUploader uploader;
+		ImageLoader loader(&uploader);
+		loader.SetProgressive(true);
+		loader.Request(path, ImageFileFormat::OpenEXR);
+
+		CHECK(WaitForIdle(loader));
+		LoadResult result;
+		CHECK(loader.Poll(result));
+		CHECK(result.hr == S_OK);
+		CHECK(result.complete);
+		CHECK(GetTextureWidth(result) == width);
+		CHECK(uploader.GetCreateCount() == 1);
+		CHECK(uploader.GetUploadCount() == 0);
+		CHECK(uploader.GetUploadedRowCount() == height);
+		CHECK(result.timings.firstBandMs > 0.0);
+		CHECK(result.timings.firstBandMs <= result.timings.totalMs);
+	}
+
+	// a, b and c have different widths. b is requested while a is being uploaded
+	// and c right after it.
+	void CheckSuperseding(const std::wstring& a, size_t widthA, const std::wstring& b, const std::wstring& c, size_t widthC)
+	{
+		GatedUploader uploader;
+		ImageLoader loader(&uploader);
+		loader.Request(a, ImageFileFormat::OpenEXR);
+		CHECK(uploader.WaitForUploads(1));
+
+		// b is dropped wherever it is when c arrives, so it never reaches the
+		// uploader, and a is not published once its upload returns.
+		loader.Request(b, ImageFileFormat::OpenEXR);
+		loader.Request(c, ImageFileFormat::OpenEXR);
+		uploader.Allow(1);
+		CHECK(uploader.WaitForUploads(2));
+		LoadResult result;
+		CHECK(!loader.Poll(result));
+
+		uploader.Allow(1);
+		CHECK(WaitForIdle(loader));
+		CHECK(loader.Poll(result));
+		CHECK(result.hr == S_OK);
+		CHECK(result.path == c);
+		CHECK(GetTextureWidth(result) == widthC);
+
+		std::vector<size_t> expected;
+		expected.push_back(widthA);
+		expected.push_back(widthC);
+		CHECK(uploader.GetWidths() == expected);
+	}
+
+	void CheckTimings(const std::wstring& path)
+	{
+		SlowUploader uploader;
+		ImageCache cache(256 * 1024 * 1024);
+		ImageLoader loader(&uploader, &cache);
+
+		const Clock::time_point start = Clock::now();
+		loader.Request(path, ImageFileFormat::OpenEXR);
+		CHECK(WaitForIdle(loader));
+		const double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		LoadResult result;
+		CHECK(loader.Poll(result));
+		const LoadTimings& timings = result.timings;
+		printf("  read %.2f ms, decode %.2f ms (analyze %.2f ms), upload %.2f ms, total %.2f ms\n",
+			timings.readMs, timings.decodeMs, timings.analyzeMs, timings.uploadMs, timings.totalMs);
+		CHECK(result.hr == S_OK);
+		CHECK(timings.readMs > 0.0);
+		CHECK(timings.decodeMs > 0.0);
+		CHECK(timings.analyzeMs <= timings.decodeMs);
+		CHECK(timings.uploadMs >= UploadDelayMs - 1);
+		CHECK(timings.publishMs == 0.0);	// The render thread fills it in.
+		CHECK(timings.firstBandMs == 0.0);
+		CHECK(timings.readMs + timings.decodeMs + timings.uploadMs <= timings.totalMs);
+		CHECK(timings.totalMs <= wallMs);
+
+		// A cache hit skips the read and decode stages.
+		loader.Request(path, ImageFileFormat::OpenEXR);
+		CHECK(WaitForIdle(loader));
+		CHECK(loader.Poll(result));
+		CHECK(result.hr == S_OK);
+		CHECK(result.timings.readMs == 0.0);
+		CHECK(result.timings.decodeMs == 0.0);
+		CHECK(result.timings.uploadMs >= UploadDelayMs - 1);
+	}
+}
+
+int main()
+{
+	EXRSaveOptions options;
+	const std::wstring a = Test::TempFilePath(L"ImageLoaderTest_a.exr");
+	const std::wstring b = Test::TempFilePath(L"ImageLoaderTest_b.exr");
+	const std::wstring c = Test::TempFilePath(L"ImageLoaderTest_c.exr");
+	const std::wstring large = Test::TempFilePath(L"ImageLoaderTest_large.exr");
+	CHECK(SUCCEEDED(Test::WriteSyntheticEXR(a, 256, 128, options)));
+	CHECK(SUCCEEDED(Test::WriteSyntheticEXR(b, 320, 128, options)));
+	CHECK(SUCCEEDED(Test::WriteSyntheticEXR(c, 384, 128, options)));
+	CHECK(SUCCEEDED(Test::WriteSyntheticEXR(large, 1024, 1024, options)));
+
+	if (Test::FailureCount() == 0)
+	{
+		CheckOrdering(a, 256);
+		CheckProgressiveOrdering(large, 1024, 1024);
+		CheckSuperseding(a, 256, b, c, 384);
+		CheckTimings(large);
+	}
+
+	DeleteFileW(a.c_str());
+	DeleteFileW(b.c_str());
+	DeleteFileW(c.c_str());
+	DeleteFileW(large.c_str());
+
+	return Test::Finish("ImageLoaderTest");
+}
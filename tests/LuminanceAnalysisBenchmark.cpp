@@ -0,0 +1,125 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// Time of the luminance analysis that runs on every load, on 4K, 8K and 16K
+// RGBA half frames as EXR files decode to: each path on a single thread, and
+// the best path in bands across the default thread pool as AnalyzeLuminance does.
+//
+// usage: LuminanceAnalysisBenchmark [runs]
+
+#include "HalfConversion.h"
+#include "LuminanceAnalysis.h"
+#include "TestCommon.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	struct Frame
+	{
+		const char* name;
+		size_t width;
+		size_t height;
+	};
+
+	// A band of random rows repeated down the frame; magnitudes from 2^-16 to 2^12.
+	void FillPixels(uint16_t* pixels, size_t width, size_t height)
+	{
+		const size_t bandRows = 64;
+		std::vector<float> row(width * 4);
+		uint32_t state = 0x12345678;
+		for (size_t y = 0; y < std::min<size_t>(bandRows, height); ++y)
+		{
+			for (float& value : row)
+			{
+				state = state * 1664525u + 1013904223u;
+				value = std::exp2(static_cast<float>(state >> 8) / static_cast<float>(1 << 24) * 28.0f - 16.0f);
+			}
+			ConvertFloat4ToHalf4(row.data(), pixels + y * width * 4, width);
+		}
+		for (size_t y = bandRows; y < height; ++y)
+		{
+			memcpy(pixels + y * width * 4, pixels + (y % bandRows) * width * 4, width * 4 * sizeof(uint16_t));
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const int runs = (argc > 1) ? std::max<int>(1, atoi(argv[1])) : 5;
+	const Frame frames[] = { { "4K", 3840, 2160 }, { "8K", 7680, 4320 }, { "16K", 15360, 8640 } };
+	const LuminanceAnalysisPath paths[] = { LuminanceAnalysisPath::Scalar, LuminanceAnalysisPath::SIMD128 };
+	const size_t threads = ThreadPool::GetDefault().GetConcurrency();
+
+	printf("Luminance analysis of RGBA half, best of %d\n", runs);
+	printf("%-6s", "frame");
+	for (LuminanceAnalysisPath path : paths)
+	{
+		if (path <= GetLuminanceAnalysisPath())
+		{
+			printf(" %12s", GetLuminanceAnalysisPathName(path));
+		}
+	}
+	char pooled[32];
+	snprintf(pooled, sizeof(pooled), "%s x%zu", GetLuminanceAnalysisPathName(LuminanceAnalysisPath::Best), threads);
+	printf(" %12s\n", pooled);
+
+	for (const Frame& frame : frames)
+	{
+		const size_t rowPitch = frame.width * 4 * sizeof(uint16_t);
+		std::unique_ptr<uint16_t[]> pixels(new uint16_t[frame.width * frame.height * 4]);
+		FillPixels(pixels.get(), frame.width, frame.height);
+		const uint32_t width = static_cast<uint32_t>(frame.width);
+		const uint32_t height = static_cast<uint32_t>(frame.height);
+
+		printf("%-6s", frame.name);
+		for (LuminanceAnalysisPath path : paths)
+		{
+			// Paths the CPU lacks fall back to the best one it has; skip the repeats.
+			if (path > GetLuminanceAnalysisPath())
+			{
+				continue;
+			}
+
+			printf(" %9.1f ms", Test::BestOfMilliseconds(runs, [&]
+			{
+				LuminanceAccumulator accumulator;
+				AccumulateLuminance(pixels.get(), rowPitch, width, height, AnalysisPixelFormat::R16G16B16A16_Float, accumulator, path);
+			}));
+		}
+
+		LuminanceStatistics statistics;
+		printf(" %9.1f ms\n", Test::BestOfMilliseconds(runs, [&]
+		{
+			AnalyzeLuminance(pixels.get(), rowPitch, width, height, AnalysisPixelFormat::R16G16B16A16_Float, statistics);
+		}));
+	}
+	return 0;
+}
@@ -0,0 +1,390 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// Luminance analysis: histograms of known images, the edge bins (black, NaN,
+// negative and beyond the FP16 range), the scalar and SIMD128 paths agreeing,
+// and merged band accumulators matching a whole-image analysis. Then the HDR10
+// metadata derived from it: rounding, the ST.2084 cap, the mastering peak
+// choice, nitsScale and the content light levels of a sequence.
+
+#include "LuminanceAnalysis.h"
+#include "TestCommon.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	// Linear scRGB that comes out at the given Rec.709 luminance.
+	float GrayForNits(float nits)
+	{
+		return nits / ScRGBReferenceNits;
+	}
+
+	void SetPixel(std::vector<float>& pixels, size_t index, float r, float g, float b)
+	{
+		pixels[index * 4 + 0] = r;
+		pixels[index * 4 + 1] = g;
+		pixels[index * 4 + 2] = b;
+		pixels[index * 4 + 3] = 1.0f;
+	}
+
+	// The bin by the bin edges, independent of the float bit tricks of the kernels.
+	uint32_t BinOf(float nits)
+	{
+		uint32_t bin = 0;
+		while (bin + 1 < LuminanceHistogramBins && GetLuminanceBinNits(bin + 1) <= nits)
+		{
+			bin++;
+		}
+		return bin;
+	}
+
+	bool Near(double a, double b, double tolerance)
+	{
+		return std::fabs(a - b) <= tolerance * std::max<double>(1.0, std::fabs(b));
+	}
+
+	void Analyze(const std::vector<float>& pixels, uint32_t width, uint32_t height, LuminanceStatistics& statistics,
+		LuminanceAnalysisPath path = LuminanceAnalysisPath::Best)
+	{
+		AnalyzeLuminance(pixels.data(), width * 4 * sizeof(float), width, height, AnalysisPixelFormat::R32G32B32A32_Float, statistics, path);
+	}
+
+	// Magnitudes from 2^-20 to 2^12 with the occasional negative component.
+	std::vector<float> RandomPixels(size_t pixelCount)
+	{
+		std::vector<float> pixels(pixelCount * 4);
+		uint32_t state = 0x2468ace1;
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			state = state * 1664525u + 1013904223u;
+			float value = std::exp2(static_cast<float>(state >> 8) / static_cast<float>(1 << 24) * 32.0f - 20.0f);
+			pixels[i] = ((state & 0x1f) == 0) ? -value : value;
+		}
+		return pixels;
+	}
+
+	void CheckSameStatistics(const LuminanceStatistics& a, const LuminanceStatistics& b)
+	{
+		CHECK(a.pixelCount == b.pixelCount);
+		CHECK(a.minNits == b.minNits);
+		CHECK(a.maxNits == b.maxNits);
+		CHECK(a.maxCLL == b.maxCLL);
+		CHECK(Near(a.meanNits, b.meanNits, 1e-5));
+		CHECK(Near(a.maxFALL, b.maxFALL, 1e-5));
+
+		uint32_t differentBins = 0;
+		for (uint32_t bin = 0; bin < LuminanceHistogramBins; bin++)
+		{
+			differentBins += (a.histogram[bin] != b.histogram[bin]) ? 1 : 0;
+		}
+		CHECK(differentBins == 0);
+	}
+
+	void TestKnownHistogram()
+	{
+		// 8 pixels at 100 nits, 4 at 12.5 and 4 at 1000; all away from the bin edges.
+		const uint32_t width = 4;
+		const uint32_t height = 4;
+		std::vector<float> pixels(width * height * 4);
+		for (size_t i = 0; i < width * height; i++)
+		{
+			const float nits = (i < 8) ? 100.0f : (i < 12) ? 12.5f : 1000.0f;
+			SetPixel(pixels, i, GrayForNits(nits), GrayForNits(nits), GrayForNits(nits));
+		}
+
+		LuminanceStatistics statistics;
+		Analyze(pixels, width, height, statistics);
+		CHECK(statistics.pixelCount == 16);
+		CHECK(statistics.histogram[BinOf(12.5f)] == 4);
+		CHECK(statistics.histogram[BinOf(100.0f)] == 8);
+		CHECK(statistics.histogram[BinOf(1000.0f)] == 4);
+
+		uint64_t total = 0;
+		for (uint32_t bin = 0; bin < LuminanceHistogramBins; bin++)
+		{
+			total += statistics.histogram[bin];
+		}
+		CHECK(total == 16);
+
+		CHECK(Near(statistics.minNits, 12.5, 1e-5));
+		CHECK(Near(statistics.maxNits, 1000.0, 1e-5));
+		CHECK(Near(statistics.meanNits, (8 * 100.0 + 4 * 12.5 + 4 * 1000.0) / 16, 1e-5));
+		CHECK(Near(statistics.maxCLL, 1000.0, 1e-5));
+		CHECK(Near(statistics.maxFALL, statistics.meanNits, 1e-5));
+
+		// The median falls in the 100 nits bin, the 99th percentile in the 1000 nits one.
+		const uint32_t medianBin = BinOf(100.0f);
+		CHECK(statistics.medianNits >= GetLuminanceBinNits(medianBin) && statistics.medianNits <= GetLuminanceBinNits(medianBin + 1));
+		const uint32_t topBin = BinOf(1000.0f);
+		CHECK(statistics.percentile99Nits >= GetLuminanceBinNits(topBin) && statistics.percentile99Nits <= statistics.maxNits);
+
+		// Saturated red: MaxCLL follows the component, the histogram the luminance.
+		SetPixel(pixels, 0, GrayForNits(2000.0f), 0.0f, 0.0f);
+		Analyze(pixels, width, height, statistics);
+		CHECK(Near(statistics.maxCLL, 2000.0, 1e-5));
+		CHECK(statistics.histogram[BinOf(2000.0f * 0.2126f)] == 1);
+	}
+
+	void TestEdgeBins()
+	{
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const float infinity = std::numeric_limits<float>::infinity();
+		const float fp16Max = 65504.0f;
+
+		// Black, NaN, negative and too dark land in the first bin; beyond the
+		// FP16 range is clamped to it and lands in the last.
+		std::vector<float> pixels(8 * 4);
+		SetPixel(pixels, 0, 0.0f, 0.0f, 0.0f);
+		SetPixel(pixels, 1, nan, nan, nan);
+		SetPixel(pixels, 2, -1.0f, -5.0f, -100.0f);
+		SetPixel(pixels, 3, 1e-9f, 1e-9f, 1e-9f);
+		SetPixel(pixels, 4, 1e6f, 1e6f, 1e6f);
+		SetPixel(pixels, 5, infinity, infinity, infinity);
+		SetPixel(pixels, 6, nan, GrayForNits(100.0f), -1.0f);
+		SetPixel(pixels, 7, GrayForNits(100.0f), GrayForNits(100.0f), GrayForNits(100.0f));
+
+		for (LuminanceAnalysisPath path : { LuminanceAnalysisPath::Scalar, LuminanceAnalysisPath::SIMD128 })
+		{
+			LuminanceStatistics statistics;
+			Analyze(pixels, 8, 1, statistics, path);
+			CHECK(statistics.histogram[0] == 4);
+			CHECK(statistics.histogram[LuminanceHistogramBins - 1] == 2);
+			CHECK(statistics.histogram[BinOf(100.0f * 0.7152f)] == 1);
+			CHECK(statistics.histogram[BinOf(100.0f)] == 1);
+			CHECK(statistics.minNits == 0.0f);
+			CHECK(statistics.maxCLL == fp16Max * ScRGBReferenceNits);
+			CHECK(Near(statistics.maxNits, fp16Max * ScRGBReferenceNits, 1e-5));
+			CHECK(std::isfinite(statistics.meanNits) && std::isfinite(statistics.maxFALL));
+		}
+
+		// The bin edges themselves.
+		CHECK(GetLuminanceBinNits(0) == std::exp2(static_cast<float>(LuminanceMinStop)));
+		CHECK(GetLuminanceBinNits(LuminanceHistogramBins) == std::exp2(static_cast<float>(LuminanceMaxStop)));
+		CHECK(GetLuminanceBinNits(1 << LuminanceBinsPerStopBits) == 2.0f * GetLuminanceBinNits(0));
+	}
+
+	void TestPathsMatch()
+	{
+		// An odd width, so that the SIMD128 path also runs its scalar tail.
+		const uint32_t width = 1001;
+		const uint32_t height = 37;
+		const std::vector<float> pixels = RandomPixels(width * height);
+
+		LuminanceStatistics scalar;
+		LuminanceStatistics simd;
+		Analyze(pixels, width, height, scalar, LuminanceAnalysisPath::Scalar);
+		Analyze(pixels, width, height, simd, LuminanceAnalysisPath::SIMD128);
+		CheckSameStatistics(scalar, simd);
+		CHECK(scalar.medianNits == simd.medianNits);
+	}
+
+	void TestMergeMatchesWhole()
+	{
+		const uint32_t width = 257;
+		const uint32_t height = 101;
+		const size_t rowPitch = width * 4 * sizeof(float);
+		const std::vector<float> pixels = RandomPixels(width * height);
+
+		LuminanceStatistics whole;
+		Analyze(pixels, width, height, whole);
+
+		// Uneven bands, merged in order, with an empty accumulator among them.
+		const uint32_t bandRows[] = { 1, 30, 7, 63 };
+		LuminanceAccumulator total;
+		uint32_t y = 0;
+		for (uint32_t rows : bandRows)
+		{
+			LuminanceAccumulator band;
+			AccumulateLuminance(pixels.data() + y * width * 4, rowPitch, width, rows, AnalysisPixelFormat::R32G32B32A32_Float, band);
+			MergeLuminance(band, total);
+			MergeLuminance(LuminanceAccumulator(), total);
+			y += rows;
+		}
+		CHECK(y == height);
+
+		LuminanceStatistics merged;
+		FinishLuminance(total, merged);
+		CheckSameStatistics(whole, merged);
+		CHECK(merged.medianNits == whole.medianNits);
+		CHECK(merged.percentile999Nits == whole.percentile999Nits);
+
+		// Nothing accumulated finishes as zeroes.
+		LuminanceStatistics empty;
+		FinishLuminance(LuminanceAccumulator(), empty);
+		CHECK(empty.pixelCount == 0 && empty.maxNits == 0.0f && empty.maxCLL == 0.0f);
+	}
+
+	ContentLightLevels Levels(float maxCLL, float maxFALL)
+	{
+		ContentLightLevels levels;
+		levels.maxCLL = maxCLL;
+		levels.maxFALL = maxFALL;
+		levels.frameCount = 1;
+		return levels;
+	}
+
+	void TestMetadataRounding()
+	{
+		// Light levels round up to whole nits, never down.
+		HDR10Metadata metadata = DeriveHDR10Metadata(Levels(400.2f, 99.01f));
+		CHECK(metadata.maxCLL == 401.0f);
+		CHECK(metadata.maxFALL == 100.0f);
+		CHECK(metadata.minMasteringNits == 0.001f);
+
+		metadata = DeriveHDR10Metadata(Levels(250.0f, 80.0f));
+		CHECK(metadata.maxCLL == 250.0f);
+		CHECK(metadata.maxFALL == 80.0f);
+
+		metadata = DeriveHDR10Metadata(Levels(0.3f, 0.1f));
+		CHECK(metadata.maxCLL == 1.0f);
+		CHECK(metadata.maxFALL == 1.0f);
+
+		// Nothing measured yet.
+		metadata = DeriveHDR10Metadata(ContentLightLevels());
+		CHECK(metadata.maxCLL == 0.0f);
+		CHECK(metadata.maxFALL == 0.0f);
+		CHECK(metadata.maxMasteringNits == 400.0f);
+	}
+
+	void TestMetadataCap()
+	{
+		// ST.2084 ends at 10000 nits; MaxFALL never exceeds MaxCLL.
+		HDR10Metadata metadata = DeriveHDR10Metadata(Levels(65504.0f * ScRGBReferenceNits, 20000.0f));
+		CHECK(metadata.maxCLL == 10000.0f);
+		CHECK(metadata.maxFALL == 10000.0f);
+		CHECK(metadata.maxMasteringNits == 10000.0f);
+
+		metadata = DeriveHDR10Metadata(Levels(9999.5f, 9999.5f));
+		CHECK(metadata.maxCLL == 10000.0f);
+		CHECK(metadata.maxFALL == 10000.0f);
+
+		metadata = DeriveHDR10Metadata(Levels(10000.5f, 500.0f));
+		CHECK(metadata.maxCLL == 10000.0f);
+		CHECK(metadata.maxFALL == 500.0f);
+	}
+
+	void TestMasteringPeak()
+	{
+		// The smallest common peak that covers MaxCLL: just below and at a peak
+		// pick it, just above picks the next one.
+		const float peaks[] = { 400.0f, 600.0f, 1000.0f, 2000.0f, 4000.0f, 10000.0f };
+		const size_t peakCount = sizeof(peaks) / sizeof(peaks[0]);
+		for (size_t i = 0; i < peakCount; i++)
+		{
+			const float next = peaks[std::min<size_t>(i + 1, peakCount - 1)];
+			CHECK(DeriveHDR10Metadata(Levels(peaks[i] - 1.0f, 1.0f)).maxMasteringNits == peaks[i]);
+			CHECK(DeriveHDR10Metadata(Levels(peaks[i] - 0.5f, 1.0f)).maxMasteringNits == peaks[i]);
+			CHECK(DeriveHDR10Metadata(Levels(peaks[i], 1.0f)).maxMasteringNits == peaks[i]);
+			CHECK(DeriveHDR10Metadata(Levels(peaks[i] + 0.25f, 1.0f)).maxMasteringNits == next);
+			CHECK(DeriveHDR10Metadata(Levels(peaks[i] + 1.0f, 1.0f)).maxMasteringNits == next);
+		}
+	}
+
+	void TestMetadataNitsScale()
+	{
+		// Shown at twice or half the measured nits, as with exposure.
+		HDR10Metadata metadata = DeriveHDR10Metadata(Levels(500.0f, 120.0f), 2.0f);
+		CHECK(metadata.maxCLL == 1000.0f);
+		CHECK(metadata.maxFALL == 240.0f);
+		CHECK(metadata.maxMasteringNits == 1000.0f);
+
+		metadata = DeriveHDR10Metadata(Levels(500.0f, 120.0f), 0.5f);
+		CHECK(metadata.maxCLL == 250.0f);
+		CHECK(metadata.maxFALL == 60.0f);
+		CHECK(metadata.maxMasteringNits == 400.0f);
+
+		// Scaled before rounding and capping.
+		metadata = DeriveHDR10Metadata(Levels(333.3f, 33.3f), 3.0f);
+		CHECK(metadata.maxCLL == 1000.0f);
+		CHECK(metadata.maxFALL == 100.0f);
+		CHECK(metadata.maxMasteringNits == 1000.0f);
+
+		metadata = DeriveHDR10Metadata(Levels(4000.0f, 1000.0f), 4.0f);
+		CHECK(metadata.maxCLL == 10000.0f);
+		CHECK(metadata.maxFALL == 4000.0f);
+	}
+
+	void TestSequenceLightLevels()
+	{
+		// Three measured frames: flat 100 nits, half 400 and half black (a 200
+		// nits average with the brightest pixel), and flat 50 nits.
+		const uint32_t width = 16;
+		const uint32_t height = 8;
+		std::vector<float> pixels(width * height * 4);
+		ContentLightLevels levels;
+		for (int frame = 0; frame < 3; frame++)
+		{
+			for (size_t i = 0; i < width * height; i++)
+			{
+				const float nits = (frame == 0) ? 100.0f : (frame == 2) ? 50.0f : (i % 2 == 0) ? 400.0f : 0.0f;
+				SetPixel(pixels, i, GrayForNits(nits), GrayForNits(nits), GrayForNits(nits));
+			}
+			LuminanceStatistics statistics;
+			Analyze(pixels, width, height, statistics);
+			AddContentLightLevels(statistics, levels);
+		}
+
+		// MaxFALL is the brightest frame average, not the ~117 nits average over the frames.
+		CHECK(levels.frameCount == 3);
+		CHECK(levels.maxCLL == 400.0f);
+		CHECK(levels.maxFALL == 200.0f);
+
+		const HDR10Metadata metadata = DeriveHDR10Metadata(levels);
+		CHECK(metadata.maxCLL == 400.0f);
+		CHECK(metadata.maxFALL == 200.0f);
+		CHECK(metadata.maxMasteringNits == 400.0f);
+
+		// A brighter frame later on raises both levels; a darker one changes neither.
+		LuminanceStatistics bright;
+		bright.maxCLL = 900.0f;
+		bright.maxFALL = 300.0f;
+		AddContentLightLevels(bright, levels);
+		LuminanceStatistics dark;
+		dark.maxCLL = 10.0f;
+		dark.maxFALL = 5.0f;
+		AddContentLightLevels(dark, levels);
+		CHECK(levels.frameCount == 5);
+		CHECK(levels.maxCLL == 900.0f);
+		CHECK(levels.maxFALL == 300.0f);
+		CHECK(DeriveHDR10Metadata(levels).maxMasteringNits == 1000.0f);
+	}
+}
+
+int main()
+{
+	TestKnownHistogram();
+	TestEdgeBins();
+	TestPathsMatch();
+	TestMergeMatchesWhole();
+	TestMetadataRounding();
+	TestMetadataCap();
+	TestMasteringPeak();
+	TestMetadataNitsScale();
+	TestSequenceLightLevels();
+	return Test::Finish("LuminanceAnalysisTest");
+}
@@ -0,0 +1,79 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// Throughput of the output transform at 4K and 8K, with the sRGB and ST.2084
+// encodings evaluated analytically and through the curve LUTs, on every path
+// this CPU supports.
+//
+// usage: OutputTransformBenchmark [iterations]
+
+#include "OutputTransform.h"
+#include "TestCommon.h"
+
+#include <cstdlib>
+
+namespace
+{
+	struct Frame
+	{
+		const char* name;
+		uint32_t width;
+		uint32_t height;
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	const uint32_t iterations = (argc > 1) ? std::max<uint32_t>(1, static_cast<uint32_t>(atoi(argv[1]))) : 3;
+	const Frame frames[] = { { "4K", 3840, 2160 }, { "8K", 7680, 4320 } };
+	const OutputCurve curves[] = { OutputCurve::sRGB, OutputCurve::ST2084 };
+	const OutputTransformPath paths[] = { OutputTransformPath::Scalar, OutputTransformPath::SIMD128, OutputTransformPath::AVX2 };
+
+	printf("Output transform, single thread, %u iterations, Mpixels/s\n", iterations);
+	printf("%-6s %-8s %-7s %10s %10s %8s\n", "frame", "curve", "path", "analytic", "LUT", "speedup");
+	for (const Frame& frame : frames)
+	{
+		for (OutputCurve curve : curves)
+		{
+			for (OutputTransformPath path : paths)
+			{
+				// Paths the CPU lacks fall back to the best one it has; skip the repeats.
+				if (path > GetOutputTransformPath())
+				{
+					continue;
+				}
+
+				OutputTransformParams params;
+				params.curve = curve;
+				const double analytic = BenchmarkOutputTransform(params, path, frame.width, frame.height, iterations);
+				params.useLut = true;
+				const double lut = BenchmarkOutputTransform(params, path, frame.width, frame.height, iterations);
+				printf("%-6s %-8s %-7s %10.1f %10.1f %7.2fx\n", frame.name, GetOutputCurveName(curve), GetOutputTransformPathName(path), analytic, lut,
+					(analytic > 0.0) ? lut / analytic : 0.0);
+			}
+		}
+	}
+	return 0;
+}
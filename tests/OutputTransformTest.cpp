@@ -0,0 +1,326 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// Renders a fixed set of pixels through every output transform path and
+// compares the encoded results with golden images. The goldens were rendered
+// by the scalar path and are checked in under tests/golden as raw
+// little-endian render target texels.
+//
+// usage: OutputTransformTest <golden directory> [--update]
+//
+// --update rewrites the goldens from the scalar path; review the diff of the
+// .bin files like any other change to the expected output.
+//
+// It also checks that the fused pass and the two-pass path, which stores the
+// exposed scene in an FP16 intermediate, agree within one code value, and
+// bounds the error of the curve LUTs.
+
+#include "OutputTransform.h"
+#include "TestCommon.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const uint32_t ImageWidth = 32;
+	const uint32_t ImageHeight = 32;
+	const size_t PixelCount = ImageWidth * ImageHeight;
+	const uint32_t HeatmapWidth = 64;
+
+	struct GoldenCase
+	{
+		const char* name;
+		OutputCurve curve;
+		OutputFormat format;	// The swap chain format the curve is shown in.
+		float standardNits;
+		float exposure;
+		bool heatmap;
+	};
+
+	const GoldenCase GoldenCases[] =
+	{
+		{ "sRGB",			OutputCurve::sRGB,		OutputFormat::R8G8B8A8_UNorm,		80.0f,	0.5f,	false },
+		{ "sRGB_heatmap",	OutputCurve::sRGB,		OutputFormat::R8G8B8A8_UNorm,		80.0f,	0.0f,	true },
+		{ "ST2084",			OutputCurve::ST2084,	OutputFormat::R10G10B10A2_UNorm,	203.0f,	-1.0f,	false },
+		{ "ST2084_heatmap",	OutputCurve::ST2084,	OutputFormat::R10G10B10A2_UNorm,	80.0f,	0.0f,	true },
+		{ "Linear",			OutputCurve::Linear,	OutputFormat::R16G16B16A16_Float,	80.0f,	1.5f,	false },
+		{ "Linear_heatmap",	OutputCurve::Linear,	OutputFormat::R16G16B16A16_Float,	80.0f,	0.0f,	true },
+	};
+
+	// Scene values from 2^-16 to 2^12, one in eight negative (out of gamut
+	// in scRGB), built with ldexp so every platform gets the same bits. The
+	// first pixels are black, reference white, mid grey and a bright highlight.
+	std::vector<float> MakeInput()
+	{
+		std::vector<float> pixels(PixelCount * 4);
+		uint32_t state = 0x2545F491;
+		for (size_t i = 0; i < PixelCount * 4; ++i)
+		{
+			state = state * 1664525u + 1013904223u;
+			const float mantissa = 1.0f + static_cast<float>(state >> 9) / static_cast<float>(1 << 23);
+			const int exponent = static_cast<int>((state >> 3) % 29) - 16;
+			const float sign = ((state & 7) == 0) ? -1.0f : 1.0f;
+			pixels[i] = ((i & 3) == 3) ? 1.0f : sign * std::ldexp(mantissa, exponent);
+		}
+
+		const float fixedPixels[4][4] =
+		{
+			{ 0.0f, 0.0f, 0.0f, 1.0f },
+			{ 1.0f, 1.0f, 1.0f, 1.0f },
+			{ 0.18f, 0.18f, 0.18f, 1.0f },
+			{ 125.0f, 60.0f, 12.5f, 1.0f },
+		};
+		memcpy(pixels.data(), fixedPixels, sizeof(fixedPixels));
+		return pixels;
+	}
+
+	// A stand-in for the heatmap.dds row: a ramp through a few hues.
+	std::vector<float> MakeHeatmap()
+	{
+		std::vector<float> heatmap(HeatmapWidth * 3);
+		for (uint32_t texel = 0; texel < HeatmapWidth; ++texel)
+		{
+			const float t = static_cast<float>(texel) / static_cast<float>(HeatmapWidth - 1);
+			heatmap[texel * 3] = t;
+			heatmap[texel * 3 + 1] = (texel & 1) ? 1.0f - t : t * 0.5f;
+			heatmap[texel * 3 + 2] = 1.0f - t;
+		}
+		return heatmap;
+	}
+
+	std::vector<uint8_t> Render(const std::vector<float>& input, const OutputTransformParams& params, OutputFormat format, OutputTransformPath path)
+	{
+		std::vector<float> output(PixelCount * 4);
+		ApplyOutputTransform(input.data(), output.data(), PixelCount, params, path);
+
+		std::vector<uint8_t> encoded(PixelCount * GetOutputFormatPixelSize(format));
+		EncodeOutput(output.data(), encoded.data(), PixelCount, format);
+		return encoded;
+	}
+
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+		fseek(file, 0, SEEK_END);
+		const long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		data.resize(size > 0 ? static_cast<size_t>(size) : 0);
+		const bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+		fclose(file);
+		return ok;
+	}
+
+	bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			return false;
+		}
+		const bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+		fclose(file);
+		return ok;
+	}
+
+	// The fused shaders skip the FP16 intermediate of the two-pass path. Half
+	// keeps 11 significant bits, finer than any of the encodings resolve, so
+	// the two may differ by one code value next to a rounding edge. Pixels with
+	// negative (out of gamut) channels are reported but not held to that: the
+	// Rec.2020 matrix of ST.2084 can cancel large channels of opposite sign and
+	// magnify their rounding in a small result.
+	void CheckFusedMatchesTwoPass(const std::vector<float>& input, OutputTransformPath path)
+	{
+		for (const GoldenCase& golden : GoldenCases)
+		{
+			if (golden.heatmap)
+			{
+				continue;
+			}
+
+			OutputTransformParams params;
+			params.curve = golden.curve;
+			params.standardNits = golden.standardNits;
+			params.exposure = golden.exposure;
+			const std::vector<uint8_t> fused = Render(input, params, golden.format, path);
+			params.twoPass = true;
+			const std::vector<uint8_t> twoPass = Render(input, params, golden.format, path);
+
+			const size_t pixelSize = GetOutputFormatPixelSize(golden.format);
+			uint32_t maxDifference = 0;
+			uint32_t maxOutOfGamutDifference = 0;
+			for (size_t i = 0; i < PixelCount; ++i)
+			{
+				const float* pixel = &input[i * 4];
+				const bool outOfGamut = pixel[0] < 0.0f || pixel[1] < 0.0f || pixel[2] < 0.0f;
+				const uint32_t difference = GetMaxOutputDifference(fused.data() + i * pixelSize, twoPass.data() + i * pixelSize, 1, golden.format);
+				uint32_t& bound = outOfGamut ? maxOutOfGamutDifference : maxDifference;
+				bound = std::max<uint32_t>(bound, difference);
+			}
+
+			printf("%-15s %-7s fused vs two-pass max difference %u (%u out of gamut)\n",
+				golden.name, GetOutputTransformPathName(path), maxDifference, maxOutOfGamutDifference);
+			CHECK(maxDifference <= 1);
+		}
+	}
+
+	// The LUTs stay within a small fraction of a code value of the analytic
+	// curves, so rendering through them must still match the goldens.
+	void CheckCurveLuts(const std::vector<float>& input, const std::vector<std::vector<uint8_t>>& goldens, const OutputTransformPath* paths, size_t pathCount)
+	{
+		const OutputCurve curves[] = { OutputCurve::sRGB, OutputCurve::ST2084 };
+		for (OutputCurve curve : curves)
+		{
+			const double error10 = MeasureOutputCurveLutError(curve, 10);
+			const double error12 = MeasureOutputCurveLutError(curve, 12);
+			printf("%-15s LUT max error %.3f 10-bit codes, %.3f 12-bit codes\n", GetOutputCurveName(curve), error10, error12);
+			CHECK(error10 < 0.1);
+			CHECK(error12 < 0.25);
+		}
+
+		for (size_t index = 0; index < sizeof(GoldenCases) / sizeof(GoldenCases[0]); ++index)
+		{
+			const GoldenCase& golden = GoldenCases[index];
+			if (golden.heatmap || golden.curve == OutputCurve::Linear || goldens[index].empty())
+			{
+				continue;
+			}
+
+			OutputTransformParams params;
+			params.curve = golden.curve;
+			params.standardNits = golden.standardNits;
+			params.exposure = golden.exposure;
+			params.useLut = true;
+			for (size_t path = 0; path < pathCount; ++path)
+			{
+				const std::vector<uint8_t> actual = Render(input, params, golden.format, paths[path]);
+				const uint32_t maxDifference = GetMaxOutputDifference(goldens[index].data(), actual.data(), PixelCount, golden.format);
+				printf("%-15s %-7s LUT max difference %u\n", golden.name, GetOutputTransformPathName(paths[path]), maxDifference);
+				CHECK(maxDifference <= 1);
+			}
+		}
+	}
+
+	// Pixels that differ from the golden by more than one code value. Only
+	// the heatmap may have any: a pixel right at a texel boundary can pick the
+	// neighbouring texel once pow is approximated.
+	size_t CountDifferingPixels(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, OutputFormat format)
+	{
+		const size_t pixelSize = GetOutputFormatPixelSize(format);
+		size_t count = 0;
+		for (size_t i = 0; i < PixelCount; ++i)
+		{
+			if (GetMaxOutputDifference(a.data() + i * pixelSize, b.data() + i * pixelSize, 1, format) > 1)
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: OutputTransformTest <golden directory> [--update]\n");
+		return 2;
+	}
+	const std::string goldenDirectory = argv[1];
+	const bool update = (argc > 2) && strcmp(argv[2], "--update") == 0;
+
+	const std::vector<float> input = MakeInput();
+	const std::vector<float> heatmap = MakeHeatmap();
+	const OutputTransformPath paths[] = { OutputTransformPath::Scalar, OutputTransformPath::SIMD128, OutputTransformPath::AVX2 };
+
+	std::vector<std::vector<uint8_t>> goldens;
+	for (const GoldenCase& golden : GoldenCases)
+	{
+		goldens.emplace_back();
+		OutputTransformParams params;
+		params.curve = golden.curve;
+		params.standardNits = golden.standardNits;
+		params.exposure = golden.exposure;
+		if (golden.heatmap)
+		{
+			params.heatmap = heatmap.data();
+			params.heatmapWidth = HeatmapWidth;
+		}
+
+		const std::string goldenPath = goldenDirectory + "/OutputTransform_" + golden.name + ".bin";
+		if (update)
+		{
+			CHECK(WriteFile(goldenPath, Render(input, params, golden.format, OutputTransformPath::Scalar)));
+			continue;
+		}
+
+		std::vector<uint8_t>& expected = goldens.back();
+		const bool loaded = ReadFile(goldenPath, expected);
+		CHECK(loaded);
+		CHECK(expected.size() == PixelCount * GetOutputFormatPixelSize(golden.format));
+		if (!loaded || expected.size() != PixelCount * GetOutputFormatPixelSize(golden.format))
+		{
+			expected.clear();
+			continue;
+		}
+
+		for (OutputTransformPath path : paths)
+		{
+			const std::vector<uint8_t> actual = Render(input, params, golden.format, path);
+			const uint32_t maxDifference = GetMaxOutputDifference(expected.data(), actual.data(), PixelCount, golden.format);
+			const size_t differing = CountDifferingPixels(expected, actual, golden.format);
+			printf("%-15s %-7s max difference %u, %zu pixel(s) off by more than one\n", golden.name, GetOutputTransformPathName(path), maxDifference, differing);
+
+			// The scalar path may round differently where the C runtime's
+			// pow does, so it gets the same one code value as the others.
+			if (golden.heatmap)
+			{
+				CHECK(differing * 100 <= PixelCount);
+			}
+			else
+			{
+				CHECK(maxDifference <= 1);
+			}
+		}
+	}
+
+	if (!update)
+	{
+		for (OutputTransformPath path : paths)
+		{
+			CheckFusedMatchesTwoPass(input, path);
+		}
+		CheckCurveLuts(input, goldens, paths, sizeof(paths) / sizeof(paths[0]));
+	}
+
+	return Test::Finish("OutputTransformTest");
+}
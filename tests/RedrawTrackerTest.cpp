@@ -0,0 +1,154 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// RedrawTracker: exposure, curve, image, UI and input events mark the view
+// dirty for the right number of frames, and an idle view stays clean.
+
+#include "RedrawTracker.h"
+#include "TestCommon.h"
+
+namespace
+{
+	// Renders frames the way the main loop does until nothing is owed, and
+	// returns how many it took. Stops at limit so a stuck tracker fails.
+	uint32_t RenderUntilIdle(RedrawTracker& tracker, const ViewState& state, uint32_t limit = 16)
+	{
+		uint32_t frames = 0;
+		while (tracker.NeedsRender(state) && frames < limit)
+		{
+			tracker.ConsumeFrame(state);
+			frames++;
+		}
+		return frames;
+	}
+
+	void TestIdle()
+	{
+		RedrawTracker tracker;
+		ViewState state;
+
+		// The first frame is always drawn, then nothing until something happens.
+		CHECK(tracker.NeedsRender(state));
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+		for (int i = 0; i < 100; i++)
+		{
+			CHECK(!tracker.NeedsRender(state));
+		}
+		CHECK(tracker.GetFramesToRender() == 0);
+
+		// An equal state built from scratch is not a change.
+		ViewState same;
+		CHECK(!tracker.NeedsRender(same));
+	}
+
+	void TestViewStateChanges()
+	{
+		RedrawTracker tracker;
+		ViewState state;
+		RenderUntilIdle(tracker, state);
+
+		state.exposure = 1.5f;
+		CHECK(tracker.NeedsRender(state));
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+
+		state.curve = 1;
+		CHECK(tracker.NeedsRender(state));
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+
+		state.referenceWhiteNits = 203.0f;
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+		state.heatmap = true;
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+		state.curveLut = true;
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+		state.lut3DSize = 65;
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+
+		// Changed and changed back before a frame started: nothing to redraw.
+		ViewState changedBack = state;
+		changedBack.exposure = -2.0f;
+		CHECK(tracker.NeedsRender(changedBack));
+		CHECK(!tracker.NeedsRender(state));
+	}
+
+	// A frame starts from one state and its UI changes it: the view is drawn
+	// once more with the final state.
+	void TestChangeDuringFrame()
+	{
+		RedrawTracker tracker;
+		ViewState state;
+		RenderUntilIdle(tracker, state);
+
+		tracker.OnImagePublished();
+		tracker.ConsumeFrame(state);
+		state.exposure = 0.25f;
+		CHECK(tracker.GetFramesToRender() == 0);
+		CHECK(tracker.NeedsRender(state));
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+		CHECK(!tracker.NeedsRender(state));
+	}
+
+	void TestEvents()
+	{
+		RedrawTracker tracker;
+		ViewState state;
+		RenderUntilIdle(tracker, state);
+
+		tracker.OnImagePublished();
+		CHECK(tracker.NeedsRender(state));
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+
+		tracker.OnUIChanged();
+		CHECK(tracker.NeedsRender(state));
+		CHECK(RenderUntilIdle(tracker, state) == 1);
+
+		// ImGui reacts to input a frame late, so input owes two frames.
+		tracker.OnInput();
+		CHECK(tracker.NeedsRender(state));
+		CHECK(RenderUntilIdle(tracker, state) == RedrawTracker::InputFrameCount);
+
+		tracker.OnWindowChanged();
+		CHECK(RenderUntilIdle(tracker, state) == RedrawTracker::InputFrameCount);
+
+		// Events do not add up; the largest request wins.
+		tracker.OnInput();
+		tracker.OnImagePublished();
+		tracker.OnUIChanged();
+		CHECK(tracker.GetFramesToRender() == RedrawTracker::InputFrameCount);
+		tracker.Invalidate(5);
+		tracker.Invalidate(1);
+		CHECK(RenderUntilIdle(tracker, state) == 5);
+		CHECK(!tracker.NeedsRender(state));
+	}
+}
+
+int main()
+{
+	TestIdle();
+	TestViewStateChanges();
+	TestChangeDuringFrame();
+	TestEvents();
+	return Test::Finish("RedrawTrackerTest");
+}
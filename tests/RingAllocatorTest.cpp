@@ -0,0 +1,161 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// RingAllocator bookkeeping: wrap-around at the end of the ring, alignment
+// padding, a full ring, retirement out of order and reclaiming oldest first.
+
+#include "RingAllocator.h"
+#include "TestCommon.h"
+
+namespace
+{
+	const uint64_t Invalid = RingAllocator::InvalidOffset;
+
+	void TestWrapAround()
+	{
+		RingAllocator ring(16);
+		uint64_t a, b, c, d;
+		CHECK(ring.Allocate(8, 1, a) == 0);
+		CHECK(ring.Allocate(6, 1, b) == 8);
+		ring.Retire(a, 1);
+		ring.Reclaim(1);
+		CHECK(ring.GetUsedBytes() == 6);
+
+		// 14..15 is too small for 4 bytes, so it starts over at 0 and the two
+		// skipped bytes at the end belong to the new allocation.
+		CHECK(ring.Allocate(4, 1, c) == 0);
+		CHECK(ring.GetUsedBytes() == 12);
+		CHECK(ring.Allocate(5, 1, d) == Invalid);
+		CHECK(ring.Allocate(4, 1, d) == 4);
+		CHECK(ring.GetUsedBytes() == 16);
+
+		// 8..13 comes back with b, but 14..15 only comes back with c.
+		ring.Retire(b, 2);
+		ring.Reclaim(2);
+		CHECK(ring.GetUsedBytes() == 10);
+		CHECK(ring.Allocate(8, 1, a) == Invalid);
+		ring.Retire(c, 3);
+		ring.Reclaim(3);
+		CHECK(ring.GetUsedBytes() == 4);
+		CHECK(ring.Allocate(8, 1, a) == 8);
+	}
+
+	void TestAlignment()
+	{
+		RingAllocator ring(64);
+		uint64_t a, b, c;
+		CHECK(ring.Allocate(3, 1, a) == 0);
+		CHECK(ring.Allocate(8, 16, b) == 16);
+		CHECK(ring.GetUsedBytes() == 24);
+
+		// The padding 3..15 is freed with b, not with a.
+		ring.Retire(a, 1);
+		ring.Reclaim(1);
+		CHECK(ring.GetUsedBytes() == 21);
+		ring.Retire(b, 1);
+		ring.Reclaim(1);
+		CHECK(ring.GetUsedBytes() == 0);
+
+		CHECK(ring.Allocate(8, 3, c) == Invalid);
+		CHECK(ring.Allocate(8, 0, c) == Invalid);
+		CHECK(ring.GetAllocationCount() == 0);
+	}
+
+	void TestFull()
+	{
+		RingAllocator ring(16);
+		uint64_t a, b;
+		CHECK(ring.Allocate(0, 1, a) == Invalid);
+		CHECK(ring.Allocate(17, 1, a) == Invalid);
+		CHECK(ring.Allocate(16, 1, a) == 0);
+		CHECK(ring.Allocate(1, 1, b) == Invalid);
+
+		// Retired but not yet reached by the fence is still full.
+		ring.Retire(a, 4);
+		ring.Reclaim(3);
+		CHECK(ring.Allocate(1, 1, b) == Invalid);
+		CHECK(ring.GetOldestFenceValue() == 4);
+
+		// An empty ring starts over at 0, so the whole capacity fits again.
+		ring.Reclaim(4);
+		CHECK(ring.GetUsedBytes() == 0);
+		CHECK(ring.Allocate(16, 1, b) == 0);
+	}
+
+	void TestOutOfOrderRetire()
+	{
+		RingAllocator ring(16);
+		uint64_t a, b, c;
+		ring.Allocate(4, 1, a);
+		ring.Allocate(4, 1, b);
+		ring.Allocate(4, 1, c);
+
+		// The newer ones are retired first, for fences that finish in the opposite order.
+		ring.Retire(c, 1);
+		ring.Retire(b, 2);
+		ring.Reclaim(5);
+		CHECK(ring.GetAllocationCount() == 3);
+		CHECK(ring.GetOldestFenceValue() == 0);
+
+		ring.Retire(a, 3);
+		CHECK(ring.GetOldestFenceValue() == 3);
+		ring.Reclaim(2);
+		CHECK(ring.GetAllocationCount() == 3);
+		ring.Reclaim(3);
+		CHECK(ring.GetAllocationCount() == 0);
+		CHECK(ring.GetUsedBytes() == 0);
+	}
+
+	void TestReclaimStopsAtUnretired()
+	{
+		RingAllocator ring(16);
+		uint64_t a, b, c;
+		ring.Allocate(4, 1, a);
+		ring.Allocate(4, 1, b);
+		ring.Allocate(4, 1, c);
+		ring.Retire(a, 1);
+		ring.Retire(c, 1);
+
+		// c is done as well, but b in front of it still holds the tail.
+		ring.Reclaim(10);
+		CHECK(ring.GetAllocationCount() == 2);
+		CHECK(ring.GetUsedBytes() == 8);
+		CHECK(ring.GetOldestFenceValue() == 0);
+
+		ring.Retire(b, 2);
+		ring.Reclaim(10);
+		CHECK(ring.GetAllocationCount() == 0);
+	}
+}
+
+int main()
+{
+	TestWrapAround();
+	TestAlignment();
+	TestFull();
+	TestOutOfOrderRetire();
+	TestReclaimStopsAtUnretired();
+	return Test::Finish("RingAllocatorTest");
+}
@@ -0,0 +1,176 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+// Streamed EXR loads keep host memory bounded: scanline files of growing size
+// go through ImageLoader with streaming on and a NullTextureUploader, and the
+// peak private bytes of each load must stay under one fixed bound and must not
+// grow with the image. Each file is written and loaded in a child process of
+// its own, so that one load's peak cannot hide another's.
+
+#include "stdafx.h"
+#include "ImageLoader.h"
+#include "NullTextureUploader.h"
+#include "SyntheticEXR.h"
+#include "TestCommon.h"
+
+#include <psapi.h>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// Exit code of a child that failed; anything else is a peak in MB.
+	const DWORD ChildFailed = 0xFFFF;
+
+	const int TimeoutMs = 120000;
+
+	// Band buffers, decoder state and luminance accumulators per decode worker.
+	const size_t WorkerMB = 8;
+	const size_t BaseMB = 64;
+
+	// How much more the largest load may take than the smallest.
+	const size_t GrowthMB = 16;
+
+	struct Size
+	{
+		size_t width;
+		size_t height;
+	};
+
+	const Size Sizes[] = { { 1024, 1024 }, { 2048, 2048 }, { 4096, 4096 }, { 8192, 4096 } };
+
+	DWORD RunChild(const std::wstring& arguments)
+	{
+		wchar_t executable[MAX_PATH];
+		GetModuleFileNameW(nullptr, executable, MAX_PATH);
+		std::wstring commandLine = L"\"" + std::wstring(executable) + L"\" " + arguments;
+
+		STARTUPINFOW startup = {};
+		startup.cb = sizeof(startup);
+		PROCESS_INFORMATION process = {};
+		if (!CreateProcessW(executable, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process))
+		{
+			return ChildFailed;
+		}
+
+		WaitForSingleObject(process.hProcess, INFINITE);
+		DWORD exitCode = ChildFailed;
+		GetExitCodeProcess(process.hProcess, &exitCode);
+		CloseHandle(process.hThread);
+		CloseHandle(process.hProcess);
+		return exitCode;
+	}
+
+	int WriteInput(const wchar_t* path, const wchar_t* width, const wchar_t* height)
+	{
+		EXRSaveOptions options;
+		HRESULT hr = Test::WriteSyntheticEXR(path, _wtoi(width), _wtoi(height), options);
+		return SUCCEEDED(hr) ? 0 : static_cast<int>(ChildFailed);
+	}
+
+	// Returns the peak private bytes of the load in MB. The peak working set also
+	// counts the pages of the mapped file, which are clean and can be dropped
+	// at any time, so it is only reported.
+	int MeasureLoad(const wchar_t* path)
+	{
+		PROCESS_MEMORY_COUNTERS before = {};
+		GetProcessMemoryInfo(GetCurrentProcess(), &before, sizeof(before));
+
+		NullTextureUploader uploader;
+		LoadResult result;
+		bool loaded = false;
+		{
+			ImageLoader loader(&uploader);
+			loader.SetStreaming(true);
+			loader.Request(path, ImageFileFormat::OpenEXR);
+
+			const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(TimeoutMs);
+			while (loader.IsBusy() && Clock::now() < deadline)
+			{
+				WaitForSingleObject(loader.GetResultEvent(), 10);
+			}
+			loaded = !loader.IsBusy() && loader.Poll(result);
+		}
+
+		PROCESS_MEMORY_COUNTERS after = {};
+		GetProcessMemoryInfo(GetCurrentProcess(), &after, sizeof(after));
+
+		if (!loaded || FAILED(result.hr) || !result.complete || uploader.GetUploadedRowCount() != result.metadata.height)
+		{
+			return static_cast<int>(ChildFailed);
+		}
+
+		const size_t peakMB = (after.PeakPagefileUsage - before.PagefileUsage) >> 20;
+		const size_t workingSetMB = (after.PeakWorkingSetSize - before.WorkingSetSize) >> 20;
+		printf("  %zux%zu: peak private %zu MB, peak working set %zu MB\n",
+			result.metadata.width, result.metadata.height, peakMB, workingSetMB);
+		return static_cast<int>(peakMB);
+	}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc == 5 && wcscmp(argv[1], L"--write") == 0)
+	{
+		return WriteInput(argv[2], argv[3], argv[4]);
+	}
+	if (argc == 3 && wcscmp(argv[1], L"--load") == 0)
+	{
+		return MeasureLoad(argv[2]);
+	}
+
+	const size_t boundMB = BaseMB + std::max<size_t>(1, std::thread::hardware_concurrency()) * WorkerMB;
+	printf("bound %zu MB, growth %zu MB\n", boundMB, GrowthMB);
+
+	size_t smallestMB = 0;
+	for (size_t i = 0; i < _countof(Sizes); ++i)
+	{
+		const Size& size = Sizes[i];
+		const std::wstring path = Test::TempFilePath(L"StreamedEXRMemoryTest.exr");
+		const std::wstring quotedPath = L"\"" + path + L"\"";
+
+		DWORD exitCode = RunChild(L"--write " + quotedPath + L" " + std::to_wstring(size.width) + L" " + std::to_wstring(size.height));
+		CHECK(exitCode == 0);
+		if (exitCode == 0)
+		{
+			const size_t imageMB = (size.width * size.height * 8) >> 20;
+			exitCode = RunChild(L"--load " + quotedPath);
+			printf("  %zux%zu: %zu MB decoded, exit code %lu\n", size.width, size.height, imageMB, exitCode);
+
+			CHECK(exitCode != ChildFailed);
+			CHECK(exitCode <= boundMB);
+			if (i == 0)
+			{
+				smallestMB = exitCode;
+			}
+			CHECK(exitCode <= smallestMB + GrowthMB);
+		}
+		DeleteFileW(path.c_str());
+	}
+
+	return Test::Finish("StreamedEXRMemoryTest");
+}
@@ -0,0 +1,74 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include "DirectXTexEXR.h"
+#include "HalfConversion.h"
+
+#include <string>
+
+// Input files for the Windows tests and benchmarks of the EXR and loader
+// modules, written on the fly so that no image has to be checked in.
+namespace Test
+{
+	// A file name in the user's temp directory.
+	inline std::wstring TempFilePath(const std::wstring& name)
+	{
+		wchar_t directory[MAX_PATH];
+		const DWORD length = GetTempPathW(MAX_PATH, directory);
+		return std::wstring(directory, length) + name;
+	}
+
+	// Writes a half-float RGBA EXR of smooth gradients with a little noise, so
+	// that it compresses like a photograph rather than a flat fill.
+	inline HRESULT WriteSyntheticEXR(const std::wstring& path, size_t width, size_t height, const DirectX::EXRSaveOptions& options)
+	{
+		DirectX::ScratchImage image;
+		HRESULT hr = image.Initialize2D(DXGI_FORMAT_R16G16B16A16_FLOAT, width, height, 1, 1);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		const DirectX::Image& target = *image.GetImage(0, 0, 0);
+		uint32_t noise = 1;
+		for (size_t y = 0; y < height; ++y)
+		{
+			uint16_t* row = reinterpret_cast<uint16_t*>(target.pixels + y * target.rowPitch);
+			for (size_t x = 0; x < width; ++x)
+			{
+				noise = noise * 1664525u + 1013904223u;
+				const float grain = static_cast<float>(noise >> 24) / 2048.0f;
+				row[x * 4 + 0] = ConvertFloatToHalf(4.0f * x / width + grain);
+				row[x * 4 + 1] = ConvertFloatToHalf(2.0f * y / height + grain);
+				row[x * 4 + 2] = ConvertFloatToHalf(0.25f + grain);
+				row[x * 4 + 3] = ConvertFloatToHalf(1.0f);
+			}
+		}
+
+		return DirectX::SaveToEXRFile(target, path.c_str(), options);
+	}
+}
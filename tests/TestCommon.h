@@ -0,0 +1,77 @@
+//*********************************************************
+//
+// MIT License
+// Copyright(c) 2018 Masafumi Takahashi / Shader.jp
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*********************************************************
+
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+
+// Helpers shared by the test and benchmark executables. A test is a plain
+// main() that returns nonzero when a check failed, which is all ctest needs.
+namespace Test
+{
+	inline int& FailureCount()
+	{
+		static int count = 0;
+		return count;
+	}
+
+	inline void Fail(const char* file, int line, const char* expression)
+	{
+		fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+		++FailureCount();
+	}
+
+	// Prints the summary line and returns the exit code for main().
+	inline int Finish(const char* name)
+	{
+		if (FailureCount() != 0)
+		{
+			printf("%s: %d check(s) failed\n", name, FailureCount());
+			return 1;
+		}
+		printf("%s: passed\n", name);
+		return 0;
+	}
+
+	// The fastest of runs calls of func, in milliseconds.
+	template <typename Func>
+	double BestOfMilliseconds(int runs, Func&& func)
+	{
+		double best = std::numeric_limits<double>::max();
+		for (int run = 0; run < runs; ++run)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			func();
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min<double>(best, elapsed.count());
+		}
+		return best;
+	}
+}
+
+#define CHECK(expression) ((expression) ? (void)0 : Test::Fail(__FILE__, __LINE__, #expression))